@@ -49,6 +49,7 @@
 
 #include "wicked-client.h"
 #include "appconfig.h"
+#include "snapshot.h"
 #include "ifcheck.h"
 #include "ifstatus.h"
 
@@ -616,6 +617,23 @@ ni_ifstatus_show_status(const char *ifname, unsigned int status)
 	if_printf(ifname, "", "%s\n", ni_ifstatus_code_name(status));
 }
 
+static void
+ni_ifstatus_show_device(ni_netdev_t *dev, ni_bool_t verbose)
+{
+	ni_ifstatus_show_iflink (dev, verbose);
+	ni_ifstatus_show_iftype (dev, verbose);
+
+	/* TODO: Hmm... this is the running config only;
+	 *              show current config info too?
+	 */
+	ni_ifstatus_show_control (dev, verbose);
+	ni_ifstatus_show_config (dev, verbose);
+	ni_ifstatus_show_leases (dev, verbose);
+
+	ni_ifstatus_show_addrs  (dev, verbose);
+	ni_ifstatus_show_routes (dev, verbose);
+}
+
 static int
 ni_ifstatus_to_retcode(int status, ni_bool_t mandatory)
 {
@@ -661,6 +679,7 @@ ni_do_ifstatus(int argc, char **argv)
 	ni_bool_t         opt_transient = FALSE;
 	ni_bool_t         check_config;
 	ni_fsm_t *        fsm;
+	ni_netconfig_t *  nc = NULL;
 	unsigned int      i, nmarked;
 
 	/* Allocate fsm and set to read-only */
@@ -728,6 +747,53 @@ ni_do_ifstatus(int argc, char **argv)
 			goto usage;
 	}
 
+	for (c = optind; c < argc; ++c) {
+		if (ni_string_eq(argv[c], "all")) {
+			all = TRUE;
+			break;
+		}
+		if (ni_string_array_index(&ifnames, argv[c]) == -1)
+			ni_string_array_append(&ifnames, argv[c]);
+	}
+	if (all)
+		ni_string_array_destroy(&ifnames);
+	if (ifnames.count > 1 || all)
+		multiple = TRUE;
+
+	/*
+	 * Without configs to check and details to show, the
+	 * state snapshot published by wickedd is sufficient
+	 * and we do not need to fetch all objects over dbus.
+	 */
+	if (!check_config && opt_ifconfig.count == 0 && opt_verbose <= OPT_NORMAL &&
+	    (nc = ni_state_snapshot_load(NULL))) {
+		ni_netdev_t *dev;
+
+		status = NI_WICKED_ST_OK;
+		for (dev = ni_netconfig_devlist(nc), nmarked = 0; dev; dev = dev->next) {
+			unsigned int st;
+			ni_bool_t mandatory = TRUE;
+
+			if (!all && ni_string_array_index(&ifnames, dev->name) == -1)
+				continue;
+
+			if (nmarked && opt_verbose > OPT_BRIEF)
+				printf("\n");
+
+			st = ni_ifstatus_of_device(dev, &mandatory);
+			ni_uint_array_append(&stcodes, st);
+			ni_uint_array_append(&stflags, mandatory);
+			nmarked++;
+
+			if (opt_verbose > OPT_QUIET)
+				ni_ifstatus_show_status(dev->name, st);
+
+			if (opt_verbose > OPT_BRIEF)
+				ni_ifstatus_show_device(dev, FALSE);
+		}
+		goto show_result;
+	}
+
 	if (!ni_fsm_create_client(fsm)) {
 		/* Severe error we always explicitly return */
 		status = NI_WICKED_ST_ERROR;
@@ -753,22 +819,6 @@ ni_do_ifstatus(int argc, char **argv)
 	}
 
 	status = NI_WICKED_ST_OK;
-	for (c = optind; c < argc; ++c) {
-		char *ifname = argv[c];
-
-		if (ni_string_eq(ifname, "all")) {
-			ni_string_array_destroy(&ifnames);
-			all = TRUE;
-			break;
-		}
-
-		if (ni_string_array_index(&ifnames, ifname) == -1)
-			ni_string_array_append(&ifnames, ifname);
-	}
-
-	if (ifnames.count > 1 || all)
-		multiple = TRUE;
-
 	for (i = 0, nmarked = 0; i < fsm->workers.count; ++i) {
 		ni_ifworker_t *w = fsm->workers.data[i];
 		ni_netdev_t *dev = w->device;
@@ -798,22 +848,11 @@ ni_do_ifstatus(int argc, char **argv)
 		if (opt_verbose <= OPT_BRIEF)
 			continue;
 
-		if (dev) {
-			ni_ifstatus_show_iflink (dev, opt_verbose > OPT_NORMAL);
-			ni_ifstatus_show_iftype (dev, opt_verbose > OPT_NORMAL);
-
-			/* TODO: Hmm... this is the running config only;
-			 *              show current config info too?
-			 */
-			ni_ifstatus_show_control (dev, opt_verbose > OPT_NORMAL);
-			ni_ifstatus_show_config (dev, opt_verbose > OPT_NORMAL);
-			ni_ifstatus_show_leases (dev, opt_verbose > OPT_NORMAL);
-
-			ni_ifstatus_show_addrs  (dev, opt_verbose > OPT_NORMAL);
-			ni_ifstatus_show_routes (dev, opt_verbose > OPT_NORMAL);
-		}
+		if (dev)
+			ni_ifstatus_show_device(dev, opt_verbose > OPT_NORMAL);
 	}
 
+show_result:
 	if (nmarked == 0) {
 		if (opt_verbose > OPT_QUIET)
 			printf("ifstatus: no matching interfaces\n");
@@ -850,6 +889,8 @@ ni_do_ifstatus(int argc, char **argv)
 	}
 
 cleanup:
+	if (nc)
+		ni_netconfig_free(nc);
 	ni_uint_array_destroy(&stcodes);
 	ni_uint_array_destroy(&stflags);
 	ni_string_array_destroy(&ifnames);
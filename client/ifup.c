@@ -214,59 +214,59 @@ error:
 	return NULL;
 }
 
-static ni_bool_t
-ni_ifup_start_policy(ni_ifworker_t *w)
+static xml_node_t *
+ni_ifup_generate_policy(ni_ifworker_t *w)
 {
 	xml_node_t *match, *policy = NULL;
-	ni_bool_t rv = FALSE;
+	const char *origin;
 	char *pname;
 
 	if (!w || !w->config.node)
-		return rv;
+		return NULL;
 
 	ni_debug_application("%s: hiring nanny", w->name);
 
 	match = __ni_ifup_generate_match(NI_NANNY_IFPOLICY_MATCH, w);
 	if (!match)
-		goto error;
+		return NULL;
 
 	pname  = ni_ifpolicy_name_from_ifname(w->name);
 	ni_debug_application("%s: converting config into policy '%s'",
 			w->name, pname);
 
+	origin = w->config.meta.origin;
 	policy = ni_convert_cfg_into_policy_node(w->config.node, match,
-			pname, w->config.meta.origin);
+			pname, origin);
 	ni_string_free(&pname);
 	xml_node_free(match);
 	if (!policy)
-		goto error;
+		return NULL;
+
+	if (!ni_ifconfig_is_policy(policy) ||
+	    !ni_ifpolicy_name_is_valid(ni_ifpolicy_get_name(policy))) {
+		ni_debug_ifconfig("Rejecting to add invalid policy from %s",
+			ni_string_empty(origin) ? "unspecified origin" : origin);
+		xml_node_free(policy);
+		return NULL;
+	}
 
 	ni_debug_application("%s: adding policy %s to nanny", w->name,
 		xml_node_get_attr(policy, NI_NANNY_IFPOLICY_NAME));
-
-	if (ni_nanny_addpolicy_node(policy, w->config.meta.origin) <= 0)
-		goto error;
-
-	ni_debug_application("%s: nanny hired!", w->name);
-	ni_ifworker_success(w);
-
-	rv = TRUE;
-
-error:
-	if (!rv)
-		ni_ifworker_fail(w, "unable to apply configuration to nanny");
-	xml_node_free(policy);
-	return rv;
+	return policy;
 }
 
 ni_bool_t
 ni_ifup_hire_nanny(ni_ifworker_array_t *array, ni_bool_t set_persistent)
 {
+	ni_ifworker_array_t hired = NI_IFWORKER_ARRAY_INIT;
+	xml_node_array_t policies = XML_NODE_ARRAY_INIT;
+	ni_string_array_t names = NI_STRING_ARRAY_INIT;
+	ni_bool_t *status = NULL;
+	xml_node_t *policy;
 	unsigned int i;
 	ni_bool_t rv = TRUE;
-	ni_string_array_t names = NI_STRING_ARRAY_INIT;
 
-	/* Send policies to nanny */
+	/* Generate the policies and send them to nanny in batches */
 	for (i = 0; i < array->count; i++) {
 		ni_ifworker_t *w = array->data[i];
 
@@ -276,13 +276,36 @@ ni_ifup_hire_nanny(ni_ifworker_array_t *array, ni_bool_t set_persistent)
 		if (set_persistent)
 			ni_client_state_set_persistent(w->config.node);
 
-		if (!ni_ifup_start_policy(w))
+		if (!(policy = ni_ifup_generate_policy(w))) {
+			ni_ifworker_fail(w, "unable to apply configuration to nanny");
+			rv = FALSE;
+			continue;
+		}
+
+		ni_ifworker_array_append(&hired, w);
+		xml_node_array_append(&policies, policy);
+		xml_node_free(policy);
+	}
+
+	if (policies.count && (status = calloc(policies.count, sizeof(*status))))
+		ni_nanny_call_add_policies(&policies, status);
+
+	for (i = 0; i < hired.count; i++) {
+		ni_ifworker_t *w = hired.data[i];
+
+		if (!status || !status[i]) {
+			ni_ifworker_fail(w, "unable to apply configuration to nanny");
 			rv = FALSE;
-		else {
+		} else {
+			ni_debug_application("%s: nanny hired!", w->name);
+			ni_ifworker_success(w);
 			ni_info("%s: configuration applied to nanny", w->name);
 			ni_string_array_append(&names, w->name);
 		}
 	}
+	free(status);
+	xml_node_array_destroy(&policies);
+	ni_ifworker_array_destroy(&hired);
 
 	/* Recheck policies on modified devices */
 	if (0 == array->count)
@@ -378,8 +401,9 @@ ni_nanny_fsm_monitor_new(ni_fsm_t *fsm)
 
 	monitor = calloc(1, sizeof(*monitor));
 	if (monitor) {
-		ni_dbus_client_add_signal_handler(client, NULL, NULL,
-				NI_OBJECTMODEL_MANAGED_NETIF_INTERFACE,
+		ni_dbus_client_add_signal_member_handler(client, NULL,
+				NI_OBJECTMODEL_MANAGED_NETIF_LIST_PATH,
+				NI_OBJECTMODEL_MANAGED_NETIF_INTERFACE, NULL,
 				ni_nanny_fsm_monitor_handler, monitor);
 	}
 	return monitor;
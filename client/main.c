@@ -1125,6 +1125,17 @@ do_lease(int argc, char **argv)
 	opt_file = argv[1];
 	opt_cmd = argv[2];
 
+	if (!strcmp(opt_cmd, "show")) {
+		xml_node_t *xml;
+
+		/* print a (binary) lease file as xml */
+		if (!(xml = ni_addrconf_lease_file_load(opt_file)))
+			return 1;
+		xml_node_print(xml, stdout);
+		xml_node_free(xml);
+		return 0;
+	}
+
 	if (!strcmp(opt_cmd, "new")) {
 		doc = xml_document_new();
 
@@ -1391,6 +1402,7 @@ usage:
 			"  {set|add}-route <ipaddr>/prefixlen [netmask <ipmask>] [gateway <ipaddr>]\n"
 			"  {set|add}-resolver [default-domain <domain>] [server <ipaddr> ...] [search <domain> ...]\n"
 			"  install --device <object-path>\n"
+			"  show\n"
 		       );
 		return ret;
 	}
@@ -444,6 +444,75 @@ ni_nanny_call_add_policy(const char *name, xml_node_t *node)
 	return rv == 0;
 }
 
+/*
+ * Create or update a batch of policies using createPolicies calls,
+ * each carrying up to NI_NANNY_CALL_POLICIES_MAX policies; status[i]
+ * is set when the i-th policy has been applied. When the nanny does
+ * not support the call, fall back to a createPolicy call per policy.
+ */
+#define NI_NANNY_CALL_POLICIES_MAX	256
+
+unsigned int
+ni_nanny_call_add_policies(const xml_node_array_t *policies, ni_bool_t *status)
+{
+	ni_dbus_object_t *root_object = NULL;
+	unsigned int i, n, count = 0;
+
+	if (!policies || !status)
+		return 0;
+
+	memset(status, 0, policies->count * sizeof(*status));
+	if (!ni_nanny_create_client(&root_object) || !root_object) {
+		ni_debug_application("Unable to create nanny client to add policies");
+		return 0;
+	}
+
+	for (i = 0; i < policies->count; i += n) {
+		ni_dbus_variant_t argv = NI_DBUS_VARIANT_INIT;
+		ni_dbus_variant_t res = NI_DBUS_VARIANT_INIT;
+		DBusError error = DBUS_ERROR_INIT;
+		unsigned int k;
+
+		n = min_t(unsigned int, policies->count - i, NI_NANNY_CALL_POLICIES_MAX);
+
+		ni_dbus_variant_init_string_array(&argv);
+		for (k = 0; k < n; ++k) {
+			char *policy_xml = xml_node_sprint(policies->data[i + k]);
+
+			ni_dbus_variant_append_string_array(&argv, policy_xml ? policy_xml : "");
+			ni_string_free(&policy_xml);
+		}
+
+		ni_debug_application("Calling %s.createPolicies(%u policies)",
+				ni_dbus_object_get_path(root_object), n);
+		if (!ni_dbus_object_call_variant(root_object, NI_OBJECTMODEL_NANNY_INTERFACE,
+					"createPolicies", 1, &argv, 1, &res, &error)) {
+			ni_debug_application("Call to %s.createPolicies() failed: %s",
+					ni_dbus_object_get_path(root_object), error.message);
+			dbus_error_free(&error);
+
+			for (k = 0; k < n; ++k) {
+				xml_node_t *pnode = policies->data[i + k];
+
+				status[i + k] = ni_nanny_call_add_policy(ni_ifpolicy_get_name(pnode), pnode);
+			}
+		} else
+		if (ni_dbus_variant_is_string_array(&res)) {
+			for (k = 0; k < n && k < res.array.len; ++k)
+				status[i + k] = !ni_string_empty(res.string_array_value[k]);
+		}
+
+		ni_dbus_variant_destroy(&argv);
+		ni_dbus_variant_destroy(&res);
+	}
+
+	for (i = 0; i < policies->count; ++i) {
+		if (status[i])
+			count++;
+	}
+	return count;
+}
+
 ni_bool_t
 ni_nanny_call_del_policy(const char *name)
 {
@@ -23,6 +23,7 @@ typedef struct ni_dbus_dict_entry ni_dbus_dict_entry_t;
 typedef struct ni_dbus_method	ni_dbus_method_t;
 typedef struct ni_dbus_property	ni_dbus_property_t;
 typedef struct ni_dbus_variant	ni_dbus_variant_t;
+typedef struct ni_dbus_dispatch	ni_dbus_dispatch_t;
 
 struct ni_dbus_variant {
 	/* the dbus type of this value */
@@ -143,7 +144,9 @@ struct ni_dbus_object {
 	char *			path;		/* absolute path */
 	void *			handle;		/* local object */
 	ni_dbus_object_t *	children;
+	ni_hashtable_t		children_index;	/* children by name */
 	const ni_dbus_service_t **interfaces;
+	ni_dbus_dispatch_t *	dispatch;	/* interface member lookup */
 
 	ni_dbus_server_object_t *server_object;
 	ni_dbus_client_object_t *client_object;
@@ -194,6 +197,10 @@ extern const char *		ni_dbus_object_get_relative_path(const ni_dbus_object_t *an
 extern void *			ni_dbus_object_get_handle(const ni_dbus_object_t *);
 extern const ni_dbus_service_t *ni_dbus_object_get_service(const ni_dbus_object_t *, const char *);
 extern const ni_dbus_service_t *ni_dbus_object_get_service_for_method(const ni_dbus_object_t *, const char *);
+extern const ni_dbus_method_t *	ni_dbus_object_find_method(const ni_dbus_object_t *, const ni_dbus_service_t *,
+					const char *);
+extern const ni_dbus_property_t *ni_dbus_object_find_property(const ni_dbus_object_t *, const ni_dbus_service_t **,
+					const char *);
 extern const ni_dbus_service_t *ni_dbus_object_get_service_for_signal(const ni_dbus_object_t *, const char *);
 extern unsigned int		ni_dbus_object_get_all_services_for_method(const ni_dbus_object_t *object, const char *method,
 					const ni_dbus_service_t **list, unsigned int list_size);
@@ -345,6 +352,17 @@ extern void			ni_dbus_client_add_signal_handler(ni_dbus_client_t *client,
 					const char *object_interface,
 					ni_dbus_signal_handler_t *callback,
 					void *user_data);
+extern void			ni_dbus_client_add_signal_member_handler(ni_dbus_client_t *client,
+					const char *sender,
+					const char *path_namespace,
+					const char *object_interface,
+					const char *member,
+					ni_dbus_signal_handler_t *callback,
+					void *user_data);
+extern void			ni_dbus_client_add_name_owner_handler(ni_dbus_client_t *client,
+					const char *name,
+					ni_dbus_signal_handler_t *callback,
+					void *user_data);
 extern void			ni_dbus_client_set_call_timeout(ni_dbus_client_t *, unsigned int msec);
 extern void			ni_dbus_client_set_error_map(ni_dbus_client_t *, const ni_intmap_t *);
 extern int			ni_dbus_client_translate_error(ni_dbus_client_t *, const DBusError *);
@@ -360,6 +378,9 @@ extern ni_dbus_object_t *	ni_dbus_client_object_new_child(ni_dbus_object_t *pare
 					const char *interface,
 					void *local_data);
 extern dbus_bool_t		ni_dbus_object_refresh_children(ni_dbus_object_t *);
+extern dbus_bool_t		ni_dbus_object_refresh_children_filtered(ni_dbus_object_t *,
+					const ni_string_array_t *interfaces,
+					const ni_string_array_t *omit);
 extern ni_dbus_object_t *	ni_dbus_object_find_child(ni_dbus_object_t *parent, const char *name);
 extern dbus_bool_t		ni_dbus_object_call_variant(const ni_dbus_object_t *,
 					const char *interface, const char *method,
@@ -378,6 +399,10 @@ extern ni_dbus_message_t *	ni_dbus_object_call_new_va(const ni_dbus_object_t *ob
 					const char *method, va_list *app);
 
 extern dbus_bool_t		ni_dbus_object_get_managed_objects(ni_dbus_object_t *, DBusError *, ni_bool_t purge);
+extern dbus_bool_t		ni_dbus_object_get_managed_objects_filtered(ni_dbus_object_t *,
+					const ni_string_array_t *interfaces,
+					const ni_string_array_t *omit,
+					DBusError *, ni_bool_t purge);
 extern dbus_bool_t		ni_dbus_object_refresh_properties(ni_dbus_object_t *, const ni_dbus_service_t *, DBusError *);
 extern dbus_bool_t		ni_dbus_object_send_property(ni_dbus_object_t *proxy,
 					const char *service_name,
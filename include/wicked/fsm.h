@@ -131,6 +131,14 @@ struct ni_ifworker {
 
 	unsigned int		ifindex;
 
+	/* Hashes the worker is linked with into the fsm lookup index */
+	struct {
+		ni_bool_t	linked;
+		unsigned int	name;
+		unsigned int	ifindex;
+		unsigned int	object_path;
+	} index;
+
 	ni_uint_range_t		target_range;
 	unsigned int		target_state;
 
@@ -139,7 +147,8 @@ struct ni_ifworker {
 				done		: 1,
 				kickstarted	: 1,
 				pending		: 1,
-				readonly	: 1;
+				readonly	: 1,
+				rebind		: 1;	/* edges need to be re-resolved */
 
 	ni_ifworker_control_t	control;
 
@@ -241,6 +250,11 @@ struct ni_fsm_event {
 struct ni_fsm {
 	ni_ifworker_array_t	pending;
 	ni_ifworker_array_t	workers;
+	struct {
+		ni_hashtable_t	name;
+		ni_hashtable_t	ifindex;
+		ni_hashtable_t	object_path;
+	} index;
 	unsigned int		worker_timeout;
 	ni_bool_t		readonly;
 
@@ -312,6 +326,7 @@ extern unsigned int		ni_fsm_start_matching_workers(ni_fsm_t *, ni_ifworker_array
 extern void			ni_fsm_reset_matching_workers(ni_fsm_t *, ni_ifworker_array_t *, const ni_uint_range_t *, ni_bool_t);
 extern void			ni_fsm_print_hierarchy(ni_fsm_t *);
 extern int			ni_fsm_build_hierarchy(ni_fsm_t *, ni_bool_t);
+extern int			ni_fsm_update_hierarchy(ni_fsm_t *, ni_bool_t);
 extern ni_bool_t		ni_fsm_workers_from_xml(ni_fsm_t *, xml_node_t *, const char *);
 extern unsigned int		ni_fsm_fail_count(ni_fsm_t *);
 extern ni_ifworker_t *		ni_fsm_ifworker_by_object_path(ni_fsm_t *, const char *);
@@ -324,6 +339,7 @@ extern ni_ifworker_t *		ni_fsm_recv_new_netif_path(ni_fsm_t *fsm, const char *pa
 extern ni_ifworker_t *		ni_fsm_recv_new_modem(ni_fsm_t *fsm, ni_dbus_object_t *object, ni_bool_t refresh);
 extern ni_ifworker_t *		ni_fsm_recv_new_modem_path(ni_fsm_t *fsm, const char *path);
 extern void			ni_fsm_destroy_worker(ni_fsm_t *fsm, ni_ifworker_t *w);
+extern ni_bool_t		ni_fsm_remove_worker(ni_fsm_t *fsm, ni_ifworker_t *w);
 extern void			ni_fsm_pull_in_children(ni_ifworker_array_t *, ni_fsm_t *);
 extern void			ni_fsm_wait_tentative_addrs(ni_fsm_t *);
 
@@ -92,11 +92,34 @@ struct ni_lldp_ieee_802_1 {
 	 */
 };
 
+/*
+ * Peer table statistics of an LLDP agent, or the sum over all agents
+ */
+typedef struct ni_lldp_stats {
+	unsigned int				agents;
+	unsigned int				peers;		/* current peer entries */
+	unsigned int				peers_max;	/* high-water mark */
+
+	unsigned long				rx_frames;
+	unsigned long				rx_errors;	/* unparsable PDUs */
+	unsigned long				rx_unknown;	/* PDUs on ports without agent */
+
+	unsigned long				inserts;	/* new peers */
+	unsigned long				updates;	/* refreshed peers */
+	unsigned long				expired;	/* peers timed out */
+	unsigned long				shutdowns;	/* peers left with ttl 0 */
+	unsigned long				overflows;	/* PDUs ignored, table full */
+
+	unsigned long				tx_frames;
+	unsigned long				tx_deferred;	/* no tx credit left */
+} ni_lldp_stats_t;
+
 extern ni_lldp_t *	ni_lldp_new(void);
 extern void		ni_lldp_free(ni_lldp_t *);
 extern ni_bool_t	ni_system_lldp_available(ni_netdev_t *);
 extern int		ni_system_lldp_up(ni_netdev_t *, const ni_lldp_t *);
 extern int		ni_system_lldp_down(ni_netdev_t *);
+extern ni_bool_t	ni_lldp_get_stats(unsigned int, ni_lldp_stats_t *);
 
 extern const char *	ni_lldp_destination_type_to_name(ni_lldp_destination_t);
 extern const char *	ni_lldp_system_capability_type_to_name(ni_lldp_destination_t);
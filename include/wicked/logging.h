@@ -11,9 +11,11 @@
 
 #ifdef __GNUC__
 # define __fmtattr	__attribute__ ((format (printf, 1, 2)))
+# define __fmtattr2	__attribute__ ((format (printf, 2, 3)))
 # define __noreturn	__attribute__ ((noreturn))
 #else
 # define __fmtattr	/* */
+# define __fmtattr2	/* */
 # define __noreturn	/* */
 #endif
 
@@ -23,6 +25,7 @@ extern void		ni_warn(const char *, ...) __fmtattr;
 extern void		ni_error(const char *, ...) __fmtattr;
 extern void		ni_error_extra(const char *, ...) __fmtattr;
 extern void		ni_trace(const char *, ...) __fmtattr;
+extern void		ni_debug_trace(unsigned int, const char *, ...) __fmtattr2;
 extern void		ni_fatal(const char *, ...) __fmtattr __noreturn;
 
 extern int		ni_enable_debug(const char *);
@@ -40,6 +43,10 @@ extern ni_bool_t	ni_log_destination(const char *program, const char *destination
 extern void		ni_log_reopen(void);
 extern void		ni_log_close(void);
 
+extern ni_bool_t	ni_log_ring_enable(unsigned int);
+extern void		ni_log_ring_dump(void);
+extern void		ni_log_ring_service(void);
+
 enum {
 	NI_LOG_ERROR,
 	NI_LOG_WARNING,
@@ -77,17 +84,18 @@ enum {
 
 extern unsigned int	ni_debug;
 extern unsigned int	ni_log_level;
+extern unsigned int	ni_log_trace_mask[];	/* ni_debug per enabled log level */
 
 #define ni_log_level_at(level)			(ni_log_level >= (level))
 #define ni_log_facility(facility)		(ni_debug & (facility))
 
 #define ni_debug_guard(level, facility) \
-	(ni_log_level_at(level) && ni_log_facility(facility))
+	(ni_log_trace_mask[(level)] & (facility))
 
 #define __ni_debug(level, facility, fmt, args...) \
 	do { \
 		if (ni_debug_guard(level, facility)) \
-			ni_trace(fmt, ##args); \
+			ni_debug_trace(facility, fmt, ##args); \
 	} while (0)
 
 #define ni_debug_ifconfig(fmt, args...)		__ni_debug(NI_LOG_DEBUG, NI_TRACE_IFCONFIG, fmt, ##args)
@@ -74,6 +74,21 @@ typedef struct ni_bitfield {
 
 #define NI_BITFIELD_INIT { 0, NULL, { 0, 0, 0, 0 } }
 
+typedef struct ni_hashtable_entry	ni_hashtable_entry_t;
+
+typedef struct ni_hashtable {
+	unsigned int		count;
+	unsigned int		size;
+	ni_hashtable_entry_t **	buckets;
+} ni_hashtable_t;
+
+#define NI_HASHTABLE_INIT	{ .count = 0, .size = 0, .buckets = NULL }
+
+typedef struct ni_hashtable_iter {
+	const ni_hashtable_entry_t *	entry;
+	unsigned int			hash;
+} ni_hashtable_iter_t;
+
 typedef enum ni_daemon_close {
 	NI_DAEMON_CLOSE_NONE	= 0,
 	NI_DAEMON_CLOSE_IN	= 1,
@@ -98,6 +113,17 @@ extern ni_bool_t	ni_bitfield_isset(const ni_bitfield_t *);
 extern ni_bool_t	ni_bitfield_parse(ni_bitfield_t *, const char *, unsigned int);
 extern ni_bool_t	ni_bitfield_format(const ni_bitfield_t *, char **, ni_bool_t);
 
+extern void		ni_hashtable_init(ni_hashtable_t *);
+extern void		ni_hashtable_destroy(ni_hashtable_t *);
+extern ni_bool_t	ni_hashtable_insert(ni_hashtable_t *, unsigned int, void *);
+extern ni_bool_t	ni_hashtable_remove(ni_hashtable_t *, unsigned int, const void *);
+extern void *		ni_hashtable_lookup(const ni_hashtable_t *, unsigned int, ni_hashtable_iter_t *);
+extern void *		ni_hashtable_lookup_next(ni_hashtable_iter_t *);
+extern unsigned int	ni_hash_bytes(const void *, size_t);
+extern unsigned int	ni_hash_string(const char *);
+extern unsigned int	ni_hash_uint(unsigned int);
+extern uint32_t		ni_crc32(uint32_t, const void *, size_t);
+
 extern void		ni_string_free(char **);
 extern void		ni_string_clear(char **);
 extern ni_bool_t	ni_string_dup(char **, const char *);
@@ -168,7 +168,8 @@ struct ni_wireless_network {
 	unsigned int			fragment_size;		/* used with EAP */
 
 	struct ni_wireless_scan_info {
-		time_t			timestamp;
+		time_t			timestamp;		/* last seen in a scan */
+		time_t			updated;		/* last properties update */
 		ni_bool_t		updating;		/* retrieving new scan info */
 		int			noise;
 		double			level;			/* in dBm*/
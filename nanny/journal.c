@@ -0,0 +1,507 @@
+/*
+ * Append-only journal used to persist the nanny policies.
+ *
+ * The journal consists of a header followed by records, each of them
+ * either storing (put) or removing (del) a named document:
+ *
+ *	header:	uint32 magic, uint32 version
+ *	record:	uint32 op, uint32 name length, uint32 data length,
+ *		uint32 crc32 of the previous fields, name and data,
+ *		name bytes, data bytes
+ *
+ * A batch of records is appended with a single write and fdatasync.
+ * A failed append is truncated off again and stays pending, so it is
+ * retried with the next sync instead of hiding the records behind it.
+ * On open, the records are replayed and a torn or corrupted tail
+ * (e.g. after a crash in the middle of an append) is truncated.
+ * Once the superseded records outnumber the live documents, the
+ * journal is compacted into a new file, which replaces the old one.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <limits.h>
+#include <errno.h>
+
+#include <wicked/util.h>
+#include <wicked/logging.h>
+
+#include "util_priv.h"
+#include "buffer.h"
+#include "nanny.h"
+
+#define NI_NANNY_JOURNAL_MAGIC		0x6e706a6c	/* "npjl" */
+#define NI_NANNY_JOURNAL_VERSION	1
+#define NI_NANNY_JOURNAL_COMPACT_MIN	256
+#define NI_NANNY_JOURNAL_RECORD_MAX	(16U << 20)
+
+typedef enum ni_nanny_journal_op {
+	NI_NANNY_JOURNAL_PUT		= 1,
+	NI_NANNY_JOURNAL_DEL		= 2,
+} ni_nanny_journal_op_t;
+
+typedef struct ni_nanny_journal_header {
+	uint32_t			magic;
+	uint32_t			version;
+} ni_nanny_journal_header_t;
+
+typedef struct ni_nanny_journal_record {
+	uint32_t			op;
+	uint32_t			nlen;
+	uint32_t			dlen;
+	uint32_t			crc;
+} ni_nanny_journal_record_t;
+
+typedef struct ni_nanny_journal_entry	ni_nanny_journal_entry_t;
+struct ni_nanny_journal_entry {
+	ni_nanny_journal_entry_t *	next;
+	char *				name;
+	char *				data;	/* while loading only */
+};
+
+struct ni_nanny_journal {
+	char *				path;
+	FILE *				file;	/* unbuffered, appending */
+	long				length;	/* of the valid records */
+	ni_bool_t			torn;	/* garbage behind length */
+	ni_buffer_t			pending;
+
+	unsigned int			records;
+	ni_hashtable_t			index;	/* live entries by name */
+	ni_nanny_journal_entry_t *	entries;
+	ni_nanny_journal_entry_t **	tail;
+};
+
+static uint32_t
+ni_nanny_journal_record_crc(const ni_nanny_journal_record_t *rec, const void *name, const void *data)
+{
+	uint32_t crc;
+
+	crc = ni_crc32(0, rec, offsetof(ni_nanny_journal_record_t, crc));
+	crc = ni_crc32(crc, name, rec->nlen);
+	crc = ni_crc32(crc, data, rec->dlen);
+	return crc;
+}
+
+/*
+ * in-memory index of the live documents
+ */
+static char *
+ni_nanny_journal_strndup(const void *ptr, size_t len)
+{
+	char *str;
+
+	str = xmalloc(len + 1);
+	memcpy(str, ptr, len);
+	str[len] = '\0';
+	return str;
+}
+
+static ni_nanny_journal_entry_t *
+ni_nanny_journal_entry_find(const ni_nanny_journal_t *j, const char *name)
+{
+	ni_nanny_journal_entry_t *entry;
+	ni_hashtable_iter_t iter;
+
+	entry = ni_hashtable_lookup(&j->index, ni_hash_string(name), &iter);
+	for ( ; entry; entry = ni_hashtable_lookup_next(&iter)) {
+		if (ni_string_eq(entry->name, name))
+			return entry;
+	}
+	return NULL;
+}
+
+static ni_nanny_journal_entry_t *
+ni_nanny_journal_entry_put(ni_nanny_journal_t *j, const char *name)
+{
+	ni_nanny_journal_entry_t *entry;
+
+	if ((entry = ni_nanny_journal_entry_find(j, name)))
+		return entry;
+
+	entry = xcalloc(1, sizeof(*entry));
+	entry->name = xstrdup(name);
+	ni_hashtable_insert(&j->index, ni_hash_string(name), entry);
+	*j->tail = entry;
+	j->tail = &entry->next;
+	return entry;
+}
+
+static void
+ni_nanny_journal_entry_del(ni_nanny_journal_t *j, const char *name)
+{
+	ni_nanny_journal_entry_t *entry, **pos;
+
+	if (!(entry = ni_nanny_journal_entry_find(j, name)))
+		return;
+
+	ni_hashtable_remove(&j->index, ni_hash_string(name), entry);
+	for (pos = &j->entries; *pos; pos = &(*pos)->next) {
+		if (*pos == entry) {
+			if (!(*pos = entry->next))
+				j->tail = pos;
+			break;
+		}
+	}
+	free(entry->name);
+	free(entry->data);
+	free(entry);
+}
+
+static void
+ni_nanny_journal_entries_destroy(ni_nanny_journal_t *j)
+{
+	ni_nanny_journal_entry_t *entry;
+
+	while ((entry = j->entries)) {
+		j->entries = entry->next;
+		free(entry->name);
+		free(entry->data);
+		free(entry);
+	}
+	j->tail = &j->entries;
+	ni_hashtable_destroy(&j->index);
+}
+
+/*
+ * Read the journal file and rebuild the index, passing the data of
+ * the live documents to the callback. Returns the length of the
+ * valid part of the file or -1 on error.
+ */
+static long
+ni_nanny_journal_load(ni_nanny_journal_t *j, ni_nanny_journal_replay_fn_t *fn, void *user_data)
+{
+	const ni_nanny_journal_header_t *hdr;
+	ni_nanny_journal_record_t rec;
+	ni_nanny_journal_entry_t *entry;
+	unsigned char *buf;
+	size_t len = 0, pos;
+	FILE *fp;
+
+	ni_nanny_journal_entries_destroy(j);
+	j->records = 0;
+
+	if (!(fp = fopen(j->path, "re"))) {
+		if (errno == ENOENT)
+			return 0;
+		ni_error("unable to open policy journal %s: %m", j->path);
+		return -1;
+	}
+	buf = ni_file_read(fp, &len, 0);
+	fclose(fp);
+	if (!buf)
+		return 0;
+
+	hdr = (const ni_nanny_journal_header_t *)buf;
+	if (len < sizeof(*hdr) || hdr->magic != NI_NANNY_JOURNAL_MAGIC ||
+	    hdr->version != NI_NANNY_JOURNAL_VERSION) {
+		ni_warn("discarding policy journal %s with invalid header", j->path);
+		free(buf);
+		return 0;
+	}
+
+	for (pos = sizeof(*hdr); pos + sizeof(rec) <= len; ) {
+		const char *name, *data;
+
+		memcpy(&rec, buf + pos, sizeof(rec));
+		if (!rec.nlen || rec.nlen > NAME_MAX || rec.dlen > NI_NANNY_JOURNAL_RECORD_MAX ||
+		    rec.nlen + rec.dlen > len - pos - sizeof(rec))
+			break;
+
+		name = (const char *)buf + pos + sizeof(rec);
+		data = name + rec.nlen;
+		if (rec.crc != ni_nanny_journal_record_crc(&rec, name, data))
+			break;
+
+		if (rec.op == NI_NANNY_JOURNAL_PUT) {
+			char *key = ni_nanny_journal_strndup(name, rec.nlen);
+
+			entry = ni_nanny_journal_entry_put(j, key);
+			free(entry->data);
+			entry->data = ni_nanny_journal_strndup(data, rec.dlen);
+			free(key);
+		} else
+		if (rec.op == NI_NANNY_JOURNAL_DEL) {
+			char *key = ni_nanny_journal_strndup(name, rec.nlen);
+
+			ni_nanny_journal_entry_del(j, key);
+			free(key);
+		} else
+			break;
+
+		j->records++;
+		pos += sizeof(rec) + rec.nlen + rec.dlen;
+	}
+	free(buf);
+
+	if (pos < len) {
+		ni_warn("policy journal %s: discarding %zu bytes of corrupted data at offset %zu",
+				j->path, len - pos, pos);
+	}
+
+	for (entry = j->entries; entry; entry = entry->next) {
+		if (fn)
+			fn(entry->name, entry->data, user_data);
+		ni_string_free(&entry->data);
+	}
+	return pos;
+}
+
+static ni_bool_t
+ni_nanny_journal_record_append(ni_buffer_t *bp, ni_nanny_journal_op_t op,
+				const char *name, const char *data)
+{
+	ni_nanny_journal_record_t rec;
+
+	memset(&rec, 0, sizeof(rec));
+	rec.op   = op;
+	rec.nlen = ni_string_len(name);
+	rec.dlen = ni_string_len(data);
+	if (!rec.nlen || rec.nlen > NAME_MAX || rec.dlen > NI_NANNY_JOURNAL_RECORD_MAX)
+		return FALSE;
+	rec.crc  = ni_nanny_journal_record_crc(&rec, name, data);
+
+	if (ni_buffer_tailroom(bp) < sizeof(rec) + rec.nlen + rec.dlen)
+		ni_buffer_ensure_tailroom(bp, sizeof(rec) + rec.nlen + rec.dlen + 4096);
+
+	return	ni_buffer_put(bp, &rec, sizeof(rec)) == 0 &&
+		ni_buffer_put(bp, name, rec.nlen) == 0 &&
+		ni_buffer_put(bp, data, rec.dlen) == 0;
+}
+
+static ni_bool_t
+ni_nanny_journal_file_sync(FILE *fp)
+{
+	if (fflush(fp) != 0 || fdatasync(fileno(fp)) < 0)
+		return FALSE;
+	return TRUE;
+}
+
+static FILE *
+ni_nanny_journal_file_create(const char *path)
+{
+	ni_nanny_journal_header_t hdr;
+	FILE *fp;
+
+	if (!(fp = ni_file_open(path, "w", 0600)))
+		return NULL;
+	setvbuf(fp, NULL, _IONBF, 0);
+
+	hdr.magic = NI_NANNY_JOURNAL_MAGIC;
+	hdr.version = NI_NANNY_JOURNAL_VERSION;
+	if (ni_file_write(fp, &hdr, sizeof(hdr)) < 0) {
+		fclose(fp);
+		unlink(path);
+		return NULL;
+	}
+	return fp;
+}
+
+/*
+ * Cut a partly written append off the journal, so the next write
+ * starts at the end of the valid records again.
+ */
+static ni_bool_t
+ni_nanny_journal_truncate(ni_nanny_journal_t *j)
+{
+	clearerr(j->file);
+	if (ftruncate(fileno(j->file), j->length) < 0 ||
+	    fseek(j->file, j->length, SEEK_SET) < 0) {
+		ni_error("unable to truncate policy journal %s: %m", j->path);
+		j->torn = TRUE;
+		return FALSE;
+	}
+	j->torn = FALSE;
+	return TRUE;
+}
+
+static ni_bool_t
+ni_nanny_journal_flush(ni_nanny_journal_t *j)
+{
+	size_t len;
+
+	if (!j || !j->file)
+		return FALSE;
+
+	if (!(len = ni_buffer_count(&j->pending)))
+		return TRUE;
+
+	if (j->torn && !ni_nanny_journal_truncate(j))
+		return FALSE;
+
+	if (ni_file_write(j->file, ni_buffer_head(&j->pending), len) < 0 ||
+	    !ni_nanny_journal_file_sync(j->file)) {
+		ni_error("unable to write policy journal %s: %m", j->path);
+		/* keep the records pending and retry with the next sync */
+		ni_nanny_journal_truncate(j);
+		return FALSE;
+	}
+	j->length += len;
+	ni_buffer_clear(&j->pending);
+	return TRUE;
+}
+
+static void
+ni_nanny_journal_compact_write(const char *name, const char *data, void *user_data)
+{
+	ni_buffer_t *bp = user_data;
+
+	ni_nanny_journal_record_append(bp, NI_NANNY_JOURNAL_PUT, name, data);
+}
+
+/*
+ * Rewrite the journal to contain the live documents only
+ */
+ni_bool_t
+ni_nanny_journal_compact(ni_nanny_journal_t *j)
+{
+	char temp[PATH_MAX];
+	ni_buffer_t buf;
+	FILE *fp;
+
+	if (!ni_nanny_journal_flush(j))
+		return FALSE;
+
+	ni_buffer_init_dynamic(&buf, 4096);
+	if (ni_nanny_journal_load(j, ni_nanny_journal_compact_write, &buf) < 0) {
+		ni_buffer_destroy(&buf);
+		return FALSE;
+	}
+
+	snprintf(temp, sizeof(temp), "%s.tmp", j->path);
+	if (!(fp = ni_nanny_journal_file_create(temp))) {
+		ni_error("unable to create policy journal %s: %m", temp);
+		ni_buffer_destroy(&buf);
+		return FALSE;
+	}
+
+	if (ni_file_write(fp, ni_buffer_head(&buf), ni_buffer_count(&buf)) < 0 ||
+	    !ni_nanny_journal_file_sync(fp) || rename(temp, j->path) < 0) {
+		ni_error("unable to replace policy journal %s: %m", j->path);
+		ni_buffer_destroy(&buf);
+		fclose(fp);
+		unlink(temp);
+		return FALSE;
+	}
+	ni_debug_nanny("compacted policy journal %s: %u records, %u policies",
+			j->path, j->records, j->index.count);
+
+	fclose(j->file);
+	j->file = fp;
+	j->length = sizeof(ni_nanny_journal_header_t) + ni_buffer_count(&buf);
+	j->torn = FALSE;
+	j->records = j->index.count;
+	ni_buffer_destroy(&buf);
+	return TRUE;
+}
+
+ni_nanny_journal_t *
+ni_nanny_journal_open(const char *path, ni_nanny_journal_replay_fn_t *fn, void *user_data)
+{
+	ni_nanny_journal_t *j;
+	long valid;
+
+	if (ni_string_empty(path))
+		return NULL;
+
+	j = xcalloc(1, sizeof(*j));
+	j->path = xstrdup(path);
+	j->tail = &j->entries;
+	ni_hashtable_init(&j->index);
+	ni_buffer_init_dynamic(&j->pending, 4096);
+
+	if ((valid = ni_nanny_journal_load(j, fn, user_data)) < 0)
+		goto failure;
+
+	if (valid == 0) {
+		if (!(j->file = ni_nanny_journal_file_create(path))) {
+			ni_error("unable to create policy journal %s: %m", path);
+			goto failure;
+		}
+		j->length = sizeof(ni_nanny_journal_header_t);
+	} else {
+		if (truncate(path, valid) < 0) {
+			ni_error("unable to truncate policy journal %s: %m", path);
+			goto failure;
+		}
+		if (!(j->file = ni_file_open(path, "a", 0600)))
+			goto failure;
+		setvbuf(j->file, NULL, _IONBF, 0);
+		j->length = valid;
+	}
+
+	ni_debug_nanny("opened policy journal %s: %u records, %u policies",
+			path, j->records, j->index.count);
+	return j;
+
+failure:
+	ni_nanny_journal_close(j);
+	return NULL;
+}
+
+void
+ni_nanny_journal_close(ni_nanny_journal_t *j)
+{
+	if (!j)
+		return;
+
+	if (j->file) {
+		ni_nanny_journal_flush(j);
+		fclose(j->file);
+	}
+	ni_nanny_journal_entries_destroy(j);
+	ni_buffer_destroy(&j->pending);
+	free(j->path);
+	free(j);
+}
+
+/*
+ * Queue a document update or removal; they're written by sync.
+ */
+ni_bool_t
+ni_nanny_journal_put(ni_nanny_journal_t *j, const char *name, const char *data)
+{
+	if (!j || !ni_nanny_journal_record_append(&j->pending, NI_NANNY_JOURNAL_PUT, name, data))
+		return FALSE;
+
+	ni_nanny_journal_entry_put(j, name);
+	j->records++;
+	return TRUE;
+}
+
+ni_bool_t
+ni_nanny_journal_del(ni_nanny_journal_t *j, const char *name)
+{
+	if (!j || !ni_nanny_journal_entry_find(j, name))
+		return TRUE;
+
+	if (!ni_nanny_journal_record_append(&j->pending, NI_NANNY_JOURNAL_DEL, name, NULL))
+		return FALSE;
+
+	ni_nanny_journal_entry_del(j, name);
+	j->records++;
+	return TRUE;
+}
+
+ni_bool_t
+ni_nanny_journal_sync(ni_nanny_journal_t *j)
+{
+	if (!ni_nanny_journal_flush(j))
+		return FALSE;
+
+	if (j->records > NI_NANNY_JOURNAL_COMPACT_MIN && j->records > 2 * j->index.count)
+		ni_nanny_journal_compact(j);
+	return TRUE;
+}
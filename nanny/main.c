@@ -213,38 +213,17 @@ ni_nanny_statedir(void)
 static ni_bool_t
 ni_nanny_policy_load(ni_nanny_t *mgr)
 {
-	ni_string_array_t files = NI_STRING_ARRAY_INIT;
-	char nanny_dir[PATH_MAX] = { '\0' };
-
 	ni_assert(mgr);
 	ni_debug_application("Loading previously saved policies:");
 
-	snprintf(nanny_dir, sizeof(nanny_dir), "%s", ni_nanny_statedir());
-	if (ni_scandir(nanny_dir, "policy*.xml", &files) != 0) {
-		unsigned int i;
-
-		for (i = 0; i < files.count; ++i) {
-			char path[PATH_MAX];
-			xml_document_t *doc;
-
-			snprintf(path, sizeof(path), "%s/%s", nanny_dir, files.data[i]);
-			doc = xml_document_read(path);
-			if (doc == NULL) {
-				ni_error("Unable to read policy file %s: %m", path);
-				continue;
-			}
-
-			if (!ni_nanny_create_policy(NULL, mgr, doc, TRUE)) {
-				ni_error("Unable to create policy from file '%s'", path);
-			}
-			xml_document_free(doc);
-		}
+	if (!ni_managed_policy_store_open(mgr)) {
+		ni_error("Unable to open the nanny policy store");
+		return FALSE;
 	}
 
-	if (files.count)
+	if (mgr->policy_list)
 		ni_nanny_recheck_policies(mgr, NULL);
 
-	ni_string_array_destroy(&files);
 	return TRUE;
 }
 
@@ -305,6 +284,7 @@ babysit(void)
 			ni_fatal("ni_socket_wait failed");
 	}
 
+	ni_managed_policy_store_close();
 	exit(0);
 }
 
@@ -763,7 +763,7 @@ ni_nanny_process_rename_event(ni_nanny_t *mgr, ni_ifworker_t *w)
 				ni_nanny_unregister_device(mgr, c);
 
 			rebuild = TRUE;
-			if (ni_ifworker_array_remove_index(&mgr->fsm->workers, i))
+			if (ni_fsm_remove_worker(mgr->fsm, c))
 				continue;
 		}
 		i++;
@@ -779,7 +779,7 @@ ni_nanny_process_rename_event(ni_nanny_t *mgr, ni_ifworker_t *w)
 	}
 
 	if (rebuild)
-		ni_fsm_build_hierarchy(mgr->fsm, FALSE);
+		ni_fsm_update_hierarchy(mgr->fsm, FALSE);
 }
 
 static void
@@ -927,18 +927,109 @@ ni_objectmodel_nanny_create_policy(ni_dbus_object_t *object, const ni_dbus_metho
 	return ni_dbus_message_append_object_path(reply, ni_dbus_object_get_path(policy_object));
 }
 
-ni_bool_t
-ni_nanny_policy_drop(const char *pname)
+/*
+ * Nanny.createPolicies(as)
+ *
+ * Create or update a batch of policies at once, committing them to
+ * the policy store with a single write. Returns the object paths of
+ * the policies in the order given, an empty string for failures.
+ */
+static const char *
+ni_nanny_create_or_update_policy(ni_nanny_t *mgr, const char *doc_string, uid_t caller_uid)
 {
-	char path[PATH_MAX] = {'\0'};
+	static char object_path[256];
+	ni_dbus_object_t *policy_object = NULL;
+	ni_managed_policy_t *mpolicy = NULL;
+	ni_fsm_policy_t *policy = NULL;
+	xml_document_t *doc;
+	xml_node_t *pnode;
+	const char *pname;
+	int rv;
 
-	ni_managed_policy_filename(pname, path, sizeof(path));
+	if (ni_string_empty(doc_string) || !(doc = xml_document_from_string(doc_string, NULL)))
+		return NULL;
 
-	if (unlink(path) < 0) {
-		if (errno == ENOENT)
-			return TRUE;
+	rv = ni_nanny_create_policy(&policy_object, mgr, doc, FALSE);
+	if (rv == 0) {
+		pnode = xml_document_root(doc)->children;
+		pname = ni_ifpolicy_get_name(pnode);
+		policy = ni_fsm_policy_by_name(mgr->fsm, pname);
+		mpolicy = ni_nanny_get_policy(mgr, policy);
+
+		if (!mpolicy || !ni_fsm_policy_update(policy, pnode)) {
+			ni_error("Unable to update policy %s", pname);
+			rv = -1;
+		} else {
+			mpolicy->owner = caller_uid;
+			mpolicy->seqno++;
+		}
+	} else
+	if (rv > 0) {
+		policy = ni_fsm_policy_by_name(mgr->fsm,
+				ni_ifpolicy_get_name(xml_document_root(doc)->children));
+		mpolicy = ni_nanny_get_policy(mgr, policy);
+	}
+	xml_document_free(doc);
+
+	if (rv < 0 || !mpolicy)
+		return NULL;
+
+	if (!ni_managed_policy_store_put(mpolicy))
+		ni_warn("Unable to save managed nanny policy %s", ni_fsm_policy_name(policy));
+
+	snprintf(object_path, sizeof(object_path), NI_OBJECTMODEL_MANAGED_POLICY_LIST_PATH "/%s",
+			ni_fsm_policy_name(policy));
+	return object_path;
+}
+
+static dbus_bool_t
+ni_objectmodel_nanny_create_policies(ni_dbus_object_t *object, const ni_dbus_method_t *method,
+					unsigned int argc, const ni_dbus_variant_t *argv,
+					uid_t caller_uid,
+					ni_dbus_message_t *reply, DBusError *error)
+{
+	ni_dbus_variant_t result = NI_DBUS_VARIANT_INIT;
+	unsigned int i, failed = 0;
+	const char *path;
+	ni_nanny_t *mgr;
+	dbus_bool_t rv;
+
+	if ((mgr = ni_objectmodel_nanny_unwrap(object, error)) == NULL || mgr->fsm == NULL)
+		return FALSE;
 
-		ni_error("Cannot remove policy file '%s': %m", path);
+	if (caller_uid != 0) {
+		dbus_set_error_const(error, NI_DBUS_ERROR_PERMISSION_DENIED, NULL);
+		return FALSE;
+	}
+
+	if (argc != 1 || !ni_dbus_variant_is_string_array(&argv[0]))
+		return ni_dbus_error_invalid_args(error, ni_dbus_object_get_path(object), method->name);
+
+	ni_dbus_variant_init_string_array(&result);
+	for (i = 0; i < argv[0].array.len; ++i) {
+		path = ni_nanny_create_or_update_policy(mgr, argv[0].string_array_value[i], caller_uid);
+		if (!path)
+			failed++;
+		ni_dbus_variant_append_string_array(&result, path ? path : "");
+	}
+
+	if (!ni_managed_policy_store_commit())
+		ni_warn("Unable to save created managed nanny policies");
+
+	ni_debug_nanny("%s.%s: %u policies applied, %u failed",
+			ni_dbus_object_get_path(object), method->name,
+			argv[0].array.len - failed, failed);
+
+	rv = ni_dbus_message_serialize_variants(reply, 1, &result, error);
+	ni_dbus_variant_destroy(&result);
+	return rv;
+}
+
+ni_bool_t
+ni_nanny_policy_drop(const char *pname)
+{
+	if (!ni_managed_policy_store_del(pname) || !ni_managed_policy_store_commit()) {
+		ni_error("Cannot remove policy %s from policy store", pname);
 		return FALSE;
 	}
 	return TRUE;
@@ -1128,7 +1219,7 @@ ni_nanny_recheck_policies(ni_nanny_t *mgr, const ni_string_array_t *ifnames)
 	}
 
 	if (count)
-		ni_fsm_build_hierarchy(mgr->fsm, FALSE);
+		ni_fsm_update_hierarchy(mgr->fsm, FALSE);
 }
 
 static dbus_bool_t
@@ -1173,6 +1264,7 @@ ni_objectmodel_nanny_recheck(ni_dbus_object_t *object, const ni_dbus_method_t *m
 static ni_dbus_method_t		ni_objectmodel_nanny_methods[] = {
 	{ "getDevice",		"s",		.handler = ni_objectmodel_nanny_get_device	 },
 	{ "createPolicy",	"s",		.handler_ex = ni_objectmodel_nanny_create_policy },
+	{ "createPolicies",	"as",		.handler_ex = ni_objectmodel_nanny_create_policies },
 	{ "deletePolicy",	"s",		.handler_ex = ni_objectmodel_nanny_delete_policy },
 	{ "addSecret",		"a{sv}ss",	.handler_ex = ni_objectmodel_nanny_set_secret	 },
 	{ "recheck",		"as",		.handler_ex = ni_objectmodel_nanny_recheck	 },
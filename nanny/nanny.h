@@ -18,6 +18,9 @@
 typedef struct ni_nanny		ni_nanny_t;
 typedef struct ni_managed_device ni_managed_device_t;
 typedef struct ni_managed_policy ni_managed_policy_t;
+typedef struct ni_nanny_journal	ni_nanny_journal_t;
+
+typedef void			ni_nanny_journal_replay_fn_t(const char *, const char *, void *);
 
 typedef enum ni_managed_state {
 	NI_MANAGED_STATE_STOPPED,
@@ -152,7 +155,11 @@ extern int			ni_factory_device_apply_policy(ni_fsm_t *, ni_ifworker_t *, ni_mana
 extern int			ni_managed_device_apply_policy(ni_managed_device_t *mdev, ni_managed_policy_t *mpolicy);
 extern void			ni_managed_device_set_policy(ni_managed_device_t *, ni_managed_policy_t *, xml_node_t *);
 extern void			ni_managed_device_down(ni_managed_device_t *mdev);
-extern ni_bool_t		ni_managed_policy_filename(const char *, char *, size_t);
+extern ni_bool_t		ni_managed_policy_store_open(ni_nanny_t *);
+extern void			ni_managed_policy_store_close(void);
+extern ni_bool_t		ni_managed_policy_store_put(const ni_managed_policy_t *);
+extern ni_bool_t		ni_managed_policy_store_del(const char *);
+extern ni_bool_t		ni_managed_policy_store_commit(void);
 
 extern ni_dbus_object_t *	ni_managed_policy_register(ni_nanny_t *, ni_fsm_policy_t *);
 extern ni_managed_policy_t *	ni_managed_policy_new(ni_nanny_t *, ni_fsm_policy_t *);
@@ -161,6 +168,13 @@ extern void			ni_managed_policy_free(ni_managed_policy_t *);
 
 extern const char *		ni_managed_state_to_string(ni_managed_state_t);
 
+extern ni_nanny_journal_t *	ni_nanny_journal_open(const char *, ni_nanny_journal_replay_fn_t *, void *);
+extern void			ni_nanny_journal_close(ni_nanny_journal_t *);
+extern ni_bool_t		ni_nanny_journal_put(ni_nanny_journal_t *, const char *, const char *);
+extern ni_bool_t		ni_nanny_journal_del(ni_nanny_journal_t *, const char *);
+extern ni_bool_t		ni_nanny_journal_sync(ni_nanny_journal_t *);
+extern ni_bool_t		ni_nanny_journal_compact(ni_nanny_journal_t *);
+
 extern ni_dbus_object_t *	ni_objectmodel_register_managed_netdev(ni_dbus_server_t *, ni_managed_device_t *);
 extern ni_dbus_object_t *	ni_objectmodel_register_managed_modem(ni_dbus_server_t *, ni_managed_device_t *);
 extern ni_dbus_object_t *	ni_objectmodel_register_managed_policy(ni_dbus_server_t *, ni_managed_policy_t *);
@@ -33,79 +33,149 @@
 #include "nanny.h"
 #include "client/ifconfig.h"
 
-ni_bool_t
-ni_managed_policy_filename(const char *name, char *path, size_t size)
+/*
+ * The managed policies are persisted in an append-only journal in the
+ * nanny state directory, which is replayed when the nanny (re)starts.
+ */
+#define NI_MANAGED_POLICY_JOURNAL	"policy.journal"
+
+static ni_nanny_journal_t *		ni_managed_policy_journal;
+
+static int
+ni_managed_policy_store_create(ni_nanny_t *mgr, xml_document_t *doc, const char *origin)
 {
-	if (path && !ni_string_empty(name)) {
-		snprintf(path, size, "%s/%s.xml", ni_nanny_statedir(), name);
-		return TRUE;
-	}
+	int rv;
 
-	return FALSE;
+	if ((rv = ni_nanny_create_policy(NULL, mgr, doc, TRUE)) < 0)
+		ni_error("Unable to create policy from %s", origin);
+	return rv;
 }
 
-static ni_bool_t
-ni_managed_policy_save_node(const xml_node_t *pnode)
+static void
+ni_managed_policy_store_replay(const char *name, const char *data, void *user_data)
 {
-	char path[PATH_MAX] = {'\0'};
-	char temp[PATH_MAX] = {'\0'};
-	const char *pname;
-	FILE *fp;
-	int fd;
+	ni_nanny_t *mgr = user_data;
+	xml_document_t *doc;
 
-	if (xml_node_is_empty(pnode))
-		return FALSE;
+	if (!(doc = xml_document_from_string(data, NULL))) {
+		ni_error("Unable to parse journaled policy %s", name);
+		return;
+	}
+	ni_managed_policy_store_create(mgr, doc, name);
+	xml_document_free(doc);
+}
 
-	pname = ni_ifpolicy_get_name(pnode);
-	if (ni_string_empty(pname))
-		return FALSE;
+/*
+ * Import the policy files saved by previous versions into the journal
+ */
+static void
+ni_managed_policy_store_migrate(ni_nanny_t *mgr)
+{
+	ni_string_array_t files = NI_STRING_ARRAY_INIT;
+	const char *dir = ni_nanny_statedir();
+	ni_fsm_policy_t *policy;
+	unsigned int i;
 
-	ni_managed_policy_filename(pname, path, sizeof(path));
-	snprintf(temp, sizeof(temp), "%s.XXXXXX", path);
+	if (!ni_scandir(dir, "policy*.xml", &files))
+		return;
 
-	if ((fd = mkstemp(temp)) < 0) {
-		ni_error("Cannot create %s policy temp file", path);
-		return FALSE;
-	}
+	for (i = 0; i < files.count; ++i) {
+		char path[PATH_MAX];
+		xml_document_t *doc;
+		xml_node_t *pnode;
+		ni_bool_t migrated;
 
-	if (!(fp = fdopen(fd, "we"))) {
-		close(fd);
-		ni_error("Cannot create %s policy temp file", path);
-		goto failure;
-	}
+		snprintf(path, sizeof(path), "%s/%s", dir, files.data[i]);
+		if (!(doc = xml_document_read(path))) {
+			ni_error("Unable to read policy file %s: %m", path);
+			continue;
+		}
 
-	if (xml_node_print(pnode, fp) < 0) {
-		ni_error("Cannot write into %s policy temp file", path);
-		goto failure;
-	}
+		/* keep the file unless the policy made it into the journal */
+		pnode = xml_node_get_child(xml_document_root(doc), NI_NANNY_IFPOLICY);
+		migrated = ni_managed_policy_store_create(mgr, doc, path) > 0 &&
+			(policy = ni_fsm_policy_by_name(mgr->fsm, ni_ifpolicy_get_name(pnode))) &&
+			ni_managed_policy_store_put(ni_nanny_get_policy(mgr, policy)) &&
+			ni_managed_policy_store_commit();
+		xml_document_free(doc);
 
-	if (rename(temp, path) < 0) {
-		ni_error("Cannot move temp file to policy file %s", path);
-		goto failure;
+		if (migrated)
+			unlink(path);
+		else
+			ni_warn("Unable to migrate policy file %s into the journal", path);
 	}
+	ni_string_array_destroy(&files);
+}
 
-	fclose(fp);
+ni_bool_t
+ni_managed_policy_store_open(ni_nanny_t *mgr)
+{
+	char path[PATH_MAX];
 
+	if (!mgr || ni_managed_policy_journal)
+		return FALSE;
+
+	snprintf(path, sizeof(path), "%s/%s", ni_nanny_statedir(), NI_MANAGED_POLICY_JOURNAL);
+	ni_managed_policy_journal = ni_nanny_journal_open(path,
+					ni_managed_policy_store_replay, mgr);
+	if (!ni_managed_policy_journal)
+		return FALSE;
+
+	ni_managed_policy_store_migrate(mgr);
 	return TRUE;
+}
 
-failure:
-	if (fp) {
-		fclose(fp);
-	}
-	unlink(temp);
-	return FALSE;
+void
+ni_managed_policy_store_close(void)
+{
+	ni_nanny_journal_close(ni_managed_policy_journal);
+	ni_managed_policy_journal = NULL;
 }
 
-static ni_bool_t
-ni_managed_policy_save(const ni_managed_policy_t *mpolicy)
+/*
+ * Queue the current policy in the journal; written on commit.
+ */
+ni_bool_t
+ni_managed_policy_store_put(const ni_managed_policy_t *mpolicy)
 {
 	const xml_node_t *node;
+	const char *name;
+	char *data;
+	ni_bool_t rv;
 
-	if (!mpolicy)
+	if (!mpolicy || !ni_managed_policy_journal)
 		return FALSE;
 
 	node = ni_fsm_policy_node(mpolicy->fsm_policy);
-	return ni_managed_policy_save_node(node);
+	name = ni_fsm_policy_name(mpolicy->fsm_policy);
+	if (xml_node_is_empty(node) || ni_string_empty(name))
+		return FALSE;
+
+	if (!(data = xml_node_sprint(node)))
+		return FALSE;
+
+	rv = ni_nanny_journal_put(ni_managed_policy_journal, name, data);
+	free(data);
+	return rv;
+}
+
+ni_bool_t
+ni_managed_policy_store_del(const char *name)
+{
+	return ni_nanny_journal_del(ni_managed_policy_journal, name);
+}
+
+ni_bool_t
+ni_managed_policy_store_commit(void)
+{
+	return ni_nanny_journal_sync(ni_managed_policy_journal);
+}
+
+static ni_bool_t
+ni_managed_policy_save(const ni_managed_policy_t *mpolicy)
+{
+	return ni_managed_policy_store_put(mpolicy) &&
+		ni_managed_policy_store_commit();
 }
 
 void
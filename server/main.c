@@ -25,6 +25,7 @@
 
 #include <wicked/netinfo.h>
 #include <wicked/addrconf.h>
+#include <wicked/route.h>
 #include <wicked/logging.h>
 #include <wicked/wicked.h>
 #include <wicked/socket.h>
@@ -32,7 +33,11 @@
 #include <wicked/wireless.h>
 #include <wicked/modem.h>
 #include "netinfo_priv.h"
+#include "appconfig.h"
+#include "util_priv.h"
 #include "udev-utils.h"
+#include "snapshot.h"
+#include "client/client_state.h"
 #include "auto6.h"
 
 enum {
@@ -93,6 +98,7 @@ static void		handle_interface_event(ni_netdev_t *, ni_event_t);
 static void		handle_interface_addr_events(ni_netdev_t *, ni_event_t, const ni_address_t *);
 static void		handle_interface_prefix_events(ni_netdev_t *, ni_event_t, const ni_ipv6_ra_pinfo_t *);
 static void		handle_interface_nduseropt_events(ni_netdev_t *, ni_event_t);
+static void		handle_route_events(ni_netconfig_t *, ni_event_t, const ni_route_t *);
 static void		handle_rfkill_event(ni_rfkill_type_t, ni_bool_t, void *);
 static void		handle_other_event(ni_event_t);
 #ifdef MODEM
@@ -254,6 +260,8 @@ run_interface_server(void)
 		ni_fatal("unable to initialize netlink prefix listener");
 	if (ni_server_enable_interface_nduseropt_events(handle_interface_nduseropt_events) < 0)
 		ni_fatal("unable to initialize netlink nduseropt listener");
+	if (ni_server_enable_route_events(handle_route_events) < 0)
+		ni_fatal("unable to initialize netlink route listener");
 
 	if (ni_udev_is_active() && ni_udev_net_subsystem_available()) {
 		if (ni_server_enable_interface_uevents() < 0)
@@ -282,6 +290,9 @@ run_interface_server(void)
 	if (opt_recover_state)
 		recover_state(opt_state_file);
 
+	if (!ni_state_snapshot_open())
+		ni_warn("unable to publish state snapshot for read-only clients");
+
 #ifdef HAVE_SYSTEMD_SD_DAEMON_H
 	if (opt_systemd) {
 		sd_notify(0, "READY=1");
@@ -295,10 +306,15 @@ run_interface_server(void)
 			timeout = ni_timer_next_timeout();
 		} while (ni_dbus_objects_garbage_collect());
 
+		ni_state_snapshot_commit(ni_global_state_handle(0));
+
 		if (ni_socket_wait(timeout) != 0)
 			ni_fatal("ni_socket_wait failed");
 	}
 
+	ni_state_snapshot_close();
+	ni_client_state_flush();
+
 	if (opt_recover_state)
 		ni_objectmodel_save_state(opt_state_file);
 
@@ -387,6 +403,158 @@ recover_state(const char *filename)
 	/* FIXME: update resolver etc. */
 }
 
+/*
+ * The netif signals are coalesced per device: the events of a receive
+ * burst are queued and sent in the next main loop iteration or after
+ * the configured max. latency, dropping duplicates and up/down events
+ * cancelling each other out. Device create, delete, rename and events
+ * with a pending uuid of a backgrounded action are sent immediately,
+ * after the events queued for the device.
+ */
+typedef struct ni_server_event_queue	ni_server_event_queue_t;
+struct ni_server_event_queue {
+	ni_server_event_queue_t *	next;
+	unsigned int			ifindex;
+	ni_uint_array_t			events;
+};
+
+static struct {
+	ni_server_event_queue_t *	list;
+	ni_server_event_queue_t **	tail;
+	ni_hashtable_t			index;
+	const ni_timer_t *		timer;
+} server_events = { .list = NULL, .tail = &server_events.list, .index = NI_HASHTABLE_INIT };
+
+static ni_event_t
+ni_server_event_opposite(ni_event_t event)
+{
+	switch (event) {
+	case NI_EVENT_DEVICE_UP:		return NI_EVENT_DEVICE_DOWN;
+	case NI_EVENT_DEVICE_DOWN:		return NI_EVENT_DEVICE_UP;
+	case NI_EVENT_LINK_UP:			return NI_EVENT_LINK_DOWN;
+	case NI_EVENT_LINK_DOWN:		return NI_EVENT_LINK_UP;
+	case NI_EVENT_NETWORK_UP:		return NI_EVENT_NETWORK_DOWN;
+	case NI_EVENT_NETWORK_DOWN:		return NI_EVENT_NETWORK_UP;
+	case NI_EVENT_LINK_ASSOCIATED:		return NI_EVENT_LINK_ASSOCIATION_LOST;
+	case NI_EVENT_LINK_ASSOCIATION_LOST:	return NI_EVENT_LINK_ASSOCIATED;
+	default:				return __NI_EVENT_MAX;
+	}
+}
+
+static ni_server_event_queue_t *
+ni_server_event_queue_find(unsigned int ifindex)
+{
+	ni_server_event_queue_t *queue;
+	ni_hashtable_iter_t iter;
+
+	queue = ni_hashtable_lookup(&server_events.index, ni_hash_uint(ifindex), &iter);
+	for ( ; queue; queue = ni_hashtable_lookup_next(&iter)) {
+		if (queue->ifindex == ifindex)
+			return queue;
+	}
+	return NULL;
+}
+
+static void
+ni_server_event_queue_send(ni_server_event_queue_t *queue)
+{
+	ni_dbus_object_t *object = NULL;
+	ni_netconfig_t *nc;
+	ni_netdev_t *dev;
+	unsigned int i;
+
+	if ((nc = ni_global_state_handle(0)) && (dev = ni_netdev_by_index(nc, queue->ifindex)))
+		object = ni_objectmodel_get_netif_object(dbus_server, dev);
+
+	for (i = 0; object && i < queue->events.count; ++i)
+		ni_objectmodel_send_netif_event(dbus_server, object, queue->events.data[i], NULL);
+	ni_uint_array_destroy(&queue->events);
+}
+
+/* send and drop the events queued for a device */
+static void
+ni_server_event_queue_flush(unsigned int ifindex)
+{
+	ni_server_event_queue_t *queue, **pos;
+
+	for (pos = &server_events.list; (queue = *pos); pos = &queue->next) {
+		if (queue->ifindex != ifindex)
+			continue;
+
+		if (!(*pos = queue->next))
+			server_events.tail = pos;
+		ni_hashtable_remove(&server_events.index, ni_hash_uint(ifindex), queue);
+		ni_server_event_queue_send(queue);
+		free(queue);
+		return;
+	}
+}
+
+static void
+ni_server_event_queue_timeout(void *user_data, const ni_timer_t *timer)
+{
+	ni_server_event_queue_t *queue;
+
+	if (server_events.timer != timer)
+		return;
+	server_events.timer = NULL;
+
+	while ((queue = server_events.list)) {
+		server_events.list = queue->next;
+		ni_server_event_queue_send(queue);
+		free(queue);
+	}
+	server_events.tail = &server_events.list;
+	ni_hashtable_destroy(&server_events.index);
+}
+
+static void
+ni_server_event_queue_add(ni_netdev_t *dev, ni_event_t event)
+{
+	ni_server_event_queue_t *queue;
+	ni_event_t opposite;
+
+	if (!(queue = ni_server_event_queue_find(dev->link.ifindex))) {
+		queue = xcalloc(1, sizeof(*queue));
+		queue->ifindex = dev->link.ifindex;
+		ni_hashtable_insert(&server_events.index, ni_hash_uint(queue->ifindex), queue);
+		*server_events.tail = queue;
+		server_events.tail = &queue->next;
+	}
+
+	if (!server_events.timer) {
+		server_events.timer = ni_timer_register(ni_global.config ?
+				ni_global.config->rtnl_event.coalesce_latency : 0,
+				ni_server_event_queue_timeout, NULL);
+	}
+
+	if (event == NI_EVENT_DEVICE_CHANGE) {
+		/* implied by any other event */
+		if (queue->events.count == 0)
+			ni_uint_array_append(&queue->events, event);
+		return;
+	}
+
+	ni_uint_array_remove(&queue->events, NI_EVENT_DEVICE_CHANGE);
+	opposite = ni_server_event_opposite(event);
+	if (opposite < __NI_EVENT_MAX && ni_uint_array_contains(&queue->events, opposite)) {
+		/*
+		 * A flap, e.g. a carrier loss: the listeners have to see
+		 * both transitions, so keep the pair in order ending with
+		 * the current one, however often it flapped meanwhile.
+		 */
+		ni_debug_events("%s: coalesced %s and %s events", dev->name,
+				ni_event_type_to_name(opposite),
+				ni_event_type_to_name(event));
+		ni_uint_array_remove(&queue->events, event);
+		ni_uint_array_append(&queue->events, event);
+		return;
+	}
+
+	if (!ni_uint_array_contains(&queue->events, event))
+		ni_uint_array_append(&queue->events, event);
+}
+
 /*
  * Handle network layer events for interface server.
  * FIXME: There should be some locking here, which prevents us from
@@ -398,6 +566,7 @@ handle_interface_event(ni_netdev_t *dev, ni_event_t event)
 {
 	const ni_uuid_t *event_uuid = NULL;
 
+	ni_state_snapshot_mark(dev->link.ifindex);
 	if (dbus_server) {
 		ni_dbus_object_t *object;
 
@@ -428,6 +597,7 @@ handle_interface_event(ni_netdev_t *dev, ni_event_t event)
 		switch (event) {
 		case NI_EVENT_DEVICE_CREATE:
 			/* Create dbus object and emit event */
+			ni_server_event_queue_flush(dev->link.ifindex);
 			ni_objectmodel_send_netif_event(dbus_server, object, event, NULL);
 			break;
 
@@ -437,17 +607,30 @@ handle_interface_event(ni_netdev_t *dev, ni_event_t event)
 			 * Note; deletion of the object will be deferred until we return
 			 * to the main loop.
 			 */
+			ni_server_event_queue_flush(dev->link.ifindex);
 			ni_objectmodel_unregister_netif(dbus_server, dev);
 			ni_objectmodel_send_netif_event(dbus_server, object, event, NULL);
 			break;
 
+		case NI_EVENT_DEVICE_RENAME:
+			ni_server_event_queue_flush(dev->link.ifindex);
+			ni_objectmodel_send_netif_event(dbus_server, object, event, NULL);
+			break;
+
 		default:
 			/* commit backgrounded action results first -- if any */
-			while ((event_uuid = ni_netdev_get_event_uuid(dev, event)) != NULL)
-				ni_objectmodel_send_netif_event(dbus_server, object, event, event_uuid);
+			if ((event_uuid = ni_netdev_get_event_uuid(dev, event)) != NULL) {
+				ni_server_event_queue_flush(dev->link.ifindex);
+				do {
+					ni_objectmodel_send_netif_event(dbus_server, object, event, event_uuid);
+				} while ((event_uuid = ni_netdev_get_event_uuid(dev, event)) != NULL);
+
+				ni_objectmodel_send_netif_event(dbus_server, object, event, NULL);
+				break;
+			}
 
-			/* send unrequested events                            */
-			ni_objectmodel_send_netif_event(dbus_server, object, event, NULL);
+			/* queue unrequested events                           */
+			ni_server_event_queue_add(dev, event);
 			break;
 		}
 	}
@@ -459,6 +642,7 @@ handle_interface_addr_events(ni_netdev_t *dev, ni_event_t event, const ni_addres
 	ni_addrconf_lease_t *lease, *next;
 
 	ni_server_trace_interface_addr_events(dev, event, ap);
+	ni_state_snapshot_mark(dev->link.ifindex);
 
 	if (ap->family != AF_INET6)
 		return;
@@ -505,6 +689,16 @@ handle_interface_nduseropt_events(ni_netdev_t *dev, ni_event_t event)
 	ni_auto6_on_nduseropt_events(dev, event);
 }
 
+static void
+handle_route_events(ni_netconfig_t *nc, ni_event_t event, const ni_route_t *rp)
+{
+	const ni_route_nexthop_t *nh;
+
+	ni_server_trace_route_events(nc, event, rp);
+	for (nh = &rp->nh; nh; nh = nh->next)
+		ni_state_snapshot_mark(nh->device.index);
+}
+
 static void
 handle_other_event(ni_event_t event)
 {
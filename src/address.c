@@ -495,24 +495,18 @@ ni_address_array_destroy(ni_address_array_t *array)
 }
 
 static ni_bool_t
-ni_address_array_realloc(ni_address_array_t *array, unsigned int newlen)
+ni_address_array_realloc(ni_address_array_t *array, unsigned int add)
 {
 	ni_address_t ** newdata;
-	size_t          newsize;
-	unsigned int    i;
 
-	if (!array || (UINT_MAX - NI_ADDRESS_ARRAY_CHUNK) <= newlen)
+	if (!array)
 		return FALSE;
 
-	newlen += NI_ADDRESS_ARRAY_CHUNK;
-	newsize = newlen * sizeof(ni_address_t *);
-	newdata = xrealloc(array->data, newsize);
+	newdata = ni_array_grow_typed(array, add, NI_ADDRESS_ARRAY_CHUNK, 0);
 	if (!newdata)
 		return FALSE;
 
 	array->data = newdata;
-	for (i = array->count; i < newlen; ++i)
-		array->data[i] = NULL;
 	return TRUE;
 }
 
@@ -522,8 +516,7 @@ ni_address_array_append(ni_address_array_t *array, ni_address_t *ap)
 	if (!array)
 		return FALSE;
 
-	if ((array->count % NI_ADDRESS_ARRAY_CHUNK) == 0 &&
-	    !ni_address_array_realloc(array, array->count))
+	if (!ni_address_array_realloc(array, 1))
 		return FALSE;
 
 	array->data[array->count++] = ap;
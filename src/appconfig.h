@@ -60,6 +60,9 @@ struct ni_extension {
 };
 
 #define NI_DHCP_SERVER_PREFERENCES_MAX	16
+#define NI_DHCP4_OFFER_WINDOW_MAX	10000	/* msec */
+#define NI_DHCP4_OFFER_CANDIDATES_MAX	8
+#define NI_DHCP4_OFFER_CANDIDATES_DEFAULT	2
 typedef struct ni_server_preference {
 	ni_opaque_t		serverid;
 	ni_sockaddr_t		address;
@@ -72,6 +75,7 @@ typedef struct ni_config_rtnl_event {
 	 */
 	unsigned int	recv_buff_length;
 	unsigned int	mesg_buff_length;
+	unsigned int	coalesce_latency;	/* msec */
 } ni_config_rtnl_event_t;
 
 typedef enum {
@@ -122,6 +126,11 @@ typedef struct ni_config_dhcp4 {
 	unsigned int		num_preferred_servers;
 	ni_server_preference_t	preferred_server[NI_DHCP_SERVER_PREFERENCES_MAX];
 
+	struct {
+		unsigned int	window;		/* msec, 0 disables */
+		unsigned int	candidates;	/* offers to validate */
+	} offer_collection;
+
 	ni_dhcp_option_decl_t *	custom_options;
 } ni_config_dhcp4_t;
 
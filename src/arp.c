@@ -17,9 +17,86 @@
 #include "netinfo_priv.h"
 #include "socket_priv.h"
 #include "buffer.h"
+#include "util_priv.h"
+
+/*
+ * Per interface ARP capture shared by all sockets on it
+ */
+struct ni_arp_link {
+	ni_arp_link_t *		next;
+	unsigned int		ifindex;
+	unsigned short		hwtype;
+	ni_capture_t *		capture;
+	ni_arp_socket_t *	sockets;
+	unsigned int		busy;
+};
+
+/*
+ * Address being verified, hashed by ifindex and address
+ */
+typedef struct ni_arp_pending	ni_arp_pending_t;
+struct ni_arp_pending {
+	unsigned int		ifindex;
+	struct in_addr		ip;
+	const ni_arp_verify_t *	vfy;
+	ni_address_t *		ap;
+};
+
+static ni_arp_link_t *		ni_arp_links;
+static ni_hashtable_t		ni_arp_pending = NI_HASHTABLE_INIT;
 
 static void	ni_arp_socket_recv(ni_socket_t *);
-static int	ni_arp_parse(ni_arp_socket_t *, ni_buffer_t *, ni_arp_packet_t *);
+static int	ni_arp_parse(const ni_arp_link_t *, ni_buffer_t *, ni_arp_packet_t *);
+
+static ni_arp_link_t *
+ni_arp_link_get(const ni_capture_devinfo_t *dev_info)
+{
+	ni_capture_protinfo_t prot_info;
+	ni_arp_link_t *link, **tail;
+
+	for (tail = &ni_arp_links; (link = *tail); tail = &link->next) {
+		if (link->ifindex == dev_info->ifindex &&
+		    link->hwtype == dev_info->hwaddr.type)
+			return link;
+	}
+
+	if (!(link = calloc(1, sizeof(*link))))
+		return NULL;
+
+	link->ifindex = dev_info->ifindex;
+	link->hwtype = dev_info->hwaddr.type;
+
+	memset(&prot_info, 0, sizeof(prot_info));
+	prot_info.eth_protocol = ETHERTYPE_ARP;
+
+	link->capture = ni_capture_open(dev_info, &prot_info, ni_arp_socket_recv);
+	if (!link->capture) {
+		free(link);
+		return NULL;
+	}
+	ni_capture_set_user_data(link->capture, link);
+
+	*tail = link;
+	return link;
+}
+
+static void
+ni_arp_link_release(ni_arp_link_t *link)
+{
+	ni_arp_link_t **pos;
+
+	if (link->busy || link->sockets)
+		return;
+
+	for (pos = &ni_arp_links; *pos; pos = &(*pos)->next) {
+		if (*pos == link) {
+			*pos = link->next;
+			break;
+		}
+	}
+	ni_capture_free(link->capture);
+	free(link);
+}
 
 /*
  * Open ARP socket
@@ -27,31 +104,50 @@ static int	ni_arp_parse(ni_arp_socket_t *, ni_buffer_t *, ni_arp_packet_t *);
 ni_arp_socket_t *
 ni_arp_socket_open(const ni_capture_devinfo_t *dev_info, ni_arp_callback_t *callback, void *calldata)
 {
-	ni_capture_protinfo_t prot_info;
 	ni_arp_socket_t *arph;
+	ni_arp_link_t *link;
 
-	arph = calloc(1, sizeof(*arph));
-	arph->dev_info = *dev_info;
-	arph->callback = callback;
-	arph->user_data = calldata;
-
-	memset(&prot_info, 0, sizeof(prot_info));
-	prot_info.eth_protocol = ETHERTYPE_ARP;
+	if (!(link = ni_arp_link_get(dev_info)))
+		return NULL;
 
-	arph->capture = ni_capture_open(dev_info, &prot_info, ni_arp_socket_recv);
-	if (!arph->capture) {
-		ni_arp_socket_close(arph);
+	if (!(arph = calloc(1, sizeof(*arph)))) {
+		ni_arp_link_release(link);
 		return NULL;
 	}
+	arph->dev_info = *dev_info;
+	arph->callback = callback;
+	arph->user_data = calldata;
 
-	ni_capture_set_user_data(arph->capture, arph);
+	arph->link = link;
+	arph->capture = link->capture;
+	arph->next = link->sockets;
+	link->sockets = arph;
 	return arph;
 }
 
 void
 ni_arp_socket_close(ni_arp_socket_t *arph)
 {
-	ni_capture_free(arph->capture);
+	ni_arp_link_t *link;
+	ni_arp_socket_t **pos;
+
+	if (!arph)
+		return;
+
+	if ((link = arph->link) != NULL) {
+		if (link->busy) {
+			/* released when the receive loop returns */
+			arph->closed = TRUE;
+			return;
+		}
+		for (pos = &link->sockets; *pos; pos = &(*pos)->next) {
+			if (*pos == arph) {
+				*pos = arph->next;
+				break;
+			}
+		}
+		ni_arp_link_release(link);
+	}
 	free(arph);
 }
 
@@ -63,15 +159,35 @@ static void
 ni_arp_socket_recv(ni_socket_t *sock)
 {
 	ni_capture_t *capture = sock->user_data;
+	ni_arp_socket_t *arph, **pos;
+	ni_arp_packet_t packet;
+	ni_arp_link_t *link;
 	ni_buffer_t buf;
 
-	if (ni_capture_recv(capture, &buf, NULL, "arp") >= 0) {
-		ni_arp_socket_t *arph = ni_capture_get_user_data(capture);
-		ni_arp_packet_t packet;
+	if (ni_capture_recv(capture, &buf, NULL, "arp") < 0)
+		return;
+
+	link = ni_capture_get_user_data(capture);
+	if (!link || ni_arp_parse(link, &buf, &packet) < 0)
+		return;
 
-		if (ni_arp_parse(arph, &buf, &packet) >= 0)
+	link->busy++;
+	for (arph = link->sockets; arph; arph = arph->next) {
+		if (!arph->closed)
 			arph->callback(arph, &packet, arph->user_data);
 	}
+	if (--link->busy)
+		return;
+
+	for (pos = &link->sockets; (arph = *pos); ) {
+		if (arph->closed) {
+			*pos = arph->next;
+			free(arph);
+		} else {
+			pos = &arph->next;
+		}
+	}
+	ni_arp_link_release(link);
 }
 
 int
@@ -176,7 +292,7 @@ ni_arp_send(ni_arp_socket_t *arph, const ni_arp_packet_t *packet)
 }
 
 int
-ni_arp_parse(ni_arp_socket_t *arph, ni_buffer_t *bp, ni_arp_packet_t *p)
+ni_arp_parse(const ni_arp_link_t *link, ni_buffer_t *bp, ni_arp_packet_t *p)
 {
 	struct arphdr *arp;
 
@@ -188,8 +304,8 @@ ni_arp_parse(ni_arp_socket_t *arph, ni_buffer_t *bp, ni_arp_packet_t *p)
 		return -1;
 
 	p->op = ntohs(arp->ar_op);
-	p->sha.type = arph->dev_info.hwaddr.type;
-	p->sha.len = ni_link_address_length(arph->dev_info.hwaddr.type);
+	p->sha.type = link->hwtype;
+	p->sha.len = ni_link_address_length(link->hwtype);
 	p->tha = p->sha;
 
 	if (ni_buffer_get(bp, p->sha.data, p->sha.len) < 0 || ni_buffer_get(bp, &p->sip, 4) < 0
@@ -217,6 +333,87 @@ ni_arp_timeout_left(struct timeval *started, const struct timeval *current, unsi
 	return left;
 }
 
+/*
+ * Addresses probed by ni_arp_verify_send(), i.e. by the address updater
+ * and arputil. dhcp4 and autoip4 probe one address per device with own
+ * timers and conflict handling (decline, RFC 3927 defense) and share
+ * only the capture.
+ */
+static inline unsigned int
+ni_arp_pending_hash(unsigned int ifindex, struct in_addr ip)
+{
+	return ni_hash_uint(ntohl(ip.s_addr) ^ ifindex);
+}
+
+static ni_arp_pending_t *
+ni_arp_pending_lookup(unsigned int ifindex, const ni_arp_verify_t *vfy, struct in_addr ip)
+{
+	ni_hashtable_iter_t iter;
+	ni_arp_pending_t *p;
+
+	p = ni_hashtable_lookup(&ni_arp_pending, ni_arp_pending_hash(ifindex, ip), &iter);
+	for ( ; p; p = ni_hashtable_lookup_next(&iter)) {
+		if (p->ifindex == ifindex && p->vfy == vfy && p->ip.s_addr == ip.s_addr)
+			return p;
+	}
+	return NULL;
+}
+
+static ni_address_t *
+ni_arp_pending_find(unsigned int ifindex, const ni_arp_verify_t *vfy, struct in_addr ip)
+{
+	ni_arp_pending_t *p;
+
+	p = ni_arp_pending_lookup(ifindex, vfy, ip);
+	return p ? p->ap : NULL;
+}
+
+static void
+ni_arp_pending_add(unsigned int ifindex, const ni_arp_verify_t *vfy, ni_address_t *ap)
+{
+	struct in_addr ip = ap->local_addr.sin.sin_addr;
+	ni_arp_pending_t *p;
+
+	if (ni_arp_pending_lookup(ifindex, vfy, ip))
+		return;
+
+	p = xcalloc(1, sizeof(*p));
+	p->ifindex = ifindex;
+	p->ip = ip;
+	p->vfy = vfy;
+	p->ap = ap;
+
+	/* a reply to a probe we could not index would go unnoticed */
+	if (!ni_hashtable_insert(&ni_arp_pending, ni_arp_pending_hash(ifindex, ip), p))
+		ni_fatal("%s: out of memory", __func__);
+}
+
+static void
+ni_arp_pending_del(unsigned int ifindex, const ni_arp_verify_t *vfy, struct in_addr ip)
+{
+	ni_arp_pending_t *p;
+
+	if ((p = ni_arp_pending_lookup(ifindex, vfy, ip))) {
+		ni_hashtable_remove(&ni_arp_pending, ni_arp_pending_hash(ifindex, ip), p);
+		free(p);
+	}
+}
+
+static void
+ni_arp_verify_unregister(ni_arp_verify_t *vfy)
+{
+	ni_address_t *ap;
+	unsigned int i;
+
+	if (!vfy->ifindex)
+		return;
+
+	for (i = 0; i < vfy->ipaddrs.count; ++i) {
+		ap = vfy->ipaddrs.data[i];
+		ni_arp_pending_del(vfy->ifindex, vfy, ap->local_addr.sin.sin_addr);
+	}
+	vfy->ifindex = 0;
+}
 
 void
 ni_arp_verify_init(ni_arp_verify_t *vfy,  unsigned int nprobes, unsigned int wait_ms)
@@ -229,6 +426,7 @@ ni_arp_verify_init(ni_arp_verify_t *vfy,  unsigned int nprobes, unsigned int wai
 void
 ni_arp_verify_reset(ni_arp_verify_t *vfy,  unsigned int nprobes, unsigned int wait_ms)
 {
+	ni_arp_verify_unregister(vfy);
 	vfy->nprobes = nprobes;
 	vfy->wait_ms = wait_ms;
 	timerclear(&vfy->started);
@@ -238,6 +436,7 @@ ni_arp_verify_reset(ni_arp_verify_t *vfy,  unsigned int nprobes, unsigned int wa
 void
 ni_arp_verify_destroy(ni_arp_verify_t *vfy)
 {
+	ni_arp_verify_unregister(vfy);
 	ni_address_array_destroy(&vfy->ipaddrs);
 	memset(vfy, 0, sizeof(*vfy));
 }
@@ -279,10 +478,10 @@ ni_arp_verify_process(ni_arp_socket_t *sock, const ni_arp_packet_t *pkt, void *u
 	if (!sock || !pkt || pkt->op != ARPOP_REPLY || !vfy)
 		return;
 
-	/* Is it about the address we're validating? */
+	/* Is it about an address we're validating? */
 	memset(&sip, 0, sizeof(sip));
 	ni_sockaddr_set_ipv4(&sip.local_addr, pkt->sip, 0);
-	dup = ni_address_array_find_match(&vfy->ipaddrs, &sip, NULL, ni_address_equal_local_addr);
+	dup = ni_arp_pending_find(sock->dev_info.ifindex, vfy, pkt->sip);
 	if (!dup) {
 		ni_debug_application("%s: ignore report about unrelated address %s from  %s",
 				sock->dev_info.ifname, ni_sockaddr_print(&sip.local_addr),
@@ -358,6 +557,11 @@ ni_arp_verify_send(ni_arp_socket_t *sock, ni_arp_verify_t *vfy, unsigned int *ti
 	if ((*timeout = ni_arp_timeout_left(&vfy->started, &now, vfy->wait_ms)))
 		return TRUE;
 
+	if (vfy->ifindex != sock->dev_info.ifindex) {
+		ni_arp_verify_unregister(vfy);
+		vfy->ifindex = sock->dev_info.ifindex;
+	}
+
 	if (vfy->nprobes && vfy->ipaddrs.count) {
 		vfy->started = now;
 		vfy->nprobes--;
@@ -375,6 +579,7 @@ ni_arp_verify_send(ni_arp_socket_t *sock, ni_arp_verify_t *vfy, unsigned int *ti
 					sock->dev_info.ifname,
 					ni_sockaddr_print(&ap->local_addr));
 
+			ni_arp_pending_add(vfy->ifindex, vfy, ap);
 			ip = &ap->local_addr.sin.sin_addr;
 			if (ni_arp_send_request(sock, null, *ip) > 0)
 				count++;
@@ -385,6 +590,7 @@ ni_arp_verify_send(ni_arp_socket_t *sock, ni_arp_verify_t *vfy, unsigned int *ti
 		}
 	}
 
+	ni_arp_verify_unregister(vfy);
 	for (count = 0, i = 0; i < vfy->ipaddrs.count; ++i) {
 		ap = vfy->ipaddrs.data[i];
 
@@ -676,32 +676,15 @@ __ni_capture_init_once(void)
 	ni_modprobe(AFPACKET_MODULE_NAME, AFPACKET_MODULE_OPTS);
 }
 
-ni_capture_t *
-ni_capture_open(const ni_capture_devinfo_t *devinfo, const ni_capture_protinfo_t *protinfo, void (*receive)(ni_socket_t *))
+static ni_capture_t *
+__ni_capture_open(const char *ifname, unsigned int ifindex, unsigned int hwtype, unsigned int mtu,
+		const ni_hwaddr_t *destaddr, const ni_capture_protinfo_t *protinfo,
+		void (*receive)(ni_socket_t *))
 {
 	ni_packetaddr_t	addr;
 	ni_capture_t *capture = NULL;
-	ni_hwaddr_t destaddr;
 	int fd = -1;
 
-	if (devinfo->ifindex == 0) {
-		ni_error("no ifindex for interface `%s'", devinfo->ifname);
-		return NULL;
-	}
-	if (protinfo->eth_protocol == 0) {
-		ni_error("%s: bad ethernet protocol for dev %s", __func__, devinfo->ifname);
-		return NULL;
-	}
-
-	/* Destination address defaults to broadcast */
-	destaddr = protinfo->eth_destaddr;
-
-	if (destaddr.len == 0
-	 && ni_link_address_get_broadcast(devinfo->hwaddr.type, &destaddr) < 0) {
-		ni_error("cannot get broadcast address for %s (bad iftype)", devinfo->ifname);
-		return NULL;
-	}
-
 	__ni_capture_init_once();
 
 	if ((fd = socket (PF_PACKET, SOCK_DGRAM, htons(protinfo->eth_protocol))) < 0) {
@@ -713,16 +696,16 @@ ni_capture_open(const ni_capture_devinfo_t *devinfo, const ni_capture_protinfo_t
 	capture = calloc(1, sizeof(*capture));
 	if (!capture)
 		goto failed;
-	ni_string_dup(&capture->ifname, devinfo->ifname);
+	ni_string_dup(&capture->ifname, ifname);
 	capture->sock = ni_socket_wrap(fd, SOCK_DGRAM);
 	capture->protocol = protinfo->eth_protocol;
 
 	capture->addr.sll.sll_family = AF_PACKET;
 	capture->addr.sll.sll_protocol = htons(protinfo->eth_protocol);
-	capture->addr.sll.sll_ifindex = devinfo->ifindex;
-	capture->addr.sll.sll_hatype = htons(devinfo->hwaddr.type);
-	capture->addr.sll.sll_halen = destaddr.len;
-	memcpy(&capture->addr.sll.sll_addr, destaddr.data, destaddr.len);
+	capture->addr.sll.sll_ifindex = ifindex;
+	capture->addr.sll.sll_hatype = htons(hwtype);
+	capture->addr.sll.sll_halen = destaddr->len;
+	memcpy(&capture->addr.sll.sll_addr, destaddr->data, destaddr->len);
 
 	if (ni_capture_set_filter(capture, protinfo) < 0)
 		goto failed;
@@ -730,7 +713,7 @@ ni_capture_open(const ni_capture_devinfo_t *devinfo, const ni_capture_protinfo_t
 	memset(&addr, 0, sizeof(addr));
 	addr.sll.sll_family = PF_PACKET;
 	addr.sll.sll_protocol = htons(protinfo->eth_protocol);
-	addr.sll.sll_ifindex = devinfo->ifindex;
+	addr.sll.sll_ifindex = ifindex;
 
 	if (bind(fd, &addr.sa, sizeof(addr)) == -1) {
 		ni_error("bind: %m");
@@ -739,7 +722,7 @@ ni_capture_open(const ni_capture_devinfo_t *devinfo, const ni_capture_protinfo_t
 
 	__ni_capture_enable_packet_auxdata(fd);
 
-	capture->mtu = devinfo->mtu;
+	capture->mtu = mtu;
 	if (capture->mtu == 0)
 		capture->mtu = MTU_MAX;
 	capture->buffer = xmalloc(capture->mtu);
@@ -758,6 +741,57 @@ failed:
 	return NULL;
 }
 
+ni_capture_t *
+ni_capture_open(const ni_capture_devinfo_t *devinfo, const ni_capture_protinfo_t *protinfo, void (*receive)(ni_socket_t *))
+{
+	ni_hwaddr_t destaddr;
+
+	if (devinfo->ifindex == 0) {
+		ni_error("no ifindex for interface `%s'", devinfo->ifname);
+		return NULL;
+	}
+	if (protinfo->eth_protocol == 0) {
+		ni_error("%s: bad ethernet protocol for dev %s", __func__, devinfo->ifname);
+		return NULL;
+	}
+
+	/* Destination address defaults to broadcast */
+	destaddr = protinfo->eth_destaddr;
+
+	if (destaddr.len == 0
+	 && ni_link_address_get_broadcast(devinfo->hwaddr.type, &destaddr) < 0) {
+		ni_error("cannot get broadcast address for %s (bad iftype)", devinfo->ifname);
+		return NULL;
+	}
+
+	return __ni_capture_open(devinfo->ifname, devinfo->ifindex, devinfo->hwaddr.type,
+				devinfo->mtu, &destaddr, protinfo, receive);
+}
+
+/*
+ * Open an ethernet capture bound to all interfaces, for link layer
+ * protocols only. The interface a packet arrived on is in the
+ * sll_ifindex of the address returned by ni_capture_recv(), and
+ * packets are sent with ni_capture_send_to().
+ */
+ni_capture_t *
+ni_capture_open_any(const ni_capture_protinfo_t *protinfo, void (*receive)(ni_socket_t *))
+{
+	switch (protinfo->eth_protocol) {
+	case ETHERTYPE_ARP:
+	case ETHERTYPE_LLDP:
+		break;
+
+	default:
+		ni_error("%s: cannot capture ether type 0x%04x on all interfaces",
+				__func__, protinfo->eth_protocol);
+		return NULL;
+	}
+
+	return __ni_capture_open("any", 0, ARPHRD_ETHER, MTU_MAX,
+				&protinfo->eth_destaddr, protinfo, receive);
+}
+
 static int
 ni_capture_set_filter(ni_capture_t *cap, const ni_capture_protinfo_t *protinfo)
 {
@@ -819,6 +853,33 @@ __ni_capture_send(const ni_capture_t *capture, const ni_buffer_t *buf)
 	return rv;
 }
 
+ssize_t
+ni_capture_send_to(const ni_capture_t *capture, const ni_buffer_t *buf,
+			unsigned int ifindex, const ni_hwaddr_t *destaddr)
+{
+	ni_packetaddr_t addr;
+	ssize_t rv;
+
+	if (capture == NULL) {
+		ni_error("%s: no capture handle", __FUNCTION__);
+		return -1;
+	}
+
+	addr = capture->addr;
+	addr.sll.sll_ifindex = ifindex;
+	if (destaddr && destaddr->len) {
+		addr.sll.sll_halen = destaddr->len;
+		memcpy(&addr.sll.sll_addr, destaddr->data, destaddr->len);
+	}
+
+	rv = sendto(capture->sock->__fd, ni_buffer_head(buf), ni_buffer_count(buf), 0,
+			&addr.sa, sizeof(addr));
+	if (rv < 0)
+		ni_error("unable to send packet on interface index %u: %m", ifindex);
+
+	return rv;
+}
+
 ssize_t
 ni_capture_send(ni_capture_t *capture, const ni_buffer_t *buf, const ni_timeout_param_t *tmo)
 {
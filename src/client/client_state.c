@@ -11,9 +11,12 @@
 #include "config.h"
 #endif
 #include <sys/time.h>
+#include <sys/stat.h>
+#include <sys/file.h>
 #include <stdio.h>
 #include <limits.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <unistd.h>
 
 #include <wicked/fsm.h>
@@ -25,17 +28,7 @@
 
 #include "client/client_state.h"
 #include "util_priv.h"
-
-/*
- * Internal utilities
- */
-static void
-ni_client_state_filename(unsigned int ifindex, char *path, size_t size)
-{
-	snprintf(path, size, "%s/state-%u.xml",
-			ni_config_statedir(),
-			ifindex);
-}
+#include "buffer.h"
 
 ni_bool_t
 ni_client_state_parse_timeval(const char *str, struct timeval *tv)
@@ -427,75 +420,691 @@ ni_client_state_scripts_copy(ni_client_state_scripts_t *dst,
 		dst->node = xml_node_clone(src->node, NULL);
 }
 
-ni_bool_t
-ni_client_state_save(const ni_client_state_t *client_state, unsigned int ifindex)
+/*
+ * Client state store
+ *
+ * The client states of all devices are kept in a single log file in
+ * the state directory: a header followed by records of the ifindex,
+ * the payload length and a check value, then the encoded state. A
+ * record without payload drops the state of the ifindex.
+ *
+ * Each process reads the log once and then applies the records other
+ * processes appended since, or re-reads it after it was rewritten.
+ * Updates are applied to the in-memory records and appended in a single
+ * write on the next main loop iteration, or at exit. Writers serialize
+ * on a lock file and catch up with the log before they append, so the
+ * log is only compacted from current records. A torn record at the end
+ * of the log is ignored by readers and truncated by the next writer.
+ * The log is rewritten once it grew to twice the size of the records.
+ */
+#define NI_CLIENT_STATE_STORE_FILE		"client-state.log"
+#define NI_CLIENT_STATE_STORE_LOCK		"client-state.lock"
+#define NI_CLIENT_STATE_STORE_MAGIC		0x6e696373	/* "nics" */
+#define NI_CLIENT_STATE_STORE_VERSION		1
+#define NI_CLIENT_STATE_STORE_COMPACT_MIN	65536
+
+typedef struct ni_client_state_store_header {
+	uint32_t			magic;
+	uint32_t			version;
+} ni_client_state_store_header_t;
+
+typedef struct ni_client_state_record_header {
+	uint32_t			ifindex;
+	uint32_t			length;
+	uint32_t			check;
+} ni_client_state_record_header_t;
+
+typedef struct ni_client_state_record	ni_client_state_record_t;
+
+struct ni_client_state_record {
+	ni_client_state_record_t *	next;
+	unsigned int			ifindex;
+	ni_buffer_t			data;
+};
+
+static struct ni_client_state_store {
+	char *				path;
+	int				fd;
+	int				lock_fd;
+	size_t				size;	/* bytes of the log applied */
+	size_t				live;	/* bytes of the current records */
+
+	ni_client_state_record_t *	records;
+	ni_hashtable_t			index;
+	ni_uint_array_t			dirty;
+	const ni_timer_t *		timer;
+} ni_client_state_store = {
+	.fd		= -1,
+	.lock_fd	= -1,
+	.index		= NI_HASHTABLE_INIT,
+	.dirty		= NI_UINT_ARRAY_INIT,
+};
+
+static inline void
+ni_client_state_store_put(ni_buffer_t *bp, const void *data, size_t len)
 {
-	char path[PATH_MAX] = {'\0'};
-	char temp[PATH_MAX] = {'\0'};
-	xml_node_t *node;
-	FILE *fp = NULL;
-	int fd;
+	ni_buffer_ensure_tailroom(bp, len);
+	ni_buffer_put(bp, data, len);
+}
+
+static inline void
+ni_client_state_store_put_uint(ni_buffer_t *bp, unsigned int value)
+{
+	uint32_t v = value;
 
-	ni_client_state_filename(ifindex, path, sizeof(path));
-	snprintf(temp, sizeof(temp), "%s.XXXXXX", path);
+	ni_client_state_store_put(bp, &v, sizeof(v));
+}
+
+static inline void
+ni_client_state_store_put_string(ni_buffer_t *bp, const char *str)
+{
+	size_t len = str ? strlen(str) : 0;
+
+	ni_client_state_store_put_uint(bp, len);
+	ni_client_state_store_put(bp, str, len);
+}
 
-	if ((fd = mkstemp(temp)) < 0) {
-		ni_error("Cannot create %s state temp file", path);
+static inline ni_bool_t
+ni_client_state_store_get_uint(ni_buffer_t *bp, unsigned int *value)
+{
+	uint32_t v;
+
+	if (ni_buffer_get(bp, &v, sizeof(v)) < 0)
 		return FALSE;
+	*value = v;
+	return TRUE;
+}
+
+static inline ni_bool_t
+ni_client_state_store_get_string(ni_buffer_t *bp, char **str)
+{
+	unsigned int len;
+
+	if (!ni_client_state_store_get_uint(bp, &len) || len > ni_buffer_count(bp))
+		return FALSE;
+
+	ni_string_free(str);
+	if (len) {
+		*str = xmalloc(len + 1);
+		memcpy(*str, ni_buffer_head(bp), len);
+		(*str)[len] = '\0';
 	}
-	if (!(fp = fdopen(fd, "we"))) {
-		close(fd);
-		ni_error("Cannot create %s state temp file", path);
-		goto failure;
+	bp->head += len;
+	return TRUE;
+}
+
+static void
+ni_client_state_encode(ni_buffer_t *bp, const ni_client_state_t *cs)
+{
+	char *scripts = NULL;
+
+	ni_client_state_store_put_uint(bp, cs->control.persistent);
+	ni_client_state_store_put_uint(bp, cs->control.usercontrol);
+	ni_client_state_store_put_uint(bp, cs->control.require_link);
+	ni_client_state_store_put(bp, &cs->config.uuid, sizeof(cs->config.uuid));
+	ni_client_state_store_put_string(bp, cs->config.origin);
+	ni_client_state_store_put_uint(bp, cs->config.owner);
+
+	if (cs->scripts.node)
+		scripts = xml_node_sprint(cs->scripts.node);
+	ni_client_state_store_put_string(bp, scripts);
+	free(scripts);
+}
+
+static ni_bool_t
+ni_client_state_decode(ni_buffer_t *bp, ni_client_state_t *cs)
+{
+	unsigned int persistent, usercontrol, require_link;
+	xml_document_t *doc;
+	char *scripts = NULL;
+	ni_bool_t ret;
+
+	if (!ni_client_state_store_get_uint(bp, &persistent) ||
+	    !ni_client_state_store_get_uint(bp, &usercontrol) ||
+	    !ni_client_state_store_get_uint(bp, &require_link) ||
+	    ni_buffer_get(bp, &cs->config.uuid, sizeof(cs->config.uuid)) < 0 ||
+	    !ni_client_state_store_get_string(bp, &cs->config.origin) ||
+	    !ni_client_state_store_get_uint(bp, &cs->config.owner) ||
+	    !ni_client_state_store_get_string(bp, &scripts))
+		return FALSE;
+
+	cs->control.persistent = !!persistent;
+	cs->control.usercontrol = !!usercontrol;
+	cs->control.require_link = (int)require_link;
+
+	if (!scripts)
+		return TRUE;
+
+	doc = xml_document_from_string(scripts, NI_CLIENT_STATE_STORE_FILE);
+	ret = doc && ni_client_state_scripts_parse_xml(xml_document_root(doc), &cs->scripts);
+	xml_document_free(doc);
+	free(scripts);
+	return ret;
+}
+
+static inline uint32_t
+ni_client_state_record_check(unsigned int ifindex, const void *data, size_t len)
+{
+	return ni_hash_bytes(data, len) ^ ni_hash_uint(ifindex) ^ len;
+}
+
+static ni_client_state_record_t *
+ni_client_state_record_get(unsigned int ifindex)
+{
+	struct ni_client_state_store *st = &ni_client_state_store;
+	ni_client_state_record_t *rec;
+	ni_hashtable_iter_t iter;
+
+	for (rec = ni_hashtable_lookup(&st->index, ni_hash_uint(ifindex), &iter); rec;
+	     rec = ni_hashtable_lookup_next(&iter)) {
+		if (rec->ifindex == ifindex)
+			return rec;
 	}
+	return NULL;
+}
 
-	if (!(node = xml_node_new(NI_CLIENT_STATE_XML_NODE, NULL))) {
-		ni_error("Cannot create %s node for %s", NI_CLIENT_STATE_XML_NODE, path);
-		goto failure;
+static void
+ni_client_state_record_set(unsigned int ifindex, const void *data, size_t len)
+{
+	struct ni_client_state_store *st = &ni_client_state_store;
+	ni_client_state_record_t *rec;
+
+	if (!(rec = ni_client_state_record_get(ifindex))) {
+		rec = xcalloc(1, sizeof(*rec));
+		rec->ifindex = ifindex;
+		ni_buffer_init_dynamic(&rec->data, len ?: 64);
+		rec->next = st->records;
+		st->records = rec;
+		ni_hashtable_insert(&st->index, ni_hash_uint(ifindex), rec);
+	} else {
+		st->live -= sizeof(ni_client_state_record_header_t) + ni_buffer_count(&rec->data);
+		ni_buffer_clear(&rec->data);
 	}
+	ni_client_state_store_put(&rec->data, data, len);
+	st->live += sizeof(ni_client_state_record_header_t) + len;
+}
 
-	if (!ni_client_state_print_xml(client_state, node)) {
-		ni_error("Cannot format state into xml for %s", path);
-		xml_node_free(node);
-		goto failure;
+static void
+ni_client_state_record_unlink(ni_client_state_record_t *rec)
+{
+	struct ni_client_state_store *st = &ni_client_state_store;
+	ni_client_state_record_t **pos;
+
+	for (pos = &st->records; *pos; pos = &(*pos)->next) {
+		if (*pos == rec) {
+			*pos = rec->next;
+			break;
+		}
 	}
+	ni_hashtable_remove(&st->index, ni_hash_uint(rec->ifindex), rec);
+	st->live -= sizeof(ni_client_state_record_header_t) + ni_buffer_count(&rec->data);
+	rec->next = NULL;
+}
 
-	if (xml_node_print(node, fp) < 0) {
-		ni_error("Cannot write into %s state temp file", path);
-		xml_node_free(node);
-		goto failure;
+static void
+ni_client_state_record_remove(unsigned int ifindex)
+{
+	ni_client_state_record_t *rec;
+
+	if ((rec = ni_client_state_record_get(ifindex))) {
+		ni_client_state_record_unlink(rec);
+		ni_buffer_destroy(&rec->data);
+		free(rec);
+	}
+}
+
+static void
+ni_client_state_store_append(ni_buffer_t *bp, unsigned int ifindex, const ni_buffer_t *data)
+{
+	ni_client_state_record_header_t hdr;
+	const void *payload = data ? ni_buffer_head(data) : NULL;
+
+	hdr.ifindex = ifindex;
+	hdr.length = data ? ni_buffer_count(data) : 0;
+	hdr.check = ni_client_state_record_check(ifindex, payload, hdr.length);
+	ni_client_state_store_put(bp, &hdr, sizeof(hdr));
+	ni_client_state_store_put(bp, payload, hdr.length);
+}
+
+static ni_bool_t
+ni_client_state_store_write(int fd, const ni_buffer_t *bp)
+{
+	const unsigned char *ptr = ni_buffer_head(bp);
+	size_t len = ni_buffer_count(bp);
+	ssize_t n;
+
+	while (len) {
+		if ((n = write(fd, ptr, len)) < 0) {
+			if (errno == EINTR)
+				continue;
+			return FALSE;
+		}
+		ptr += n;
+		len -= n;
+	}
+	return TRUE;
+}
+
+static ni_bool_t
+ni_client_state_store_open(void)
+{
+	struct ni_client_state_store *st = &ni_client_state_store;
+	int fd;
+
+	if ((fd = open(st->path, O_RDWR | O_APPEND | O_CLOEXEC)) < 0) {
+		if (errno != ENOENT)
+			ni_error("Cannot open client state store '%s': %m", st->path);
+		return FALSE;
+	}
+
+	if (st->fd >= 0)
+		close(st->fd);
+	st->fd = fd;
+	st->size = 0;
+	return TRUE;
+}
+
+static ni_bool_t
+ni_client_state_store_lock(void)
+{
+	struct ni_client_state_store *st = &ni_client_state_store;
+	char *path = NULL;
+
+	if (st->lock_fd < 0) {
+		if (!ni_string_printf(&path, "%s/%s", ni_config_statedir(),
+					NI_CLIENT_STATE_STORE_LOCK))
+			return FALSE;
+		st->lock_fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+		if (st->lock_fd < 0)
+			ni_error("Cannot open client state store lock '%s': %m", path);
+		ni_string_free(&path);
+		if (st->lock_fd < 0)
+			return FALSE;
+	}
+
+	while (flock(st->lock_fd, LOCK_EX) < 0) {
+		if (errno != EINTR) {
+			ni_error("Cannot lock client state store: %m");
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+static void
+ni_client_state_store_unlock(void)
+{
+	struct ni_client_state_store *st = &ni_client_state_store;
+
+	if (st->lock_fd >= 0)
+		flock(st->lock_fd, LOCK_UN);
+}
+
+/*
+ * Write the current records into a new log and replace the old one.
+ * The caller holds the store lock.
+ */
+static ni_bool_t
+ni_client_state_store_rewrite(void)
+{
+	struct ni_client_state_store *st = &ni_client_state_store;
+	ni_client_state_store_header_t hdr;
+	ni_client_state_record_t *rec;
+	char *tmpname = NULL;
+	ni_buffer_t buf;
+	int fd;
+
+	if (!ni_string_printf(&tmpname, "%s.XXXXXX", st->path))
+		return FALSE;
+	if ((fd = mkstemp(tmpname)) < 0) {
+		ni_error("Cannot create client state store temp file %s: %m", tmpname);
+		ni_string_free(&tmpname);
+		return FALSE;
 	}
-	xml_node_free(node);
 
-	if (rename(temp, path) < 0) {
-		ni_error("Cannot move temp file to state file %s", path);
+	ni_buffer_init_dynamic(&buf, sizeof(hdr) + st->live);
+	hdr.magic = NI_CLIENT_STATE_STORE_MAGIC;
+	hdr.version = NI_CLIENT_STATE_STORE_VERSION;
+	ni_client_state_store_put(&buf, &hdr, sizeof(hdr));
+	for (rec = st->records; rec; rec = rec->next)
+		ni_client_state_store_append(&buf, rec->ifindex, &rec->data);
+
+	if (!ni_client_state_store_write(fd, &buf)) {
+		ni_error("Cannot write client state store temp file %s: %m", tmpname);
 		goto failure;
 	}
+	if (rename(tmpname, st->path) < 0) {
+		ni_error("Cannot move temp file to client state store %s: %m", st->path);
+		goto failure;
+	}
+	close(fd);
 
-	fclose(fp);
+	if (!ni_client_state_store_open()) {
+		ni_buffer_destroy(&buf);
+		ni_string_free(&tmpname);
+		return FALSE;
+	}
+	st->size = ni_buffer_count(&buf);
+	ni_uint_array_destroy(&st->dirty);
 
+	ni_buffer_destroy(&buf);
+	ni_string_free(&tmpname);
 	return TRUE;
 
 failure:
-	if (fp) {
-		fclose(fp);
-	}
-	unlink(temp);
+	ni_buffer_destroy(&buf);
+	close(fd);
+	unlink(tmpname);
+	ni_string_free(&tmpname);
 	return FALSE;
 }
 
+/*
+ * Apply the records in data, returning the length of the valid part.
+ * Records of ifindexes changed by this process and not written yet
+ * are skipped, as the pending ones replace them.
+ */
+static size_t
+ni_client_state_store_parse(const unsigned char *data, size_t size, ni_bool_t header)
+{
+	struct ni_client_state_store *st = &ni_client_state_store;
+	const ni_client_state_store_header_t *hdr = (const void *)data;
+	ni_client_state_record_header_t rec;
+	size_t pos = 0;
+
+	if (header) {
+		if (size < sizeof(*hdr) || hdr->magic != NI_CLIENT_STATE_STORE_MAGIC ||
+		    hdr->version != NI_CLIENT_STATE_STORE_VERSION)
+			return 0;
+		pos = sizeof(*hdr);
+	}
+
+	for ( ; pos + sizeof(rec) <= size; pos += sizeof(rec) + rec.length) {
+		memcpy(&rec, data + pos, sizeof(rec));
+		if (rec.length > size - pos - sizeof(rec))
+			break;
+		if (rec.check != ni_client_state_record_check(rec.ifindex,
+					data + pos + sizeof(rec), rec.length))
+			break;
+
+		if (ni_uint_array_contains(&st->dirty, rec.ifindex))
+			continue;
+		if (rec.length)
+			ni_client_state_record_set(rec.ifindex, data + pos + sizeof(rec), rec.length);
+		else
+			ni_client_state_record_remove(rec.ifindex);
+	}
+	return pos;
+}
+
+/*
+ * Forget the records read from a log that has been replaced
+ */
+static void
+ni_client_state_store_forget(void)
+{
+	struct ni_client_state_store *st = &ni_client_state_store;
+	ni_client_state_record_t *rec, *next;
+
+	for (rec = st->records; rec; rec = next) {
+		next = rec->next;
+		if (!ni_uint_array_contains(&st->dirty, rec->ifindex))
+			ni_client_state_record_remove(rec->ifindex);
+	}
+}
+
+/*
+ * Catch up with the records other processes wrote to the log. When
+ * locked, a torn record at its end is truncated. Returns FALSE when
+ * the log does not exist or is not valid and has to be rewritten.
+ */
+static ni_bool_t
+ni_client_state_store_sync(ni_bool_t locked)
+{
+	struct ni_client_state_store *st = &ni_client_state_store;
+	struct stat cur, our;
+	unsigned char *data;
+	size_t len, valid;
+	ssize_t n;
+
+	if (stat(st->path, &cur) < 0) {
+		if (errno != ENOENT)
+			ni_error("Cannot stat client state store '%s': %m", st->path);
+		return FALSE;
+	}
+
+	if (st->fd < 0 || fstat(st->fd, &our) < 0 ||
+	    our.st_dev != cur.st_dev || our.st_ino != cur.st_ino) {
+		ni_client_state_store_forget();
+		if (!ni_client_state_store_open())
+			return FALSE;
+	}
+
+	if (fstat(st->fd, &our) < 0)
+		return FALSE;
+	if ((size_t)our.st_size <= st->size)
+		return st->size > 0;
+
+	len = our.st_size - st->size;
+	data = xmalloc(len);
+	for (valid = 0; valid < len; valid += n) {
+		n = pread(st->fd, data + valid, len - valid, st->size + valid);
+		if (n < 0 && errno == EINTR)
+			n = 0;
+		else if (n <= 0)
+			break;
+	}
+	valid = ni_client_state_store_parse(data, valid, st->size == 0);
+	free(data);
+	st->size += valid;
+
+	if (locked && st->size < (size_t)our.st_size) {
+		if (!st->size)
+			return FALSE;
+
+		ni_warn("Discarding %zu bytes of incomplete records in '%s'",
+				(size_t)our.st_size - st->size, st->path);
+		if (ftruncate(st->fd, st->size) < 0)
+			return FALSE;
+	}
+	return st->size > 0;
+}
+
+static ni_bool_t	ni_client_state_load_file(ni_client_state_t *, const char *);
+
+/*
+ * Import the per-device state files written by older versions
+ */
+static void
+ni_client_state_store_import(ni_string_array_t *files)
+{
+	const char *statedir = ni_config_statedir();
+	ni_string_array_t names = NI_STRING_ARRAY_INIT;
+	char path[PATH_MAX];
+	ni_client_state_t cs;
+	unsigned int i, ifindex;
+	ni_buffer_t buf;
+
+	if (!ni_scandir(statedir, "state-*.xml", &names))
+		return;
+
+	ni_client_state_init(&cs);
+	ni_buffer_init_dynamic(&buf, 256);
+	for (i = 0; i < names.count; ++i) {
+		if (sscanf(names.data[i], "state-%u.xml", &ifindex) != 1 || !ifindex)
+			continue;
+
+		snprintf(path, sizeof(path), "%s/%s", statedir, names.data[i]);
+		ni_string_array_append(files, path);
+		if (ni_client_state_record_get(ifindex))
+			continue;
+
+		ni_client_state_reset(&cs);
+		if (!ni_client_state_load_file(&cs, path))
+			continue;
+
+		ni_buffer_clear(&buf);
+		ni_client_state_encode(&buf, &cs);
+		ni_client_state_record_set(ifindex, ni_buffer_head(&buf), ni_buffer_count(&buf));
+	}
+	ni_client_state_reset(&cs);
+	ni_buffer_destroy(&buf);
+	ni_string_array_destroy(&names);
+}
+
+static ni_bool_t
+ni_client_state_store_load(void)
+{
+	struct ni_client_state_store *st = &ni_client_state_store;
+	ni_string_array_t legacy = NI_STRING_ARRAY_INIT;
+	ni_bool_t locked, valid;
+	unsigned int i;
+
+	if (st->path) {
+		ni_client_state_store_sync(FALSE);
+		return TRUE;
+	}
+
+	if (!ni_string_printf(&st->path, "%s/%s", ni_config_statedir(),
+				NI_CLIENT_STATE_STORE_FILE))
+		return FALSE;
+
+	locked = ni_client_state_store_lock();
+	valid = ni_client_state_store_sync(locked);
+
+	ni_client_state_store_import(&legacy);
+
+	if (locked && (!valid || legacy.count) && ni_client_state_store_rewrite()) {
+		for (i = 0; i < legacy.count; ++i)
+			unlink(legacy.data[i]);
+	}
+	if (locked)
+		ni_client_state_store_unlock();
+	ni_string_array_destroy(&legacy);
+
+	return TRUE;
+}
+
+static void
+ni_client_state_store_timeout(void *user_data, const ni_timer_t *timer)
+{
+	struct ni_client_state_store *st = &ni_client_state_store;
+
+	if (st->timer == timer) {
+		st->timer = NULL;
+		ni_client_state_flush();
+	}
+}
+
+static void
+ni_client_state_store_atexit(void)
+{
+	ni_client_state_flush();
+}
+
+static void
+ni_client_state_store_mark(unsigned int ifindex)
+{
+	struct ni_client_state_store *st = &ni_client_state_store;
+	static ni_bool_t atexit_done = FALSE;
+
+	if (!ni_uint_array_contains(&st->dirty, ifindex))
+		ni_uint_array_append(&st->dirty, ifindex);
+
+	/* processes without a main loop write at exit */
+	if (!atexit_done) {
+		atexit(ni_client_state_store_atexit);
+		atexit_done = TRUE;
+	}
+	if (!st->timer)
+		st->timer = ni_timer_register(0, ni_client_state_store_timeout, NULL);
+}
+
+static ni_bool_t
+ni_client_state_store_append_dirty(void)
+{
+	struct ni_client_state_store *st = &ni_client_state_store;
+	ni_client_state_record_t *rec;
+	unsigned int i, ifindex;
+	ni_buffer_t buf;
+
+	ni_buffer_init_dynamic(&buf, 256 * st->dirty.count);
+	for (i = 0; i < st->dirty.count; ++i) {
+		ifindex = st->dirty.data[i];
+		rec = ni_client_state_record_get(ifindex);
+		ni_client_state_store_append(&buf, ifindex, rec ? &rec->data : NULL);
+	}
+
+	if (!ni_client_state_store_write(st->fd, &buf)) {
+		ni_error("Cannot write client state store '%s': %m", st->path);
+		ni_buffer_destroy(&buf);
+		/* do not leave a torn record in front of the next ones;
+		 * the fd appends, so the next write starts at st->size */
+		if (ftruncate(st->fd, st->size) < 0)
+			return ni_client_state_store_rewrite();
+		return FALSE;
+	}
+	st->size += ni_buffer_count(&buf);
+	ni_uint_array_destroy(&st->dirty);
+	ni_buffer_destroy(&buf);
+	return TRUE;
+}
+
+/*
+ * Write the records changed since the last flush to the log
+ */
 ni_bool_t
-ni_client_state_load(ni_client_state_t *client_state, unsigned int ifindex)
+ni_client_state_flush(void)
+{
+	struct ni_client_state_store *st = &ni_client_state_store;
+	ni_bool_t ret;
+
+	if (!st->path || !st->dirty.count)
+		return TRUE;
+
+	if (!ni_client_state_store_lock())
+		return FALSE;
+
+	if (!ni_client_state_store_sync(TRUE) ||
+	    (st->size > NI_CLIENT_STATE_STORE_COMPACT_MIN && st->size > 2 * st->live))
+		ret = ni_client_state_store_rewrite();
+	else
+		ret = ni_client_state_store_append_dirty();
+
+	ni_client_state_store_unlock();
+	return ret;
+}
+
+ni_bool_t
+ni_client_state_save(const ni_client_state_t *client_state, unsigned int ifindex)
+{
+	ni_client_state_record_t *rec;
+	ni_buffer_t buf;
+
+	if (!client_state || !ni_client_state_store_load())
+		return FALSE;
+
+	ni_buffer_init_dynamic(&buf, 256);
+	ni_client_state_encode(&buf, client_state);
+
+	rec = ni_client_state_record_get(ifindex);
+	if (!rec || ni_buffer_count(&rec->data) != ni_buffer_count(&buf) ||
+	    memcmp(ni_buffer_head(&rec->data), ni_buffer_head(&buf), ni_buffer_count(&buf))) {
+		ni_client_state_record_set(ifindex, ni_buffer_head(&buf), ni_buffer_count(&buf));
+		ni_client_state_store_mark(ifindex);
+	}
+
+	ni_buffer_destroy(&buf);
+	return TRUE;
+}
+
+static ni_bool_t
+ni_client_state_load_file(ni_client_state_t *client_state, const char *path)
 {
-	char path[PATH_MAX] = {'\0'};
 	xml_node_t *xml;
 	xml_node_t *node;
 	FILE *fp;
 
-	if (!client_state)
-		return FALSE;
-
-	ni_client_state_filename(ifindex, path, sizeof(path));
 	if (!(fp = fopen(path, "re"))) {
 		if (errno != ENOENT)
 			ni_error("Cannot open state file '%s': %m", path);
@@ -528,44 +1137,69 @@ ni_client_state_load(ni_client_state_t *client_state, unsigned int ifindex)
 	return TRUE;
 }
 
+ni_bool_t
+ni_client_state_load(ni_client_state_t *client_state, unsigned int ifindex)
+{
+	ni_client_state_record_t *rec;
+	ni_buffer_t buf;
+
+	if (!client_state || !ni_client_state_store_load())
+		return FALSE;
+
+	if (!(rec = ni_client_state_record_get(ifindex)))
+		return FALSE;
+
+	ni_buffer_init_reader(&buf, ni_buffer_head(&rec->data), ni_buffer_count(&rec->data));
+	ni_client_state_reset(client_state);
+	if (!ni_client_state_decode(&buf, client_state)) {
+		ni_error("Cannot decode client state of ifindex %u from '%s'",
+				ifindex, ni_client_state_store.path);
+		ni_client_state_reset(client_state);
+		return FALSE;
+	}
+	return TRUE;
+}
 
 ni_bool_t
 ni_client_state_move(unsigned int ifindex_old, unsigned int ifindex_new)
 {
-	char path_old[PATH_MAX] = {'\0'};
-	char path_new[PATH_MAX] = {'\0'};
+	struct ni_client_state_store *st = &ni_client_state_store;
+	ni_client_state_record_t *rec;
 
 	if (ifindex_old == ifindex_new)
 		return TRUE;
 
-	ni_client_state_filename(ifindex_old, path_old, sizeof(path_old));
-	ni_client_state_filename(ifindex_new, path_new, sizeof(path_new));
-
-	if (rename(path_old, path_new) < 0) {
-		if (errno == ENOENT && !ni_file_exists(path_old)) {
-			ni_debug_verbose(NI_LOG_DEBUG3, NI_TRACE_READWRITE,
-				"%s does not exists, not renamed to %s", path_old, path_new);
-			return TRUE;
-		}
-		ni_error("Cannot rename state %s to %s", path_old, path_new);
+	if (!ni_client_state_store_load())
 		return FALSE;
+
+	if (!(rec = ni_client_state_record_get(ifindex_old))) {
+		ni_debug_verbose(NI_LOG_DEBUG3, NI_TRACE_READWRITE,
+			"no state of ifindex %u, not moved to %u", ifindex_old, ifindex_new);
+		return TRUE;
 	}
+
+	ni_client_state_record_remove(ifindex_new);
+	ni_client_state_record_unlink(rec);
+	rec->ifindex = ifindex_new;
+	rec->next = st->records;
+	st->records = rec;
+	ni_hashtable_insert(&st->index, ni_hash_uint(ifindex_new), rec);
+	st->live += sizeof(ni_client_state_record_header_t) + ni_buffer_count(&rec->data);
+
+	ni_client_state_store_mark(ifindex_new);
+	ni_client_state_store_mark(ifindex_old);
 	return TRUE;
 }
 
 ni_bool_t
 ni_client_state_drop(unsigned int ifindex)
 {
-	char path[PATH_MAX] = {'\0'};
-
-	ni_client_state_filename(ifindex, path, sizeof(path));
-
-	if (unlink(path) < 0) {
-		if (errno == ENOENT)
-			return TRUE;
-
-		ni_error("Cannot remove state file '%s': %m", path);
+	if (!ni_client_state_store_load())
 		return FALSE;
+
+	if (ni_client_state_record_get(ifindex)) {
+		ni_client_state_record_remove(ifindex);
+		ni_client_state_store_mark(ifindex);
 	}
 	return TRUE;
 }
@@ -91,6 +91,7 @@ ni_config_new()
 
 	conf->rtnl_event.recv_buff_length = 1024 * 1024;
 	conf->rtnl_event.mesg_buff_length = 0;
+	conf->rtnl_event.coalesce_latency = 0;
 
 	/* we enable it explicitly in wickedd only */
 	conf->teamd.enabled = FALSE;
@@ -120,6 +121,7 @@ ni_config_dhcp4_clone(const ni_config_dhcp4_t *src, const char *device)
 	dst->lease_time = src->lease_time;
 	ni_string_array_copy(&dst->ignore_servers, &src->ignore_servers);
 	memcpy(&dst->preferred_server, &src->preferred_server, sizeof(dst->preferred_server));
+	dst->offer_collection = src->offer_collection;
 	ni_dhcp_option_decl_list_copy(&dst->custom_options, src->custom_options);
 	return dst;
 }
@@ -532,6 +534,28 @@ ni_config_parse_addrconf_dhcp4_nodes(ni_config_dhcp4_t *dhcp4, xml_node_t *node)
 		if (!strcmp(child->name, "lease-time") && child->cdata)
 			dhcp4->lease_time = strtoul(child->cdata, NULL, 0);
 		else
+		if (!strcmp(child->name, "offer-collection")) {
+			unsigned int value;
+
+			if ((attrval = xml_node_get_attr(child, "window")) != NULL) {
+				if (ni_parse_uint(attrval, &value, 0) < 0 ||
+				    value > NI_DHCP4_OFFER_WINDOW_MAX) {
+					ni_warn("config: invalid <offer-collection window=\"%s\">",
+							attrval);
+				} else {
+					dhcp4->offer_collection.window = value;
+				}
+			}
+			if ((attrval = xml_node_get_attr(child, "candidates")) != NULL) {
+				if (ni_parse_uint(attrval, &value, 0) < 0 || !value ||
+				    value > NI_DHCP4_OFFER_CANDIDATES_MAX) {
+					ni_warn("config: invalid <offer-collection candidates=\"%s\">",
+							attrval);
+				} else {
+					dhcp4->offer_collection.candidates = value;
+				}
+			}
+		} else
 		if (!strcmp(child->name, "ignore-server")) {
 			if ((attrval = xml_node_get_attr(child, "ip")) != NULL)
 				ni_string_array_append(&dhcp4->ignore_servers, attrval);
@@ -1537,6 +1561,10 @@ ni_config_parse_rtnl_event(ni_config_rtnl_event_t *conf, xml_node_t *node)
 		if (ni_string_eq(child->name, "message-buffer-length")) {
 			if (ni_parse_uint(child->cdata, &conf->mesg_buff_length, 0))
 				return FALSE;
+		} else
+		if (ni_string_eq(child->name, "coalesce-latency")) {
+			if (ni_parse_uint(child->cdata, &conf->coalesce_latency, 0))
+				return FALSE;
 		}
 	}
 	return TRUE;
@@ -224,6 +224,29 @@ ni_dbus_client_add_signal_handler(ni_dbus_client_t *client,
 					callback, user_data);
 }
 
+void
+ni_dbus_client_add_signal_member_handler(ni_dbus_client_t *client,
+					const char *sender,
+					const char *path_namespace,
+					const char *object_interface,
+					const char *member,
+					ni_dbus_signal_handler_t *callback,
+					void *user_data)
+{
+	ni_dbus_add_signal_member_handler(client->connection,
+					sender, path_namespace, object_interface,
+					member, callback, user_data);
+}
+
+void
+ni_dbus_client_add_name_owner_handler(ni_dbus_client_t *client,
+					const char *name,
+					ni_dbus_signal_handler_t *callback,
+					void *user_data)
+{
+	ni_dbus_add_name_owner_handler(client->connection, name, callback, user_data);
+}
+
 /*
  * Proxy objects, and calling through proxies
  */
@@ -471,37 +494,15 @@ ni_dbus_object_call_async(ni_dbus_object_t *proxy,
 }
 
 /*
- * Use ObjectManager.GetManagedObjects to retrieve (part of)
- * the server's object hierarchy
+ * Process the object dict of a GetManagedObjects(Paged) reply
  */
-dbus_bool_t
-ni_dbus_object_get_managed_objects(ni_dbus_object_t *proxy, DBusError *error, ni_bool_t purge)
+static dbus_bool_t
+__ni_dbus_object_get_managed_objects_dict(ni_dbus_object_t *proxy, DBusMessageIter *iter)
 {
-	ni_dbus_client_t *client;
-	ni_dbus_object_t *objmgr;
-	ni_dbus_message_t *call = NULL, *reply = NULL;
-	DBusMessageIter iter, iter_dict;
-	dbus_bool_t rv = FALSE;
+	DBusMessageIter iter_dict;
 
-	if (!(client = ni_dbus_object_get_client(proxy))) {
-		dbus_set_error(error, DBUS_ERROR_FAILED, "%s: not a client object", __FUNCTION__);
+	if (!ni_dbus_message_open_dict_read(iter, &iter_dict))
 		return FALSE;
-	}
-
-	if (purge)
-		__ni_dbus_object_mark_stale(proxy);
-
-	objmgr = ni_dbus_client_object_new(client, &ni_dbus_anonymous_class, proxy->path,
-			NI_DBUS_INTERFACE ".ObjectManager",
-			NULL);
-
-	call = ni_dbus_object_call_new(objmgr, "GetManagedObjects", 0);
-	if ((reply = ni_dbus_client_call(client, call, error)) == NULL)
-		goto out;
-
-	dbus_message_iter_init(reply, &iter);
-	if (!ni_dbus_message_open_dict_read(&iter, &iter_dict))
-		goto bad_reply;
 	while (dbus_message_iter_get_arg_type(&iter_dict) == DBUS_TYPE_DICT_ENTRY) {
 		DBusMessageIter iter_dict_entry;
 		ni_dbus_object_t *descendant;
@@ -511,11 +512,11 @@ ni_dbus_object_get_managed_objects(ni_dbus_object_t *proxy, DBusError *error, ni
 		dbus_message_iter_next(&iter_dict);
 
 		if (dbus_message_iter_get_arg_type(&iter_dict_entry) != DBUS_TYPE_STRING)
-			goto bad_reply;
+			return FALSE;
 		dbus_message_iter_get_basic(&iter_dict_entry, &object_path);
 
 		if (!dbus_message_iter_next(&iter_dict_entry))
-			goto bad_reply;
+			return FALSE;
 
 		descendant = ni_dbus_object_create(proxy, object_path, NULL, NULL);
 
@@ -538,10 +539,45 @@ ni_dbus_object_get_managed_objects(ni_dbus_object_t *proxy, DBusError *error, ni
 			descendant->class->initialize(descendant);
 
 		if (!__ni_dbus_object_get_managed_object_interfaces(descendant, &iter_dict_entry))
-			goto bad_reply;
+			return FALSE;
 
 		descendant->stale = FALSE;
 	}
+	return TRUE;
+}
+
+/*
+ * Use ObjectManager.GetManagedObjects to retrieve (part of)
+ * the server's object hierarchy
+ */
+dbus_bool_t
+ni_dbus_object_get_managed_objects(ni_dbus_object_t *proxy, DBusError *error, ni_bool_t purge)
+{
+	ni_dbus_client_t *client;
+	ni_dbus_object_t *objmgr;
+	ni_dbus_message_t *call = NULL, *reply = NULL;
+	DBusMessageIter iter;
+	dbus_bool_t rv = FALSE;
+
+	if (!(client = ni_dbus_object_get_client(proxy))) {
+		dbus_set_error(error, DBUS_ERROR_FAILED, "%s: not a client object", __FUNCTION__);
+		return FALSE;
+	}
+
+	if (purge)
+		__ni_dbus_object_mark_stale(proxy);
+
+	objmgr = ni_dbus_client_object_new(client, &ni_dbus_anonymous_class, proxy->path,
+			NI_DBUS_INTERFACE ".ObjectManager",
+			NULL);
+
+	call = ni_dbus_object_call_new(objmgr, "GetManagedObjects", 0);
+	if ((reply = ni_dbus_client_call(client, call, error)) == NULL)
+		goto out;
+
+	dbus_message_iter_init(reply, &iter);
+	if (!__ni_dbus_object_get_managed_objects_dict(proxy, &iter))
+		goto bad_reply;
 
 	if (purge)
 		__ni_dbus_object_purge_stale(proxy);
@@ -561,6 +597,102 @@ bad_reply:
 	goto out;
 }
 
+/*
+ * Same as above, but using ObjectManager.GetManagedObjectsPaged to fetch
+ * the objects in bounded replies. Only objects providing one of the given
+ * interfaces are returned (all when NULL or empty), and the properties of
+ * the interfaces in omit are not transferred.
+ * Falls back to GetManagedObjects when the server does not support it.
+ */
+dbus_bool_t
+ni_dbus_object_get_managed_objects_filtered(ni_dbus_object_t *proxy,
+		const ni_string_array_t *interfaces, const ni_string_array_t *omit,
+		DBusError *error, ni_bool_t purge)
+{
+	ni_dbus_variant_t argv[4] = {
+		NI_DBUS_VARIANT_INIT, NI_DBUS_VARIANT_INIT,
+		NI_DBUS_VARIANT_INIT, NI_DBUS_VARIANT_INIT
+	};
+	ni_dbus_client_t *client;
+	ni_dbus_object_t *objmgr;
+	ni_dbus_message_t *call = NULL, *reply = NULL;
+	DBusMessageIter iter;
+	char *cursor = NULL;
+	unsigned int pages = 0;
+	dbus_bool_t rv = FALSE;
+
+	if (!(client = ni_dbus_object_get_client(proxy))) {
+		dbus_set_error(error, DBUS_ERROR_FAILED, "%s: not a client object", __FUNCTION__);
+		return FALSE;
+	}
+
+	if (purge)
+		__ni_dbus_object_mark_stale(proxy);
+
+	objmgr = ni_dbus_client_object_new(client, &ni_dbus_anonymous_class, proxy->path,
+			NI_DBUS_INTERFACE ".ObjectManager",
+			NULL);
+
+	ni_dbus_variant_set_string_array(&argv[0], interfaces ? (const char **)interfaces->data : NULL,
+					interfaces ? interfaces->count : 0);
+	ni_dbus_variant_set_string_array(&argv[1], omit ? (const char **)omit->data : NULL,
+					omit ? omit->count : 0);
+	ni_dbus_variant_set_uint32(&argv[3], 0);
+
+	do {
+		const char *next = NULL;
+
+		ni_dbus_variant_set_string(&argv[2], cursor ? cursor : "");
+		call = ni_dbus_object_call_new(objmgr, "GetManagedObjectsPaged", 0);
+		if (!call || !ni_dbus_message_serialize_variants(call, 4, argv, error))
+			goto out;
+
+		if ((reply = ni_dbus_client_call(client, call, error)) == NULL) {
+			if (pages == 0 && dbus_error_has_name(error, DBUS_ERROR_UNKNOWN_METHOD)) {
+				dbus_error_free(error);
+				rv = ni_dbus_object_get_managed_objects(proxy, error, purge);
+			}
+			goto out;
+		}
+
+		dbus_message_iter_init(reply, &iter);
+		if (!__ni_dbus_object_get_managed_objects_dict(proxy, &iter)
+		 || !dbus_message_iter_next(&iter)
+		 || dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_STRING)
+			goto bad_reply;
+		dbus_message_iter_get_basic(&iter, &next);
+		ni_string_dup(&cursor, next);
+
+		dbus_message_unref(call);
+		dbus_message_unref(reply);
+		call = reply = NULL;
+		pages++;
+	} while (!ni_string_empty(cursor));
+
+	ni_debug_dbus("%s: received managed objects in %u page(s)", proxy->path, pages);
+	if (purge)
+		__ni_dbus_object_purge_stale(proxy);
+
+	rv = TRUE;
+
+out:
+	if (call)
+		dbus_message_unref(call);
+	if (reply)
+		dbus_message_unref(reply);
+	ni_dbus_variant_destroy(&argv[0]);
+	ni_dbus_variant_destroy(&argv[1]);
+	ni_dbus_variant_destroy(&argv[2]);
+	ni_dbus_variant_destroy(&argv[3]);
+	ni_string_free(&cursor);
+	ni_dbus_object_free(objmgr);
+	return rv;
+
+bad_reply:
+	dbus_set_error(error, DBUS_ERROR_FAILED, "%s: failed to parse reply", __FUNCTION__);
+	goto out;
+}
+
 static dbus_bool_t
 __ni_dbus_object_get_managed_object_interfaces(ni_dbus_object_t *proxy, DBusMessageIter *iter)
 {
@@ -781,11 +913,18 @@ __ni_dbus_object_purge_stale(ni_dbus_object_t *proxy)
 
 dbus_bool_t
 ni_dbus_object_refresh_children(ni_dbus_object_t *proxy)
+{
+	return ni_dbus_object_refresh_children_filtered(proxy, NULL, NULL);
+}
+
+dbus_bool_t
+ni_dbus_object_refresh_children_filtered(ni_dbus_object_t *proxy,
+		const ni_string_array_t *interfaces, const ni_string_array_t *omit)
 {
 	DBusError error = DBUS_ERROR_INIT;
 	dbus_bool_t rv;
 
-	rv = ni_dbus_object_get_managed_objects(proxy, &error, TRUE);
+	rv = ni_dbus_object_get_managed_objects_filtered(proxy, interfaces, omit, &error, TRUE);
 	if (!rv)
 		ni_dbus_print_error(&error, "%s.getManagedObjects failed", proxy->path);
 	dbus_error_free(&error);
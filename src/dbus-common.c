@@ -13,6 +13,7 @@
 #include "socket_priv.h"
 #include "dbus-common.h"
 #include "dbus-dict.h"
+#include "util_priv.h"
 #include "debug.h"
 
 int
@@ -573,26 +574,20 @@ ni_dbus_variant_is_byte_array(const ni_dbus_variant_t *var)
  * Helper function for handling arrays
  */
 #define NI_DBUS_ARRAY_CHUNK		32
-#define NI_DBUS_ARRAY_ALLOCATION(len)	(((len) + NI_DBUS_ARRAY_CHUNK - 1) & ~(NI_DBUS_ARRAY_CHUNK - 1))
 static inline void
 __ni_dbus_array_grow(ni_dbus_variant_t *var, size_t element_size, unsigned int grow_by)
 {
-	unsigned int max = NI_DBUS_ARRAY_ALLOCATION(var->array.len);
 	unsigned int len = var->array.len;
+	void *new_data;
 
-	if (len + grow_by >= max) {
-		void *new_data;
+	/* keeps one spare element */
+	new_data = ni_array_grow(var->byte_array_value, element_size, len, grow_by,
+				NI_DBUS_ARRAY_CHUNK, 1);
+	if (new_data == NULL)
+		ni_fatal("%s: out of memory try to grow array to %u elements",
+				__FUNCTION__, len + grow_by);
 
-		max = NI_DBUS_ARRAY_ALLOCATION(len + grow_by);
-		new_data = xcalloc(max, element_size);
-		if (new_data == NULL)
-			ni_fatal("%s: out of memory try to grow array to %u elements",
-					__FUNCTION__, len + grow_by);
-
-		memcpy(new_data, var->byte_array_value, len * element_size);
-		free(var->byte_array_value);
-		var->byte_array_value = new_data;
-	}
+	var->byte_array_value = new_data;
 }
 
 void
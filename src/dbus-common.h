@@ -14,6 +14,7 @@
 #define NI_DBUS_BUS_NAME	"org.freedesktop.DBus"
 #define NI_DBUS_OBJECT_PATH	"/org/freedesktop/DBus"
 #define NI_DBUS_INTERFACE	"org.freedesktop.DBus"
+#define NI_DBUS_SIGNAL_NAME_OWNER_CHANGED	"NameOwnerChanged"
 
 extern const char *		ni_dbus_object_get_path(const ni_dbus_object_t *);
 extern char *			ni_dbus_object_introspect(ni_dbus_object_t *object);
@@ -42,13 +42,28 @@ struct ni_dbus_async_server_call {
 typedef struct ni_dbus_sigaction ni_dbus_sigaction_t;
 struct ni_dbus_sigaction {
 	ni_dbus_sigaction_t *	next;
-	char *			sender;
 	char *			object_path;
+	ni_bool_t		path_namespace;
 	char *			object_interface;
+	char *			member;
+	char *			rule;
 	ni_dbus_signal_handler_t *signal_handler;
 	void *			user_data;
 };
 
+/*
+ * Credentials of a peer on the bus, keyed by its unique name.
+ * Unique names are never reused, NameOwnerChanged drops them.
+ */
+typedef struct ni_dbus_caller ni_dbus_caller_t;
+struct ni_dbus_caller {
+	ni_dbus_caller_t *	prev;
+	ni_dbus_caller_t *	next;
+	unsigned int		hash;
+	char *			name;
+	uid_t			uid;
+};
+
 struct ni_dbus_connection {
 	DBusConnection *	conn;
 	ni_bool_t		private;
@@ -56,6 +71,12 @@ struct ni_dbus_connection {
 	ni_dbus_async_client_call_t *async_client_calls;
 	ni_dbus_async_server_call_t *async_server_calls;
 	ni_dbus_sigaction_t *	sighandlers;
+	ni_hashtable_t		sighandler_index;	/* by interface and member */
+	ni_hashtable_t		sighandler_rules;	/* by match rule */
+
+	ni_bool_t		track_callers;
+	ni_dbus_caller_t *	callers;
+	ni_hashtable_t		caller_index;	/* callers by name */
 
 	ni_bool_t		dispatching;
 };
@@ -87,6 +108,8 @@ static dbus_bool_t		__ni_dbus_add_watch(DBusWatch *, void *);
 static void			__ni_dbus_remove_watch(DBusWatch *, void *);
 static DBusHandlerResult	__ni_dbus_signal_filter(DBusConnection *, DBusMessage *, void *);
 static void			__ni_dbus_connection_dispatch(ni_dbus_connection_t *);
+static void			ni_dbus_caller_free(ni_dbus_caller_t *);
+static void			ni_dbus_caller_drop(ni_dbus_connection_t *, ni_dbus_caller_t *);
 
 static int			ni_dbus_use_socket_mainloop = 1;
 
@@ -242,6 +265,12 @@ ni_dbus_connection_free(ni_dbus_connection_t *dbc)
 		dbc->sighandlers = sig->next;
 		__ni_dbus_sigaction_free(sig);
 	}
+	ni_hashtable_destroy(&dbc->sighandler_index);
+	ni_hashtable_destroy(&dbc->sighandler_rules);
+
+	while (dbc->callers)
+		ni_dbus_caller_drop(dbc, dbc->callers);
+	ni_hashtable_destroy(&dbc->caller_index);
 
 	if (dbc->conn) {
 		if (dbc->private)
@@ -420,16 +449,32 @@ ni_dbus_connection_send_error(ni_dbus_connection_t *connection, ni_dbus_message_
 
 /*
  * Signal handling
+ *
+ * Each handler installs its own match rule, so the bus only sends us
+ * the signals somebody asked for; received signals are dispatched via
+ * a hash of the interface and member names.
  */
+static unsigned int
+ni_dbus_sigaction_hash(const char *object_interface, const char *member)
+{
+	return ni_hash_string(object_interface) ^ ni_hash_uint(ni_hash_string(member));
+}
+
 static ni_dbus_sigaction_t *
-__ni_sigaction_new(const char *object_interface,
+__ni_sigaction_new(const char *object_path, ni_bool_t path_namespace,
+				const char *object_interface, const char *member,
+				const char *rule,
 				ni_dbus_signal_handler_t *callback,
 				void *user_data)
 {
 	ni_dbus_sigaction_t *s;
 
 	s = calloc(1, sizeof(*s));
+	ni_string_dup(&s->object_path, object_path);
+	s->path_namespace = path_namespace;
 	ni_string_dup(&s->object_interface, object_interface);
+	ni_string_dup(&s->member, member);
+	ni_string_dup(&s->rule, rule);
 	s->signal_handler = callback;
 	s->user_data = user_data;
 
@@ -439,46 +484,94 @@ __ni_sigaction_new(const char *object_interface,
 static void
 __ni_dbus_sigaction_free(ni_dbus_sigaction_t *s)
 {
+	ni_string_free(&s->object_path);
 	ni_string_free(&s->object_interface);
+	ni_string_free(&s->member);
+	ni_string_free(&s->rule);
 	free(s);
 }
 
-void
-ni_dbus_add_signal_handler(ni_dbus_connection_t *connection,
+static ni_bool_t
+__ni_dbus_sigaction_have_rule(const ni_dbus_connection_t *connection, const char *rule)
+{
+	const ni_dbus_sigaction_t *s;
+	ni_hashtable_iter_t iter;
+
+	s = ni_hashtable_lookup(&connection->sighandler_rules, ni_hash_string(rule), &iter);
+	for ( ; s; s = ni_hashtable_lookup_next(&iter)) {
+		if (ni_string_eq(s->rule, rule))
+			return TRUE;
+	}
+	return FALSE;
+}
+
+static ni_bool_t
+__ni_dbus_sigaction_match_path(const ni_dbus_sigaction_t *s, const char *path)
+{
+	size_t len;
+
+	if (!s->object_path)
+		return TRUE;
+	if (!path)
+		return FALSE;
+	if (!s->path_namespace)
+		return ni_string_eq(s->object_path, path);
+
+	len = strlen(s->object_path);
+	if (len == 1)	/* "/" */
+		return TRUE;
+	return !strncmp(s->object_path, path, len) && (path[len] == '\0' || path[len] == '/');
+}
+
+static void
+__ni_dbus_add_signal_handler(ni_dbus_connection_t *connection,
 					const char *sender,
 					const char *object_path,
+					ni_bool_t path_namespace,
 					const char *object_interface,
+					const char *member,
+					const char *arg0,
 					ni_dbus_signal_handler_t *callback,
 					void *user_data)
 {
 	DBusMessage *call = NULL, *reply = NULL;
 	DBusError error = DBUS_ERROR_INIT;
 	ni_dbus_sigaction_t *sigact;
-	char specbuf[1024], *arg;
-
-	if (sender && object_path && object_interface) {
-		snprintf(specbuf, sizeof(specbuf), "type='signal',sender='%s',path='%s',interface='%s'",
-			sender, object_path, object_interface);
-	} else if (sender && object_interface) {
-		snprintf(specbuf, sizeof(specbuf), "type='signal',sender='%s',interface='%s'",
-			sender, object_interface);
-	} else {
-		snprintf(specbuf, sizeof(specbuf), "type='signal',interface='%s'",
-			object_interface);
-	}
-	arg = specbuf;
+	ni_stringbuf_t rule = NI_STRINGBUF_INIT_DYNAMIC;
 
-	call = dbus_message_new_method_call(NI_DBUS_BUS_NAME,
-			NI_DBUS_OBJECT_PATH, NI_DBUS_INTERFACE, "AddMatch");
-	if (!dbus_message_append_args(call, DBUS_TYPE_STRING, &arg, 0))
-		goto failed;
+	if (!connection || !object_interface || !callback)
+		return;
 
-	if ((reply = ni_dbus_connection_call(connection, call, 1000 * 10, &error)) == NULL)
-		goto out;
+	ni_stringbuf_puts(&rule, "type='signal'");
+	if (sender)
+		ni_stringbuf_printf(&rule, ",sender='%s'", sender);
+	if (object_path)
+		ni_stringbuf_printf(&rule, ",%s='%s'",
+				path_namespace ? "path_namespace" : "path", object_path);
+	ni_stringbuf_printf(&rule, ",interface='%s'", object_interface);
+	if (member)
+		ni_stringbuf_printf(&rule, ",member='%s'", member);
+	if (arg0)
+		ni_stringbuf_printf(&rule, ",arg0='%s'", arg0);
+
+	/* the bus sends a signal once, even if several rules match it */
+	if (!__ni_dbus_sigaction_have_rule(connection, rule.string)) {
+		call = dbus_message_new_method_call(NI_DBUS_BUS_NAME,
+				NI_DBUS_OBJECT_PATH, NI_DBUS_INTERFACE, "AddMatch");
+		if (!call || !dbus_message_append_args(call, DBUS_TYPE_STRING, &rule.string, 0))
+			goto failed;
+
+		if ((reply = ni_dbus_connection_call(connection, call, 1000 * 10, &error)) == NULL)
+			goto out;
+	}
 
-	sigact = __ni_sigaction_new(object_interface, callback, user_data);
+	sigact = __ni_sigaction_new(object_path, path_namespace, object_interface,
+					member, rule.string, callback, user_data);
 	sigact->next = connection->sighandlers;
 	connection->sighandlers = sigact;
+	ni_hashtable_insert(&connection->sighandler_index,
+			ni_dbus_sigaction_hash(object_interface, member), sigact);
+	ni_hashtable_insert(&connection->sighandler_rules, ni_hash_string(sigact->rule), sigact);
 
 out:
 	if (call)
@@ -486,6 +579,7 @@ out:
 	if (reply)
 		dbus_message_unref(reply);
 	dbus_error_free(&error);
+	ni_stringbuf_destroy(&rule);
 	return;
 
 failed:
@@ -493,13 +587,80 @@ failed:
 	goto out;
 }
 
+void
+ni_dbus_add_signal_handler(ni_dbus_connection_t *connection,
+					const char *sender,
+					const char *object_path,
+					const char *object_interface,
+					ni_dbus_signal_handler_t *callback,
+					void *user_data)
+{
+	__ni_dbus_add_signal_handler(connection, sender, object_path, FALSE,
+				object_interface, NULL, NULL, callback, user_data);
+}
+
+/*
+ * Like above, but for the objects below a path and, unless
+ * the member is NULL, a single signal only
+ */
+void
+ni_dbus_add_signal_member_handler(ni_dbus_connection_t *connection,
+					const char *sender,
+					const char *path_namespace,
+					const char *object_interface,
+					const char *member,
+					ni_dbus_signal_handler_t *callback,
+					void *user_data)
+{
+	__ni_dbus_add_signal_handler(connection, sender, path_namespace, TRUE,
+				object_interface, member, NULL, callback, user_data);
+}
+
+/*
+ * NameOwnerChanged of a single bus name only
+ */
+void
+ni_dbus_add_name_owner_handler(ni_dbus_connection_t *connection,
+					const char *name,
+					ni_dbus_signal_handler_t *callback,
+					void *user_data)
+{
+	__ni_dbus_add_signal_handler(connection, NI_DBUS_BUS_NAME, NI_DBUS_OBJECT_PATH, FALSE,
+				NI_DBUS_INTERFACE, NI_DBUS_SIGNAL_NAME_OWNER_CHANGED, name,
+				callback, user_data);
+}
+
+static unsigned int
+__ni_dbus_signal_dispatch(ni_dbus_connection_t *connection, DBusMessage *msg,
+				const char *interface, const char *member,
+				const char *path, ni_bool_t by_member)
+{
+	ni_dbus_sigaction_t *sigact;
+	ni_hashtable_iter_t iter;
+	unsigned int handled = 0;
+
+	sigact = ni_hashtable_lookup(&connection->sighandler_index,
+			ni_dbus_sigaction_hash(interface, by_member ? member : NULL), &iter);
+	for ( ; sigact; sigact = ni_hashtable_lookup_next(&iter)) {
+		if (!ni_string_eq(sigact->object_interface, interface))
+			continue;
+		if (by_member ? !ni_string_eq(sigact->member, member) : sigact->member != NULL)
+			continue;
+		if (!__ni_dbus_sigaction_match_path(sigact, path))
+			continue;
+
+		sigact->signal_handler(connection, msg, sigact->user_data);
+		handled++;
+	}
+	return handled;
+}
+
 static DBusHandlerResult
 __ni_dbus_signal_filter(DBusConnection *conn, DBusMessage *msg, void *user_data)
 {
 	ni_dbus_connection_t *connection = user_data;
-	ni_dbus_sigaction_t *sigact;
-	const char *interface;
-	int handled = 0;
+	const char *interface, *member, *path;
+	unsigned int handled = 0;
 
 	if (connection->conn != conn)
 		return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
@@ -507,13 +668,15 @@ __ni_dbus_signal_filter(DBusConnection *conn, DBusMessage *msg, void *user_data)
 	if (dbus_message_get_type(msg) != DBUS_MESSAGE_TYPE_SIGNAL)
 		return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
 
-	interface = dbus_message_get_interface(msg);
-	for (sigact = connection->sighandlers; sigact; sigact = sigact->next) {
-		if (!strcmp(sigact->object_interface, interface)) {
-			sigact->signal_handler(connection, msg, sigact->user_data);
-			handled++;
-		}
-	}
+	if (!(interface = dbus_message_get_interface(msg)))
+		return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+	member = dbus_message_get_member(msg);
+	path = dbus_message_get_path(msg);
+
+	if (member)
+		handled += __ni_dbus_signal_dispatch(connection, msg, interface, member, path, TRUE);
+	handled += __ni_dbus_signal_dispatch(connection, msg, interface, member, path, FALSE);
 
 	if (handled)
 		return DBUS_HANDLER_RESULT_HANDLED;
@@ -629,6 +792,109 @@ ni_dbus_async_server_call_run_command(ni_dbus_connection_t *conn,
 	return 0;
 }
 
+/*
+ * Caller credentials cache
+ */
+static void
+ni_dbus_caller_free(ni_dbus_caller_t *caller)
+{
+	ni_string_free(&caller->name);
+	free(caller);
+}
+
+static ni_dbus_caller_t *
+ni_dbus_caller_find(ni_dbus_connection_t *conn, const char *name)
+{
+	ni_hashtable_iter_t iter;
+	ni_dbus_caller_t *caller;
+
+	caller = ni_hashtable_lookup(&conn->caller_index, ni_hash_string(name), &iter);
+	for ( ; caller; caller = ni_hashtable_lookup_next(&iter)) {
+		if (ni_string_eq(caller->name, name))
+			return caller;
+	}
+	return NULL;
+}
+
+static ni_dbus_caller_t *
+ni_dbus_caller_new(ni_dbus_connection_t *conn, const char *name)
+{
+	ni_dbus_caller_t *caller;
+
+	if (!(caller = calloc(1, sizeof(*caller))))
+		return NULL;
+	if (!ni_string_dup(&caller->name, name)) {
+		free(caller);
+		return NULL;
+	}
+
+	caller->hash = ni_hash_string(name);
+	if (!ni_hashtable_insert(&conn->caller_index, caller->hash, caller)) {
+		ni_dbus_caller_free(caller);
+		return NULL;
+	}
+	if ((caller->next = conn->callers))
+		caller->next->prev = caller;
+	conn->callers = caller;
+	return caller;
+}
+
+static void
+ni_dbus_caller_drop(ni_dbus_connection_t *conn, ni_dbus_caller_t *caller)
+{
+	if (caller->prev)
+		caller->prev->next = caller->next;
+	else
+		conn->callers = caller->next;
+	if (caller->next)
+		caller->next->prev = caller->prev;
+
+	ni_hashtable_remove(&conn->caller_index, caller->hash, caller);
+	ni_dbus_caller_free(caller);
+}
+
+static void
+ni_dbus_caller_name_owner_changed(ni_dbus_connection_t *conn, ni_dbus_message_t *msg, void *user_data)
+{
+	const char *name = NULL, *old_owner = NULL, *new_owner = NULL;
+	ni_dbus_caller_t *caller;
+
+	(void)user_data;
+	if (!ni_string_eq(dbus_message_get_member(msg), NI_DBUS_SIGNAL_NAME_OWNER_CHANGED))
+		return;
+
+	if (!dbus_message_get_args(msg, NULL,
+				DBUS_TYPE_STRING, &name,
+				DBUS_TYPE_STRING, &old_owner,
+				DBUS_TYPE_STRING, &new_owner,
+				DBUS_TYPE_INVALID))
+		return;
+
+	/* we are interested in unique names only */
+	if (!name || name[0] != ':')
+		return;
+
+	if (ni_string_empty(new_owner) && (caller = ni_dbus_caller_find(conn, name)))
+		ni_dbus_caller_drop(conn, caller);
+}
+
+/*
+ * Start caching the credentials of the peers on the bus; they are
+ * requested on the first method call of a peer that needs them and
+ * forgotten when the peer disconnects.
+ */
+void
+ni_dbus_connection_track_callers(ni_dbus_connection_t *conn)
+{
+	if (!conn || conn->track_callers)
+		return;
+
+	ni_dbus_add_signal_member_handler(conn, NI_DBUS_BUS_NAME, NI_DBUS_OBJECT_PATH,
+			NI_DBUS_INTERFACE, NI_DBUS_SIGNAL_NAME_OWNER_CHANGED,
+			ni_dbus_caller_name_owner_changed, NULL);
+	conn->track_callers = TRUE;
+}
+
 /*
  * Get the uid of the process having sent us a specific message
  */
@@ -637,9 +903,16 @@ ni_dbus_connection_get_caller_uid(ni_dbus_connection_t *conn, const char *name,
 {
 	DBusError error = DBUS_ERROR_INIT;
 	DBusMessage *call = NULL, *reply = NULL;
+	ni_dbus_caller_t *caller = NULL;
 	uint32_t user_id;
 	int rv = 0;
 
+	if (conn->track_callers && name && (caller = ni_dbus_caller_find(conn, name))) {
+		if (uidp)
+			*uidp = caller->uid;
+		return 0;
+	}
+
 	call = dbus_message_new_method_call("org.freedesktop.DBus",
 					"/org/freedesktop/DBus",
 					"org.freedesktop.DBus",
@@ -673,6 +946,9 @@ ni_dbus_connection_get_caller_uid(ni_dbus_connection_t *conn, const char *name,
 		*uidp = user_id;
 	rv = 0;
 
+	if (conn->track_callers && (caller = ni_dbus_caller_new(conn, name)))
+		caller->uid = user_id;
+
 out:
 	if (call)
 		dbus_message_unref(call);
@@ -26,6 +26,17 @@ extern void			ni_dbus_add_signal_handler(ni_dbus_connection_t *conn,
 					const char *object_interface,
 					ni_dbus_signal_handler_t *callback,
 					void *user_data);
+extern void			ni_dbus_add_signal_member_handler(ni_dbus_connection_t *conn,
+					const char *sender,
+					const char *path_namespace,
+					const char *object_interface,
+					const char *member,
+					ni_dbus_signal_handler_t *callback,
+					void *user_data);
+extern void			ni_dbus_add_name_owner_handler(ni_dbus_connection_t *conn,
+					const char *name,
+					ni_dbus_signal_handler_t *callback,
+					void *user_data);
 extern void			ni_dbus_connection_register_object(ni_dbus_connection_t *, ni_dbus_object_t *);
 extern void			ni_dbus_connection_unregister_object(ni_dbus_connection_t *, ni_dbus_object_t *);
 extern int			ni_dbus_async_server_call_run_command(ni_dbus_connection_t *conn,
@@ -36,5 +47,6 @@ extern int			ni_dbus_async_server_call_run_command(ni_dbus_connection_t *conn,
 extern void			ni_dbus_mainloop(ni_dbus_connection_t *);
 
 extern int			ni_dbus_connection_get_caller_uid(ni_dbus_connection_t *, const char *, uid_t *);
+extern void			ni_dbus_connection_track_callers(ni_dbus_connection_t *);
 
 #endif /* __WICKED_DBUS_CONNECTION_H__ */
@@ -25,6 +25,8 @@ static dbus_bool_t		__ni_dbus_object_get_one_property(const ni_dbus_object_t *ob
 					ni_dbus_variant_t *var,
 					DBusError *error);
 static const char *		__ni_dbus_object_child_path(const ni_dbus_object_t *, const char *);
+static const ni_dbus_dispatch_t *__ni_dbus_object_dispatch(const ni_dbus_object_t *);
+static void			__ni_dbus_dispatch_release(ni_dbus_dispatch_t *);
 
 const ni_dbus_class_t		ni_dbus_anonymous_class = {
 	.name = "<anonymous>"
@@ -71,6 +73,7 @@ __ni_dbus_object_new_child(ni_dbus_object_t *parent, const ni_dbus_class_t *obje
 	child->parent = parent;
 	__ni_dbus_object_insert(pos, child);
 	ni_string_dup(&child->name, name);
+	ni_hashtable_insert(&parent->children_index, ni_hash_string(child->name), child);
 	if (parent->server_object)
 		__ni_dbus_server_object_inherit(child, parent);
 	if (parent->client_object)
@@ -100,13 +103,22 @@ __ni_dbus_object_new_child(ni_dbus_object_t *parent, const ni_dbus_class_t *obje
 /*
  * Free a dbus object
  */
+static void
+__ni_dbus_object_unlink_child(ni_dbus_object_t *object)
+{
+	if (object->parent)
+		ni_hashtable_remove(&object->parent->children_index,
+				ni_hash_string(object->name), object);
+	__ni_dbus_object_unlink(object);
+	object->parent = NULL;
+}
+
 void
 __ni_dbus_object_free(ni_dbus_object_t *object)
 {
 	ni_dbus_object_t *child;
 
-	__ni_dbus_object_unlink(object);
-	object->parent = NULL;
+	__ni_dbus_object_unlink_child(object);
 
 	if (object->server_object)
 		__ni_dbus_server_object_destroy(object);
@@ -115,6 +127,7 @@ __ni_dbus_object_free(ni_dbus_object_t *object)
 
 	while ((child = object->children) != NULL)
 		__ni_dbus_object_free(child);
+	ni_hashtable_destroy(&object->children_index);
 
 	if (object->handle && object->class && object->class->destroy)
 		object->class->destroy(object);
@@ -122,6 +135,7 @@ __ni_dbus_object_free(ni_dbus_object_t *object)
 	ni_string_free(&object->name);
 	ni_string_free(&object->path);
 
+	__ni_dbus_dispatch_release(object->dispatch);
 	free(object->interfaces);
 	free(object);
 }
@@ -136,8 +150,7 @@ ni_dbus_object_free(ni_dbus_object_t *object)
 	if (object->pprev) {
 		ni_debug_dbus("%s: deferring deletion of active object %s",
 				__FUNCTION__, object->path);
-		__ni_dbus_object_unlink(object);
-		object->parent = NULL;
+		__ni_dbus_object_unlink_child(object);
 		__ni_dbus_object_insert(&__ni_dbus_objects_trashcan, object);
 	} else {
 		__ni_dbus_object_free(object);
@@ -178,12 +191,14 @@ static ni_dbus_object_t *
 __ni_dbus_object_get_child(ni_dbus_object_t *parent, const char *name)
 {
 	ni_dbus_object_t *child;
+	ni_hashtable_iter_t iter;
 
 	if (*name == '\0')
 		return parent;
 
-	for (child = parent->children; child; child = child->next) {
-		if (!strcmp(child->name, name))
+	child = ni_hashtable_lookup(&parent->children_index, ni_hash_string(name), &iter);
+	for ( ; child; child = ni_hashtable_lookup_next(&iter)) {
+		if (ni_string_eq(child->name, name))
 			return child;
 	}
 
@@ -295,19 +310,214 @@ ni_dbus_object_find_descendant_by_handle(const ni_dbus_object_t *parent, const v
 	return found;
 }
 
+/*
+ * Interface member dispatch tables.
+ *
+ * Objects providing the same list of interfaces (usually the objects
+ * of one class) share a dispatch table, mapping the interface names and
+ * the method, signal and property names to the services providing them.
+ * The table is built on first use after an interface registration.
+ */
+typedef struct ni_dbus_dispatch_member {
+	const ni_dbus_service_t *	service;
+	const char *			name;
+	const void *			member;
+} ni_dbus_dispatch_member_t;
+
+struct ni_dbus_dispatch {
+	unsigned int			refcount;
+	unsigned int			hash;
+	unsigned int			count;
+	const ni_dbus_service_t **	interfaces;
+
+	ni_hashtable_t			services;
+	ni_hashtable_t			methods;
+	ni_hashtable_t			signals;
+	ni_hashtable_t			properties;
+	ni_dbus_dispatch_member_t *	members;
+};
+
+static ni_hashtable_t			__ni_dbus_dispatch_cache = NI_HASHTABLE_INIT;
+
+static unsigned int
+__ni_dbus_dispatch_hash_nocase(const char *name)
+{
+	char lower[256];
+	size_t len;
+
+	if ((len = ni_string_len(name)) >= sizeof(lower))
+		len = sizeof(lower) - 1;
+	memcpy(lower, name, len);
+	lower[len] = '\0';
+	ni_string_tolower(lower);
+	return ni_hash_bytes(lower, len);
+}
+
+static unsigned int
+__ni_dbus_dispatch_count_members(const ni_dbus_service_t *svc)
+{
+	const ni_dbus_method_t *method;
+	const ni_dbus_property_t *property;
+	unsigned int count = 0;
+
+	for (method = svc->methods; method && method->name; ++method)
+		count++;
+	for (method = svc->signals; method && method->name; ++method)
+		count++;
+	for (property = svc->properties; property && property->name; ++property)
+		count++;
+	return count;
+}
+
+static ni_dbus_dispatch_member_t *
+__ni_dbus_dispatch_add_member(ni_hashtable_t *table, ni_dbus_dispatch_member_t *entry,
+				const ni_dbus_service_t *svc, const char *name, const void *member)
+{
+	entry->service = svc;
+	entry->name = name;
+	entry->member = member;
+	ni_hashtable_insert(table, ni_hash_string(name), entry);
+	return entry + 1;
+}
+
+static ni_dbus_dispatch_t *
+__ni_dbus_dispatch_new(const ni_dbus_service_t **interfaces, unsigned int count, unsigned int hash)
+{
+	ni_dbus_dispatch_member_t *entry;
+	const ni_dbus_method_t *method;
+	const ni_dbus_property_t *property;
+	const ni_dbus_service_t *svc;
+	ni_dbus_dispatch_t *dispatch;
+	unsigned int i, members = 0;
+
+	dispatch = xcalloc(1, sizeof(*dispatch));
+	dispatch->refcount = 1;
+	dispatch->hash = hash;
+	dispatch->count = count;
+	dispatch->interfaces = xcalloc(count + 1, sizeof(svc));
+	memcpy(dispatch->interfaces, interfaces, count * sizeof(svc));
+
+	for (i = 0; i < count; ++i)
+		members += __ni_dbus_dispatch_count_members(interfaces[i]);
+	entry = dispatch->members = xcalloc(members + 1, sizeof(*entry));
+
+	for (i = 0; i < count; ++i) {
+		svc = interfaces[i];
+
+		ni_hashtable_insert(&dispatch->services, __ni_dbus_dispatch_hash_nocase(svc->name),
+					(void *) svc);
+		for (method = svc->methods; method && method->name; ++method)
+			entry = __ni_dbus_dispatch_add_member(&dispatch->methods, entry,
+							svc, method->name, method);
+		for (method = svc->signals; method && method->name; ++method)
+			entry = __ni_dbus_dispatch_add_member(&dispatch->signals, entry,
+							svc, method->name, method);
+		for (property = svc->properties; property && property->name; ++property)
+			entry = __ni_dbus_dispatch_add_member(&dispatch->properties, entry,
+							svc, property->name, property);
+	}
+
+	ni_hashtable_insert(&__ni_dbus_dispatch_cache, hash, dispatch);
+	return dispatch;
+}
+
+static void
+__ni_dbus_dispatch_release(ni_dbus_dispatch_t *dispatch)
+{
+	if (!dispatch)
+		return;
+
+	ni_assert(dispatch->refcount);
+	if (--dispatch->refcount)
+		return;
+
+	ni_hashtable_remove(&__ni_dbus_dispatch_cache, dispatch->hash, dispatch);
+	ni_hashtable_destroy(&dispatch->services);
+	ni_hashtable_destroy(&dispatch->methods);
+	ni_hashtable_destroy(&dispatch->signals);
+	ni_hashtable_destroy(&dispatch->properties);
+	free(dispatch->members);
+	free(dispatch->interfaces);
+	free(dispatch);
+}
+
+static const ni_dbus_dispatch_t *
+__ni_dbus_object_dispatch(const ni_dbus_object_t *object)
+{
+	ni_dbus_dispatch_t *dispatch;
+	ni_hashtable_iter_t iter;
+	unsigned int count, hash;
+
+	if (object == NULL || object->interfaces == NULL)
+		return NULL;
+
+	if (object->dispatch)
+		return object->dispatch;
+
+	for (count = 0; object->interfaces[count]; ++count)
+		;
+	hash = ni_hash_bytes(object->interfaces, count * sizeof(object->interfaces[0]));
+
+	dispatch = ni_hashtable_lookup(&__ni_dbus_dispatch_cache, hash, &iter);
+	for ( ; dispatch; dispatch = ni_hashtable_lookup_next(&iter)) {
+		if (dispatch->count == count &&
+		    !memcmp(dispatch->interfaces, object->interfaces, count * sizeof(object->interfaces[0])))
+			break;
+	}
+
+	if (dispatch)
+		dispatch->refcount++;
+	else
+		dispatch = __ni_dbus_dispatch_new(object->interfaces, count, hash);
+
+	/* The dispatch table is a cache, so it can be set on const objects */
+	((ni_dbus_object_t *) object)->dispatch = dispatch;
+	return dispatch;
+}
+
+static const ni_dbus_dispatch_member_t *
+__ni_dbus_dispatch_lookup(const ni_hashtable_t *table, const char *name, ni_hashtable_iter_t *iter)
+{
+	const ni_dbus_dispatch_member_t *entry;
+
+	if (name == NULL)
+		return NULL;
+
+	entry = ni_hashtable_lookup(table, ni_hash_string(name), iter);
+	for ( ; entry; entry = ni_hashtable_lookup_next(iter)) {
+		if (!strcmp(entry->name, name))
+			return entry;
+	}
+	return NULL;
+}
+
+static const ni_dbus_dispatch_member_t *
+__ni_dbus_dispatch_lookup_next(const char *name, ni_hashtable_iter_t *iter)
+{
+	const ni_dbus_dispatch_member_t *entry;
+
+	while ((entry = ni_hashtable_lookup_next(iter))) {
+		if (!strcmp(entry->name, name))
+			return entry;
+	}
+	return NULL;
+}
+
 /*
  * Look up an object interface by name
  */
 const ni_dbus_service_t *
 ni_dbus_object_get_service(const ni_dbus_object_t *object, const char *interface)
 {
+	const ni_dbus_dispatch_t *dispatch;
 	const ni_dbus_service_t *svc;
-	unsigned int i;
+	ni_hashtable_iter_t iter;
 
-	if (object == NULL || object->interfaces == NULL)
+	if (interface == NULL || !(dispatch = __ni_dbus_object_dispatch(object)))
 		return NULL;
 
-	for (i = 0; (svc = object->interfaces[i]) != NULL; ++i) {
+	svc = ni_hashtable_lookup(&dispatch->services, __ni_dbus_dispatch_hash_nocase(interface), &iter);
+	for ( ; svc; svc = ni_hashtable_lookup_next(&iter)) {
 		if (!strcasecmp(svc->name, interface))
 			return svc;
 	}
@@ -315,6 +525,56 @@ ni_dbus_object_get_service(const ni_dbus_object_t *object, const char *interface
 	return NULL;
 }
 
+/*
+ * Look up a method or property of the given object interface
+ */
+const ni_dbus_method_t *
+ni_dbus_object_find_method(const ni_dbus_object_t *object, const ni_dbus_service_t *service,
+				const char *name)
+{
+	const ni_dbus_dispatch_member_t *entry;
+	const ni_dbus_dispatch_t *dispatch;
+	ni_hashtable_iter_t iter;
+
+	if (service == NULL || !(dispatch = __ni_dbus_object_dispatch(object)))
+		return NULL;
+
+	entry = __ni_dbus_dispatch_lookup(&dispatch->methods, name, &iter);
+	for ( ; entry; entry = __ni_dbus_dispatch_lookup_next(name, &iter)) {
+		if (entry->service == service)
+			return entry->member;
+	}
+
+	/* The service is not registered with this object */
+	return ni_dbus_service_get_method(service, name);
+}
+
+const ni_dbus_property_t *
+ni_dbus_object_find_property(const ni_dbus_object_t *object, const ni_dbus_service_t **service,
+				const char *name)
+{
+	const ni_dbus_dispatch_member_t *entry;
+	const ni_dbus_dispatch_t *dispatch;
+	ni_hashtable_iter_t iter;
+
+	if (service == NULL || !(dispatch = __ni_dbus_object_dispatch(object)))
+		return NULL;
+
+	entry = __ni_dbus_dispatch_lookup(&dispatch->properties, name, &iter);
+	for ( ; entry; entry = __ni_dbus_dispatch_lookup_next(name, &iter)) {
+		if (*service == NULL) {
+			*service = entry->service;
+			return entry->member;
+		}
+		if (entry->service == *service)
+			return entry->member;
+	}
+
+	if (*service)
+		return ni_dbus_service_get_property(*service, name);
+	return NULL;
+}
+
 /*
  * Helper function for ni_dbus_object_get_{service,signal}_for_method.
  * When searching an object's method tables, a specific method may be offered
@@ -342,18 +602,19 @@ __ni_dbus_object_pick_more_specific(const ni_dbus_service_t *best, const ni_dbus
 const ni_dbus_service_t *
 ni_dbus_object_get_service_for_method(const ni_dbus_object_t *object, const char *method)
 {
-	const ni_dbus_service_t *svc, *best = NULL;
-	unsigned int i;
+	const ni_dbus_dispatch_member_t *entry;
+	const ni_dbus_service_t *best = NULL;
+	const ni_dbus_dispatch_t *dispatch;
+	ni_hashtable_iter_t iter;
 
-	if (object == NULL || object->interfaces == NULL || method == NULL)
+	if (method == NULL || !(dispatch = __ni_dbus_object_dispatch(object)))
 		return NULL;
 
-	for (i = 0; (svc = object->interfaces[i]) != NULL; ++i) {
-		if (ni_dbus_service_get_method(svc, method)) {
-			if (!(best = __ni_dbus_object_pick_more_specific(best, svc))) {
-				ni_error("%s: ambiguous overloaded method \"%s\"", object->path, method);
-				return NULL;
-			}
+	entry = __ni_dbus_dispatch_lookup(&dispatch->methods, method, &iter);
+	for ( ; entry; entry = __ni_dbus_dispatch_lookup_next(method, &iter)) {
+		if (!(best = __ni_dbus_object_pick_more_specific(best, entry->service))) {
+			ni_error("%s: ambiguous overloaded method \"%s\"", object->path, method);
+			return NULL;
 		}
 	}
 
@@ -364,17 +625,18 @@ unsigned int
 ni_dbus_object_get_all_services_for_method(const ni_dbus_object_t *object, const char *method,
 					const ni_dbus_service_t **list, unsigned int list_size)
 {
-	const ni_dbus_service_t *svc;
-	unsigned int i, found = 0;
+	const ni_dbus_dispatch_member_t *entry;
+	const ni_dbus_dispatch_t *dispatch;
+	ni_hashtable_iter_t iter;
+	unsigned int found = 0;
 
-	if (object == NULL || object->interfaces == NULL || method == NULL)
+	if (method == NULL || !(dispatch = __ni_dbus_object_dispatch(object)))
 		return 0;
 
-	for (i = 0; (svc = object->interfaces[i]) != NULL; ++i) {
-		if (ni_dbus_service_get_method(svc, method)) {
-			if (found < list_size)
-				list[found++] = svc;
-		}
+	entry = __ni_dbus_dispatch_lookup(&dispatch->methods, method, &iter);
+	for ( ; entry; entry = __ni_dbus_dispatch_lookup_next(method, &iter)) {
+		if (found < list_size)
+			list[found++] = entry->service;
 	}
 
 	return found;
@@ -383,18 +645,19 @@ ni_dbus_object_get_all_services_for_method(const ni_dbus_object_t *object, const
 const ni_dbus_service_t *
 ni_dbus_object_get_service_for_signal(const ni_dbus_object_t *object, const char *signal_name)
 {
-	const ni_dbus_service_t *svc, *best = NULL;
-	unsigned int i;
+	const ni_dbus_dispatch_member_t *entry;
+	const ni_dbus_service_t *best = NULL;
+	const ni_dbus_dispatch_t *dispatch;
+	ni_hashtable_iter_t iter;
 
-	if (object == NULL || object->interfaces == NULL)
+	if (signal_name == NULL || !(dispatch = __ni_dbus_object_dispatch(object)))
 		return NULL;
 
-	for (i = 0; (svc = object->interfaces[i]) != NULL; ++i) {
-		if (ni_dbus_service_get_signal(svc, signal_name)) {
-			if (!(best = __ni_dbus_object_pick_more_specific(best, svc))) {
-				ni_error("%s: ambiguous overloaded method \"%s\"", object->path, signal_name);
-				return NULL;
-			}
+	entry = __ni_dbus_dispatch_lookup(&dispatch->signals, signal_name, &iter);
+	for ( ; entry; entry = __ni_dbus_dispatch_lookup_next(signal_name, &iter)) {
+		if (!(best = __ni_dbus_object_pick_more_specific(best, entry->service))) {
+			ni_error("%s: ambiguous overloaded method \"%s\"", object->path, signal_name);
+			return NULL;
 		}
 	}
 
@@ -404,16 +667,10 @@ ni_dbus_object_get_service_for_signal(const ni_dbus_object_t *object, const char
 const ni_dbus_service_t *
 ni_dbus_object_get_service_for_property(const ni_dbus_object_t *object, const char *property_name)
 {
-	const ni_dbus_service_t *svc;
-	unsigned int i;
+	const ni_dbus_service_t *svc = NULL;
 
-	if (object == NULL || object->interfaces == NULL)
-		return NULL;
-
-	for (i = 0; (svc = object->interfaces[i]) != NULL; ++i) {
-		if (ni_dbus_service_get_property(svc, property_name))
-			return svc;
-	}
+	if (ni_dbus_object_find_property(object, &svc, property_name))
+		return svc;
 
 	return NULL;
 }
@@ -503,6 +760,10 @@ ni_dbus_object_register_service(ni_dbus_object_t *object, const ni_dbus_service_
 	object->interfaces[count++] = svc;
 	object->interfaces[count] = NULL;
 
+	/* Interface list changed, dispatch table gets rebuilt on next use */
+	__ni_dbus_dispatch_release(object->dispatch);
+	object->dispatch = NULL;
+
 	if (svc->properties)
 		ni_dbus_object_register_property_interface(object);
 	return TRUE;
@@ -27,6 +27,7 @@
 #include "dbus-common.h"
 #include "xml-schema.h"
 #include "appconfig.h"
+#include "snapshot.h"
 #include "model.h"
 #include "debug.h"
 
@@ -1110,6 +1111,7 @@ static void
 __ni_objectmodel_netif_set_client_state_save_trigger(ni_netdev_t *dev)
 {
 	if (dev && dev->client_state) {
+		ni_state_snapshot_mark(dev->link.ifindex);
 		ni_client_state_save(dev->client_state, dev->link.ifindex);
 		ni_debug_dbus("saving %s structure into a file for %s",
 			NI_CLIENT_STATE_XML_NODE, dev->name);
@@ -1210,6 +1212,8 @@ dbus_bool_t
 ni_objectmodel_send_netif_event(ni_dbus_server_t *server, ni_dbus_object_t *object,
 			ni_event_t ifevent, const ni_uuid_t *uuid)
 {
+	ni_netdev_t *dev;
+
 	if (ifevent >= __NI_EVENT_MAX)
 		return FALSE;
 
@@ -1218,6 +1222,9 @@ ni_objectmodel_send_netif_event(ni_dbus_server_t *server, ni_dbus_object_t *obje
 		return FALSE;
 	}
 
+	if ((dev = ni_objectmodel_unwrap_netif(object, NULL)))
+		ni_state_snapshot_mark(dev->link.ifindex);
+
 	return __ni_objectmodel_device_event(server, object, NI_OBJECTMODEL_NETIF_INTERFACE, ifevent, uuid);
 }
 
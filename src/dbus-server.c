@@ -54,6 +54,7 @@ ni_dbus_server_open(const char *bus_type, const char *bus_name, void *root_objec
 		return NULL;
 
 	}
+	ni_dbus_connection_track_callers(server->connection);
 
 	/* Translate bus name foo.bar.baz into object path /foo/bar/baz */
 	root = ni_dbus_object_new(&dbus_root_object_class, __ni_dbus_server_root_path(bus_name), root_object_handle);
@@ -216,8 +217,29 @@ ni_dbus_server_register_object(ni_dbus_server_t *server, const char *object_path
 static const ni_dbus_service_t __ni_dbus_object_manager_interface;
 static const ni_dbus_service_t __ni_dbus_object_properties_interface;
 static const ni_dbus_service_t __ni_dbus_object_introspectable_interface;
+
+/*
+ * GetManagedObjectsPaged state: objects are sent in tree order, at most
+ * limit per reply; the client passes the path of the last object of the
+ * previous page as cursor to resume after it.
+ */
+#define NI_DBUS_MANAGED_OBJECTS_PAGE_DEFAULT	64
+#define NI_DBUS_MANAGED_OBJECTS_PAGE_MAX	1024
+
+typedef struct ni_dbus_managed_objects_page {
+	const ni_dbus_variant_t *interfaces;	/* objects to include, empty for all */
+	const ni_dbus_variant_t *omit;		/* interfaces sent without properties */
+	const char *		cursor;		/* skip up to and including this path */
+	unsigned int		limit;
+	unsigned int		count;
+	char *			last;		/* path of the last object sent */
+	ni_bool_t		full;
+} ni_dbus_managed_objects_page_t;
+
 static dbus_bool_t		__ni_dbus_object_manager_enumerate_object(ni_dbus_object_t *,
-					ni_dbus_variant_t *dict, DBusError *);
+					ni_dbus_variant_t *dict,
+					ni_dbus_managed_objects_page_t *,
+					DBusError *);
 
 dbus_bool_t
 ni_dbus_object_register_object_manager(ni_dbus_object_t *object)
@@ -270,7 +292,7 @@ __ni_dbus_object_manager_get_managed_objects(ni_dbus_object_t *object,
 	NI_TRACE_ENTER_ARGS("path=%s, method=%s", object->path, method->name);
 
 	ni_dbus_variant_init_dict(&obj_dict);
-	rv = __ni_dbus_object_manager_enumerate_object(object, &obj_dict, error);
+	rv = __ni_dbus_object_manager_enumerate_object(object, &obj_dict, NULL, error);
 	if (rv)
 		rv = ni_dbus_message_serialize_variants(reply, 1, &obj_dict, error);
 	ni_dbus_variant_destroy(&obj_dict);
@@ -278,8 +300,73 @@ __ni_dbus_object_manager_get_managed_objects(ni_dbus_object_t *object,
 	return rv;
 }
 
+/*
+ * GetManagedObjectsPaged(as interfaces, as omit, s cursor, u limit)
+ * returns the GetManagedObjects dict for the next page of objects
+ * and the cursor to pass in the next call, empty after the last page.
+ */
+static dbus_bool_t
+__ni_dbus_object_manager_get_managed_objects_paged(ni_dbus_object_t *object,
+		const ni_dbus_method_t *method,
+		unsigned int argc, const ni_dbus_variant_t *argv,
+		ni_dbus_message_t *reply,
+		DBusError *error)
+{
+	ni_dbus_managed_objects_page_t page;
+	ni_dbus_variant_t result[2] = { NI_DBUS_VARIANT_INIT, NI_DBUS_VARIANT_INIT };
+	const char *cursor = NULL;
+	uint32_t limit = 0;
+	int rv = TRUE;
+
+	NI_TRACE_ENTER_ARGS("path=%s, method=%s", object->path, method->name);
+
+	if (argc != 4
+	 || !ni_dbus_variant_is_string_array(&argv[0])
+	 || !ni_dbus_variant_is_string_array(&argv[1])
+	 || !ni_dbus_variant_get_string(&argv[2], &cursor)
+	 || !ni_dbus_variant_get_uint32(&argv[3], &limit)) {
+		dbus_set_error(error, DBUS_ERROR_INVALID_ARGS,
+				"%s: bad arguments in call to %s",
+				object->path, method->name);
+		return FALSE;
+	}
+
+	memset(&page, 0, sizeof(page));
+	page.interfaces = &argv[0];
+	page.omit = &argv[1];
+	page.cursor = ni_string_empty(cursor) ? NULL : cursor;
+	if (limit == 0)
+		page.limit = NI_DBUS_MANAGED_OBJECTS_PAGE_DEFAULT;
+	else if (limit > NI_DBUS_MANAGED_OBJECTS_PAGE_MAX)
+		page.limit = NI_DBUS_MANAGED_OBJECTS_PAGE_MAX;
+	else
+		page.limit = limit;
+
+	ni_dbus_variant_init_dict(&result[0]);
+	rv = __ni_dbus_object_manager_enumerate_object(object, &result[0], &page, error);
+	if (rv && page.cursor) {
+		/* The cursor object is gone; start over, the client
+		 * just refreshes the objects it sees a second time. */
+		ni_debug_dbus("%s: %s cursor %s not found, restarting",
+				object->path, method->name, page.cursor);
+		page.cursor = NULL;
+		rv = __ni_dbus_object_manager_enumerate_object(object, &result[0], &page, error);
+	}
+	if (rv) {
+		ni_dbus_variant_set_string(&result[1], page.full ? page.last : "");
+		rv = ni_dbus_message_serialize_variants(reply, 2, result, error);
+	}
+	ni_dbus_variant_destroy(&result[0]);
+	ni_dbus_variant_destroy(&result[1]);
+	ni_string_free(&page.last);
+
+	return rv;
+}
+
 static ni_dbus_method_t	__ni_dbus_object_manager_methods[] = {
 	{ "GetManagedObjects",	NULL,	.handler = __ni_dbus_object_manager_get_managed_objects },
+	{ "GetManagedObjectsPaged", "asassu",
+				.handler = __ni_dbus_object_manager_get_managed_objects_paged },
 	{ NULL }
 };
 
@@ -327,17 +414,7 @@ __ni_dbus_object_properties_arg_property(ni_dbus_object_t *object, const ni_dbus
 	if (property_name == NULL || property_name[0] == '\0')
 		return FALSE;
 
-	if (service != NULL) {
-		property = ni_dbus_service_get_property(service, property_name);
-	} else {
-		unsigned int i;
-
-		for (i = 0; (service = object->interfaces[i]) != NULL; ++i) {
-			property = ni_dbus_service_get_property(service, property_name);
-			if (property)
-				break;
-		}
-	}
+	property = ni_dbus_object_find_property(object, &service, property_name);
 
 	if (property == NULL) {
 		dbus_set_error(error, DBUS_ERROR_UNKNOWN_METHOD,
@@ -505,13 +582,53 @@ static const ni_dbus_service_t __ni_dbus_object_introspectable_interface = {
 	.methods = __ni_dbus_object_introspectable_methods,
 };
 
+static ni_bool_t
+__ni_dbus_managed_objects_list_match(const ni_dbus_variant_t *list, const char *name)
+{
+	unsigned int i;
+
+	for (i = 0; i < list->array.len; ++i) {
+		if (ni_string_eq(list->string_array_value[i], name))
+			return TRUE;
+	}
+	return FALSE;
+}
+
+static ni_bool_t
+__ni_dbus_managed_objects_page_select(ni_dbus_managed_objects_page_t *page, ni_dbus_object_t *object)
+{
+	const ni_dbus_service_t *service;
+	unsigned int i;
+
+	if (page->cursor) {
+		if (ni_string_eq(page->cursor, object->path))
+			page->cursor = NULL;
+		return FALSE;
+	}
+
+	if (page->interfaces->array.len == 0)
+		return TRUE;
+
+	for (i = 0; (service = object->interfaces[i]) != NULL; ++i) {
+		if (__ni_dbus_managed_objects_list_match(page->interfaces, service->name))
+			return TRUE;
+	}
+	return FALSE;
+}
+
 dbus_bool_t
-__ni_dbus_object_manager_enumerate_object(ni_dbus_object_t *object, ni_dbus_variant_t *obj_dict, DBusError *error)
+__ni_dbus_object_manager_enumerate_object(ni_dbus_object_t *object, ni_dbus_variant_t *obj_dict,
+				ni_dbus_managed_objects_page_t *page, DBusError *error)
 {
 	ni_dbus_object_t *child;
 	int rv = TRUE;
 
-	if (object->interfaces) {
+	if (page && page->count >= page->limit) {
+		page->full = TRUE;
+		return TRUE;
+	}
+
+	if (object->interfaces && (!page || __ni_dbus_managed_objects_page_select(page, object))) {
 		ni_dbus_variant_t *ifdict = ni_dbus_dict_add(obj_dict, object->path);
 		const ni_dbus_service_t *service;
 		unsigned int i;
@@ -521,23 +638,38 @@ __ni_dbus_object_manager_enumerate_object(ni_dbus_object_t *object, ni_dbus_vari
 			ni_dbus_variant_t *propdict = ni_dbus_dict_add(ifdict, service->name);
 
 			ni_dbus_variant_init_dict(propdict);
+
+			/* Announce the interface, but leave out the properties */
+			if (page && __ni_dbus_managed_objects_list_match(page->omit, service->name))
+				continue;
+
 			rv = ni_dbus_object_get_properties_as_dict(object, service, propdict, error);
 		}
+
+		if (page) {
+			ni_string_dup(&page->last, object->path);
+			page->count++;
+		}
 	}
 
 	for (child = object->children; child && rv; child = child->next) {
+		if (page && page->full)
+			break;
+
 		/* If the object has a refresh function, call it now.
 		 * Note that the server method call handling code will
 		 * already have refreshed the top-level object, so we will
 		 * only refresh the children here.
+		 * Objects skipped up to the page cursor are not refreshed.
 		 */
-		if (child->class && child->class->refresh
+		if ((!page || !page->cursor)
+		 && child->class && child->class->refresh
 		 && !child->class->refresh(object)) {
 			rv = FALSE;
 			continue;
 		}
 
-		rv = __ni_dbus_object_manager_enumerate_object(child, obj_dict, error);
+		rv = __ni_dbus_object_manager_enumerate_object(child, obj_dict, page, error);
 	}
 
 	return rv;
@@ -597,7 +729,7 @@ __ni_dbus_object_message(DBusConnection *conn, DBusMessage *call, void *user_dat
 
 	server = ni_dbus_object_get_server(object);
 
-	method = ni_dbus_service_get_method(svc, method_name);
+	method = ni_dbus_object_find_method(object, svc, method_name);
 	if (method == NULL
 	 || (!method->handler && !method->handler_ex && !method->async_handler)) {
 		dbus_set_error(&error,
@@ -30,6 +30,7 @@
 
 
 static unsigned int	ni_dhcp4_do_bits(const ni_config_dhcp4_t *, unsigned int);
+static void		ni_dhcp4_config_offer_collection(const char *, ni_dhcp4_config_t *);
 static const char *	ni_dhcp4_print_doflags(unsigned int);
 static void		ni_dhcp4_config_set_request_options(const char *, ni_uint_array_t *, const ni_string_array_t *);
 
@@ -144,6 +145,7 @@ ni_dhcp4_device_free(ni_dhcp4_device_t *dev)
 	ni_dhcp4_device_drop_buffer(dev);
 	ni_dhcp4_device_drop_lease(dev);
 	ni_dhcp4_device_drop_best_offer(dev);
+	ni_dhcp4_device_drop_offers(dev);
 	ni_dhcp4_device_close(dev);
 	ni_string_free(&dev->system.ifname);
 	ni_string_free(&dev->ifname);
@@ -234,6 +236,23 @@ ni_dhcp4_device_drop_best_offer(ni_dhcp4_device_t *dev)
 	dev->best_offer.lease = NULL;
 }
 
+void
+ni_dhcp4_device_drop_offers(ni_dhcp4_device_t *dev)
+{
+	unsigned int i;
+
+	if (dev->offers.timer) {
+		ni_timer_cancel(dev->offers.timer);
+		dev->offers.timer = NULL;
+	}
+	for (i = 0; i < dev->offers.count; ++i)
+		ni_addrconf_lease_free(dev->offers.list[i].lease);
+	memset(dev->offers.list, 0, sizeof(dev->offers.list));
+	dev->offers.count = 0;
+	dev->offers.probing = FALSE;
+	dev->offers.nprobes = 0;
+}
+
 /*
  * Refresh the device mtu and MAC address info prior to taking any actions
  */
@@ -286,6 +305,7 @@ ni_dhcp4_acquire(ni_dhcp4_device_t *dev, const ni_dhcp4_request_t *info)
 		config->update &= ni_config_addrconf_update_mask(NI_ADDRCONF_DHCP, AF_INET);
 	}
 	config->doflags = ni_dhcp4_do_bits(ni_config_dhcp4_find_device(dev->ifname), config->update);
+	ni_dhcp4_config_offer_collection(dev->ifname, config);
 
 	config->route_priority = info->route_priority;
 	config->recover_lease = info->recover_lease;
@@ -549,6 +569,7 @@ ni_dhcp4_release(ni_dhcp4_device_t *dev, const ni_uuid_t *req_uuid)
 		dev->fsm.timer = NULL;
 	}
 	ni_dhcp4_device_drop_best_offer(dev);
+	ni_dhcp4_device_drop_offers(dev);
 	ni_dhcp4_device_arp_close(dev);
 
 	if (dev->defer.timer)
@@ -999,6 +1020,20 @@ ni_dhcp4_config_server_preference_hwaddr(const ni_hwaddr_t *hwaddr)
 	return 0;
 }
 
+static void
+ni_dhcp4_config_offer_collection(const char *ifname, ni_dhcp4_config_t *config)
+{
+	const ni_config_dhcp4_t *dhconf = ni_config_dhcp4_find_device(ifname);
+
+	if (!dhconf)
+		return;
+
+	config->offer_window = dhconf->offer_collection.window;
+	config->offer_candidates = dhconf->offer_collection.candidates;
+	if (!config->offer_candidates)
+		config->offer_candidates = NI_DHCP4_OFFER_CANDIDATES_DEFAULT;
+}
+
 unsigned int
 ni_dhcp4_config_max_lease_time(void)
 {
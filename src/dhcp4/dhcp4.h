@@ -14,6 +14,7 @@
 #include <wicked/wicked.h>
 #include <wicked/socket.h>
 #include "netinfo_priv.h"
+#include "appconfig.h"
 #include "buffer.h"
 
 enum fsm_state {
@@ -33,6 +34,15 @@ typedef struct ni_dhcp4_message ni_dhcp4_message_t;
 typedef struct ni_dhcp4_config ni_dhcp4_config_t;
 typedef struct ni_dhcp4_request	ni_dhcp4_request_t;
 
+/*
+ * Offer collected in the offer-collection window
+ */
+typedef struct ni_dhcp4_offer {
+	ni_addrconf_lease_t *	lease;
+	int			score;
+	ni_bool_t		conflict;
+} ni_dhcp4_offer_t;
+
 typedef struct ni_dhcp4_device {
 	struct ni_dhcp4_device *	next;
 	unsigned int		users;
@@ -86,8 +96,47 @@ typedef struct ni_dhcp4_device {
 	   ni_addrconf_lease_t *lease;
 	   int			weight;
 	} best_offer;
+
+	struct {
+	   const ni_timer_t *	timer;
+	   unsigned int		count;
+	   ni_dhcp4_offer_t	list[NI_DHCP4_OFFER_CANDIDATES_MAX];
+	   ni_bool_t		probing;
+	   unsigned int		nprobes;
+	   struct in_addr	validated;	/* probed before the request */
+	} offers;
 } ni_dhcp4_device_t;
 
+/*
+ * Options of a received message indexed by code, pointing into
+ * the message without copying them. Enough to select an offer;
+ * the lease is decoded from it by ni_dhcp4_parse_response.
+ */
+#define NI_DHCP4_OPTION_AREAS		3	/* options, file, sname */
+
+typedef struct ni_dhcp4_option_ref {
+	const unsigned char *	data;		/* first occurrence */
+	unsigned int		len;		/* total of all occurrences */
+	unsigned int		parts;
+} ni_dhcp4_option_ref_t;
+
+typedef struct ni_dhcp4_option_index {
+	int			msg_type;
+
+	unsigned int		count;
+	unsigned char		order[256];	/* codes as they appear */
+	ni_dhcp4_option_ref_t	opts[256];
+
+	unsigned int		nareas;
+	struct {
+	    const unsigned char *data;
+	    unsigned int	len;
+	}			areas[NI_DHCP4_OPTION_AREAS];
+
+	unsigned int		use_bootfile : 1,
+				use_bootserver : 1;
+} ni_dhcp4_option_index_t;
+
 #define NI_DHCP4_RESEND_TIMEOUT_INIT	4	/* seconds */
 #define NI_DHCP4_RESEND_TIMEOUT_MAX	64	/* seconds */
 #define NI_DHCP4_REQUEST_TIMEOUT		60	/* seconds */
@@ -199,6 +248,9 @@ struct ni_dhcp4_config {
 	unsigned int		max_lease_time;
 	ni_bool_t		recover_lease;
 	ni_bool_t		release_lease;
+
+	unsigned int		offer_window;		/* msec, 0 disables */
+	unsigned int		offer_candidates;	/* offers to validate */
 };
 
 enum ni_dhcp4_event {
@@ -231,8 +283,14 @@ extern int		ni_dhcp4_build_message(const ni_dhcp4_device_t *,
 extern void		ni_dhcp4_fsm_link_up(ni_dhcp4_device_t *);
 extern void		ni_dhcp4_fsm_link_down(ni_dhcp4_device_t *);
 
+extern int		ni_dhcp4_option_index_build(ni_dhcp4_option_index_t *,
+						const ni_dhcp4_message_t *, ni_buffer_t *);
+extern ni_bool_t	ni_dhcp4_option_index_get_ipv4(const ni_dhcp4_option_index_t *,
+						unsigned int, struct in_addr *);
+extern ni_bool_t	ni_dhcp4_option_index_get_opaque(const ni_dhcp4_option_index_t *,
+						unsigned int, ni_opaque_t *);
 extern int		ni_dhcp4_parse_response(const ni_dhcp4_config_t *, const ni_dhcp4_message_t *,
-						ni_buffer_t *, ni_addrconf_lease_t **);
+						const ni_dhcp4_option_index_t *, ni_addrconf_lease_t **);
 
 extern int		ni_dhcp4_socket_open(ni_dhcp4_device_t *);
 
@@ -265,6 +323,7 @@ extern ni_bool_t	ni_dhcp4_set_config_client_id(ni_opaque_t *, const ni_dhcp4_dev
 extern void		ni_dhcp4_new_xid(ni_dhcp4_device_t *);
 extern void		ni_dhcp4_device_set_best_offer(ni_dhcp4_device_t *, ni_addrconf_lease_t *, int);
 extern void		ni_dhcp4_device_drop_best_offer(ni_dhcp4_device_t *);
+extern void		ni_dhcp4_device_drop_offers(ni_dhcp4_device_t *);
 
 extern int		ni_dhcp4_xml_from_lease(const ni_addrconf_lease_t *, xml_node_t *);
 extern int		ni_dhcp4_xml_to_lease(ni_addrconf_lease_t *, const xml_node_t *);
@@ -40,6 +40,11 @@ static void		ni_dhcp4_fsm_fail_lease(ni_dhcp4_device_t *);
 static int		ni_dhcp4_fsm_validate_lease(ni_dhcp4_device_t *, ni_addrconf_lease_t *);
 static void		ni_dhcp4_send_event(enum ni_dhcp4_event, ni_dhcp4_device_t *, ni_addrconf_lease_t *);
 static void		__ni_dhcp4_fsm_timeout(void *, const ni_timer_t *);
+static void		ni_dhcp4_fsm_offer_collect(ni_dhcp4_device_t *, ni_addrconf_lease_t *, int);
+static void		ni_dhcp4_fsm_offers_select(ni_dhcp4_device_t *);
+static void		ni_dhcp4_fsm_offers_timeout(void *, const ni_timer_t *);
+static unsigned int	ni_dhcp4_fsm_offers_candidates(const ni_dhcp4_device_t *);
+static ni_bool_t	ni_dhcp4_fsm_arp_conflict(ni_dhcp4_device_t *, const ni_arp_packet_t *);
 
 static ni_dhcp4_event_handler_t *ni_dhcp4_fsm_event_handler;
 
@@ -70,11 +75,63 @@ ni_dhcp4_fsm_init_device(ni_dhcp4_device_t *dev)
 	}
 }
 
+/*
+ * Server preference weight of an offer
+ */
+static int
+ni_dhcp4_fsm_offer_weight(const ni_dhcp4_device_t *dev, struct in_addr srv_addr, const ni_sockaddr_t *from)
+{
+	ni_hwaddr_t hwaddr;
+	int weight;
+
+	/* Check if we have any preferred servers. */
+	ni_capture_from_hwaddr_set(&hwaddr, from);
+	if (!(weight = ni_dhcp4_config_server_preference_ipaddr(srv_addr)))
+		weight = ni_dhcp4_config_server_preference_hwaddr(&hwaddr);
+
+	/* If we're refreshing an existing lease (eg after link disconnect
+	 * and reconnect), we accept the offer if it comes from the same
+	 * server as the original one.
+	 */
+	if (dev->lease
+	 && dev->lease->dhcp4.server_id.s_addr == srv_addr.s_addr)
+		weight = 100;
+
+	return weight;
+}
+
+/*
+ * Decode the lease of a message we're going to use
+ */
+static ni_addrconf_lease_t *
+ni_dhcp4_fsm_decode_lease(ni_dhcp4_device_t *dev, const ni_dhcp4_message_t *message,
+			const ni_dhcp4_option_index_t *index, const char *sender)
+{
+	ni_addrconf_lease_t *lease = NULL;
+
+	if (ni_dhcp4_parse_response(dev->config, message, index, &lease) < 0) {
+		ni_error("%s: unable to parse DHCP4 response%s%s", dev->ifname,
+				sender ? " sender " : "", sender ? sender : "");
+		return NULL;
+	}
+	ni_string_dup(&lease->dhcp4.sender_hwa, sender);
+
+	/* set reqest client-id in the response early to have it in test mode */
+	if (!lease->dhcp4.client_id.len && dev->config->client_id.len) {
+		ni_opaque_set(&lease->dhcp4.client_id,	dev->config->client_id.data,
+							dev->config->client_id.len);
+	}
+	return lease;
+}
+
 int
 ni_dhcp4_fsm_process_dhcp4_packet(ni_dhcp4_device_t *dev, ni_buffer_t *msgbuf, ni_sockaddr_t *from)
 {
+	ni_dhcp4_option_index_t index;
 	ni_dhcp4_message_t *message;
 	ni_addrconf_lease_t *lease = NULL;
+	ni_opaque_t client_id;
+	char *sender_hwa = NULL;
 	const char *sender = NULL;
 	int msg_code;
 
@@ -109,7 +166,11 @@ ni_dhcp4_fsm_process_dhcp4_packet(ni_dhcp4_device_t *dev, ni_buffer_t *msgbuf, n
 		return -1;
 	}
 
-	msg_code = ni_dhcp4_parse_response(dev->config, message, msgbuf, &lease);
+	/*
+	 * Index the options only; the lease is decoded when we
+	 * are going to use it, not for every offer we discard.
+	 */
+	msg_code = ni_dhcp4_option_index_build(&index, message, msgbuf);
 	sender = ni_capture_from_hwaddr_print(from);
 	if (msg_code < 0) {
 		/* Ignore this message, time out later */
@@ -117,10 +178,13 @@ ni_dhcp4_fsm_process_dhcp4_packet(ni_dhcp4_device_t *dev, ni_buffer_t *msgbuf, n
 				sender ? " sender " : "", sender ? sender : "");
 		return -1;
 	}
-	ni_string_dup(&lease->dhcp4.sender_hwa, sender);
-	sender = lease->dhcp4.sender_hwa;
+	ni_string_dup(&sender_hwa, sender);
+	sender = sender_hwa;
+
+	memset(&client_id, 0, sizeof(client_id));
+	ni_dhcp4_option_index_get_opaque(&index, DHCP4_CLIENTID, &client_id);
 
-	if (dev->config->client_id.len && !lease->dhcp4.client_id.len) {
+	if (dev->config->client_id.len && !client_id.len) {
 		/*
 		 * https://tools.ietf.org/html/rfc6842:
 		 *
@@ -139,8 +203,8 @@ ni_dhcp4_fsm_process_dhcp4_packet(ni_dhcp4_device_t *dev, ni_buffer_t *msgbuf, n
 		 */
 		ni_debug_dhcp("%s: server does not send client-id back", dev->ifname);
 	} else
-	if (lease->dhcp4.client_id.len &&
-	    !ni_opaque_eq(&dev->config->client_id, &lease->dhcp4.client_id)) {
+	if (client_id.len &&
+	    !ni_opaque_eq(&dev->config->client_id, &client_id)) {
 		/*
 		 * https://tools.ietf.org/html/rfc6842:
 		 *
@@ -152,6 +216,7 @@ ni_dhcp4_fsm_process_dhcp4_packet(ni_dhcp4_device_t *dev, ni_buffer_t *msgbuf, n
 		 */
 		ni_debug_dhcp("%s: ignoring packet with not matching client-id%s%s",
 				dev->ifname, sender ? " sender " : "", sender ? sender : "");
+		ni_string_free(&sender_hwa);
 		return -1;
 	}
 
@@ -160,28 +225,22 @@ ni_dhcp4_fsm_process_dhcp4_packet(ni_dhcp4_device_t *dev, ni_buffer_t *msgbuf, n
 			ni_dhcp4_fsm_state_name(dev->fsm.state),
 			sender ? " sender " : "", sender ? sender : "");
 
-	if (lease->dhcp4.client_id.len) {
+	if (client_id.len) {
 		ni_debug_verbose(NI_LOG_DEBUG1, NI_TRACE_DHCP,
 				"%s: and matching client id %s", dev->ifname,
-				ni_print_hex(lease->dhcp4.client_id.data,
-						lease->dhcp4.client_id.len));
+				ni_print_hex(client_id.data, client_id.len));
 	}
 
-	/* set reqest client-id in the response early to have it in test mode */
-	if (!lease->dhcp4.client_id.len && dev->config->client_id.len) {
-		ni_opaque_set(&lease->dhcp4.client_id,	dev->config->client_id.data,
-							dev->config->client_id.len);
-	}
-
-
 	/* When receiving a DHCP4 OFFER, verify sender address against list of
 	 * servers to ignore, and preferred servers. */
 	if (msg_code == DHCP4_OFFER && dev->fsm.state == NI_DHCP4_STATE_SELECTING) {
-		struct in_addr srv_addr = lease->dhcp4.server_id;
-		const char *ipaddr = inet_ntoa(srv_addr);
-		ni_hwaddr_t hwaddr;
+		struct in_addr srv_addr = { 0 };
+		const char *ipaddr;
 		int weight = 0;
 
+		ni_dhcp4_option_index_get_ipv4(&index, DHCP4_SERVERIDENTIFIER, &srv_addr);
+		ipaddr = inet_ntoa(srv_addr);
+
 		if (sender && ni_dhcp4_config_ignore_server(sender)) {
 			ni_debug_dhcp("%s: ignoring DHCP4 offer from %s%s%s%s (blacklisted)",
 					dev->ifname, inet_ntoa(srv_addr),
@@ -199,27 +258,37 @@ ni_dhcp4_fsm_process_dhcp4_packet(ni_dhcp4_device_t *dev, ni_buffer_t *msgbuf, n
 			goto out;
 		}
 
+		/* With an offer collection window, all offers arriving
+		 * in the window are ranked and the best ones validated
+		 * before we request one of them.
+		 */
+		if (dev->config->offer_window) {
+			if (dev->offers.probing) {
+				ni_debug_dhcp("%s: ignoring late lease offer from %s",
+						dev->ifname, inet_ntoa(srv_addr));
+				goto out;
+			}
+
+			weight = ni_dhcp4_fsm_offer_weight(dev, srv_addr, from);
+			if (weight < 0)
+				goto out;
+
+			if (!(lease = ni_dhcp4_fsm_decode_lease(dev, message, &index, sender)))
+				goto failure;
+			ni_dhcp4_fsm_offer_collect(dev, lease, weight);
+			ni_string_free(&sender_hwa);
+			return 0;
+		}
+
 		/* If we're scanning all offers, we need to decide whether
 		 * this offer is accepted, or whether we want to wait for
 		 * more.
 		 */
 		if (!dev->dhcp4.accept_any_offer) {
-
-			/* Check if we have any preferred servers. */
-			ni_capture_from_hwaddr_set(&hwaddr, from);
-			if (!(weight = ni_dhcp4_config_server_preference_ipaddr(srv_addr)))
-				weight = ni_dhcp4_config_server_preference_hwaddr(&hwaddr);
-
-			/* If we're refreshing an existing lease (eg after link disconnect
-			 * and reconnect), we accept the offer if it comes from the same
-			 * server as the original one.
-			 */
-			if (dev->lease
-			 && dev->lease->dhcp4.server_id.s_addr == srv_addr.s_addr)
-				weight = 100;
+			weight = ni_dhcp4_fsm_offer_weight(dev, srv_addr, from);
 
 			ni_debug_dhcp("%s: received lease offer from %s; server weight=%d (best offer=%d)",
-					dev->ifname, inet_ntoa(lease->dhcp4.server_id),
+					dev->ifname, inet_ntoa(srv_addr),
 					weight,	dev->best_offer.weight);
 
 			/* negative weight means never. */
@@ -229,19 +298,30 @@ ni_dhcp4_fsm_process_dhcp4_packet(ni_dhcp4_device_t *dev, ni_buffer_t *msgbuf, n
 			/* weight between 0 and 100 means maybe. */
 			if (weight < 100) {
 				if (dev->best_offer.weight < weight) {
+					if (!(lease = ni_dhcp4_fsm_decode_lease(dev, message, &index, sender)))
+						goto failure;
 					ni_dhcp4_device_set_best_offer(dev, lease, weight);
+					ni_string_free(&sender_hwa);
 					return 0;
 				}
 				/* OK, but it is better than previous */
 			} else {
 				/* If the weight has maximum value, just accept this offer. */
+				if (!(lease = ni_dhcp4_fsm_decode_lease(dev, message, &index, sender)))
+					goto failure;
 				ni_dhcp4_device_set_best_offer(dev, lease, weight);
 				lease = NULL;
 			}
 		} else {
+			if (!(lease = ni_dhcp4_fsm_decode_lease(dev, message, &index, sender)))
+				goto failure;
 			ni_dhcp4_device_set_best_offer(dev, lease, weight);
 			lease = NULL;
 		}
+	} else
+	if (msg_code == DHCP4_ACK) {
+		if (!(lease = ni_dhcp4_fsm_decode_lease(dev, message, &index, sender)))
+			goto failure;
 	}
 
 	/* We've received a valid response; if something goes wrong now
@@ -332,7 +412,12 @@ out:
 	if (msg_code != DHCP4_NAK)
 		dev->dhcp4.nak_backoff = 1;
 
+	ni_string_free(&sender_hwa);
 	return 0;
+
+failure:
+	ni_string_free(&sender_hwa);
+	return -1;
 }
 
 static void
@@ -348,6 +433,8 @@ ni_dhcp4_fsm_restart(ni_dhcp4_device_t *dev)
 	dev->dhcp4.xid = 0;
 	dev->config->elapsed_timeout = 0;
 
+	ni_dhcp4_device_drop_offers(dev);
+	dev->offers.validated.s_addr = 0;
 	ni_dhcp4_device_drop_lease(dev);
 }
 
@@ -421,11 +508,192 @@ __ni_dhcp4_fsm_discover(ni_dhcp4_device_t *dev, int scan_offers)
 	ni_dhcp4_device_send_message(dev, DHCP4_DISCOVER, lease);
 
 	ni_dhcp4_device_drop_best_offer(dev);
+	ni_dhcp4_device_drop_offers(dev);
+	dev->offers.validated.s_addr = 0;
 
 	if (lease != dev->lease)
 		ni_addrconf_lease_free(lease);
 }
 
+/*
+ * Offer collection window: rank the offers by the server preference
+ * weight and, when the window closes, probe the best candidates
+ * concurrently.
+ */
+static void
+ni_dhcp4_fsm_offer_collect(ni_dhcp4_device_t *dev, ni_addrconf_lease_t *lease, int weight)
+{
+	ni_dhcp4_offer_t *list = dev->offers.list;
+	int score = weight;
+	unsigned int i, pos;
+
+	ni_debug_dhcp("%s: collecting lease offer of %s from %s; weight=%d",
+			dev->ifname, inet_ntoa(lease->dhcp4.address),
+			inet_ntoa(lease->dhcp4.server_id), weight);
+	if (score < 0) {
+		ni_addrconf_lease_free(lease);
+		return;
+	}
+
+	/* a server answering a retransmitted discover replaces its offer */
+	for (i = 0; i < dev->offers.count; ++i) {
+		if (list[i].lease->dhcp4.server_id.s_addr != lease->dhcp4.server_id.s_addr)
+			continue;
+		ni_addrconf_lease_free(list[i].lease);
+		dev->offers.count--;
+		memmove(&list[i], &list[i + 1], (dev->offers.count - i) * sizeof(list[0]));
+		memset(&list[dev->offers.count], 0, sizeof(list[0]));
+		break;
+	}
+
+	/* keep the arrival order among offers with equal score */
+	for (pos = 0; pos < dev->offers.count; ++pos) {
+		if (list[pos].score < score)
+			break;
+	}
+	if (pos >= NI_DHCP4_OFFER_CANDIDATES_MAX) {
+		ni_addrconf_lease_free(lease);
+		return;
+	}
+	if (dev->offers.count == NI_DHCP4_OFFER_CANDIDATES_MAX) {
+		dev->offers.count--;
+		ni_addrconf_lease_free(list[dev->offers.count].lease);
+	}
+	memmove(&list[pos + 1], &list[pos], (dev->offers.count - pos) * sizeof(list[0]));
+	list[pos].lease = lease;
+	list[pos].score = score;
+	list[pos].conflict = FALSE;
+	dev->offers.count++;
+
+	if (weight >= 100) {
+		/* a perfect match does not need to wait for the window */
+		ni_dhcp4_fsm_offers_select(dev);
+	} else
+	if (!dev->offers.timer) {
+		dev->offers.timer = ni_timer_register(dev->config->offer_window,
+					ni_dhcp4_fsm_offers_timeout, dev);
+	}
+}
+
+static unsigned int
+ni_dhcp4_fsm_offers_candidates(const ni_dhcp4_device_t *dev)
+{
+	if (dev->offers.count < dev->config->offer_candidates)
+		return dev->offers.count;
+	return dev->config->offer_candidates;
+}
+
+static void
+ni_dhcp4_fsm_offers_accept(ni_dhcp4_device_t *dev, unsigned int pos)
+{
+	ni_dhcp4_offer_t *offer = &dev->offers.list[pos];
+	ni_addrconf_lease_t *lease = offer->lease;
+	int score = offer->score;
+
+	ni_debug_dhcp("%s: accepting lease offer of %s from %s; score=%d",
+			dev->ifname, inet_ntoa(lease->dhcp4.address),
+			inet_ntoa(lease->dhcp4.server_id), score);
+
+	offer->lease = NULL;
+	ni_dhcp4_device_drop_offers(dev);
+	ni_dhcp4_device_arp_close(dev);
+
+	ni_dhcp4_device_set_best_offer(dev, lease, score);
+	ni_dhcp4_device_disarm_retransmit(dev);
+	ni_dhcp4_process_offer(dev, dev->best_offer.lease);
+}
+
+static void
+ni_dhcp4_fsm_offers_probe(ni_dhcp4_device_t *dev)
+{
+	struct in_addr null = { 0 };
+	const ni_dhcp4_offer_t *offer;
+	unsigned int i, n;
+
+	n = ni_dhcp4_fsm_offers_candidates(dev);
+	if (dev->offers.nprobes) {
+		for (i = 0; i < n; ++i) {
+			offer = &dev->offers.list[i];
+			if (offer->conflict)
+				continue;
+
+			ni_debug_dhcp("%s: arp validate: probing for offered %s",
+					dev->ifname, inet_ntoa(offer->lease->dhcp4.address));
+			ni_arp_send_request(dev->arp.handle, null, offer->lease->dhcp4.address);
+		}
+		dev->offers.nprobes--;
+		dev->offers.timer = ni_timer_register(NI_DHCP4_ARP_TIMEOUT,
+					ni_dhcp4_fsm_offers_timeout, dev);
+		return;
+	}
+
+	for (i = 0; i < n; ++i) {
+		if (dev->offers.list[i].conflict)
+			continue;
+
+		dev->offers.validated = dev->offers.list[i].lease->dhcp4.address;
+		ni_dhcp4_fsm_offers_accept(dev, i);
+		return;
+	}
+
+	ni_info("%s: all offered addresses are already in use", dev->ifname);
+	ni_dhcp4_device_arp_close(dev);
+	ni_dhcp4_fsm_restart(dev);
+	ni_dhcp4_fsm_set_timeout(dev, 10);
+}
+
+static void
+ni_dhcp4_fsm_offers_select(ni_dhcp4_device_t *dev)
+{
+	if (dev->offers.timer) {
+		ni_timer_cancel(dev->offers.timer);
+		dev->offers.timer = NULL;
+	}
+
+	if (dev->offers.probing) {
+		/* every candidate conflicts */
+		ni_dhcp4_fsm_offers_probe(dev);
+		return;
+	}
+
+	if (!dev->offers.count)
+		return;
+
+	if (dev->config->doflags & DHCP4_DO_ARP) {
+		if (dev->arp.handle == NULL) {
+			dev->arp.handle = ni_arp_socket_open(&dev->system,
+					ni_dhcp4_fsm_process_arp_packet, dev);
+		}
+		if (dev->arp.handle) {
+			dev->offers.probing = TRUE;
+			dev->offers.nprobes = 3;
+			ni_dhcp4_fsm_offers_probe(dev);
+			return;
+		}
+		ni_error("%s: unable to create ARP handle", dev->ifname);
+	}
+
+	/* when we cannot probe, request the best offer */
+	ni_dhcp4_fsm_offers_accept(dev, 0);
+}
+
+static void
+ni_dhcp4_fsm_offers_timeout(void *user_data, const ni_timer_t *timer)
+{
+	ni_dhcp4_device_t *dev = user_data;
+
+	if (dev->offers.timer != timer) {
+		ni_warn("%s: bad timer handle", __func__);
+		return;
+	}
+	dev->offers.timer = NULL;
+
+	if (dev->offers.probing)
+		ni_dhcp4_fsm_offers_probe(dev);
+	else
+		ni_dhcp4_fsm_offers_select(dev);
+}
+
 static void
 ni_dhcp4_fsm_discover_init(ni_dhcp4_device_t *dev)
 {
@@ -603,6 +871,10 @@ ni_dhcp4_fsm_timeout(ni_dhcp4_device_t *dev)
 		break;
 
 	case NI_DHCP4_STATE_SELECTING:
+		if (dev->offers.count) {
+			/* the offer window or probing decides */
+			return;
+		}
 		if (!dev->dhcp4.accept_any_offer) {
 
 			/* We were scanning all offers to check for a best offer.
@@ -836,6 +1108,12 @@ ni_dhcp4_process_ack(ni_dhcp4_device_t *dev, ni_addrconf_lease_t *lease)
 	/* set lease to validate and commit or decline */
 	ni_dhcp4_device_set_lease(dev, lease);
 
+	if (dev->offers.validated.s_addr &&
+	    dev->offers.validated.s_addr == lease->dhcp4.address.s_addr) {
+		/* probed while selecting the offer, no need to do it twice */
+		dev->offers.validated.s_addr = 0;
+		ni_dhcp4_fsm_commit_lease(dev, lease);
+	} else
 	if (dev->config->doflags & DHCP4_DO_ARP) {
 		/*
 		 * When we cannot init validate [arp], commit it.
@@ -1062,7 +1340,7 @@ ni_dhcp4_fsm_arp_validate(ni_dhcp4_device_t *dev)
 	if (dev->arp.handle == NULL) {
 		dev->arp.handle = ni_arp_socket_open(&dev->system,
 				ni_dhcp4_fsm_process_arp_packet, dev);
-		if (!dev->arp.handle->user_data) {
+		if (!dev->arp.handle) {
 			ni_error("%s: unable to create ARP handle", dev->ifname);
 			return -1;
 		}
@@ -1095,23 +1373,72 @@ void
 ni_dhcp4_fsm_process_arp_packet(ni_arp_socket_t *arph, const ni_arp_packet_t *pkt, void *user_data)
 {
 	ni_dhcp4_device_t *dev = user_data;
-	ni_netconfig_t *nc = ni_global_state_handle(0);
-	const ni_netdev_t *ifp;
-	ni_bool_t false_alarm = FALSE;
-	ni_bool_t found_addr = FALSE;
+	ni_dhcp4_offer_t *offer;
+	unsigned int i, n, conflicts;
 
-	if (!pkt || pkt->op != ARPOP_REPLY || !dev->lease)
+	if (!pkt || pkt->op != ARPOP_REPLY)
+		return;
+
+	if (dev->offers.probing) {
+		n = ni_dhcp4_fsm_offers_candidates(dev);
+		for (i = conflicts = 0; i < n; ++i) {
+			offer = &dev->offers.list[i];
+			if (!offer->conflict &&
+			    pkt->sip.s_addr == offer->lease->dhcp4.address.s_addr &&
+			    ni_dhcp4_fsm_arp_conflict(dev, pkt)) {
+				ni_debug_dhcp("%s: offered address %s already in use by %s",
+						dev->ifname, inet_ntoa(pkt->sip),
+						ni_link_address_print(&pkt->sha));
+				offer->conflict = TRUE;
+			}
+			if (offer->conflict)
+				conflicts++;
+		}
+		/* no point to wait for the remaining probes */
+		if (n && conflicts == n) {
+			dev->offers.nprobes = 0;
+			if (dev->offers.timer) {
+				ni_timer_cancel(dev->offers.timer);
+				dev->offers.timer = NULL;
+			}
+			ni_dhcp4_fsm_offers_select(dev);
+		}
+		return;
+	}
+
+	if (!dev->lease)
 		return;
 
 	/* Is it about the address we're validating at all? */
 	if (pkt->sip.s_addr != dev->lease->dhcp4.address.s_addr)
 		return;
 
+	if (!ni_dhcp4_fsm_arp_conflict(dev, pkt))
+		return;
+
+	ni_debug_dhcp("%s: address %s already in use by %s",
+			dev->ifname, inet_ntoa(pkt->sip),
+			ni_link_address_print(&pkt->sha));
+	ni_dhcp4_device_arp_close(dev);
+	ni_dhcp4_fsm_decline(dev);
+}
+
+/*
+ * Whether an ARP reply for an address really means it is in use
+ */
+static ni_bool_t
+ni_dhcp4_fsm_arp_conflict(ni_dhcp4_device_t *dev, const ni_arp_packet_t *pkt)
+{
+	ni_netconfig_t *nc = ni_global_state_handle(0);
+	const ni_netdev_t *ifp;
+	ni_bool_t false_alarm = FALSE;
+	ni_bool_t found_addr = FALSE;
+
 	/* Ignore any ARP replies that seem to come from our own
 	 * MAC address. Some helpful switches seem to generate
 	 * these. */
 	if (ni_link_address_equal(&dev->system.hwaddr, &pkt->sha))
-		return;
+		return FALSE;
 
 	/* As well as ARP replies that seem to come from our own
 	 * host: dup if same address, not a dup if there are two
@@ -1137,13 +1464,9 @@ ni_dhcp4_fsm_process_arp_packet(ni_arp_socket_t *arph, const ni_arp_packet_t *pk
 			found_addr = TRUE;
 	}
 	if (false_alarm && !found_addr)
-		return;
+		return FALSE;
 
-	ni_debug_dhcp("%s: address %s already in use by %s",
-			dev->ifname, inet_ntoa(pkt->sip),
-			ni_link_address_print(&pkt->sha));
-	ni_dhcp4_device_arp_close(dev);
-	ni_dhcp4_fsm_decline(dev);
+	return TRUE;
 }
 
 /*
@@ -25,6 +25,7 @@
 
 #include <errno.h>
 #include <limits.h>
+#include <stddef.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <stdio.h>
@@ -1802,52 +1803,30 @@ ni_dhcp4_apply_routes(ni_addrconf_lease_t *lease, ni_route_array_t *routes)
 }
 
 /*
- * Parse a DHCP4 response.
+ * Index the options of a DHCP4 response.
+ *
+ * This runs for every received message, so it does not copy or
+ * decode anything but the message type; just enough to filter
+ * and select offers before ni_dhcp4_parse_response decodes them.
  */
-int
-ni_dhcp4_parse_response(const ni_dhcp4_config_t *config, const ni_dhcp4_message_t *message,
-			ni_buffer_t *options, ni_addrconf_lease_t **leasep)
+static int
+ni_dhcp4_option_index_area(ni_dhcp4_option_index_t *index, const unsigned char *data,
+				unsigned int len, ni_bool_t overloaded)
 {
-	ni_buffer_t overload_buf;
-	ni_addrconf_lease_t *lease;
-	ni_route_array_t default_routes = NI_ROUTE_ARRAY_INIT;
-	ni_route_array_t static_routes = NI_ROUTE_ARRAY_INIT;
-	ni_route_array_t classless_routes = NI_ROUTE_ARRAY_INIT;
-	ni_string_array_t dns_servers = NI_STRING_ARRAY_INIT;
-	ni_string_array_t dns_search = NI_STRING_ARRAY_INIT;
-	ni_string_array_t dns_domain = NI_STRING_ARRAY_INIT;
-	ni_string_array_t nis_servers = NI_STRING_ARRAY_INIT;
-	char *nisdomain = NULL;
-	char *tmp = NULL;
-	int opt_overload = 0;
-	int msg_type = -1;
-	int use_bootserver = 1;
-	int use_bootfile = 1;
-	unsigned int pfxlen;
-	ni_dhcp_option_t *opts = NULL, *opt;
-
-	lease = ni_addrconf_lease_new(NI_ADDRCONF_DHCP, AF_INET);
-
-	lease->state = NI_ADDRCONF_STATE_GRANTED;
-	lease->type = NI_ADDRCONF_DHCP;
-	lease->family = AF_INET;
-	ni_timer_get_time(&lease->acquired);
-	lease->fqdn.enabled = NI_TRISTATE_DEFAULT;
-	lease->fqdn.qualify = config->fqdn.qualify;
+	ni_dhcp4_option_ref_t *ref;
+	ni_buffer_t area, buf;
+	int overload = 0;
+	int option;
 
-	lease->dhcp4.address.s_addr = message->yiaddr;
-	lease->dhcp4.boot_saddr.s_addr = message->siaddr;
-	lease->dhcp4.relay_addr.s_addr = message->giaddr;
-
-parse_more:
-	/* Loop as long as we still have data in the buffer. */
-	while (ni_buffer_count(options) && !options->underflow) {
-		ni_buffer_t buf;
-		int option;
-
-		option = ni_dhcp4_option_next(options, &buf);
+	if (index->nareas >= NI_DHCP4_OPTION_AREAS)
+		return -1;
+	index->areas[index->nareas].data = data;
+	index->areas[index->nareas].len = len;
+	index->nareas++;
 
-		//ni_debug_dhcp("handle option %s (%d)", ni_dhcp4_option_name(option), option);
+	ni_buffer_init_reader(&area, (void *) data, len);
+	while (ni_buffer_count(&area) && !area.underflow) {
+		option = ni_dhcp4_option_next(&area, &buf);
 		if (option == DHCP4_END || option < 0)
 			break;
 
@@ -1857,17 +1836,17 @@ parse_more:
 
 		case DHCP4_MESSAGETYPE:
 			option = ni_buffer_getc(&buf);
-			if (option == EOF || msg_type != -1)
-				goto error;
-			msg_type = option;
+			if (option == EOF || index->msg_type != -1)
+				return -1;
+			index->msg_type = option;
 			continue;
 
 		case DHCP4_OPTIONSOVERLOADED:
-			if (options != &overload_buf) {
-				opt_overload = ni_buffer_getc(&buf);
-				if (opt_overload == EOF) {
+			if (!overloaded) {
+				overload = ni_buffer_getc(&buf);
+				if (overload == EOF) {
 					ni_debug_dhcp("DHCP4: ignoring invalid OVERLOAD option");
-					opt_overload = 0;
+					overload = 0;
 				}
 			} else if (ni_buffer_getc(&buf) == EOF) {
 				ni_debug_dhcp("DHCP4: ignoring invalid OVERLOAD option in overloaded data");
@@ -1885,224 +1864,439 @@ parse_more:
 			continue;
 		}
 
-		if ((opt = ni_dhcp_option_list_find(opts, option))) {
-			if (ni_dhcp_option_append(opt, ni_buffer_count(&buf), ni_buffer_head(&buf)))
-				ni_buffer_pull_head(&buf, ni_buffer_count(&buf));
-		} else
-		if ((opt = ni_dhcp_option_new(option, ni_buffer_count(&buf), ni_buffer_head(&buf)))) {
-			if (ni_dhcp_option_list_append(&opts, opt))
-				ni_buffer_pull_head(&buf, ni_buffer_count(&buf));
-			else
-				ni_dhcp_option_free(opt);
-		} else {
-			ni_debug_dhcp("unable to allocate DHCP4 option %s", ni_dhcp4_option_name(option));
-			continue;
+		/* RFC 3396: multiple occurrences are concatenated */
+		ref = &index->opts[option];
+		if (ref->parts++ == 0) {
+			ref->data = ni_buffer_head(&buf);
+			index->order[index->count++] = option;
 		}
+		ref->len += ni_buffer_count(&buf);
+	}
 
-		if (buf.underflow) {
-			ni_debug_dhcp("unable to parse DHCP4 option %s: too short",
-					ni_dhcp4_option_name(option));
-		} else if (ni_buffer_count(&buf)) {
-			ni_debug_dhcp("excess data in DHCP4 option %s - %u bytes left",
-					ni_dhcp4_option_name(option),
-					ni_buffer_count(&buf));
+	if (area.underflow) {
+		ni_debug_dhcp("unable to parse DHCP4 response: truncated packet");
+		return -1;
+	}
+	return overload;
+}
+
+int
+ni_dhcp4_option_index_build(ni_dhcp4_option_index_t *index, const ni_dhcp4_message_t *message,
+				ni_buffer_t *options)
+{
+	int overload;
+
+	memset(index, 0, sizeof(*index));
+	index->msg_type = -1;
+	index->use_bootfile = 1;
+	index->use_bootserver = 1;
+
+	overload = ni_dhcp4_option_index_area(index, ni_buffer_head(options),
+					ni_buffer_count(options), FALSE);
+	if (overload < 0)
+		return -1;
+
+	if (overload & DHCP4_OVERLOAD_BOOTFILE) {
+		index->use_bootfile = 0;
+		if (ni_dhcp4_option_index_area(index, message->bootfile,
+					sizeof(message->bootfile), TRUE) < 0)
+			return -1;
+	}
+	if (overload & DHCP4_OVERLOAD_SERVERNAME) {
+		index->use_bootserver = 0;
+		if (ni_dhcp4_option_index_area(index, message->servername,
+					sizeof(message->servername), TRUE) < 0)
+			return -1;
+	}
+
+	return index->msg_type;
+}
+
+/*
+ * Copy the (concatenated) option data into a buffer of ref->len bytes
+ */
+static unsigned int
+ni_dhcp4_option_index_copy(const ni_dhcp4_option_index_t *index, unsigned int code,
+				unsigned char *data)
+{
+	const ni_dhcp4_option_ref_t *ref = &index->opts[code];
+	unsigned int i, len = 0, count;
+	ni_buffer_t area, buf;
+	int option;
+
+	if (ref->parts == 1) {
+		memcpy(data, ref->data, ref->len);
+		return ref->len;
+	}
+
+	for (i = 0; i < index->nareas; ++i) {
+		ni_buffer_init_reader(&area, (void *) index->areas[i].data,
+						index->areas[i].len);
+		while (ni_buffer_count(&area)) {
+			option = ni_dhcp4_option_next(&area, &buf);
+			if (option == DHCP4_END || option < 0)
+				break;
+			if (option != (int) code)
+				continue;
+
+			count = ni_buffer_count(&buf);
+			if (len + count > ref->len)
+				return len;
+			memcpy(data + len, ni_buffer_head(&buf), count);
+			len += count;
 		}
 	}
+	return len;
+}
 
-	if (options->underflow) {
-		ni_debug_dhcp("unable to parse DHCP4 response: truncated packet");
-		goto error;
+ni_bool_t
+ni_dhcp4_option_index_get_ipv4(const ni_dhcp4_option_index_t *index, unsigned int code,
+				struct in_addr *addr)
+{
+	if (code > 255 || index->opts[code].len != sizeof(*addr))
+		return FALSE;
+
+	return ni_dhcp4_option_index_copy(index, code, (unsigned char *) addr) == sizeof(*addr);
+}
+
+ni_bool_t
+ni_dhcp4_option_index_get_opaque(const ni_dhcp4_option_index_t *index, unsigned int code,
+				ni_opaque_t *opaque)
+{
+	unsigned int len;
+
+	if (code > 255 || !(len = index->opts[code].len) || len > sizeof(opaque->data))
+		return FALSE;
+
+	opaque->len = ni_dhcp4_option_index_copy(index, code, opaque->data);
+	return opaque->len == len;
+}
+
+/*
+ * Option decoders, dispatched by code from ni_dhcp4_option_decoders.
+ */
+typedef struct ni_dhcp4_response		ni_dhcp4_response_t;
+typedef struct ni_dhcp4_option_decoder	ni_dhcp4_option_decoder_t;
+
+struct ni_dhcp4_response {
+	ni_addrconf_lease_t *	lease;
+
+	ni_route_array_t	default_routes;
+	ni_route_array_t	static_routes;
+	ni_route_array_t	classless_routes;
+	ni_string_array_t	dns_servers;
+	ni_string_array_t	dns_search;
+	ni_string_array_t	dns_domain;
+	ni_string_array_t	nis_servers;
+	char *			nisdomain;
+};
+
+struct ni_dhcp4_option_decoder {
+	int			(*decode)(ni_dhcp4_response_t *, ni_buffer_t *,
+					const ni_dhcp4_option_decoder_t *);
+	size_t			offset;		/* of the lease member */
+	const char *		what;
+};
+
+#define NI_DHCP4_LEASE_MEMBER(member)	offsetof(ni_addrconf_lease_t, member)
+
+static inline void *
+ni_dhcp4_decoder_member(const ni_dhcp4_response_t *resp, const ni_dhcp4_option_decoder_t *dec)
+{
+	return (char *) resp->lease + dec->offset;
+}
+
+static int
+ni_dhcp4_decode_lease_ipv4(ni_dhcp4_response_t *resp, ni_buffer_t *bp,
+				const ni_dhcp4_option_decoder_t *dec)
+{
+	return ni_dhcp4_option_get_ipv4(bp, ni_dhcp4_decoder_member(resp, dec));
+}
+
+static int
+ni_dhcp4_decode_lease_uint32(ni_dhcp4_response_t *resp, ni_buffer_t *bp,
+				const ni_dhcp4_option_decoder_t *dec)
+{
+	return ni_dhcp4_option_get32(bp, ni_dhcp4_decoder_member(resp, dec));
+}
+
+static int
+ni_dhcp4_decode_lease_opaque(ni_dhcp4_response_t *resp, ni_buffer_t *bp,
+				const ni_dhcp4_option_decoder_t *dec)
+{
+	return ni_dhcp4_option_get_opaque(bp, ni_dhcp4_decoder_member(resp, dec));
+}
+
+static int
+ni_dhcp4_decode_lease_domain(ni_dhcp4_response_t *resp, ni_buffer_t *bp,
+				const ni_dhcp4_option_decoder_t *dec)
+{
+	return ni_dhcp4_option_get_domain(bp, ni_dhcp4_decoder_member(resp, dec), dec->what);
+}
+
+static int
+ni_dhcp4_decode_lease_pathname(ni_dhcp4_response_t *resp, ni_buffer_t *bp,
+				const ni_dhcp4_option_decoder_t *dec)
+{
+	return ni_dhcp4_option_get_pathname(bp, ni_dhcp4_decoder_member(resp, dec), dec->what);
+}
+
+static int
+ni_dhcp4_decode_lease_printable(ni_dhcp4_response_t *resp, ni_buffer_t *bp,
+				const ni_dhcp4_option_decoder_t *dec)
+{
+	return ni_dhcp4_option_get_printable(bp, ni_dhcp4_decoder_member(resp, dec), dec->what);
+}
+
+static int
+ni_dhcp4_decode_lease_address_list(ni_dhcp4_response_t *resp, ni_buffer_t *bp,
+				const ni_dhcp4_option_decoder_t *dec)
+{
+	return ni_dhcp4_decode_address_list(bp, ni_dhcp4_decoder_member(resp, dec));
+}
+
+static int
+ni_dhcp4_decode_lease_sipservers(ni_dhcp4_response_t *resp, ni_buffer_t *bp,
+				const ni_dhcp4_option_decoder_t *dec)
+{
+	return ni_dhcp4_decode_sipservers(bp, ni_dhcp4_decoder_member(resp, dec));
+}
+
+static int
+ni_dhcp4_decode_lease_netbios_type(ni_dhcp4_response_t *resp, ni_buffer_t *bp,
+				const ni_dhcp4_option_decoder_t *dec)
+{
+	return ni_dhcp4_option_get_netbios_type(bp, ni_dhcp4_decoder_member(resp, dec));
+}
+
+static int
+ni_dhcp4_decode_mtu(ni_dhcp4_response_t *resp, ni_buffer_t *bp,
+				const ni_dhcp4_option_decoder_t *dec)
+{
+	ni_addrconf_lease_t *lease = resp->lease;
+
+	if (ni_dhcp4_option_get16(bp, &lease->dhcp4.mtu) < 0)
+		return -1;
+
+	/* Minimum legal mtu is 68 accoridng to
+	 * RFC 2132. In practise it's 576 which is the
+	 * minimum maximum message size. */
+	if (lease->dhcp4.mtu <= MTU_MIN) {
+		ni_debug_dhcp("MTU %u is too low, minimum is %d; ignoring",
+				lease->dhcp4.mtu, MTU_MIN);
+		lease->dhcp4.mtu = 0;
+	}
+	return 0;
+}
+
+static int
+ni_dhcp4_decode_fqdn(ni_dhcp4_response_t *resp, ni_buffer_t *bp,
+				const ni_dhcp4_option_decoder_t *dec)
+{
+	return ni_dhcp4_option_get_fqdn(bp, &resp->lease->hostname, &resp->lease->fqdn);
+}
+
+static int
+ni_dhcp4_decode_hostname(ni_dhcp4_response_t *resp, ni_buffer_t *bp,
+				const ni_dhcp4_option_decoder_t *dec)
+{
+	if (resp->lease->fqdn.enabled == NI_TRISTATE_ENABLE) {
+		ni_buffer_clear(bp);
+		return 0;
 	}
+	return ni_dhcp4_option_get_domain(bp, &resp->lease->hostname, dec->what);
+}
 
-	while ((opt = ni_dhcp_option_list_pull(&opts))) {
-		ni_buffer_t buf;
-		int option = opt->code;
+static int
+ni_dhcp4_decode_dns_domain(ni_dhcp4_response_t *resp, ni_buffer_t *bp,
+				const ni_dhcp4_option_decoder_t *dec)
+{
+	return ni_dhcp4_option_get_domain_list(bp, &resp->dns_domain, dec->what);
+}
 
-		ni_buffer_init_reader(&buf, opt->data, opt->len);
-		switch (option) {
-		case DHCP4_ADDRESS:
-			ni_dhcp4_option_get_ipv4(&buf, &lease->dhcp4.address);
-			break;
-		case DHCP4_NETMASK:
-			ni_dhcp4_option_get_ipv4(&buf, &lease->dhcp4.netmask);
-			break;
-		case DHCP4_BROADCAST:
-			ni_dhcp4_option_get_ipv4(&buf, &lease->dhcp4.broadcast);
-			break;
-		case DHCP4_SERVERIDENTIFIER:
-			ni_dhcp4_option_get_ipv4(&buf, &lease->dhcp4.server_id);
-			break;
-		case DHCP4_CLIENTID:
-			ni_dhcp4_option_get_opaque(&buf, &lease->dhcp4.client_id);
-			break;
-		case DHCP4_LEASETIME:
-			ni_dhcp4_option_get32(&buf, &lease->dhcp4.lease_time);
-			break;
-		case DHCP4_RENEWALTIME:
-			ni_dhcp4_option_get32(&buf, &lease->dhcp4.renewal_time);
-			break;
-		case DHCP4_REBINDTIME:
-			ni_dhcp4_option_get32(&buf, &lease->dhcp4.rebind_time);
-			break;
-		case DHCP4_MTU:
-			ni_dhcp4_option_get16(&buf, &lease->dhcp4.mtu);
-			/* Minimum legal mtu is 68 accoridng to
-			 * RFC 2132. In practise it's 576 which is the
-			 * minimum maximum message size. */
-			if (lease->dhcp4.mtu <= MTU_MIN) {
-				ni_debug_dhcp("MTU %u is too low, minimum is %d; ignoring",
-						lease->dhcp4.mtu, MTU_MIN);
-				lease->dhcp4.mtu = 0;
-			}
-			break;
-		case DHCP4_FQDN:
-			ni_dhcp4_option_get_fqdn(&buf, &lease->hostname, &lease->fqdn);
-			break;
-		case DHCP4_HOSTNAME:
-			if (lease->fqdn.enabled != NI_TRISTATE_ENABLE) {
-				ni_dhcp4_option_get_domain(&buf, &lease->hostname,
-								"hostname");
-			}
-			break;
-		case DHCP4_DNSDOMAIN:
-			ni_dhcp4_option_get_domain_list(&buf, &dns_domain,
-							"dns-domain");
-			break;
-		case DHCP4_MESSAGE:
-			ni_dhcp4_option_get_printable(&buf, &lease->dhcp4.message,
-							"dhcp4-message");
-			break;
-		case DHCP4_ROOTPATH:
-			ni_dhcp4_option_get_pathname(&buf, &lease->dhcp4.root_path,
-							"root-path");
-			break;
-		case DHCP4_NISDOMAIN:
-			ni_dhcp4_option_get_domain(&buf, &nisdomain,
-							"nis-domain");
-			break;
-		case DHCP4_NETBIOSNODETYPE:
-			ni_dhcp4_option_get_netbios_type(&buf, &lease->netbios_type);
-			break;
-		case DHCP4_NETBIOSSCOPE:
-			ni_dhcp4_option_get_domain(&buf, &lease->netbios_scope,
-							"netbios-scope");
-			break;
-		case DHCP4_DNSSERVER:
-			ni_dhcp4_decode_address_list(&buf, &dns_servers);
-			break;
-		case DHCP4_NTPSERVER:
-			ni_dhcp4_decode_address_list(&buf, &lease->ntp_servers);
-			break;
-		case DHCP4_NISSERVER:
-			ni_dhcp4_decode_address_list(&buf, &nis_servers);
-			break;
-		case DHCP4_LPRSERVER:
-			ni_dhcp4_decode_address_list(&buf, &lease->lpr_servers);
-			break;
-		case DHCP4_LOGSERVER:
-			ni_dhcp4_decode_address_list(&buf, &lease->log_servers);
-			break;
-		case DHCP4_NETBIOSNAMESERVER:
-			ni_dhcp4_decode_address_list(&buf, &lease->netbios_name_servers);
-			break;
-		case DHCP4_NETBIOSDDSERVER:
-			ni_dhcp4_decode_address_list(&buf, &lease->netbios_dd_servers);
-			break;
-		case DHCP4_DNSSEARCH:
-			ni_dhcp4_decode_dnssearch(&buf, &dns_search, "dns-search domain");
-			break;
+static int
+ni_dhcp4_decode_dns_search(ni_dhcp4_response_t *resp, ni_buffer_t *bp,
+				const ni_dhcp4_option_decoder_t *dec)
+{
+	return ni_dhcp4_decode_dnssearch(bp, &resp->dns_search, dec->what);
+}
 
-		case DHCP4_NDS_SERVER:
-			ni_dhcp4_decode_address_list(&buf, &lease->nds_servers);
-			break;
-		case DHCP4_NDS_CTX:
-			if (!ni_dhcp4_option_get_printable(&buf, &tmp, "nds-context"))
-				ni_string_array_append(&lease->nds_context, tmp);
-			ni_string_free(&tmp);
-			break;
-		case DHCP4_NDS_TREE:
-			ni_dhcp4_option_get_printable(&buf, &lease->nds_tree,
-							"nds-tree");
-			break;
+static int
+ni_dhcp4_decode_dns_servers(ni_dhcp4_response_t *resp, ni_buffer_t *bp,
+				const ni_dhcp4_option_decoder_t *dec)
+{
+	return ni_dhcp4_decode_address_list(bp, &resp->dns_servers);
+}
 
-		case DHCP4_CSR:
-		case DHCP4_MSCSR:
-			ni_route_array_destroy(&classless_routes);
-			ni_dhcp4_decode_csr(&buf, &classless_routes);
-			break;
+static int
+ni_dhcp4_decode_nis_domain(ni_dhcp4_response_t *resp, ni_buffer_t *bp,
+				const ni_dhcp4_option_decoder_t *dec)
+{
+	return ni_dhcp4_option_get_domain(bp, &resp->nisdomain, dec->what);
+}
 
-		case DHCP4_SIPSERVER:
-			ni_dhcp4_decode_sipservers(&buf, &lease->sip_servers);
-			break;
+static int
+ni_dhcp4_decode_nis_servers(ni_dhcp4_response_t *resp, ni_buffer_t *bp,
+				const ni_dhcp4_option_decoder_t *dec)
+{
+	return ni_dhcp4_decode_address_list(bp, &resp->nis_servers);
+}
 
-		case DHCP4_STATICROUTE:
-			ni_route_array_destroy(&static_routes);
-			ni_dhcp4_decode_static_routes(&buf, &static_routes);
-			break;
+static int
+ni_dhcp4_decode_nds_context(ni_dhcp4_response_t *resp, ni_buffer_t *bp,
+				const ni_dhcp4_option_decoder_t *dec)
+{
+	char *tmp = NULL;
+	int ret;
 
-		case DHCP4_ROUTERS:
-			ni_route_array_destroy(&default_routes);
-			ni_dhcp4_decode_routers(&buf, &default_routes);
-			break;
+	if (!(ret = ni_dhcp4_option_get_printable(bp, &tmp, dec->what)))
+		ni_string_array_append(&resp->lease->nds_context, tmp);
+	ni_string_free(&tmp);
+	return ret;
+}
 
-		case DHCP4_POSIX_TZ_STRING:
-			ni_dhcp4_option_get_printable(&buf, &lease->posix_tz_string,
-							"posix-tz-string");
-			break;
+static int
+ni_dhcp4_decode_classless_routes(ni_dhcp4_response_t *resp, ni_buffer_t *bp,
+				const ni_dhcp4_option_decoder_t *dec)
+{
+	ni_route_array_destroy(&resp->classless_routes);
+	return ni_dhcp4_decode_csr(bp, &resp->classless_routes);
+}
 
-		case DHCP4_POSIX_TZ_DBNAME:
-			ni_dhcp4_option_get_printable(&buf, &lease->posix_tz_dbname,
-							"posix-tz-dbname");
-			break;
+static int
+ni_dhcp4_decode_static_route_list(ni_dhcp4_response_t *resp, ni_buffer_t *bp,
+				const ni_dhcp4_option_decoder_t *dec)
+{
+	ni_route_array_destroy(&resp->static_routes);
+	return ni_dhcp4_decode_static_routes(bp, &resp->static_routes);
+}
 
-		default:
-			ni_debug_dhcp("adding unparsed DHCP4 option %s code %u len %u",
-					ni_dhcp4_option_name(option), option, opt->len);
+static int
+ni_dhcp4_decode_default_routes(ni_dhcp4_response_t *resp, ni_buffer_t *bp,
+				const ni_dhcp4_option_decoder_t *dec)
+{
+	ni_route_array_destroy(&resp->default_routes);
+	return ni_dhcp4_decode_routers(bp, &resp->default_routes);
+}
 
-			if (ni_dhcp_option_list_append(&lease->dhcp4.options, opt)) {
-				ni_buffer_clear(&buf);
-				opt = NULL;
-			}
-			break;
-		}
+/*
+ * Options without a decoder are kept as raw data in the lease.
+ */
+static const ni_dhcp4_option_decoder_t	ni_dhcp4_option_decoders[256] = {
+ [DHCP4_ADDRESS]		= { ni_dhcp4_decode_lease_ipv4,		NI_DHCP4_LEASE_MEMBER(dhcp4.address)		},
+ [DHCP4_NETMASK]		= { ni_dhcp4_decode_lease_ipv4,		NI_DHCP4_LEASE_MEMBER(dhcp4.netmask)		},
+ [DHCP4_BROADCAST]		= { ni_dhcp4_decode_lease_ipv4,		NI_DHCP4_LEASE_MEMBER(dhcp4.broadcast)		},
+ [DHCP4_SERVERIDENTIFIER]	= { ni_dhcp4_decode_lease_ipv4,		NI_DHCP4_LEASE_MEMBER(dhcp4.server_id)		},
+ [DHCP4_CLIENTID]		= { ni_dhcp4_decode_lease_opaque,	NI_DHCP4_LEASE_MEMBER(dhcp4.client_id)		},
+ [DHCP4_LEASETIME]		= { ni_dhcp4_decode_lease_uint32,	NI_DHCP4_LEASE_MEMBER(dhcp4.lease_time)		},
+ [DHCP4_RENEWALTIME]		= { ni_dhcp4_decode_lease_uint32,	NI_DHCP4_LEASE_MEMBER(dhcp4.renewal_time)	},
+ [DHCP4_REBINDTIME]		= { ni_dhcp4_decode_lease_uint32,	NI_DHCP4_LEASE_MEMBER(dhcp4.rebind_time)	},
+ [DHCP4_MTU]			= { ni_dhcp4_decode_mtu									},
+ [DHCP4_FQDN]			= { ni_dhcp4_decode_fqdn								},
+ [DHCP4_HOSTNAME]		= { ni_dhcp4_decode_hostname,		0, "hostname"					},
+ [DHCP4_DNSDOMAIN]		= { ni_dhcp4_decode_dns_domain,		0, "dns-domain"					},
+ [DHCP4_MESSAGE]		= { ni_dhcp4_decode_lease_printable,	NI_DHCP4_LEASE_MEMBER(dhcp4.message),	"dhcp4-message"	},
+ [DHCP4_ROOTPATH]		= { ni_dhcp4_decode_lease_pathname,	NI_DHCP4_LEASE_MEMBER(dhcp4.root_path),	"root-path"	},
+ [DHCP4_NISDOMAIN]		= { ni_dhcp4_decode_nis_domain,		0, "nis-domain"					},
+ [DHCP4_NETBIOSNODETYPE]	= { ni_dhcp4_decode_lease_netbios_type,	NI_DHCP4_LEASE_MEMBER(netbios_type)		},
+ [DHCP4_NETBIOSSCOPE]		= { ni_dhcp4_decode_lease_domain,	NI_DHCP4_LEASE_MEMBER(netbios_scope),	"netbios-scope"	},
+ [DHCP4_DNSSERVER]		= { ni_dhcp4_decode_dns_servers								},
+ [DHCP4_NTPSERVER]		= { ni_dhcp4_decode_lease_address_list,	NI_DHCP4_LEASE_MEMBER(ntp_servers)		},
+ [DHCP4_NISSERVER]		= { ni_dhcp4_decode_nis_servers								},
+ [DHCP4_LPRSERVER]		= { ni_dhcp4_decode_lease_address_list,	NI_DHCP4_LEASE_MEMBER(lpr_servers)		},
+ [DHCP4_LOGSERVER]		= { ni_dhcp4_decode_lease_address_list,	NI_DHCP4_LEASE_MEMBER(log_servers)		},
+ [DHCP4_NETBIOSNAMESERVER]	= { ni_dhcp4_decode_lease_address_list,	NI_DHCP4_LEASE_MEMBER(netbios_name_servers)	},
+ [DHCP4_NETBIOSDDSERVER]	= { ni_dhcp4_decode_lease_address_list,	NI_DHCP4_LEASE_MEMBER(netbios_dd_servers)	},
+ [DHCP4_DNSSEARCH]		= { ni_dhcp4_decode_dns_search,		0, "dns-search domain"				},
+ [DHCP4_NDS_SERVER]		= { ni_dhcp4_decode_lease_address_list,	NI_DHCP4_LEASE_MEMBER(nds_servers)		},
+ [DHCP4_NDS_CTX]		= { ni_dhcp4_decode_nds_context,	0, "nds-context"				},
+ [DHCP4_NDS_TREE]		= { ni_dhcp4_decode_lease_printable,	NI_DHCP4_LEASE_MEMBER(nds_tree),	"nds-tree"	},
+ [DHCP4_CSR]			= { ni_dhcp4_decode_classless_routes							},
+ [DHCP4_MSCSR]			= { ni_dhcp4_decode_classless_routes							},
+ [DHCP4_SIPSERVER]		= { ni_dhcp4_decode_lease_sipservers,	NI_DHCP4_LEASE_MEMBER(sip_servers)		},
+ [DHCP4_STATICROUTE]		= { ni_dhcp4_decode_static_route_list							},
+ [DHCP4_ROUTERS]		= { ni_dhcp4_decode_default_routes							},
+ [DHCP4_POSIX_TZ_STRING]	= { ni_dhcp4_decode_lease_printable,	NI_DHCP4_LEASE_MEMBER(posix_tz_string),	"posix-tz-string"	},
+ [DHCP4_POSIX_TZ_DBNAME]	= { ni_dhcp4_decode_lease_printable,	NI_DHCP4_LEASE_MEMBER(posix_tz_dbname),	"posix-tz-dbname"	},
+};
 
-		ni_dhcp_option_free(opt);
-		if (buf.underflow) {
-			ni_debug_dhcp("unable to parse DHCP4 option %s (%u): too short",
-					ni_dhcp4_option_name(option), option);
-		} else if (ni_buffer_count(&buf)) {
-			ni_debug_dhcp("excess data in DHCP4 option %s (%u): %u data bytes left",
-					ni_dhcp4_option_name(option), option,
-					ni_buffer_count(&buf));
+static void
+ni_dhcp4_decode_option(ni_dhcp4_response_t *resp, const ni_dhcp4_option_index_t *index,
+				unsigned int option)
+{
+	const ni_dhcp4_option_ref_t *ref = &index->opts[option];
+	const ni_dhcp4_option_decoder_t *dec = &ni_dhcp4_option_decoders[option];
+	unsigned char *data = NULL;
+	ni_dhcp_option_t *opt;
+	ni_buffer_t buf;
+
+	if (ref->parts == 1) {
+		ni_buffer_init_reader(&buf, (void *) ref->data, ref->len);
+	} else {
+		if (!(data = malloc(ref->len))) {
+			ni_debug_dhcp("unable to allocate DHCP4 option %s",
+					ni_dhcp4_option_name(option));
+			return;
 		}
+		ni_buffer_init_reader(&buf, data, ni_dhcp4_option_index_copy(index, option, data));
 	}
 
-	if (opt_overload) {
-		const void *more_data = NULL;
-		size_t size = 0;
+	if (dec->decode) {
+		dec->decode(resp, &buf, dec);
+	} else {
+		ni_debug_dhcp("adding unparsed DHCP4 option %s code %u len %u",
+				ni_dhcp4_option_name(option), option, ni_buffer_count(&buf));
 
-		if (opt_overload & DHCP4_OVERLOAD_BOOTFILE) {
-			use_bootfile = 0;
-			more_data = message->bootfile;
-			size = sizeof(message->bootfile);
-			opt_overload &= ~DHCP4_OVERLOAD_BOOTFILE;
-		} else
-		if (opt_overload & DHCP4_OVERLOAD_SERVERNAME) {
-			use_bootserver = 0;
-			more_data = message->servername;
-			size = sizeof(message->servername);
-			opt_overload &= ~DHCP4_OVERLOAD_SERVERNAME;
-		} else {
-			opt_overload = 0;
-		}
-		if (more_data) {
-			ni_buffer_init_reader(&overload_buf, (void *) more_data, size);
-			options = &overload_buf;
-			goto parse_more;
-		}
+		opt = ni_dhcp_option_new(option, ni_buffer_count(&buf), ni_buffer_head(&buf));
+		if (opt && ni_dhcp_option_list_append(&resp->lease->dhcp4.options, opt))
+			ni_buffer_clear(&buf);
+		else
+			ni_dhcp_option_free(opt);
+	}
+
+	if (buf.underflow) {
+		ni_debug_dhcp("unable to parse DHCP4 option %s (%u): too short",
+				ni_dhcp4_option_name(option), option);
+	} else if (ni_buffer_count(&buf)) {
+		ni_debug_dhcp("excess data in DHCP4 option %s (%u): %u data bytes left",
+				ni_dhcp4_option_name(option), option,
+				ni_buffer_count(&buf));
 	}
+	free(data);
+}
+
+/*
+ * Parse a DHCP4 response.
+ */
+int
+ni_dhcp4_parse_response(const ni_dhcp4_config_t *config, const ni_dhcp4_message_t *message,
+			const ni_dhcp4_option_index_t *index, ni_addrconf_lease_t **leasep)
+{
+	ni_dhcp4_response_t resp;
+	ni_addrconf_lease_t *lease;
+	unsigned int pfxlen, i;
+
+	if (!index || index->msg_type < 0)
+		return -1;
 
-	if (use_bootserver && message->servername[0]) {
+	memset(&resp, 0, sizeof(resp));
+	resp.lease = lease = ni_addrconf_lease_new(NI_ADDRCONF_DHCP, AF_INET);
+
+	lease->state = NI_ADDRCONF_STATE_GRANTED;
+	lease->type = NI_ADDRCONF_DHCP;
+	lease->family = AF_INET;
+	ni_timer_get_time(&lease->acquired);
+	lease->fqdn.enabled = NI_TRISTATE_DEFAULT;
+	lease->fqdn.qualify = config->fqdn.qualify;
+
+	lease->dhcp4.address.s_addr = message->yiaddr;
+	lease->dhcp4.boot_saddr.s_addr = message->siaddr;
+	lease->dhcp4.relay_addr.s_addr = message->giaddr;
+
+	for (i = 0; i < index->count; ++i)
+		ni_dhcp4_decode_option(&resp, index, index->order[i]);
+
+	if (index->use_bootserver && message->servername[0]) {
 		char tmp[sizeof(message->servername)];
 		size_t len;
 
@@ -2117,7 +2311,7 @@ parse_more:
 				ni_print_suspect(tmp, len));
 		}
 	}
-	if (use_bootfile && message->bootfile[0]) {
+	if (index->use_bootfile && message->bootfile[0]) {
 		char tmp[sizeof(message->bootfile)];
 		size_t len;
 
@@ -2159,65 +2353,53 @@ parse_more:
 			ni_sockaddr_set_ipv4(&ap->bcast_addr, lease->dhcp4.broadcast, 0);
 	}
 
-	if (classless_routes.count) {
+	if (resp.classless_routes.count) {
 		/* if CSR or MSCSR are available, ignore other routes */
-		ni_dhcp4_apply_routes(lease, &classless_routes);
-		ni_route_array_destroy(&classless_routes);
+		ni_dhcp4_apply_routes(lease, &resp.classless_routes);
 	} else {
-		ni_dhcp4_apply_routes(lease, &static_routes);
-		ni_route_array_destroy(&static_routes);
-		ni_dhcp4_apply_routes(lease, &default_routes);
-		ni_route_array_destroy(&default_routes);
+		ni_dhcp4_apply_routes(lease, &resp.static_routes);
+		ni_dhcp4_apply_routes(lease, &resp.default_routes);
 	}
 
-	if (dns_servers.count || dns_search.count || dns_domain.count) {
+	if (resp.dns_servers.count || resp.dns_search.count || resp.dns_domain.count) {
 		ni_resolver_info_t *resolver = ni_resolver_info_new();
 
-		if (dns_domain.count)
-			ni_string_dup(&resolver->default_domain, dns_domain.data[0]);
+		if (resp.dns_domain.count)
+			ni_string_dup(&resolver->default_domain, resp.dns_domain.data[0]);
 
-		if (dns_search.count)
-			ni_string_array_move(&resolver->dns_search, &dns_search);
+		if (resp.dns_search.count)
+			ni_string_array_move(&resolver->dns_search, &resp.dns_search);
 		else
-			ni_string_array_move(&resolver->dns_search, &dns_domain);
+			ni_string_array_move(&resolver->dns_search, &resp.dns_domain);
 
-		ni_string_array_move(&resolver->dns_servers, &dns_servers);
+		ni_string_array_move(&resolver->dns_servers, &resp.dns_servers);
 		lease->resolver = resolver;
 	}
-	if (nisdomain != NULL) {
+	if (resp.nisdomain != NULL) {
 		ni_nis_info_t *nis = ni_nis_info_new();
 
-		nis->domainname = nisdomain;
-		nisdomain = NULL;
+		nis->domainname = resp.nisdomain;
+		resp.nisdomain = NULL;
 
-		if (nis_servers.count == 0)
+		if (resp.nis_servers.count == 0)
 			nis->default_binding = NI_NISCONF_BROADCAST;
 		else
-			ni_string_array_move(&nis->default_servers, &nis_servers);
+			ni_string_array_move(&nis->default_servers, &resp.nis_servers);
 		lease->nis = nis;
 	}
 
 	*leasep = lease;
-	lease = NULL;
-
-done:
-	ni_route_array_destroy(&default_routes);
-	ni_route_array_destroy(&static_routes);
-	ni_route_array_destroy(&classless_routes);
-	ni_string_array_destroy(&dns_servers);
-	ni_string_array_destroy(&dns_search);
-	ni_string_array_destroy(&dns_domain);
-	ni_string_array_destroy(&nis_servers);
-	ni_string_free(&nisdomain);
-	ni_dhcp_option_list_destroy(&opts);
-
-	return msg_type;
-
-error:
-	if (lease)
-		ni_addrconf_lease_free(lease);
-	msg_type = -1;
-	goto done;
+
+	ni_route_array_destroy(&resp.default_routes);
+	ni_route_array_destroy(&resp.static_routes);
+	ni_route_array_destroy(&resp.classless_routes);
+	ni_string_array_destroy(&resp.dns_servers);
+	ni_string_array_destroy(&resp.dns_search);
+	ni_string_array_destroy(&resp.dns_domain);
+	ni_string_array_destroy(&resp.nis_servers);
+	ni_string_free(&resp.nisdomain);
+
+	return index->msg_type;
 }
 
 /*
@@ -33,6 +33,8 @@
 #include "appconfig.h"
 #include "util_priv.h"
 
+#define NI_IFWORKER_ARRAY_CHUNK		16
+
 static ni_fsm_user_prompt_fn_t *ni_fsm_user_prompt_fn;
 static void *			ni_fsm_user_prompt_data;
 
@@ -63,6 +65,8 @@ static void			ni_ifworker_advance_state(ni_ifworker_t *, ni_event_t);
 static ni_bool_t		ni_ifworker_revert_state(ni_ifworker_t *, ni_event_t);
 static ni_bool_t		ni_ifworker_del_child_master(xml_node_t *);
 static void			ni_fsm_clear_hierarchy(ni_ifworker_t *);
+static void			ni_fsm_refresh_master_dev(ni_fsm_t *, ni_ifworker_t *);
+static void			ni_fsm_refresh_lower_dev(ni_fsm_t *, ni_ifworker_t *);
 
 static void			ni_ifworker_update_client_state_control(ni_ifworker_t *w);
 static inline void		ni_ifworker_update_client_state_config(ni_ifworker_t *w);
@@ -78,6 +82,9 @@ ni_fsm_new(void)
 
 	fsm = calloc(1, sizeof(*fsm));
 	fsm->readonly = FALSE;
+	ni_hashtable_init(&fsm->index.name);
+	ni_hashtable_init(&fsm->index.ifindex);
+	ni_hashtable_init(&fsm->index.object_path);
 
 	ni_fsm_user_prompt_fn = ni_fsm_user_prompt_default;
 	return fsm;
@@ -89,6 +96,9 @@ ni_fsm_free(ni_fsm_t *fsm)
 	ni_fsm_events_destroy(&fsm->events);
 	ni_ifworker_array_destroy(&fsm->pending);
 	ni_ifworker_array_destroy(&fsm->workers);
+	ni_hashtable_destroy(&fsm->index.name);
+	ni_hashtable_destroy(&fsm->index.ifindex);
+	ni_hashtable_destroy(&fsm->index.object_path);
 	free(fsm);
 }
 
@@ -800,10 +810,16 @@ ni_ifworker_array_new(void)
 void
 ni_ifworker_array_append(ni_ifworker_array_t *array, ni_ifworker_t *w)
 {
+	ni_ifworker_t **newdata;
+
 	if (!array || !w)
 		return;
 
-	array->data = realloc(array->data, (array->count + 1) * sizeof(array->data[0]));
+	newdata = ni_array_grow_typed(array, 1, NI_IFWORKER_ARRAY_CHUNK, 0);
+	if (!newdata)
+		return;
+
+	array->data = newdata;
 	array->data[array->count++] = ni_ifworker_get(w);
 }
 
@@ -854,23 +870,6 @@ ni_ifworker_array_find_by_objectpath(ni_ifworker_array_t *array, const char *obj
 	return NULL;
 }
 
-static ni_ifworker_t *
-ni_ifworker_array_find_by_name(const ni_ifworker_array_t *array, ni_ifworker_type_t type, const char *name)
-{
-	unsigned int i;
-
-	if (ni_string_empty(name))
-		return NULL;
-
-	for (i = 0; i < array->count; ++i) {
-		ni_ifworker_t *worker = array->data[i];
-
-		if (worker->type == type && ni_string_eq(worker->name, name))
-			return worker;
-	}
-	return NULL;
-}
-
 ni_ifworker_array_t *
 ni_ifworker_array_clone(ni_ifworker_array_t *array)
 {
@@ -936,10 +935,111 @@ ni_ifworker_array_remove_with_children(ni_ifworker_array_t *array, ni_ifworker_t
 	}
 }
 
+/*
+ * The fsm maintains name, ifindex and object-path hash indexes over
+ * the workers array. Every function modifying one of these members of
+ * a worker in fsm->workers has to call ni_fsm_ifworker_index_update().
+ */
+static void
+ni_fsm_ifworker_index_unlink(ni_fsm_t *fsm, ni_ifworker_t *w)
+{
+	if (!w->index.linked)
+		return;
+
+	ni_hashtable_remove(&fsm->index.name, w->index.name, w);
+	ni_hashtable_remove(&fsm->index.ifindex, w->index.ifindex, w);
+	ni_hashtable_remove(&fsm->index.object_path, w->index.object_path, w);
+	w->index.linked = FALSE;
+}
+
+static void
+ni_fsm_ifworker_index_link(ni_fsm_t *fsm, ni_ifworker_t *w)
+{
+	w->index.name = ni_hash_string(w->name);
+	w->index.ifindex = ni_hash_uint(w->ifindex);
+	w->index.object_path = ni_hash_string(w->object_path);
+
+	if (!ni_string_empty(w->name))
+		ni_hashtable_insert(&fsm->index.name, w->index.name, w);
+	if (w->ifindex)
+		ni_hashtable_insert(&fsm->index.ifindex, w->index.ifindex, w);
+	if (!ni_string_empty(w->object_path))
+		ni_hashtable_insert(&fsm->index.object_path, w->index.object_path, w);
+	w->index.linked = TRUE;
+}
+
+static void
+ni_fsm_ifworker_index_update(ni_fsm_t *fsm, ni_ifworker_t *w)
+{
+	unsigned int name;
+
+	if (!fsm || !w || !w->index.linked)
+		return;
+
+	name = w->index.name;
+	ni_fsm_ifworker_index_unlink(fsm, w);
+	ni_fsm_ifworker_index_link(fsm, w);
+
+	/* references by name may resolve differently now */
+	if (name != w->index.name)
+		w->rebind = TRUE;
+}
+
+static ni_ifworker_t *
+ni_fsm_ifworker_new(ni_fsm_t *fsm, ni_ifworker_type_t type, const char *name)
+{
+	ni_ifworker_t *w;
+
+	if ((w = ni_ifworker_new(&fsm->workers, type, name))) {
+		ni_fsm_ifworker_index_link(fsm, w);
+		w->rebind = TRUE;
+	}
+	return w;
+}
+
+ni_bool_t
+ni_fsm_remove_worker(ni_fsm_t *fsm, ni_ifworker_t *w)
+{
+	int index;
+
+	if (!fsm || !w || (index = ni_ifworker_array_index(&fsm->workers, w)) < 0)
+		return FALSE;
+
+	ni_fsm_ifworker_index_unlink(fsm, w);
+	ni_fsm_clear_hierarchy(w);
+	return ni_ifworker_array_remove_index(&fsm->workers, index);
+}
+
+/*
+ * When the index contains multiple workers with the same key (e.g. a
+ * config-only and a renamed device worker), prefer the one found first
+ * in the workers array as the linear search did.
+ */
+static ni_ifworker_t *
+ni_fsm_ifworker_index_prefer(const ni_fsm_t *fsm, ni_ifworker_t *found, ni_ifworker_t *w)
+{
+	if (!found)
+		return w;
+	if (ni_ifworker_array_index(&fsm->workers, w) < ni_ifworker_array_index(&fsm->workers, found))
+		return w;
+	return found;
+}
+
 ni_ifworker_t *
 ni_fsm_ifworker_by_name(const ni_fsm_t *fsm, ni_ifworker_type_t type, const char *name)
 {
-	return ni_ifworker_array_find_by_name(&fsm->workers, type, name);
+	ni_ifworker_t *w, *found = NULL;
+	ni_hashtable_iter_t iter;
+
+	if (!fsm || ni_string_empty(name))
+		return NULL;
+
+	w = ni_hashtable_lookup(&fsm->index.name, ni_hash_string(name), &iter);
+	for ( ; w; w = ni_hashtable_lookup_next(&iter)) {
+		if (w->type == type && ni_string_eq(w->name, name))
+			found = ni_fsm_ifworker_index_prefer(fsm, found, w);
+	}
+	return found;
 }
 
 ni_ifworker_t *
@@ -970,45 +1070,64 @@ ni_fsm_ifworker_by_policy_name(ni_fsm_t *fsm, ni_ifworker_type_t type, const cha
 ni_ifworker_t *
 ni_fsm_ifworker_by_object_path(ni_fsm_t *fsm, const char *object_path)
 {
-	return ni_ifworker_array_find_by_objectpath(&fsm->workers, object_path);
+	ni_ifworker_t *w, *found = NULL;
+	ni_hashtable_iter_t iter;
+
+	if (!fsm || ni_string_empty(object_path))
+		return NULL;
+
+	w = ni_hashtable_lookup(&fsm->index.object_path, ni_hash_string(object_path), &iter);
+	for ( ; w; w = ni_hashtable_lookup_next(&iter)) {
+		if (ni_string_eq(w->object_path, object_path))
+			found = ni_fsm_ifworker_index_prefer(fsm, found, w);
+	}
+	return found;
 }
 
 ni_ifworker_t *
 ni_fsm_ifworker_by_ifindex(ni_fsm_t *fsm, unsigned int ifindex)
 {
-	unsigned int i;
+	ni_ifworker_t *w, *found = NULL;
+	ni_hashtable_iter_t iter;
 
-	if (0 == ifindex)
+	if (!fsm || 0 == ifindex)
 		return NULL;
 
-	for (i = 0; i < fsm->workers.count; ++i) {
-		ni_ifworker_t *w = fsm->workers.data[i];
-
-		if (w->ifindex && w->ifindex == ifindex)
-			return w;
+	w = ni_hashtable_lookup(&fsm->index.ifindex, ni_hash_uint(ifindex), &iter);
+	for ( ; w; w = ni_hashtable_lookup_next(&iter)) {
+		if (w->ifindex == ifindex)
+			found = ni_fsm_ifworker_index_prefer(fsm, found, w);
 	}
-
-	return NULL;
+	return found;
 }
 
 ni_ifworker_t *
 ni_fsm_ifworker_by_netdev(ni_fsm_t *fsm, const ni_netdev_t *dev)
 {
+	ni_ifworker_t *w, *found = NULL;
+	ni_hashtable_iter_t iter;
 	unsigned int i;
 
-	if (dev == NULL)
+	if (!fsm || dev == NULL)
 		return NULL;
 
-	for (i = 0; i < fsm->workers.count; ++i) {
-		ni_ifworker_t *w = fsm->workers.data[i];
-
-		if (w->device == dev)
-			return w;
-		if (w->ifindex && w->ifindex == dev->link.ifindex)
-			return w;
+	/* A worker referring the netdev has the same ifindex,
+	 * except of netdevs without ifindex we have to search. */
+	if (!dev->link.ifindex) {
+		for (i = 0; i < fsm->workers.count; ++i) {
+			w = fsm->workers.data[i];
+			if (w->device == dev)
+				return w;
+		}
+		return NULL;
 	}
 
-	return NULL;
+	w = ni_hashtable_lookup(&fsm->index.ifindex, ni_hash_uint(dev->link.ifindex), &iter);
+	for ( ; w; w = ni_hashtable_lookup_next(&iter)) {
+		if (w->device == dev || w->ifindex == dev->link.ifindex)
+			found = ni_fsm_ifworker_index_prefer(fsm, found, w);
+	}
+	return found;
 }
 
 static ni_ifworker_t *
@@ -2081,6 +2200,7 @@ ni_ifworker_set_config(ni_ifworker_t *w, xml_node_t *ifnode, const char *config_
 {
 	xml_node_t *child;
 
+	w->rebind = TRUE;
 	xml_node_free(w->config.node);
 	ni_client_state_config_reset(&w->config.meta);
 	if (!(w->config.node = xml_node_clone_ref(ifnode)))
@@ -2144,7 +2264,7 @@ ni_fsm_workers_from_xml(ni_fsm_t *fsm, xml_node_t *ifnode, const char *origin)
 		} else {
 			ifname = node->cdata;
 			if (ifname && (w = ni_fsm_ifworker_by_name(fsm, type, ifname)) == NULL)
-				w = ni_ifworker_new(&fsm->workers, type, ifname);
+				w = ni_fsm_ifworker_new(fsm, type, ifname);
 		}
 	}
 
@@ -3276,11 +3396,25 @@ ni_fsm_reset_matching_workers(ni_fsm_t *fsm, ni_ifworker_array_t *marked,
 	}
 }
 
+/*
+ * Drop all edges of a worker. The workers on the other end of
+ * these edges have to re-resolve their references as well.
+ */
 static void
 ni_fsm_clear_hierarchy(ni_ifworker_t *w)
 {
 	unsigned int i;
 
+	w->rebind = TRUE;
+	if (w->masterdev)
+		w->masterdev->rebind = TRUE;
+	if (w->lowerdev)
+		w->lowerdev->rebind = TRUE;
+	for (i = 0; i < w->lowerdev_for.count; i++)
+		w->lowerdev_for.data[i]->rebind = TRUE;
+	for (i = 0; i < w->children.count; i++)
+		w->children.data[i]->rebind = TRUE;
+
 	if (w->masterdev)
 		ni_ifworker_array_remove(&w->masterdev->children, w);
 
@@ -3313,7 +3447,7 @@ ni_fsm_clear_hierarchy(ni_ifworker_t *w)
 }
 
 static void
-ni_ifworker_device_delete(ni_ifworker_t *w)
+ni_ifworker_device_delete(ni_fsm_t *fsm, ni_ifworker_t *w)
 {
 	ni_ifworker_get(w);
 	ni_debug_application("%s(%s)", __func__, w->name);
@@ -3329,6 +3463,7 @@ ni_ifworker_device_delete(ni_ifworker_t *w)
 	}
 	ni_string_free(&w->object_path);
 	w->object_path = NULL;
+	ni_fsm_ifworker_index_update(fsm, w);
 
 	ni_ifworker_cancel_secondary_timeout(w);
 	ni_ifworker_cancel_timeout(w);
@@ -3353,12 +3488,12 @@ ni_fsm_destroy_worker(ni_fsm_t *fsm, ni_ifworker_t *w)
 	ni_ifworker_get(w);
 
 	ni_debug_application("%s(%s)", __func__, w->name);
-	if (!ni_ifworker_array_remove(&fsm->workers, w)) {
+	if (!ni_fsm_remove_worker(fsm, w)) {
 		ni_ifworker_release(w);
 		return;
 	}
 
-	ni_ifworker_device_delete(w);
+	ni_ifworker_device_delete(fsm, w);
 
 	ni_ifworker_release(w);
 }
@@ -3674,6 +3809,130 @@ ni_fsm_build_hierarchy(ni_fsm_t *fsm, ni_bool_t destructive)
 	}
 
 	ni_ifworkers_break_loops(fsm);
+	for (i = 0; i < fsm->workers.count; ++i)
+		fsm->workers.data[i]->rebind = FALSE;
+	ni_fsm_events_unblock(fsm);
+
+	if (ni_log_facility(NI_TRACE_APPLICATION))
+		ni_fsm_print_hierarchy(fsm);
+	return 0;
+}
+
+static ni_bool_t
+ni_ifworker_has_unresolved_refs(const ni_ifworker_t *w)
+{
+	const ni_fsm_require_t *req;
+
+	for (req = w->fsm.check_state_req_list; req; req = req->next) {
+		if (req->test_fn == ni_ifworker_require_resolver_test)
+			return TRUE;
+	}
+	return FALSE;
+}
+
+static inline void
+ni_ifworker_array_append_unique(ni_ifworker_array_t *array, ni_ifworker_t *w)
+{
+	if (w && ni_ifworker_array_index(array, w) < 0)
+		ni_ifworker_array_append(array, w);
+}
+
+/*
+ * Patch the hierarchy after some workers got added, removed or their
+ * config changed (marked by the rebind flag), instead of rebuilding it
+ * from scratch: only the edges of the changed workers and of their
+ * neighbours are re-resolved, plus references which could not be
+ * resolved so far, and loops are searched starting at these workers
+ * only -- a new loop has to contain at least one of them.
+ */
+int
+ni_fsm_update_hierarchy(ni_fsm_t *fsm, ni_bool_t destructive)
+{
+	ni_ifworker_array_t affected = NI_IFWORKER_ARRAY_INIT;
+	ni_ifworker_array_t guard = NI_IFWORKER_ARRAY_INIT;
+	ni_ifworker_t *w;
+	unsigned int i, j;
+
+	for (i = 0; i < fsm->workers.count; ++i) {
+		w = fsm->workers.data[i];
+
+		if (!w->rebind)
+			continue;
+
+		ni_ifworker_array_append_unique(&affected, w);
+		ni_ifworker_array_append_unique(&affected, w->masterdev);
+		ni_ifworker_array_append_unique(&affected, w->lowerdev);
+		for (j = 0; j < w->lowerdev_for.count; ++j)
+			ni_ifworker_array_append_unique(&affected, w->lowerdev_for.data[j]);
+		for (j = 0; j < w->children.count; ++j)
+			ni_ifworker_array_append_unique(&affected, w->children.data[j]);
+	}
+	if (!affected.count)
+		return 0;
+
+	for (i = 0; i < fsm->workers.count; ++i) {
+		w = fsm->workers.data[i];
+
+		if (w->config.node && ni_ifworker_has_unresolved_refs(w))
+			ni_ifworker_array_append_unique(&affected, w);
+	}
+
+	ni_debug_application("Updating device hierarchy of %u of %u workers",
+			affected.count, fsm->workers.count);
+
+	ni_fsm_events_block(fsm);
+	for (i = 0; i < affected.count; ++i) {
+		w = affected.data[i];
+
+		if (w->rebind)
+			ni_fsm_clear_hierarchy(w);
+	}
+
+	for (i = 0; i < affected.count; ++i) {
+		w = affected.data[i];
+
+		/* edges discovered from the device state */
+		ni_fsm_refresh_master_dev(fsm, w);
+		ni_fsm_refresh_lower_dev(fsm, w);
+	}
+
+	for (i = 0; i < affected.count; ++i) {
+		int rv;
+
+		w = affected.data[i];
+		if (!w->config.node)
+			continue;
+
+		if ((rv = ni_ifworker_bind_early(w, fsm, FALSE)) < 0) {
+			if (destructive) {
+				if (-NI_ERROR_DOCUMENT_ERROR == rv)
+					ni_debug_application("%s: configuration failed", w->name);
+				ni_fsm_destroy_worker(fsm, w);
+				ni_ifworker_array_remove_index(&affected, i--);
+			}
+		}
+	}
+
+	for (i = 0; i < affected.count; ++i) {
+		w = affected.data[i];
+
+		if (w->masterdev) {
+			if (!ni_ifworker_add_child_master(w->config.node, w->masterdev->name))
+				continue;
+			ni_ifworker_generate_uuid(w);
+		}
+	}
+
+	for (i = 0; i < affected.count; ++i) {
+		w = affected.data[i];
+
+		ni_ifworker_break_loops(&guard, w, 0);
+		ni_ifworker_array_destroy(&guard);
+	}
+
+	for (i = 0; i < affected.count; ++i)
+		affected.data[i]->rebind = FALSE;
+	ni_ifworker_array_destroy(&affected);
 	ni_fsm_events_unblock(fsm);
 
 	if (ni_log_facility(NI_TRACE_APPLICATION))
@@ -3955,6 +4214,23 @@ ni_fsm_refresh_state(ni_fsm_t *fsm)
 	return TRUE;
 }
 
+/*
+ * Refresh the netif proxy objects below object; the property groups
+ * the fsm does not look at are not transferred. The Wireless group
+ * is needed for the scan results of wireless essid policy matches.
+ */
+static ni_bool_t
+ni_fsm_refresh_netif_objects(ni_dbus_object_t *object)
+{
+	static ni_string_array_t omit = NI_STRING_ARRAY_INIT;
+
+	if (omit.count == 0) {
+		ni_string_array_append(&omit, NI_OBJECTMODEL_ETHTOOL_INTERFACE);
+		ni_string_array_append(&omit, NI_OBJECTMODEL_LLDP_INTERFACE);
+	}
+	return ni_dbus_object_refresh_children_filtered(object, NULL, &omit);
+}
+
 static ni_bool_t
 __ni_ifworker_refresh_netdevs(ni_fsm_t *fsm)
 {
@@ -3966,8 +4242,8 @@ __ni_ifworker_refresh_netdevs(ni_fsm_t *fsm)
 		return FALSE;
 	}
 
-	/* Call ObjectManager.GetManagedObjects to get list of objects and their properties */
-	if (!ni_dbus_object_refresh_children(list_object)) {
+	/* Call ObjectManager.GetManagedObjectsPaged to get list of objects and their properties */
+	if (!ni_fsm_refresh_netif_objects(list_object)) {
 		ni_error("Couldn't refresh list of active network interfaces");
 		return FALSE;
 	}
@@ -3986,7 +4262,7 @@ ni_fsm_recv_new_netif(ni_fsm_t *fsm, ni_dbus_object_t *object, ni_bool_t refresh
 
 	/* note: dev is a not yet referece counted object->handle */
 	if (dev == NULL || dev->name == NULL || refresh) {
-		if (!ni_dbus_object_refresh_children(object))
+		if (!ni_fsm_refresh_netif_objects(object))
 			return NULL;
 
 		dev = ni_objectmodel_unwrap_netif(object, NULL);
@@ -4005,13 +4281,13 @@ ni_fsm_recv_new_netif(ni_fsm_t *fsm, ni_dbus_object_t *object, ni_bool_t refresh
 			ni_ifworker_array_remove(&fsm->pending, found);
 
 		/* lookup worker by object path (ifindex) first, then by name */
-		found = ni_ifworker_array_find_by_objectpath(&fsm->workers, object->path);
+		found = ni_fsm_ifworker_by_object_path(fsm, object->path);
 		if (!found)
 			found = ni_fsm_ifworker_by_name(fsm, NI_IFWORKER_TYPE_NETDEV, dev->name);
 		if (!found) {
 			ni_debug_application("received new ready device %s (%s)",
 						dev->name, object->path);
-			found = ni_ifworker_new(&fsm->workers, NI_IFWORKER_TYPE_NETDEV, dev->name);
+			found = ni_fsm_ifworker_new(fsm, NI_IFWORKER_TYPE_NETDEV, dev->name);
 			if (found)
 				found->readonly = fsm->readonly;
 		} else {
@@ -4068,6 +4344,7 @@ ni_fsm_recv_new_netif(ni_fsm_t *fsm, ni_dbus_object_t *object, ni_bool_t refresh
 
 	found->ifindex = dev->link.ifindex;
 	found->object = object;
+	ni_fsm_ifworker_index_update(fsm, found);
 
 	return found;
 }
@@ -4139,7 +4416,7 @@ ni_fsm_recv_new_modem(ni_fsm_t *fsm, ni_dbus_object_t *object, ni_bool_t refresh
 		found = ni_fsm_ifworker_by_object_path(fsm, object->path);
 	if (!found) {
 		ni_debug_application("received new modem %s (%s)", modem->device, object->path);
-		found = ni_ifworker_new(&fsm->workers, NI_IFWORKER_TYPE_MODEM, modem->device);
+		found = ni_fsm_ifworker_new(fsm, NI_IFWORKER_TYPE_MODEM, modem->device);
 	}
 
 	if (!found)
@@ -4150,6 +4427,7 @@ ni_fsm_recv_new_modem(ni_fsm_t *fsm, ni_dbus_object_t *object, ni_bool_t refresh
 	if (!found->modem)
 		found->modem = ni_modem_hold(modem);
 	found->object = object;
+	ni_fsm_ifworker_index_update(fsm, found);
 
 	/* Don't touch devices we're done with */
 	if (!found->done)
@@ -4866,6 +5144,7 @@ ni_ifworker_call_device_factory(ni_fsm_t *fsm, ni_ifworker_t *w, ni_fsm_transiti
 		ni_debug_application("created device %s (path=%s)", w->name, object_path);
 		ni_string_free(&w->object_path);
 		w->object_path = object_path;
+		ni_fsm_ifworker_index_update(fsm, w);
 
 		/* Lookup the object corresponding to this path. If it doesn't
 		 * exist, create it on the fly (with a generic class of "netif" -
@@ -4876,7 +5155,7 @@ ni_ifworker_call_device_factory(ni_fsm_t *fsm, ni_ifworker_t *w, ni_fsm_transiti
 					NULL,
 					NULL);
 
-		if (!w->object || !ni_dbus_object_refresh_children(w->object)) {
+		if (!w->object || !ni_fsm_refresh_netif_objects(w->object)) {
 			ni_ifworker_fail(w, "unable to refresh new device");
 			return -1;
 		}
@@ -5458,12 +5737,9 @@ ni_fsm_process_worker_event(ni_fsm_t *fsm, ni_ifworker_t *w, ni_fsm_event_t *ev)
 	switch (event_type) {
 	case NI_EVENT_DEVICE_READY:
 	case NI_EVENT_DEVICE_UP:
-		/* Rebuild hierarchy */
-		ni_fsm_refresh_master_dev(fsm, w);
-		ni_fsm_refresh_lower_dev(fsm, w);
-
-		/* Rebuild hierarchy in case of new device shows up */
-		ni_fsm_build_hierarchy(fsm, FALSE);
+		/* Update hierarchy in case of new device shows up */
+		w->rebind = TRUE;
+		ni_fsm_update_hierarchy(fsm, FALSE);
 
 		/* Handle devices which were not present on ifup */
 		if(w->pending) {
@@ -5553,12 +5829,12 @@ ni_fsm_process_worker_event(ni_fsm_t *fsm, ni_ifworker_t *w, ni_fsm_event_t *ev)
 
 	if (event_type == NI_EVENT_DEVICE_DELETE) {
 		if (ni_config_use_nanny() && ni_ifworker_is_factory_device(w))
-			ni_ifworker_device_delete(w);
+			ni_ifworker_device_delete(fsm, w);
 		else
 			ni_fsm_destroy_worker(fsm, w);
 
-		/* Rebuild hierarchy since one device is gone */
-		ni_fsm_build_hierarchy(fsm, FALSE);
+		/* Update hierarchy since one device is gone */
+		ni_fsm_update_hierarchy(fsm, FALSE);
 	}
 
 done: ;
@@ -5603,6 +5879,7 @@ ni_fsm_process_rename_event(ni_fsm_t *fsm, ni_fsm_event_t *ev)
 	c->object = w->object;
 	c->ifindex = w->ifindex;
 	ni_string_dup(&c->object_path, w->object_path);
+	ni_fsm_ifworker_index_update(fsm, c);
 
 	/* reset moved device on renamed worker */
 	ni_netdev_put(w->device);
@@ -5615,14 +5892,16 @@ ni_fsm_process_rename_event(ni_fsm_t *fsm, ni_fsm_event_t *ev)
 		/* when the worker is in use, fail */
 		ni_ifworker_reset(w);
 		ni_string_dup(&w->name, w->old_name ? w->old_name : "renamed");
+		ni_fsm_ifworker_index_update(fsm, w);
 		ni_ifworker_fail(w, "active device has been renamed to %s", c->name);
 	} else {
 		/* otherwise reset it and remove   */
 		ni_ifworker_reset(w);
-		ni_ifworker_array_remove(&fsm->workers, w);
+		ni_fsm_remove_worker(fsm, w);
 	}
+	c->rebind = TRUE;
 
-	ni_fsm_build_hierarchy(fsm, FALSE);
+	ni_fsm_update_hierarchy(fsm, FALSE);
 
 	/* kickstart and return the pending worker */
 	c->pending = FALSE;
@@ -5846,13 +6125,15 @@ ni_fsm_create_client(ni_fsm_t *fsm)
 
 	client = ni_dbus_object_get_client(fsm->client_root_object);
 
-	ni_dbus_client_add_signal_handler(client, NULL, NULL,
-					NI_OBJECTMODEL_NETIF_INTERFACE,
+	ni_dbus_client_add_signal_member_handler(client, NULL,
+					NI_OBJECTMODEL_NETIF_LIST_PATH,
+					NI_OBJECTMODEL_NETIF_INTERFACE, NULL,
 					interface_state_change_signal,
 					fsm);
 
-	ni_dbus_client_add_signal_handler(client, NULL, NULL,
-					NI_OBJECTMODEL_MODEM_INTERFACE,
+	ni_dbus_client_add_signal_member_handler(client, NULL,
+					NI_OBJECTMODEL_MODEM_LIST_PATH,
+					NI_OBJECTMODEL_MODEM_INTERFACE, NULL,
 					interface_state_change_signal,
 					fsm);
 
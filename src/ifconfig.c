@@ -111,6 +111,9 @@
 #define	BOND_DEFAULT_MIIMON		100
 #endif
 
+/* max. time in msec to wait for ipv6 dad before continuing the apply */
+#define NI_ADDRCONF_UPDATER_VERIFY_TIMEOUT	12500
+
 static int	__ni_netdev_update_addrs(ni_netdev_t *dev,
 				const ni_addrconf_lease_t *old_lease,
 				ni_addrconf_lease_t       *new_lease,
@@ -266,7 +269,7 @@ ni_system_interface_enslave(ni_netconfig_t *nc, ni_netdev_t *master, ni_netdev_t
 			return -1;
 		}
 
-		ret = ni_ovs_vsctl_bridge_port_add(dev->name, &req->port->ovsbr, TRUE);
+		ret = ni_ovs_ctl_bridge_port_add(dev->name, &req->port->ovsbr, TRUE);
 		if (ret == 0)  {
 			ni_netdev_ref_set(&dev->link.masterdev,
 					master->name, master->link.ifindex);
@@ -330,7 +333,7 @@ ni_system_interface_link_change(ni_netdev_t *dev, const ni_netdev_req_t *ifp_req
 			if (master && master->link.type == NI_IFTYPE_OVS_SYSTEM) {
 				if (ifp_req->port && ifp_req->port->type == NI_IFTYPE_OVS_BRIDGE &&
 				    !ni_string_empty(ifp_req->port->ovsbr.bridge.name)) {
-					ni_ovs_vsctl_bridge_port_add(dev->name, &ifp_req->port->ovsbr, TRUE);
+					ni_ovs_ctl_bridge_port_add(dev->name, &ifp_req->port->ovsbr, TRUE);
 				}
 			}
 
@@ -581,59 +584,39 @@ __ni_addrconf_action_addrs_verify_check(ni_netdev_t *dev, ni_addrconf_lease_t *l
 	return 0;		/* continue to apply, there is a verified IP  */
 }
 
+/*
+ * Tentative IPv6 addresses are not reported via NEWADDR events, so we
+ * fetch the addresses once when entering the verify action and again
+ * on timer wakeups only, in case we missed an event. Meanwhile, the
+ * rtnetlink events keep dev->addrs current and re-execute the updater
+ * when the kernel finished the dad (see handle_interface_addr_events),
+ * so many interfaces can wait for dad without blocking each other.
+ */
 static int
-__ni_addrconf_action_addrs_verify_loop(ni_netdev_t *dev, ni_addrconf_lease_t *lease)
+__ni_addrconf_action_addrs_verify(ni_netdev_t *dev, ni_addrconf_lease_t *lease)
 {
 	ni_netconfig_t *nc = ni_global_state_handle(0);
-	unsigned int loops = 50;
+	ni_addrconf_updater_t *updater = lease->updater;
+	struct timeval now, delta;
 	int res = -1;
 
-	ni_debug_ifconfig("%s: entering address verify loop for lease %s:%s in state %s",
-			dev->name,
-			ni_addrfamily_type_to_name(lease->family),
-			ni_addrconf_type_to_name(lease->type),
-			ni_addrconf_state_to_name(lease->state));
-	do {
-		if (!nc || (res = __ni_system_refresh_interface_addrs(nc, dev)) < 0)
-			return res;
-
-		if ((res = __ni_addrconf_action_addrs_verify_check(dev, lease)) <= 0)
-			return res;
-
-		/* In case the client is configured to ignore link-up
-		 * and sets IPs already at device-up [without waiting
-		 * for link detection], we detect dadfailed above, but
-		 * do not wait util the kernel verified the addresses:
-		 * kernel will not even set link local or start dad
-		 * without link-up [detected carrier / lower UP] ...
-		 */
-		if (!ni_netdev_link_is_up(dev))
-			break;
-
-		usleep(250000);
-	} while (res && loops-- > 0);
-
-	return 0;
-}
-
-static int
-__ni_addrconf_action_addrs_verify_timed(ni_netdev_t *dev, ni_addrconf_lease_t *lease)
-{
-	ni_netconfig_t *nc = ni_global_state_handle(0);
-	int res = -1;
+	if (!nc)
+		return res;
 
-	if (!nc || (res = __ni_system_refresh_interface_addrs(nc, dev)) < 0)
+	if ((!updater || updater->resync) &&
+	    (res = __ni_system_refresh_interface_addrs(nc, dev)) < 0)
 		return res;
 
-	/* updater is executed on address updates removing tentative flags */
-	if ((res = __ni_addrconf_action_addrs_verify_check(dev, lease)) == 0)
+	if ((res = __ni_addrconf_action_addrs_verify_check(dev, lease)) <= 0)
 		return res;
 
-	/* This should not happen for auto6 addresses as the
-	 * kernel is never applying any without link-up, but
-	 * we may want to use it for other leases as well.
-	 *
-	 * In case the client is configured to ignore link-up
+	/* Without an updater nothing executes us again once the
+	 * dad finished, so we cannot wait for it and continue.
+	 */
+	if (!updater)
+		return 0;
+
+	/* In case the client is configured to ignore link-up
 	 * and sets IPs already at device-up [without waiting
 	 * for link detection], we detect dadfailed above, but
 	 * do not wait util the kernel verified the addresses:
@@ -643,20 +626,21 @@ __ni_addrconf_action_addrs_verify_timed(ni_netdev_t *dev, ni_addrconf_lease_t *l
 	if (!ni_netdev_link_is_up(dev))
 		return 0;
 
-	if (res > 0 && lease->updater && !lease->updater->timeout)
-		lease->updater->timeout = 250;
-	return res;
-}
-
-static int
-__ni_addrconf_action_addrs_verify(ni_netdev_t *dev, ni_addrconf_lease_t *lease)
-{
-	ni_addrconf_updater_t *updater = lease->updater;
-
-	if (updater && timerisset(&updater->started))
-		return __ni_addrconf_action_addrs_verify_timed(dev, lease);
+	ni_timer_get_time(&now);
+	if (timercmp(&now, &updater->astart, >))
+		timersub(&now, &updater->astart, &delta);
 	else
-		return __ni_addrconf_action_addrs_verify_loop(dev, lease);
+		timerclear(&delta);
+
+	if (delta.tv_sec * 1000 + delta.tv_usec / 1000 >= NI_ADDRCONF_UPDATER_VERIFY_TIMEOUT) {
+		ni_debug_ifconfig("%s: lease %s:%s addresses still tentative after %ums, continuing",
+				dev->name,
+				ni_addrfamily_type_to_name(lease->family),
+				ni_addrconf_type_to_name(lease->type),
+				NI_ADDRCONF_UPDATER_VERIFY_TIMEOUT);
+		return 0;
+	}
+	return res;
 }
 
 static int
@@ -898,10 +882,13 @@ ni_addrconf_updater_action_call(ni_netdev_t *dev, ni_addrconf_lease_t *lease)
 			break;
 		}
 
-		if (!timerisset(&updater->astart))
+		if (!timerisset(&updater->astart)) {
 			ni_timer_get_time(&updater->astart);
+			updater->resync = TRUE;
+		}
 
 		res = updater->action->func(dev, lease);
+		updater->resync = FALSE;
 
 		ni_timer_get_time(&now);
 		if (timercmp(&now, &updater->astart, >))
@@ -1085,6 +1072,7 @@ ni_addrconf_updater_timer_call(void *user_data, const ni_timer_t *timer)
 		return;
 
 	updater->timer = NULL;
+	updater->resync = TRUE;
 
 	if (!(nc = ni_global_state_handle(0)))
 		return;
@@ -1932,7 +1920,7 @@ ni_system_ovs_bridge_create(ni_netconfig_t *nc, const ni_netdev_t *cfg, ni_netde
 		}
 	}
 
-	if (ni_ovs_vsctl_bridge_add(cfg, TRUE))
+	if (ni_ovs_ctl_bridge_add(cfg, nc, TRUE))
 		return -1;
 
 	/* Wait for sysfs to appear */
@@ -1969,7 +1957,7 @@ ni_system_ovs_bridge_delete(ni_netconfig_t *nc, ni_netdev_t *dev)
 	if (!dev || dev->link.type != NI_IFTYPE_OVS_BRIDGE)
 		return -1;
 
-	return ni_ovs_vsctl_bridge_del(dev->name) ? -1 : 0;
+	return ni_ovs_ctl_bridge_del(dev->name) ? -1 : 0;
 }
 
 /*
@@ -27,6 +27,7 @@
 #include "sysfs.h"
 #include "kernel.h"
 #include "appconfig.h"
+#include "teamd.h"
 
 #ifndef NI_ND_OPT_RDNSS_INFORMATION
 #define NI_ND_OPT_RDNSS_INFORMATION	25	/* RFC 5006 */
@@ -59,8 +60,31 @@ typedef struct ni_rtevent_handle
 {
 	struct nl_sock *nlsock;
 	ni_uint_array_t	groups;
+	unsigned int	recv_buff_len;
 } ni_rtevent_handle_t;
 
+/*
+ * Object classes to resync after a receive buffer overrun
+ */
+#define NI_RTEVENT_RESYNC_LINKS		(1U << 0)
+#define NI_RTEVENT_RESYNC_ADDRS4	(1U << 1)
+#define NI_RTEVENT_RESYNC_ADDRS6	(1U << 2)
+#define NI_RTEVENT_RESYNC_ROUTES	(1U << 3)
+#define NI_RTEVENT_RESYNC_RULES		(1U << 4)
+
+#define NI_RTEVENT_RESYNC_DELAY		100		/* msec */
+#define NI_RTEVENT_RECV_BUFF_MAX	(16 * 1024 * 1024)
+#define NI_RTEVENT_MESG_BUFF_MAX	(1024 * 1024)
+
+static struct {
+	unsigned int		pending;
+	const ni_timer_t *	timer;
+
+	unsigned int		overruns;	/* receive buffer overruns */
+	unsigned int		resyncs;	/* object classes resynced */
+	unsigned int		failures;	/* failed resync dumps     */
+} __ni_rtevent_resync;
+
 /*
  * TODO: Move the socket somewhere else & add cleanup...
  */
@@ -247,6 +271,8 @@ __ni_netdev_process_events(ni_netconfig_t *nc, ni_netdev_t *dev, unsigned int ol
 
 	if (dev->deleted) {
 		dev->deleted = 0;
+		if (dev->link.type == NI_IFTYPE_TEAM)
+			ni_teamd_device_delete(dev->name);
 		ni_uint_array_append(&events, NI_EVENT_DEVICE_DELETE);
 	} else
 	if (events.count == 0) {
@@ -261,43 +287,142 @@ __ni_netdev_process_events(ni_netconfig_t *nc, ni_netdev_t *dev, unsigned int ol
 
 
 /*
- * Process NEWLINK event
+ * Devices whose name conflicts with the name reported for another
+ * device in a NEWLINK event of the current receive batch.
  */
-int
-__ni_rtevent_newlink(ni_netconfig_t *nc, const struct sockaddr_nl *nladdr, struct nlmsghdr *h)
+static ni_uint_array_t	__ni_rtevent_stale_names = NI_UINT_ARRAY_INIT;
+
+static void
+__ni_rtevent_newlink_delete(ni_netconfig_t *nc, ni_netdev_t *dev)
+{
+	unsigned int old_flags = dev->link.ifflags;
+
+	dev->link.ifflags = 0;
+	dev->deleted = 1;
+
+	__ni_netdev_process_events(nc, dev, old_flags);
+	ni_client_state_drop(dev->link.ifindex);
+	ni_netconfig_device_remove(nc, dev);
+}
+
+static int
+__ni_rtevent_ifindex_cmp(const void *a, const void *b)
+{
+	unsigned int l = *(const unsigned int *)a;
+	unsigned int r = *(const unsigned int *)b;
+
+	return l < r ? -1 : l > r;
+}
+
+/*
+ * Resolve names marked stale in the receive batch.
+ *
+ * The events are processed in the order the kernel sent them, so the
+ * name in each NEWLINK event is the current one at the time of the
+ * event and renames like eth0->rename1->eth1, eth1->rename2->eth0
+ * are applied in sequence. A conflict remains after the batch only
+ * when we've missed an event and is then resolved by querying the
+ * kernel once per affected device: it is deleted when it does not
+ * exist any more and renamed when its current name differs.
+ */
+static void
+__ni_rtevent_reconcile_names(ni_netconfig_t *nc)
 {
 	char namebuf[IF_NAMESIZE+1] = {'\0'};
-	ni_netdev_t *dev, *old;
+	ni_netdev_t *dev, *conflict;
+	unsigned int i, ifindex;
+
+	qsort(__ni_rtevent_stale_names.data, __ni_rtevent_stale_names.count,
+			sizeof(unsigned int), __ni_rtevent_ifindex_cmp);
+
+	for (i = 0; i < __ni_rtevent_stale_names.count; ++i) {
+		ifindex = __ni_rtevent_stale_names.data[i];
+		if (i && ifindex == __ni_rtevent_stale_names.data[i - 1])
+			continue;
+
+		if (!nc || !(dev = ni_netdev_by_index(nc, ifindex)))
+			continue;
+
+		for (conflict = ni_netconfig_devlist(nc); conflict; conflict = conflict->next) {
+			if (conflict != dev && ni_string_eq(conflict->name, dev->name))
+				break;
+		}
+		if (!conflict)
+			continue;
+
+		if (!if_indextoname(ifindex, namebuf)) {
+			__ni_rtevent_newlink_delete(nc, dev);
+		} else
+		if (!ni_string_eq(dev->name, namebuf)) {
+			ni_debug_events("%s[%u]: device renamed to %s",
+					dev->name, ifindex, namebuf);
+			ni_string_dup(&dev->name, namebuf);
+			__ni_netdev_event(nc, dev, NI_EVENT_DEVICE_RENAME);
+		}
+	}
+	ni_uint_array_destroy(&__ni_rtevent_stale_names);
+}
+
+/*
+ * Tell the teamd client about ports joining or leaving a team,
+ * so it can tell whether its cached team config is still valid.
+ */
+static void
+__ni_rtevent_team_port_event(ni_netconfig_t *nc, ni_netdev_t *dev, unsigned int old_master)
+{
+	unsigned int new_master = dev->link.masterdev.index;
+	ni_netdev_t *master;
+
+	if (old_master == new_master)
+		return;
+
+	master = old_master ? ni_netdev_by_index(nc, old_master) : NULL;
+	if (master && master->link.type == NI_IFTYPE_TEAM)
+		ni_teamd_port_event(master->name, dev->name, FALSE);
+
+	master = new_master ? ni_netdev_by_index(nc, new_master) : NULL;
+	if (master && master->link.type == NI_IFTYPE_TEAM)
+		ni_teamd_port_event(master->name, dev->name, TRUE);
+}
+
+/*
+ * Process NEWLINK event or a NEWLINK of a resync dump
+ */
+static int
+__ni_rtevent_process_newlink(ni_netconfig_t *nc, struct nlmsghdr *h, ni_bool_t dump)
+{
+	ni_netdev_t *dev, *old, *conflict;
 	struct ifinfomsg *ifi;
 	struct nlattr *nla;
-	char *ifname = NULL;
+	const char *ifname;
+	unsigned int old_master = 0;
 	int old_flags = 0;
 
 	if (!(ifi = ni_rtnl_ifinfomsg(h, RTM_NEWLINK)))
 		return -1;
 
 	if (ifi->ifi_family == AF_BRIDGE)
-		return 0;
+		return __ni_netdev_process_bridge_portinfo(nc, h, ifi);
 
-	old = ni_netdev_by_index(nc, ifi->ifi_index);
-	ifname = if_indextoname(ifi->ifi_index, namebuf);
-	if (!ifname) {
-		/*
-		 * device (index) does not exists any more;
-		 * process deletion/cleanup of the device.
-		 */
-		if (old) {
-			old_flags = old->link.ifflags;
-			old->link.ifflags = 0;
-			old->deleted = 1;
-
-			__ni_netdev_process_events(nc, old, old_flags);
-			ni_client_state_drop(old->link.ifindex);
-			ni_netconfig_device_remove(nc, old);
-		}
-		return 0;
+	if (!(nla = nlmsg_find_attr(h, sizeof(*ifi), IFLA_IFNAME)) ||
+	    ni_string_empty(ifname = nla_get_string(nla))) {
+		ni_debug_events("RTM_NEWLINK message without name for index %d",
+				ifi->ifi_index);
+		return -1;
 	}
 
+	/*
+	 * The kernel does not permit duplicate names, so a device with
+	 * this name in our list and another index missed the event about
+	 * its rename or deletion or it follows in the read buffer.
+	 * A dump reports the current name of the conflicting device as
+	 * well or deletes it after the dump, when it did not report it.
+	 */
+	conflict = dump ? NULL : ni_netdev_by_name(nc, ifname);
+	if (conflict && conflict->link.ifindex != (unsigned int)ifi->ifi_index)
+		ni_uint_array_append(&__ni_rtevent_stale_names, conflict->link.ifindex);
+
+	old = ni_netdev_by_index(nc, ifi->ifi_index);
 	if (old) {
 		if (!ni_string_eq(old->name, ifname)) {
 			ni_debug_events("%s[%u]: device renamed to %s",
@@ -307,6 +432,7 @@ __ni_rtevent_newlink(ni_netconfig_t *nc, const struct sockaddr_nl *nladdr, struc
 		}
 		dev = old;
 		old_flags = old->link.ifflags;
+		old_master = old->link.masterdev.index;
 	} else {
 		if (!(dev = ni_netdev_new(ifname, ifi->ifi_index))) {
 			ni_warn("%s[%u]: unable to allocate memory for device",
@@ -318,44 +444,11 @@ __ni_rtevent_newlink(ni_netconfig_t *nc, const struct sockaddr_nl *nladdr, struc
 	}
 
 	if (__ni_netdev_process_newlink(dev, h, ifi, nc) < 0) {
-		ni_error("Problem parsing RTM_NEWLINK message for %s", ifname);
+		ni_error("Problem parsing RTM_NEWLINK message for %s", dev->name);
 		return -1;
 	}
 
-	if ((ifname = dev->name)) {
-		ni_netdev_t *conflict;
-
-		conflict = ni_netdev_by_name(nc, ifname);
-		if (conflict && conflict->link.ifindex != (unsigned int)ifi->ifi_index) {
-			/*
-			 * As the events often provide an already obsolete name [2 events,
-			 * we process 1st with next in read buffer], we are reading the
-			 * current dev->name in advance (above).
-			 *
-			 * On a rename like eth0->rename1->eth1, eth1->rename2->eth0, the
-			 * current dev->name is already eth1 at processing time of eth0
-			 * to rename1 event. This sometimes causes that we find eth1 in
-			 * our device list [eth1 -> rename2 event in the read buffer].
-			 *
-			 * Just update the name of the conflicting device in advance too
-			 * and when the interface does not exist any more, emit events.
-			 */
-			char *current = if_indextoname(conflict->link.ifindex, namebuf);
-			if (current) {
-				ni_string_dup(&conflict->name, current);
-				__ni_netdev_event(nc, conflict, NI_EVENT_DEVICE_RENAME);
-			} else {
-				unsigned int ifflags = conflict->link.ifflags;
-				conflict->link.ifflags = 0;
-				conflict->deleted = 1;
-
-				__ni_netdev_process_events(nc, conflict, ifflags);
-				ni_client_state_drop(conflict->link.ifindex);
-				ni_netconfig_device_remove(nc, conflict);
-			}
-		}
-	}
-
+	__ni_rtevent_team_port_event(nc, dev, old_master);
 	__ni_netdev_process_events(nc, dev, old_flags);
 
 	if ((nla = nlmsg_find_attr(h, sizeof(*ifi), IFLA_WIRELESS)) != NULL)
@@ -364,6 +457,12 @@ __ni_rtevent_newlink(ni_netconfig_t *nc, const struct sockaddr_nl *nladdr, struc
 	return 0;
 }
 
+int
+__ni_rtevent_newlink(ni_netconfig_t *nc, const struct sockaddr_nl *nladdr, struct nlmsghdr *h)
+{
+	return __ni_rtevent_process_newlink(nc, h, FALSE);
+}
+
 /*
  * Process DELLINK event
  */
@@ -928,7 +1027,243 @@ __ni_rtevent_process_cb(struct nl_msg *msg, void *ptr)
 }
 
 static ni_bool_t	__ni_rtevent_restart(ni_socket_t *sock);
+static ni_bool_t	__ni_rtevent_set_recv_buff(ni_rtevent_handle_t *, unsigned int);
+static ni_bool_t	__ni_rtevent_set_mesg_buff(ni_rtevent_handle_t *, unsigned int);
+
+/*
+ * Resync the links by replaying a dump through the event handlers,
+ * so changes missed in an overrun are signaled as usual.
+ */
+static int
+__ni_rtevent_resync_links(ni_netconfig_t *nc, int family)
+{
+	struct ni_nlmsg_list list;
+	ni_uint_array_t seen = NI_UINT_ARRAY_INIT;
+	ni_netdev_t *dev, *next;
+	struct ni_nlmsg *entry;
+	struct ifinfomsg *ifi;
+
+	ni_nlmsg_list_init(&list);
+	if (ni_nl_dump_store(family, RTM_GETLINK, &list) < 0) {
+		ni_nlmsg_list_destroy(&list);
+		return -1;
+	}
+
+	for (entry = list.head; entry; entry = entry->next) {
+		if (!(ifi = ni_rtnl_ifinfomsg(&entry->h, RTM_NEWLINK)))
+			continue;
+
+		if (__ni_rtevent_process_newlink(nc, &entry->h, TRUE) == 0)
+			ni_uint_array_append(&seen, ifi->ifi_index);
+	}
+	ni_nlmsg_list_destroy(&list);
+
+	if (family == AF_UNSPEC) {
+		for (dev = ni_netconfig_devlist(nc); dev; dev = next) {
+			next = dev->next;
+			if (!ni_uint_array_contains(&seen, dev->link.ifindex))
+				__ni_rtevent_newlink_delete(nc, dev);
+		}
+	}
+	ni_uint_array_destroy(&seen);
+
+	if (__ni_rtevent_stale_names.count)
+		__ni_rtevent_reconcile_names(nc);
+	return 0;
+}
+
+/*
+ * Resync the addresses of a family, signaling updates of the dumped
+ * and the deletion of the addresses not in the dump any more.
+ */
+static int
+__ni_rtevent_resync_addrs(ni_netconfig_t *nc, unsigned int family)
+{
+	struct ni_nlmsg_list list;
+	struct ni_nlmsg *entry;
+	ni_address_t *ap, *next;
+	unsigned int seqno;
+	ni_netdev_t *dev;
+
+	ni_nlmsg_list_init(&list);
+	if (ni_nl_dump_store(family, RTM_GETADDR, &list) < 0) {
+		ni_nlmsg_list_destroy(&list);
+		return -1;
+	}
+
+	do {
+		seqno = ++__ni_global_seqno;
+	} while (!seqno);
+
+	for (dev = ni_netconfig_devlist(nc); dev; dev = dev->next) {
+		for (ap = dev->addrs; ap; ap = ap->next) {
+			if (ap->family == family)
+				ap->seq = 0;
+		}
+		dev->seq = seqno;
+	}
+
+	for (entry = list.head; entry; entry = entry->next)
+		__ni_rtevent_newaddr(nc, NULL, &entry->h);
+	ni_nlmsg_list_destroy(&list);
+
+	for (dev = ni_netconfig_devlist(nc); dev; dev = dev->next) {
+		for (ap = dev->addrs; ap; ap = next) {
+			next = ap->next;
+			if (ap->family != family || ap->seq == seqno)
+				continue;
+
+			__ni_netdev_addr_event(dev, NI_EVENT_ADDRESS_DELETE, ap);
+			__ni_address_list_remove(&dev->addrs, ap);
+		}
+	}
+	return 0;
+}
+
+static void
+__ni_rtevent_resync_timeout(void *user_data, const ni_timer_t *timer)
+{
+	unsigned int pending = __ni_rtevent_resync.pending;
+	ni_netconfig_t *nc;
+	unsigned int family;
+
+	if (__ni_rtevent_resync.timer != timer)
+		return;
+
+	__ni_rtevent_resync.timer = NULL;
+	__ni_rtevent_resync.pending = 0;
+	if (!(nc = ni_global_state_handle(0)))
+		return;
+
+	family = ni_netconfig_get_family_filter(nc);
+	ni_debug_events("resync of rtnetlink object classes 0x%x after %u overruns",
+			pending, __ni_rtevent_resync.overruns);
+
+	/*
+	 * On failure, the class is resynced again with the next overrun
+	 * or the next (enforced) refresh.
+	 */
+	if (pending & NI_RTEVENT_RESYNC_LINKS) {
+		if (__ni_rtevent_resync_links(nc, AF_UNSPEC) < 0 ||
+		    (family != AF_INET && __ni_rtevent_resync_links(nc, AF_INET6) < 0))
+			__ni_rtevent_resync.failures++;
+		else
+			__ni_rtevent_resync.resyncs++;
+	}
+	if (pending & NI_RTEVENT_RESYNC_ADDRS4) {
+		if (__ni_rtevent_resync_addrs(nc, AF_INET) < 0)
+			__ni_rtevent_resync.failures++;
+		else
+			__ni_rtevent_resync.resyncs++;
+	}
+	if (pending & NI_RTEVENT_RESYNC_ADDRS6) {
+		if (__ni_rtevent_resync_addrs(nc, AF_INET6) < 0)
+			__ni_rtevent_resync.failures++;
+		else
+			__ni_rtevent_resync.resyncs++;
+	}
+	if (pending & NI_RTEVENT_RESYNC_ROUTES) {
+		if (__ni_system_refresh_routes(nc) < 0)
+			__ni_rtevent_resync.failures++;
+		else
+			__ni_rtevent_resync.resyncs++;
+	}
+	if (pending & NI_RTEVENT_RESYNC_RULES) {
+		if (__ni_system_refresh_rules(nc) < 0)
+			__ni_rtevent_resync.failures++;
+		else
+			__ni_rtevent_resync.resyncs++;
+	}
+
+	ni_note("rtnetlink event resync: %u overruns, %u resyncs, %u failures",
+			__ni_rtevent_resync.overruns, __ni_rtevent_resync.resyncs,
+			__ni_rtevent_resync.failures);
+}
+
+/*
+ * The kernel reports a receive buffer overrun (ENOBUFS) once and
+ * keeps the socket usable -- we don't set NETLINK_NO_ENOBUFS, which
+ * would hide it. Events of all joined groups may be lost, so schedule
+ * a resync of their object classes and grow the receive buffer.
+ * A message truncated by a too small libnl message buffer is lost
+ * as well; then grow the message buffer instead.
+ */
+static void
+__ni_rtevent_overrun(ni_rtevent_handle_t *handle, int ret)
+{
+	unsigned int i, pending = 0;
+
+	__ni_rtevent_resync.overruns++;
+	for (i = 0; i < handle->groups.count; ++i) {
+		switch (handle->groups.data[i]) {
+		case RTNLGRP_LINK:
+		case RTNLGRP_IPV6_IFINFO:
+			pending |= NI_RTEVENT_RESYNC_LINKS;
+			break;
+		case RTNLGRP_IPV4_IFADDR:
+			pending |= NI_RTEVENT_RESYNC_ADDRS4;
+			break;
+		case RTNLGRP_IPV6_IFADDR:
+			pending |= NI_RTEVENT_RESYNC_ADDRS6;
+			break;
+		case RTNLGRP_IPV4_ROUTE:
+		case RTNLGRP_IPV6_ROUTE:
+			pending |= NI_RTEVENT_RESYNC_ROUTES;
+			break;
+		case RTNLGRP_IPV4_RULE:
+		case RTNLGRP_IPV6_RULE:
+			pending |= NI_RTEVENT_RESYNC_RULES;
+			break;
+		default:
+			/* prefix and nd user option events can't be dumped */
+			break;
+		}
+	}
 
+	ni_warn("rtnetlink event %s buffer overrun, scheduling resync",
+			ret == -NLE_MSG_OVERFLOW ? "message" : "receive");
+	__ni_rtevent_resync.pending |= pending;
+	if (!__ni_rtevent_resync.timer) {
+		__ni_rtevent_resync.timer = ni_timer_register(NI_RTEVENT_RESYNC_DELAY,
+				__ni_rtevent_resync_timeout, NULL);
+	}
+
+	if (ret == -NLE_MSG_OVERFLOW) {
+		/* zero is the libnl default of four pages */
+		unsigned int len = nl_socket_get_msg_buf_size(handle->nlsock);
+
+		if (!len)
+			len = getpagesize() * 4;
+		if (len < NI_RTEVENT_MESG_BUFF_MAX)
+			__ni_rtevent_set_mesg_buff(handle, min_t(unsigned int, len * 2,
+						NI_RTEVENT_MESG_BUFF_MAX));
+	} else
+	if (handle->recv_buff_len && handle->recv_buff_len < NI_RTEVENT_RECV_BUFF_MAX) {
+		unsigned int len = handle->recv_buff_len * 2;
+
+		if (len > NI_RTEVENT_RECV_BUFF_MAX)
+			len = NI_RTEVENT_RECV_BUFF_MAX;
+		__ni_rtevent_set_recv_buff(handle, len);
+	}
+}
+
+/*
+ * libnl maps the ENOBUFS of a receive buffer overrun to NLE_NOMEM,
+ * which it returns on allocation failures as well, so we check the
+ * errno set by recvmsg to tell them apart.
+ */
+static inline ni_bool_t
+__ni_rtevent_is_overrun(int ret)
+{
+	switch (ret) {
+	case -NLE_NOMEM:
+		return errno == ENOBUFS;
+	case -NLE_MSG_OVERFLOW:
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
 
 /*
  * Receive netlink message and trigger processing by callback
@@ -941,9 +1276,17 @@ __ni_rtevent_receive(ni_socket_t *sock)
 
 	if (handle && handle->nlsock) {
 		do {
+			errno = 0;
 			ret = nl_recvmsgs_default(handle->nlsock);
+			if (__ni_rtevent_is_overrun(ret)) {
+				__ni_rtevent_overrun(handle, ret);
+				ret = NLE_SUCCESS;
+			}
 		} while (ret == NLE_SUCCESS || ret == -NLE_INTR);
 
+		if (__ni_rtevent_stale_names.count)
+			__ni_rtevent_reconcile_names(ni_global_state_handle(0));
+
 		switch (ret) {
 		case NLE_SUCCESS:
 		case -NLE_AGAIN:
@@ -1050,6 +1393,32 @@ __ni_rtevent_config_mesg_buff_len(void)
 	return ni_global.config ? ni_global.config->rtnl_event.mesg_buff_length : 0;
 }
 
+static ni_bool_t
+__ni_rtevent_set_recv_buff(ni_rtevent_handle_t *handle, unsigned int len)
+{
+	int fd = nl_socket_get_fd(handle->nlsock);
+
+	if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, (char *)&len, sizeof(len)) &&
+	    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, (char *)&len, sizeof(len))) {
+		ni_warn("Unable to set netlink event receive buffer to %u bytes: %m", len);
+		return FALSE;
+	}
+	ni_info("Using netlink event receive buffer of %u bytes", len);
+	handle->recv_buff_len = len;
+	return TRUE;
+}
+
+static ni_bool_t
+__ni_rtevent_set_mesg_buff(ni_rtevent_handle_t *handle, unsigned int len)
+{
+	if (nl_socket_set_msg_buf_size(handle->nlsock, len)) {
+		ni_warn("Unable to set netlink event message buffer to %u bytes", len);
+		return FALSE;
+	}
+	ni_info("Using netlink event message buffer of %u bytes", len);
+	return TRUE;
+}
+
 static ni_socket_t *
 __ni_rtevent_sock_open(void)
 {
@@ -1096,27 +1465,10 @@ __ni_rtevent_sock_open(void)
 		return NULL;
 	}
 
-	if (recv_buff_len) {
-		if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE,
-				(char *)&recv_buff_len, sizeof(recv_buff_len)) &&
-		    setsockopt(fd, SOL_SOCKET, SO_RCVBUF,
-				(char *)&recv_buff_len, sizeof(recv_buff_len))) {
-			ni_warn("Unable to set netlink event receive buffer to %u bytes: %m",
-					recv_buff_len);
-		} else {
-			ni_info("Using netlink event receive buffer of %u bytes",
-					recv_buff_len);
-		}
-	}
-	if (mesg_buff_len) {
-		if (nl_socket_set_msg_buf_size(handle->nlsock, mesg_buff_len)) {
-			ni_warn("Unable to set netlink event message buffer to %u bytes",
-					mesg_buff_len);
-		} else {
-			ni_info("Using netlink event message buffer of %u bytes",
-					mesg_buff_len);
-		}
-	}
+	if (recv_buff_len)
+		__ni_rtevent_set_recv_buff(handle, recv_buff_len);
+	if (mesg_buff_len)
+		__ni_rtevent_set_mesg_buff(handle, mesg_buff_len);
 
 	sock->user_data	= handle;
 	sock->receive	= __ni_rtevent_receive;
@@ -69,7 +69,7 @@ static int		__ni_netdev_process_newroute(ni_netdev_t *, struct nlmsghdr *,
 					struct rtmsg *, ni_netconfig_t *);
 static int		__ni_netdev_process_newrule(struct nlmsghdr *, struct fib_rule_hdr *,
 					ni_netconfig_t *);
-static int		__ni_discover_bridge(ni_netdev_t *);
+static int		__ni_discover_bridge(ni_netdev_t *, struct nlattr **);
 static int		__ni_discover_bond(ni_netdev_t *, struct nlattr **, ni_netconfig_t *);
 static int		__ni_discover_addrconf(ni_netdev_t *);
 static int		__ni_discover_infiniband(ni_netdev_t *, ni_netconfig_t *);
@@ -1096,7 +1096,7 @@ __ni_process_ifinfomsg_ovs_type(ni_iftype_t *type, const char *ifname, ni_netcon
 	if (ni_netconfig_discover_filtered(nc, NI_NETCONFIG_DISCOVER_LINK_EXTERN))
 		return;
 
-	if (ni_ovs_vsctl_bridge_exists(ifname) == 0)
+	if (ni_ovs_ctl_bridge_exists(ifname) == 0)
 		*type = NI_IFTYPE_OVS_BRIDGE;
 }
 
@@ -1400,6 +1400,90 @@ __ni_process_ifinfomsg_bond_slave_data(ni_linkinfo_t *link, const char *ifname,
 	}
 }
 
+static void
+__ni_bridge_id_print(char **str, struct nlattr *aptr)
+{
+	const struct ifla_bridge_id *id;
+
+	if (nla_len(aptr) < (int)sizeof(*id))
+		return;
+
+	id = nla_data(aptr);
+	ni_string_printf(str, "%.2x%.2x.%.2x%.2x%.2x%.2x%.2x%.2x",
+			id->prio[0], id->prio[1],
+			id->addr[0], id->addr[1], id->addr[2],
+			id->addr[3], id->addr[4], id->addr[5]);
+}
+
+/*
+ * Bridge port status from the port's IFLA_INFO_SLAVE_DATA, so port
+ * events do not need to walk the port's sysfs brport directory.
+ */
+static void
+__ni_process_ifinfomsg_bridge_port_data(ni_bridge_port_t *port, const char *ifname, struct nlattr *data)
+{
+	/* static const */ struct nla_policy	__port_policy[IFLA_BRPORT_MAX+1] = {
+		[IFLA_BRPORT_STATE]			= { .type = NLA_U8	},
+		[IFLA_BRPORT_PRIORITY]			= { .type = NLA_U16	},
+		[IFLA_BRPORT_COST]			= { .type = NLA_U32	},
+		[IFLA_BRPORT_MODE]			= { .type = NLA_U8	},
+		[IFLA_BRPORT_ROOT_ID]			= { .type = NLA_UNSPEC	},
+		[IFLA_BRPORT_BRIDGE_ID]			= { .type = NLA_UNSPEC	},
+		[IFLA_BRPORT_DESIGNATED_PORT]		= { .type = NLA_U16	},
+		[IFLA_BRPORT_DESIGNATED_COST]		= { .type = NLA_U16	},
+		[IFLA_BRPORT_ID]			= { .type = NLA_U16	},
+		[IFLA_BRPORT_NO]			= { .type = NLA_U16	},
+		[IFLA_BRPORT_TOPOLOGY_CHANGE_ACK]	= { .type = NLA_U8	},
+		[IFLA_BRPORT_CONFIG_PENDING]		= { .type = NLA_U8	},
+		[IFLA_BRPORT_MESSAGE_AGE_TIMER]		= { .type = NLA_U64	},
+		[IFLA_BRPORT_FORWARD_DELAY_TIMER]	= { .type = NLA_U64	},
+		[IFLA_BRPORT_HOLD_TIMER]		= { .type = NLA_U64	},
+	};
+	struct nlattr *tb[IFLA_BRPORT_MAX+1];
+	ni_bridge_port_status_t *ps = &port->status;
+
+	memset(tb, 0, sizeof(tb));
+	if (nla_parse_nested(tb, IFLA_BRPORT_MAX, data, __port_policy) < 0) {
+		ni_warn("%s: unable to parse bridge port data", ifname);
+		return;
+	}
+
+	if (tb[IFLA_BRPORT_PRIORITY])
+		port->priority = ps->priority = nla_get_u16(tb[IFLA_BRPORT_PRIORITY]);
+	if (tb[IFLA_BRPORT_COST])
+		port->path_cost = ps->path_cost = nla_get_u32(tb[IFLA_BRPORT_COST]);
+	if (tb[IFLA_BRPORT_STATE])
+		ps->state = nla_get_u8(tb[IFLA_BRPORT_STATE]);
+	if (tb[IFLA_BRPORT_NO])
+		ps->port_no = nla_get_u16(tb[IFLA_BRPORT_NO]);
+	if (tb[IFLA_BRPORT_ID])
+		ps->port_id = nla_get_u16(tb[IFLA_BRPORT_ID]);
+	if (tb[IFLA_BRPORT_ROOT_ID])
+		__ni_bridge_id_print(&ps->designated_root, tb[IFLA_BRPORT_ROOT_ID]);
+	if (tb[IFLA_BRPORT_BRIDGE_ID])
+		__ni_bridge_id_print(&ps->designated_bridge, tb[IFLA_BRPORT_BRIDGE_ID]);
+	if (tb[IFLA_BRPORT_DESIGNATED_PORT])
+		ps->designated_port = nla_get_u16(tb[IFLA_BRPORT_DESIGNATED_PORT]);
+	if (tb[IFLA_BRPORT_DESIGNATED_COST])
+		ps->designated_cost = nla_get_u16(tb[IFLA_BRPORT_DESIGNATED_COST]);
+	if (tb[IFLA_BRPORT_TOPOLOGY_CHANGE_ACK])
+		ps->change_ack = nla_get_u8(tb[IFLA_BRPORT_TOPOLOGY_CHANGE_ACK]);
+	if (tb[IFLA_BRPORT_MODE])
+		ps->hairpin_mode = nla_get_u8(tb[IFLA_BRPORT_MODE]);
+	if (tb[IFLA_BRPORT_CONFIG_PENDING])
+		ps->config_pending = nla_get_u8(tb[IFLA_BRPORT_CONFIG_PENDING]);
+	if (tb[IFLA_BRPORT_HOLD_TIMER])
+		ps->hold_timer = nla_get_u64(tb[IFLA_BRPORT_HOLD_TIMER]);
+	if (tb[IFLA_BRPORT_MESSAGE_AGE_TIMER])
+		ps->message_age_timer = nla_get_u64(tb[IFLA_BRPORT_MESSAGE_AGE_TIMER]);
+	if (tb[IFLA_BRPORT_FORWARD_DELAY_TIMER])
+		ps->forward_delay_timer = nla_get_u64(tb[IFLA_BRPORT_FORWARD_DELAY_TIMER]);
+
+	ni_debug_verbose(NI_LOG_DEBUG2, NI_TRACE_EVENTS,
+			"%s: bridge port state %d, priority %u, path-cost %u",
+			ifname, ps->state, ps->priority, ps->path_cost);
+}
+
 static inline void
 __ni_process_ifinfomsg_slave_data(ni_linkinfo_t *link, const char *ifname,
 		ni_netdev_t *master, const char *kind, struct nlattr *data)
@@ -1437,6 +1521,16 @@ __ni_process_ifinfomsg_slave_data(ni_linkinfo_t *link, const char *ifname,
 			__ni_process_ifinfomsg_bond_slave_data(link, ifname, data);
 		break;
 
+	case NI_IFTYPE_BRIDGE:
+		if (master && master->bridge && data) {
+			ni_bridge_port_t *port;
+
+			port = ni_bridge_port_by_index(master->bridge, link->ifindex);
+			if (port)
+				__ni_process_ifinfomsg_bridge_port_data(port, ifname, data);
+		}
+		break;
+
 	default:
 		break;
 	}
@@ -1864,7 +1958,7 @@ __ni_netdev_process_newlink(ni_netdev_t *dev, struct nlmsghdr *h,
 		break;
 
 	case NI_IFTYPE_BRIDGE:
-		__ni_discover_bridge(dev);
+		__ni_discover_bridge(dev, tb);
 		break;
 	case NI_IFTYPE_BOND:
 		__ni_discover_bond(dev, tb, nc);
@@ -3434,10 +3528,129 @@ failure:
  * Discover bridge topology
  */
 static int
-__ni_discover_bridge(ni_netdev_t *dev)
+__ni_discover_bridge_netlink(ni_netdev_t *dev, struct nlattr **tb)
+{
+	/* static const */ struct nla_policy	__info_data_policy[IFLA_INFO_MAX+1] = {
+		[IFLA_INFO_KIND]			= { .type = NLA_STRING	},
+		[IFLA_INFO_DATA]			= { .type = NLA_NESTED	},
+	};
+	/* static const */ struct nla_policy	__bridge_policy[IFLA_BR_MAX+1] = {
+		[IFLA_BR_FORWARD_DELAY]			= { .type = NLA_U32	},
+		[IFLA_BR_HELLO_TIME]			= { .type = NLA_U32	},
+		[IFLA_BR_MAX_AGE]			= { .type = NLA_U32	},
+		[IFLA_BR_AGEING_TIME]			= { .type = NLA_U32	},
+		[IFLA_BR_STP_STATE]			= { .type = NLA_U32	},
+		[IFLA_BR_PRIORITY]			= { .type = NLA_U16	},
+		[IFLA_BR_ROOT_ID]			= { .type = NLA_UNSPEC	},
+		[IFLA_BR_BRIDGE_ID]			= { .type = NLA_UNSPEC	},
+		[IFLA_BR_ROOT_PORT]			= { .type = NLA_U16	},
+		[IFLA_BR_ROOT_PATH_COST]		= { .type = NLA_U32	},
+		[IFLA_BR_TOPOLOGY_CHANGE]		= { .type = NLA_U8	},
+		[IFLA_BR_TOPOLOGY_CHANGE_DETECTED]	= { .type = NLA_U8	},
+		[IFLA_BR_HELLO_TIMER]			= { .type = NLA_U64	},
+		[IFLA_BR_TCN_TIMER]			= { .type = NLA_U64	},
+		[IFLA_BR_TOPOLOGY_CHANGE_TIMER]		= { .type = NLA_U64	},
+		[IFLA_BR_GC_TIMER]			= { .type = NLA_U64	},
+		[IFLA_BR_GROUP_ADDR]			= { .type = NLA_UNSPEC	},
+	};
+	struct nlattr *info[IFLA_INFO_MAX+1];
+	struct nlattr *br[IFLA_BR_MAX+1];
+	ni_bridge_t *bridge = dev->bridge;
+	ni_bridge_status_t *bs = &bridge->status;
+	static int fallback = 1;
+
+	if (!tb || !tb[IFLA_LINKINFO])
+		return fallback;
+
+	if (nla_parse_nested(info, IFLA_INFO_MAX, tb[IFLA_LINKINFO], __info_data_policy) < 0) {
+		ni_error("%s: Unable to parse IFLA_LINKINFO newlink attribute", dev->name);
+		return -1;
+	}
+
+	if (!info[IFLA_INFO_KIND] || !ni_string_eq("bridge", nla_get_string(info[IFLA_INFO_KIND])))
+		return fallback;
+
+	if (!info[IFLA_INFO_DATA])
+		return fallback;
+
+	if (nla_parse_nested(br, IFLA_BR_MAX, info[IFLA_INFO_DATA], __bridge_policy) < 0) {
+		ni_error("%s: Unable to parse bridge IFLA_INFO_DATA", dev->name);
+		return -1;
+	}
+
+	/* kernels before 4.4 provide the configuration only */
+	if (!br[IFLA_BR_ROOT_ID])
+		return fallback;
+
+	fallback = 0;		 /* disable sysfs fallback, kernel supports netlink */
+
+	if (br[IFLA_BR_STP_STATE]) {
+		bs->stp_state = nla_get_u32(br[IFLA_BR_STP_STATE]);
+		bridge->stp = bs->stp_state ? TRUE : FALSE;
+	}
+	if (br[IFLA_BR_PRIORITY])
+		bridge->priority = nla_get_u16(br[IFLA_BR_PRIORITY]);
+	if (br[IFLA_BR_FORWARD_DELAY])
+		bridge->forward_delay = (double)nla_get_u32(br[IFLA_BR_FORWARD_DELAY]) / 100.0;
+	if (br[IFLA_BR_AGEING_TIME])
+		bridge->ageing_time = (double)nla_get_u32(br[IFLA_BR_AGEING_TIME]) / 100.0;
+	if (br[IFLA_BR_HELLO_TIME])
+		bridge->hello_time = (double)nla_get_u32(br[IFLA_BR_HELLO_TIME]) / 100.0;
+	if (br[IFLA_BR_MAX_AGE])
+		bridge->max_age = (double)nla_get_u32(br[IFLA_BR_MAX_AGE]) / 100.0;
+
+	__ni_bridge_id_print(&bs->root_id, br[IFLA_BR_ROOT_ID]);
+	if (br[IFLA_BR_BRIDGE_ID])
+		__ni_bridge_id_print(&bs->bridge_id, br[IFLA_BR_BRIDGE_ID]);
+	if (br[IFLA_BR_GROUP_ADDR] && nla_len(br[IFLA_BR_GROUP_ADDR]) >= ETH_ALEN) {
+		const unsigned char *addr = nla_data(br[IFLA_BR_GROUP_ADDR]);
+
+		ni_string_printf(&bs->group_addr, "%02x:%02x:%02x:%02x:%02x:%02x",
+				addr[0], addr[1], addr[2], addr[3], addr[4], addr[5]);
+	}
+	if (br[IFLA_BR_ROOT_PORT])
+		bs->root_port = nla_get_u16(br[IFLA_BR_ROOT_PORT]);
+	if (br[IFLA_BR_ROOT_PATH_COST])
+		bs->root_path_cost = nla_get_u32(br[IFLA_BR_ROOT_PATH_COST]);
+	if (br[IFLA_BR_TOPOLOGY_CHANGE])
+		bs->topology_change = nla_get_u8(br[IFLA_BR_TOPOLOGY_CHANGE]);
+	if (br[IFLA_BR_TOPOLOGY_CHANGE_DETECTED])
+		bs->topology_change_detected = nla_get_u8(br[IFLA_BR_TOPOLOGY_CHANGE_DETECTED]);
+	if (br[IFLA_BR_GC_TIMER])
+		bs->gc_timer = nla_get_u64(br[IFLA_BR_GC_TIMER]);
+	if (br[IFLA_BR_TCN_TIMER])
+		bs->tcn_timer = nla_get_u64(br[IFLA_BR_TCN_TIMER]);
+	if (br[IFLA_BR_HELLO_TIMER])
+		bs->hello_timer = nla_get_u64(br[IFLA_BR_HELLO_TIMER]);
+	if (br[IFLA_BR_TOPOLOGY_CHANGE_TIMER])
+		bs->topology_change_timer = nla_get_u64(br[IFLA_BR_TOPOLOGY_CHANGE_TIMER]);
+
+	return 0;
+}
+
+static ni_bridge_port_t *
+__ni_discover_bridge_port_known(const ni_bridge_port_array_t *ports, const char *ifname,
+				unsigned int ifindex, unsigned int hint)
+{
+	ni_bridge_port_t *port;
+	unsigned int i;
+
+	/* the brif directory order is stable, try the same position first */
+	for (i = 0; i < ports->count; ++i) {
+		port = ports->data[(hint + i) % ports->count];
+		if (port->ifindex == ifindex && ni_string_eq(port->ifname, ifname))
+			return port;
+	}
+	return NULL;
+}
+
+static int
+__ni_discover_bridge(ni_netdev_t *dev, struct nlattr **tb)
 {
+	ni_string_array_t names = NI_STRING_ARRAY_INIT;
+	ni_bridge_port_array_t known;
 	ni_bridge_t *bridge;
-	ni_string_array_t ports;
+	ni_bool_t netlink;
 	unsigned int i;
 
 	if (dev->link.type != NI_IFTYPE_BRIDGE)
@@ -3445,31 +3658,82 @@ __ni_discover_bridge(ni_netdev_t *dev)
 
 	bridge = ni_netdev_get_bridge(dev);
 
-	ni_sysfs_bridge_get_config(dev->name, bridge);
-	ni_sysfs_bridge_get_status(dev->name, &bridge->status);
-
-	ni_string_array_init(&ports);
-	ni_sysfs_bridge_get_port_names(dev->name, &ports);
-	ni_bridge_ports_destroy(bridge);
-
-	for (i = 0; i < ports.count; ++i) {
-		const char *ifname = ports.data[i];
-		unsigned int index;
-		ni_bridge_port_t *port;
+	netlink = __ni_discover_bridge_netlink(dev, tb) == 0;
+	if (!netlink) {
+		ni_sysfs_bridge_get_config(dev->name, bridge);
+		ni_sysfs_bridge_get_status(dev->name, &bridge->status);
+	}
 
-		if ((index = if_nametoindex(ifname)) == 0) {
+	/*
+	 * Netlink does not list the ports of a bridge. With netlink, the
+	 * status of known ports is maintained from the port's slave data
+	 * and bridge port events; only new ports are read from sysfs.
+	 */
+	known = bridge->ports;
+	memset(&bridge->ports, 0, sizeof(bridge->ports));
+
+	ni_sysfs_bridge_get_port_names(dev->name, &names);
+	for (i = 0; i < names.count; ++i) {
+		const char *ifname = names.data[i];
+		ni_bridge_port_status_t status;
+		ni_bridge_port_t *port, *old;
+		unsigned int index = 0;
+
+		memset(&status, 0, sizeof(status));
+		if (netlink && ni_sysfs_netif_get_uint(ifname, "ifindex", &index) == 0 &&
+		    (old = __ni_discover_bridge_port_known(&known, ifname, index, i))) {
+			status = old->status;
+			memset(&old->status, 0, sizeof(old->status));
+		} else
+		if (ni_sysfs_bridge_port_get_info(ifname, &index, &status) < 0 || !index) {
 			/* Looks like someone is renaming interfaces while we're
 			 * trying to discover them :-( */
-			ni_error("%s: port interface %s has index 0?!", __func__, ifname);
+			ni_error("%s: unable to discover port interface %s", dev->name, ifname);
+			ni_bridge_port_status_destroy(&status);
 			continue;
 		}
-		port = ni_bridge_port_new(bridge, ifname, index);
 
-		ni_sysfs_bridge_port_get_config(port->ifname, port);
-		ni_sysfs_bridge_port_get_status(port->ifname, &port->status);
+		port = ni_bridge_port_new(bridge, ifname, index);
+		port->status = status;
+		port->priority = status.priority;
+		port->path_cost = status.path_cost;
 	}
-	ni_string_array_destroy(&ports);
+	ni_string_array_destroy(&names);
+
+	for (i = 0; i < known.count; ++i)
+		ni_bridge_port_free(known.data[i]);
+	free(known.data);
+
+	return 0;
+}
+
+/*
+ * Update the status of a bridge port from an AF_BRIDGE RTM_NEWLINK,
+ * as sent by the kernel on port (e.g. STP) state changes.
+ */
+int
+__ni_netdev_process_bridge_portinfo(ni_netconfig_t *nc, struct nlmsghdr *h, struct ifinfomsg *ifi)
+{
+	struct nlattr *tb[IFLA_MAX+1];
+	ni_bridge_port_t *port;
+	ni_netdev_t *master;
+	const char *ifname;
+
+	if (nlmsg_parse(h, sizeof(*ifi), tb, IFLA_MAX, NULL) < 0)
+		return -1;
+
+	if (!tb[IFLA_MASTER] || !tb[IFLA_PROTINFO] || !tb[IFLA_IFNAME])
+		return 0;
+
+	master = ni_netdev_by_index(nc, nla_get_u32(tb[IFLA_MASTER]));
+	if (!master || !master->bridge)
+		return 0;
+
+	ifname = nla_get_string(tb[IFLA_IFNAME]);
+	if (!(port = ni_bridge_port_by_index(master->bridge, ifi->ifi_index)))
+		return 0;
 
+	__ni_process_ifinfomsg_bridge_port_data(port, ifname, tb[IFLA_PROTINFO]);
 	return 0;
 }
 
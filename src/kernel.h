@@ -135,6 +135,7 @@ extern int	__ni_rtnl_parse_newprefix(const char *, struct nlmsghdr *, struct pre
 
 extern int	__ni_netdev_process_newlink(ni_netdev_t *, struct nlmsghdr *, struct ifinfomsg *, ni_netconfig_t *);
 extern int	__ni_netdev_process_newlink_ipv6(ni_netdev_t *, struct nlmsghdr *, struct ifinfomsg *);
+extern int	__ni_netdev_process_bridge_portinfo(ni_netconfig_t *, struct nlmsghdr *, struct ifinfomsg *);
 extern int	__ni_netdev_process_newprefix(ni_netdev_t *, struct nlmsghdr *, struct prefixmsg *);
 extern int	__ni_netdev_process_newaddr_event(ni_netdev_t *dev, struct nlmsghdr *h, struct ifaddrmsg *ifa, const ni_address_t **);
 
@@ -30,10 +30,15 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <limits.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <errno.h>
 #include <inttypes.h>
+#include <arpa/inet.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <wicked/netinfo.h>
 #include <wicked/addrconf.h>
@@ -46,6 +51,7 @@
 
 #include "appconfig.h"
 #include "leasefile.h"
+#include "buffer.h"
 #include "dhcp.h"
 #include "dhcp4/lease.h"
 #include "dhcp6/lease.h"
@@ -1237,13 +1243,319 @@ ni_addrconf_lease_from_xml(ni_addrconf_lease_t **leasep, const xml_node_t *root,
 	return ret;
 }
 
+/*
+ * Binary lease files
+ *
+ * The lease xml tree is stored in a compact, position independent
+ * encoding, so a renew costs a single write and reading it back does
+ * not need the xml scanner; the file can be decoded in place from a
+ * mapping. All integers are in network byte order:
+ *
+ *   header:	magic, u16 version, u16 reserved,
+ *		u32 payload length, u32 crc32 of the payload
+ *   payload:	the root node
+ *   node:	name, u16 attribute count, u16 child count, cdata
+ *		string, attributes as name + value string, child nodes
+ *   name:	u8 length + bytes, NI_ADDRCONF_LEASE_BIN_NO_NAME if unset
+ *   string:	u32 length + bytes, NI_ADDRCONF_LEASE_BIN_NONE if unset
+ */
+#define NI_ADDRCONF_LEASE_BIN_MAGIC		"WLBL"
+#define NI_ADDRCONF_LEASE_BIN_VERSION		1
+#define NI_ADDRCONF_LEASE_BIN_HDR_LEN		16
+#define NI_ADDRCONF_LEASE_BIN_NONE		0xffffffffU
+#define NI_ADDRCONF_LEASE_BIN_NO_NAME		0xffU
+#define NI_ADDRCONF_LEASE_BIN_MAX_DEPTH		32
+
+static int
+__ni_addrconf_lease_bin_put(ni_buffer_t *bp, const void *data, size_t len)
+{
+	if (ni_buffer_tailroom(bp) < len)
+		ni_buffer_ensure_tailroom(bp, len > bp->size ? len : bp->size);
+	return ni_buffer_put(bp, data, len);
+}
+
+static int
+__ni_addrconf_lease_bin_put_uint16(ni_buffer_t *bp, unsigned int value)
+{
+	uint16_t data = htons(value);
+
+	if (value > 0xffff)
+		return -1;
+	return __ni_addrconf_lease_bin_put(bp, &data, sizeof(data));
+}
+
+static int
+__ni_addrconf_lease_bin_put_string(ni_buffer_t *bp, const char *str)
+{
+	size_t len = str ? strlen(str) : 0;
+	uint32_t data;
+
+	data = htonl(str ? len : NI_ADDRCONF_LEASE_BIN_NONE);
+	if (__ni_addrconf_lease_bin_put(bp, &data, sizeof(data)) < 0)
+		return -1;
+	return __ni_addrconf_lease_bin_put(bp, str, len);
+}
+
+static int
+__ni_addrconf_lease_bin_put_name(ni_buffer_t *bp, const char *name)
+{
+	size_t len = name ? strlen(name) : 0;
+	unsigned char data;
+
+	if (len >= NI_ADDRCONF_LEASE_BIN_NO_NAME)
+		return -1;
+	data = name ? len : NI_ADDRCONF_LEASE_BIN_NO_NAME;
+	if (__ni_addrconf_lease_bin_put(bp, &data, sizeof(data)) < 0)
+		return -1;
+	return __ni_addrconf_lease_bin_put(bp, name, len);
+}
+
+static int
+__ni_addrconf_lease_bin_put_node(ni_buffer_t *bp, const xml_node_t *node)
+{
+	const xml_node_t *child;
+	unsigned int i, count = 0;
+
+	for (child = node->children; child; child = child->next)
+		count++;
+
+	if (__ni_addrconf_lease_bin_put_name(bp, node->name) < 0
+	 || __ni_addrconf_lease_bin_put_uint16(bp, node->attrs.count) < 0
+	 || __ni_addrconf_lease_bin_put_uint16(bp, count) < 0
+	 || __ni_addrconf_lease_bin_put_string(bp, node->cdata) < 0)
+		return -1;
+
+	for (i = 0; i < node->attrs.count; ++i) {
+		const ni_var_t *attr = &node->attrs.data[i];
+
+		if (__ni_addrconf_lease_bin_put_name(bp, attr->name) < 0
+		 || __ni_addrconf_lease_bin_put_string(bp, attr->value) < 0)
+			return -1;
+	}
+
+	for (child = node->children; child; child = child->next) {
+		if (__ni_addrconf_lease_bin_put_node(bp, child) < 0)
+			return -1;
+	}
+	return 0;
+}
+
+/*
+ * Encode the lease xml tree including the file header into bp
+ */
+static int
+__ni_addrconf_lease_bin_encode(ni_buffer_t *bp, const xml_node_t *root)
+{
+	unsigned char *hdr;
+	uint32_t len, crc;
+	uint16_t version;
+
+	if (__ni_addrconf_lease_bin_put(bp, NULL, NI_ADDRCONF_LEASE_BIN_HDR_LEN) < 0
+	 || __ni_addrconf_lease_bin_put_node(bp, root) < 0)
+		return -1;
+
+	hdr = bp->base + bp->head;
+	len = ni_buffer_count(bp) - NI_ADDRCONF_LEASE_BIN_HDR_LEN;
+	crc = ni_crc32(0, hdr + NI_ADDRCONF_LEASE_BIN_HDR_LEN, len);
+	version = htons(NI_ADDRCONF_LEASE_BIN_VERSION);
+	len = htonl(len);
+	crc = htonl(crc);
+
+	memcpy(hdr, NI_ADDRCONF_LEASE_BIN_MAGIC, 4);
+	memcpy(hdr + 4, &version, 2);
+	memset(hdr + 6, 0, 2);
+	memcpy(hdr + 8, &len, 4);
+	memcpy(hdr + 12, &crc, 4);
+	return 0;
+}
+
+static int
+__ni_addrconf_lease_bin_get_string(ni_buffer_t *bp, char **str)
+{
+	const char *ptr;
+	uint32_t len;
+
+	if (ni_buffer_get_uint32(bp, &len) < 0)
+		return -1;
+	if (len == NI_ADDRCONF_LEASE_BIN_NONE)
+		return 0;
+	if (!(ptr = ni_buffer_pull_head(bp, len)))
+		return -1;
+	if (len == 0)
+		return ni_string_dup(str, "") ? 0 : -1;
+	return ni_string_set(str, ptr, len) ? 0 : -1;
+}
+
+static int
+__ni_addrconf_lease_bin_get_name(ni_buffer_t *bp, char *name, const char **namep)
+{
+	const char *ptr;
+	int len;
+
+	if ((len = ni_buffer_getc(bp)) < 0)
+		return -1;
+	if (len == NI_ADDRCONF_LEASE_BIN_NO_NAME) {
+		*namep = NULL;
+		return 0;
+	}
+	if (!(ptr = ni_buffer_pull_head(bp, len)))
+		return -1;
+	memcpy(name, ptr, len);
+	name[len] = '\0';
+	*namep = name;
+	return 0;
+}
+
+static xml_node_t *
+__ni_addrconf_lease_bin_get_node(ni_buffer_t *bp, xml_node_t *parent, unsigned int depth)
+{
+	char namebuf[NI_ADDRCONF_LEASE_BIN_NO_NAME];
+	uint16_t nattrs, nchildren;
+	const char *name;
+	xml_node_t *node;
+	char *value = NULL;
+
+	if (depth > NI_ADDRCONF_LEASE_BIN_MAX_DEPTH
+	 || __ni_addrconf_lease_bin_get_name(bp, namebuf, &name) < 0
+	 || ni_buffer_get_uint16(bp, &nattrs) < 0
+	 || ni_buffer_get_uint16(bp, &nchildren) < 0)
+		return NULL;
+
+	node = xml_node_new(name, parent);
+	if (__ni_addrconf_lease_bin_get_string(bp, &node->cdata) < 0)
+		goto failure;
+
+	while (nattrs--) {
+		if (__ni_addrconf_lease_bin_get_name(bp, namebuf, &name) < 0 || !name
+		 || __ni_addrconf_lease_bin_get_string(bp, &value) < 0)
+			goto failure;
+		xml_node_add_attr(node, name, value);
+		ni_string_free(&value);
+	}
+
+	while (nchildren--) {
+		if (!__ni_addrconf_lease_bin_get_node(bp, node, depth + 1))
+			goto failure;
+	}
+	return node;
+
+failure:
+	/* children are attached to their parent; the root frees them all */
+	if (!parent)
+		xml_node_free(node);
+	ni_string_free(&value);
+	return NULL;
+}
+
+/*
+ * Decode a binary lease file image; returns NULL if it is not
+ * a (valid) binary lease.
+ */
+static xml_node_t *
+__ni_addrconf_lease_bin_decode(const unsigned char *data, size_t size, const char *filename)
+{
+	xml_node_t *root;
+	uint16_t version;
+	uint32_t len, crc;
+	ni_buffer_t buf;
+
+	ni_buffer_init_reader(&buf, (void *)data, size);
+	if (!ni_buffer_pull_head(&buf, 4) || memcmp(data, NI_ADDRCONF_LEASE_BIN_MAGIC, 4)
+	 || ni_buffer_get_uint16(&buf, &version) < 0 || !ni_buffer_pull_head(&buf, 2)
+	 || ni_buffer_get_uint32(&buf, &len) < 0 || ni_buffer_get_uint32(&buf, &crc) < 0) {
+		ni_error("%s: not a binary lease file", filename);
+		return NULL;
+	}
+	if (version != NI_ADDRCONF_LEASE_BIN_VERSION) {
+		ni_error("%s: unsupported binary lease version %u", filename, version);
+		return NULL;
+	}
+	if (len != ni_buffer_count(&buf)
+	 || crc != ni_crc32(0, ni_buffer_head(&buf), len)) {
+		ni_error("%s: binary lease file is truncated or corrupt", filename);
+		return NULL;
+	}
+
+	root = __ni_addrconf_lease_bin_get_node(&buf, NULL, 0);
+	if (root && ni_buffer_count(&buf)) {
+		xml_node_free(root);
+		root = NULL;
+	}
+	if (root == NULL)
+		ni_error("%s: unable to decode binary lease file", filename);
+	return root;
+}
+
+/*
+ * Load a lease file in binary or xml format as xml tree
+ */
+xml_node_t *
+ni_addrconf_lease_file_load(const char *filename)
+{
+	xml_node_t *xml = NULL;
+	struct stat st;
+	void *data;
+	FILE *fp;
+	int fd;
+
+	if ((fd = open(filename, O_RDONLY | O_CLOEXEC)) < 0) {
+		ni_error("Unable to open %s for reading: %m", filename);
+		return NULL;
+	}
+
+	/* a binary lease truncated within the header is still rejected */
+	if (fstat(fd, &st) == 0 && st.st_size >= (off_t)strlen(NI_ADDRCONF_LEASE_BIN_MAGIC)) {
+		data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data != MAP_FAILED) {
+			if (!memcmp(data, NI_ADDRCONF_LEASE_BIN_MAGIC, 4)) {
+				xml = __ni_addrconf_lease_bin_decode(data, st.st_size, filename);
+				munmap(data, st.st_size);
+				close(fd);
+				return xml;
+			}
+			munmap(data, st.st_size);
+		}
+	}
+
+	/* not a binary lease, try xml */
+	if ((fp = fdopen(fd, "re")) == NULL) {
+		close(fd);
+		return NULL;
+	}
+	xml = xml_node_scan(fp, filename);
+	fclose(fp);
+	if (xml == NULL)
+		ni_error("Unable to parse %s", filename);
+	return xml;
+}
+
 /*
  * lease file read and write routines
  */
 static const char *		__ni_addrconf_lease_file_path(char **,
-				const char *, const char *, int, int);
+				const char *, const char *, int, int,
+				const char *);
 static void			__ni_addrconf_lease_file_remove(
-				const char *, const char *, int, int);
+				const char *, const char *, int, int,
+				const char *);
+
+static int
+__ni_addrconf_lease_file_write_data(int fd, const unsigned char *data, size_t len)
+{
+	ssize_t ret;
+
+	while (len) {
+		ret = write(fd, data, len);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		data += ret;
+		len -= ret;
+	}
+	return 0;
+}
 
 /*
  * Write a lease to a file
@@ -1255,7 +1567,7 @@ ni_addrconf_lease_file_write(const char *ifname, ni_addrconf_lease_t *lease)
 	ni_bool_t fallback = FALSE;
 	char *filename = NULL;
 	xml_node_t *xml = NULL;
-	FILE *fp = NULL;
+	ni_buffer_t buf;
 	int ret = -1;
 	int fd;
 
@@ -1265,7 +1577,8 @@ ni_addrconf_lease_file_write(const char *ifname, ni_addrconf_lease_t *lease)
 	}
 
 	if (!__ni_addrconf_lease_file_path(&filename, ni_config_storedir(),
-					ifname, lease->type, lease->family)) {
+					ifname, lease->type, lease->family,
+					NI_ADDRCONF_LEASE_FILE_BIN)) {
 		ni_error("Cannot construct lease file name: %m");
 		return -1;
 	}
@@ -1281,6 +1594,17 @@ ni_addrconf_lease_file_write(const char *ifname, ni_addrconf_lease_t *lease)
 					ni_addrfamily_type_to_name(lease->family),
 					ni_addrconf_type_to_name(lease->type));
 		}
+		ni_string_free(&filename);
+		return -1;
+	}
+
+	ni_buffer_init_dynamic(&buf, 1024);
+	ret = __ni_addrconf_lease_bin_encode(&buf, xml);
+	xml_node_free(xml);
+	if (ret < 0) {
+		ni_error("Unable to encode %s:%s lease",
+				ni_addrfamily_type_to_name(lease->family),
+				ni_addrconf_type_to_name(lease->type));
 		goto failed;
 	}
 
@@ -1288,7 +1612,8 @@ ni_addrconf_lease_file_write(const char *ifname, ni_addrconf_lease_t *lease)
 	if ((fd = mkstemp(tempname)) < 0) {
 		if (errno == EROFS && __ni_addrconf_lease_file_path(&filename,
 						ni_config_statedir(), ifname,
-						lease->type, lease->family)) {
+						lease->type, lease->family,
+						NI_ADDRCONF_LEASE_FILE_BIN)) {
 			ni_debug_dhcp("Read-only filesystem, try fallback to %s",
 					filename);
 			snprintf(tempname, sizeof(tempname), "%s.XXXXXX", filename);
@@ -1303,36 +1628,41 @@ ni_addrconf_lease_file_write(const char *ifname, ni_addrconf_lease_t *lease)
 			goto failed;
 		}
 	}
-	if ((fp = fdopen(fd, "we")) == NULL) {
+
+	ni_debug_dhcp("Writing lease to temporary file for '%s'", filename);
+	ret = __ni_addrconf_lease_file_write_data(fd, ni_buffer_head(&buf), ni_buffer_count(&buf));
+	if (close(fd) < 0 || ret < 0) {
+		ni_error("Unable to write temporary lease file '%s': %m", tempname);
 		ret = -1;
-		close(fd);
-		ni_error("Cannot reopen temporary lease file '%s': %m", tempname);
 		goto failed;
 	}
 
-	ni_debug_dhcp("Writing lease to temporary file for '%s'", filename);
-	xml_node_print(xml, fp);
-	fclose(fp);
-	xml_node_free(xml);
-
 	if ((ret = rename(tempname, filename)) != 0) {
 		ni_error("Unable to rename temporary lease file '%s' to '%s': %m",
 				tempname, filename);
 		goto failed;
-	} else if (!fallback) {
+	}
+
+	/* drop the lease files it supersedes */
+	__ni_addrconf_lease_file_remove(fallback ? ni_config_statedir() : ni_config_storedir(),
+				ifname, lease->type, lease->family,
+				NI_ADDRCONF_LEASE_FILE_XML);
+	if (!fallback && !ni_string_eq(ni_config_statedir(), ni_config_storedir())) {
 		__ni_addrconf_lease_file_remove(ni_config_statedir(),
-				ifname, lease->type, lease->family);
+				ifname, lease->type, lease->family,
+				NI_ADDRCONF_LEASE_FILE_BIN);
+		__ni_addrconf_lease_file_remove(ni_config_statedir(),
+				ifname, lease->type, lease->family,
+				NI_ADDRCONF_LEASE_FILE_XML);
 	}
 
 	ni_debug_dhcp("Lease written to file '%s'", filename);
+	ni_buffer_destroy(&buf);
 	ni_string_free(&filename);
 	return 0;
 
 failed:
-	if (fp)
-		fclose(fp);
-	if (xml)
-		xml_node_free(xml);
+	ni_buffer_destroy(&buf);
 	if (tempname[0])
 		unlink(tempname);
 	ni_string_free(&filename);
@@ -1340,49 +1670,40 @@ failed:
 }
 
 /*
- * Read a lease from a file
+ * Read a lease from a file; the binary format is preferred over xml
+ * and the statedir (read-only storedir fallback) over the storedir.
  */
 ni_addrconf_lease_t *
 ni_addrconf_lease_file_read(const char *ifname, int type, int family)
 {
+	static const char *formats[] = {
+		NI_ADDRCONF_LEASE_FILE_BIN,
+		NI_ADDRCONF_LEASE_FILE_XML,
+	};
 	ni_addrconf_lease_t *lease = NULL;
 	xml_node_t *xml = NULL, *lnode;
 	char *filename = NULL;
-	FILE *fp;
-
-	if (!__ni_addrconf_lease_file_path(&filename,
-				ni_config_statedir(),
-				ifname, type, family)) {
-		ni_error("Unable to construct lease file name: %m");
-		return NULL;
-	}
+	const char *dirs[2];
+	unsigned int i;
 
-	if ((fp = fopen(filename, "re")) == NULL) {
-		if (errno == ENOENT) {
-			if (__ni_addrconf_lease_file_path(&filename,
-						ni_config_storedir(),
-						ifname, type, family))
-				fp = fopen(filename, "re");
-		}
-		if (fp == NULL) {
-			if (errno != ENOENT) {
-				ni_error("Unable to open %s for reading: %m",
-						filename);
-			}
-			ni_string_free(&filename);
+	dirs[0] = ni_config_statedir();
+	dirs[1] = ni_config_storedir();
+	for (i = 0; !xml && i < 4; ++i) {
+		if (!__ni_addrconf_lease_file_path(&filename, dirs[i / 2],
+					ifname, type, family, formats[i % 2])) {
+			ni_error("Unable to construct lease file name: %m");
 			return NULL;
 		}
-	}
 
-	ni_debug_dhcp("Reading lease from %s", filename);
-	xml = xml_node_scan(fp, filename);
-	fclose(fp);
+		if (ni_file_exists(filename))
+			xml = ni_addrconf_lease_file_load(filename);
+	}
 
 	if (xml == NULL) {
-		ni_error("Unable to parse %s", filename);
 		ni_string_free(&filename);
 		return NULL;
 	}
+	ni_debug_dhcp("Read lease from %s", filename);
 
 	/* find the lease node already here, so we can report it */
 	if (!ni_string_eq(xml->name, NI_ADDRCONF_LEASE_XML_NODE))
@@ -1397,7 +1718,7 @@ ni_addrconf_lease_file_read(const char *ifname, int type, int family)
 	}
 
 	if (ni_addrconf_lease_from_xml(&lease, xml, ifname) < 0) {
-		ni_error("Unable to parse xml lease file '%s'", filename);
+		ni_error("Unable to parse lease file '%s'", filename);
 		ni_string_free(&filename);
 		xml_node_free(xml);
 		return NULL;
@@ -1413,11 +1734,11 @@ ni_addrconf_lease_file_read(const char *ifname, int type, int family)
  */
 static void
 __ni_addrconf_lease_file_remove(const char *dir, const char *ifname,
-				int type, int family)
+				int type, int family, const char *format)
 {
 	char *filename = NULL;
 
-	if (!__ni_addrconf_lease_file_path(&filename, dir, ifname, type, family))
+	if (!__ni_addrconf_lease_file_path(&filename, dir, ifname, type, family, format))
 		return;
 
 	if (ni_file_exists(filename) && unlink(filename) == 0)
@@ -1428,34 +1749,41 @@ __ni_addrconf_lease_file_remove(const char *dir, const char *ifname,
 void
 ni_addrconf_lease_file_remove(const char *ifname, int type, int family)
 {
-	__ni_addrconf_lease_file_remove(ni_config_statedir(), ifname, type, family);
-	__ni_addrconf_lease_file_remove(ni_config_storedir(), ifname, type, family);
+	__ni_addrconf_lease_file_remove(ni_config_statedir(), ifname, type, family,
+					NI_ADDRCONF_LEASE_FILE_BIN);
+	__ni_addrconf_lease_file_remove(ni_config_statedir(), ifname, type, family,
+					NI_ADDRCONF_LEASE_FILE_XML);
+	__ni_addrconf_lease_file_remove(ni_config_storedir(), ifname, type, family,
+					NI_ADDRCONF_LEASE_FILE_BIN);
+	__ni_addrconf_lease_file_remove(ni_config_storedir(), ifname, type, family,
+					NI_ADDRCONF_LEASE_FILE_XML);
 }
 
 static const char *
 __ni_addrconf_lease_file_path(char **path, const char *dir,
-		const char *ifname, int type, int family)
+		const char *ifname, int type, int family, const char *format)
 {
 	const char *t = ni_addrconf_type_to_name(type);
 	const char *f = ni_addrfamily_type_to_name(family);
 
 	if (!path || ni_string_empty(dir) || ni_string_empty(ifname) || !t || !f)
 		return NULL;
-	return ni_string_printf(path, "%s/lease-%s-%s-%s.xml", dir, ifname, t, f);
+	return ni_string_printf(path, "%s/lease-%s-%s-%s.%s", dir, ifname, t, f, format);
 }
 
 ni_bool_t
 ni_addrconf_lease_file_exists(const char *ifname, int type, int family)
 {
+	const char *dirs[2];
 	char *filename = NULL;
+	unsigned int i;
 
-	if (__ni_addrconf_lease_file_path(&filename, ni_config_statedir(), ifname, type, family)) {
-		if (ni_file_exists(filename)) {
-			ni_string_free(&filename);
-			return TRUE;
-		}
-	}
-	if (__ni_addrconf_lease_file_path(&filename, ni_config_storedir(), ifname, type, family)) {
+	dirs[0] = ni_config_statedir();
+	dirs[1] = ni_config_storedir();
+	for (i = 0; i < 4; ++i) {
+		if (!__ni_addrconf_lease_file_path(&filename, dirs[i / 2], ifname, type, family,
+				i % 2 ? NI_ADDRCONF_LEASE_FILE_XML : NI_ADDRCONF_LEASE_FILE_BIN))
+			continue;
 		if (ni_file_exists(filename)) {
 			ni_string_free(&filename);
 			return TRUE;
@@ -1464,4 +1792,3 @@ ni_addrconf_lease_file_exists(const char *ifname, int type, int family)
 	ni_string_free(&filename);
 	return FALSE;
 }
-
@@ -32,6 +32,9 @@
  * constants to avoid construction using the
  * ni_addrconf/family_type_to_name functions.
  */
+#define NI_ADDRCONF_LEASE_FILE_BIN			"bin"
+#define NI_ADDRCONF_LEASE_FILE_XML			"xml"
+
 #define	NI_ADDRCONF_LEASE_XML_NODE			"lease"
 #define NI_ADDRCONF_LEASE_XML_DHCP4_NODE		"ipv4:dhcp"
 #define NI_ADDRCONF_LEASE_XML_DHCP6_NODE		"ipv6:dhcp"
@@ -22,6 +22,7 @@
 #include <time.h>
 #include <net/if_arp.h>
 #include <net/ethernet.h>
+#include <netpacket/packet.h>
 #include <stdarg.h>
 
 #if defined(HAVE_DCB_ATTR_IEEE_MAXRATE) && defined(HAVE_LINUX_DCBNL_H)
@@ -37,18 +38,25 @@
 #include "lldp-priv.h"
 
 /*
- * Maximum number of LLDP peer entries we keep
+ * Maximum number of LLDP peer entries we keep per agent
  */
 #define NI_LLDP_MAX_PEERS	256
 
+/*
+ * Agents due for transmission are sent in bursts of at most
+ * NI_LLDP_TX_BURST PDUs, NI_LLDP_TX_SPACING msec apart.
+ */
+#define NI_LLDP_TX_BURST	8
+#define NI_LLDP_TX_SPACING	20
+
 typedef struct ni_lldp_agent ni_lldp_agent_t;
 typedef struct ni_lldp_peer ni_lldp_peer_t;
 
 struct ni_lldp_agent {
-	ni_lldp_agent_t *	next;
+	ni_lldp_agent_t *	next;		/* in order of tx_due */
 	unsigned int		ifindex;
 
-	const ni_timer_t *	txTTR;
+	struct timeval		tx_due;
 	uint16_t		msgFastTx;
 	uint16_t		msgTxHold;
 	uint16_t		msgTxInterval;
@@ -65,21 +73,41 @@ struct ni_lldp_agent {
 	ni_lldp_t *		config;
 	ni_dcbx_state_t *	dcbx;
 
-	ni_lldp_peer_t *	peers;
+	ni_lldp_peer_t *	peers;		/* in order of increasing expiry */
+	ni_lldp_peer_t *	peers_tail;
+	ni_hashtable_t		peer_index;	/* peers by raw id */
+	ni_lldp_stats_t		stats;
 
-	ni_capture_t *		capture;
 	ni_buffer_t		sendbuf;
 };
 
 struct ni_lldp_peer {
 	ni_lldp_peer_t *	next;
+	ni_lldp_peer_t *	prev;
+	unsigned int		hash;
 	time_t			expires;
 	ni_lldp_t *		data;
 	unsigned int		raw_id_len;
 	unsigned char		raw_id[0];
 };
 
-static ni_lldp_agent_t *	ni_lldp_agents;
+/*
+ * All agents share one ETH_P_LLDP capture bound to all interfaces
+ * and one tx timer. Received PDUs are passed to the agent of the
+ * interface they arrived on. The agent list is kept in order of the
+ * next transmission and the timer is armed for its head.
+ */
+static struct ni_lldp_engine {
+	ni_capture_t *		capture;
+	ni_lldp_agent_t *	agents;
+	ni_hashtable_t		index;		/* agents by ifindex */
+
+	const ni_timer_t *	timer;
+	struct timeval		timer_due;
+	ni_bool_t		tx_running;
+
+	unsigned long		rx_unknown;
+} ni_lldp_engine;
 
 static ni_hwaddr_t		ni_lldp_destaddr[__NI_LLDP_DEST_MAX] = {
 [NI_LLDP_DEST_NEAREST_BRIDGE] = {
@@ -110,9 +138,11 @@ static void		ni_lldp_agent_free(ni_lldp_agent_t *);
 static int		ni_lldp_agent_update(ni_lldp_agent_t *, ni_lldp_t *, const void *, unsigned int);
 static void		ni_lldp_tx_timer_arm(ni_lldp_agent_t *);
 static void		ni_lldp_tx_timer_arm_quick(ni_lldp_agent_t *);
+static void		ni_lldp_tx_timer_arm_now(ni_lldp_agent_t *);
+static void		ni_lldp_tx_timer_update(unsigned long);
 static void		ni_lldp_receive(ni_socket_t *);
 static ni_lldp_peer_t *	ni_lldp_peer_new(const void *raw_id, unsigned int raw_id_len);
-static void		ni_lldp_peer_unlink_and_free(ni_lldp_peer_t **);
+static void		ni_lldp_peer_drop(ni_lldp_agent_t *, ni_lldp_peer_t *);
 static int		ni_lldp_pdu_build(const ni_lldp_t *, ni_dcbx_state_t *, ni_buffer_t *);
 static int		ni_lldp_pdu_parse(ni_lldp_t *, ni_buffer_t *);
 static int		ni_lldp_pdu_get_raw_id(ni_buffer_t *, const void **, unsigned int *);
@@ -204,6 +234,7 @@ ni_lldp_peer_new(const void *raw_id, unsigned int raw_id_len)
 	ni_lldp_peer_t *peer;
 
 	peer = xcalloc(1, sizeof(*peer) + raw_id_len);
+	peer->hash = ni_hash_bytes(raw_id, raw_id_len);
 	peer->raw_id_len = raw_id_len;
 	memcpy(peer->raw_id, raw_id, raw_id_len);
 	return peer;
@@ -215,15 +246,71 @@ ni_lldp_peer_free(ni_lldp_peer_t *peer)
 	ni_lldp_free(peer->data);
 	free(peer);
 }
+
+static ni_lldp_peer_t *
+ni_lldp_peer_find(const ni_lldp_agent_t *agent, const void *raw_id, unsigned int raw_id_len)
+{
+	ni_hashtable_iter_t iter;
+	ni_lldp_peer_t *peer;
+
+	peer = ni_hashtable_lookup(&agent->peer_index, ni_hash_bytes(raw_id, raw_id_len), &iter);
+	for ( ; peer; peer = ni_hashtable_lookup_next(&iter)) {
+		if (peer->raw_id_len == raw_id_len
+		 && !memcmp(peer->raw_id, raw_id, raw_id_len))
+			break;
+	}
+	return peer;
+}
+
+/*
+ * Insert a peer in order of increasing expiry. A refreshed peer
+ * usually expires last, so search from the tail.
+ */
 static void
-ni_lldp_peer_unlink_and_free(ni_lldp_peer_t **pos)
+ni_lldp_peer_link(ni_lldp_agent_t *agent, ni_lldp_peer_t *peer)
 {
-	ni_lldp_peer_t *peer = *pos;
+	ni_lldp_peer_t *prev;
+
+	for (prev = agent->peers_tail; prev && prev->expires > peer->expires; prev = prev->prev)
+		;
 
-	if (peer) {
-		*pos = peer->next;
-		ni_lldp_peer_free(peer);
+	peer->prev = prev;
+	if (prev) {
+		peer->next = prev->next;
+		prev->next = peer;
+	} else {
+		peer->next = agent->peers;
+		agent->peers = peer;
 	}
+	if (peer->next)
+		peer->next->prev = peer;
+	else
+		agent->peers_tail = peer;
+}
+
+static void
+ni_lldp_peer_unlink(ni_lldp_agent_t *agent, ni_lldp_peer_t *peer)
+{
+	if (peer->prev)
+		peer->prev->next = peer->next;
+	else if (agent->peers == peer)
+		agent->peers = peer->next;
+	else
+		return;
+
+	if (peer->next)
+		peer->next->prev = peer->prev;
+	else
+		agent->peers_tail = peer->prev;
+	peer->next = peer->prev = NULL;
+}
+
+static void
+ni_lldp_peer_drop(ni_lldp_agent_t *agent, ni_lldp_peer_t *peer)
+{
+	ni_lldp_peer_unlink(agent, peer);
+	ni_hashtable_remove(&agent->peer_index, peer->hash, peer);
+	ni_lldp_peer_free(peer);
 }
 
 static inline ni_bool_t
@@ -291,11 +378,14 @@ ni_system_lldp_up(ni_netdev_t *dev, const ni_lldp_t *config)
 	if (config || dcbx) {
 		ni_lldp_t *lldp = config? ni_lldp_clone(config) : ni_lldp_new();
 
-		if (ni_lldp_agent_start(dev, lldp, dcbx) < 0)
-			return -1;
+		/* Record the LLDP config requested by the user; the
+		 * agent owns and completes its own copy */
+		ni_netdev_set_lldp(dev, ni_lldp_clone(lldp));
 
-		/* Record the LLDP config requested by the user */
-		ni_netdev_set_lldp(dev, lldp);
+		if (ni_lldp_agent_start(dev, lldp, dcbx) < 0) {
+			ni_netdev_set_lldp(dev, NULL);
+			return -1;
+		}
 	} else {
 		/* Else: stop LLDP */
 		ni_netdev_set_lldp(dev, NULL);
@@ -326,6 +416,8 @@ ni_lldp_agent_new(ni_netdev_t *dev, unsigned int mtu)
 	ni_buffer_init(&agent->sendbuf, (void *) (agent + 1), mtu);
 
 	agent->dev = ni_netdev_get(dev);
+	agent->ifindex = dev->link.ifindex;
+	ni_hashtable_init(&agent->peer_index);
 
 	/* init tx state machine variables with recommended defaults */
 	agent->msgFastTx = 1;
@@ -346,37 +438,91 @@ ni_lldp_agent_new(ni_netdev_t *dev, unsigned int mtu)
 void
 ni_lldp_agent_free(ni_lldp_agent_t *agent)
 {
-	ni_capture_free(agent->capture);
 	ni_lldp_free(agent->config);
-	if (agent->txTTR)
-		ni_timer_cancel(agent->txTTR);
 	if (agent->dev)
 		ni_netdev_put(agent->dev);
 	if (agent->dcbx)
 		ni_dcbx_free(agent->dcbx);
 	ni_buffer_destroy(&agent->sendbuf);
 	while (agent->peers)
-		ni_lldp_peer_unlink_and_free(&agent->peers);
+		ni_lldp_peer_drop(agent, agent->peers);
+	ni_hashtable_destroy(&agent->peer_index);
 	free(agent);
 }
 
 static ni_lldp_agent_t *
-__ni_lldp_take_agent(unsigned int ifindex, ni_lldp_agent_t ***pos_ret)
+ni_lldp_agent_find(unsigned int ifindex)
+{
+	ni_hashtable_iter_t iter;
+	ni_lldp_agent_t *agent;
+
+	agent = ni_hashtable_lookup(&ni_lldp_engine.index, ni_hash_uint(ifindex), &iter);
+	while (agent && agent->ifindex != ifindex)
+		agent = ni_hashtable_lookup_next(&iter);
+	return agent;
+}
+
+static void
+ni_lldp_agent_unschedule(ni_lldp_agent_t *agent)
 {
-	ni_lldp_agent_t *agent, **pos;
+	ni_lldp_agent_t **pos;
 
-	for (pos = &ni_lldp_agents; (agent = *pos) != NULL; pos = &agent->next) {
-		if (agent->ifindex == ifindex) {
+	for (pos = &ni_lldp_engine.agents; *pos; pos = &(*pos)->next) {
+		if (*pos == agent) {
 			*pos = agent->next;
 			agent->next = NULL;
 			break;
 		}
 	}
+}
+
+static ni_lldp_agent_t *
+__ni_lldp_take_agent(unsigned int ifindex)
+{
+	ni_lldp_agent_t *agent;
 
-	*pos_ret = pos;
+	if ((agent = ni_lldp_agent_find(ifindex)) != NULL) {
+		ni_hashtable_remove(&ni_lldp_engine.index, ni_hash_uint(ifindex), agent);
+		ni_lldp_agent_unschedule(agent);
+		ni_lldp_tx_timer_update(0);
+	}
 	return agent;
 }
 
+/*
+ * The shared capture is opened with the first agent and closed
+ * again when the last one is gone.
+ */
+static ni_bool_t
+ni_lldp_engine_open(void)
+{
+	ni_capture_protinfo_t protinfo;
+
+	if (ni_lldp_engine.capture)
+		return TRUE;
+
+	memset(&protinfo, 0, sizeof(protinfo));
+	protinfo.eth_protocol = ETHERTYPE_LLDP;
+	protinfo.eth_destaddr = ni_lldp_destaddr[NI_LLDP_DEST_NEAREST_BRIDGE];
+
+	ni_lldp_engine.capture = ni_capture_open_any(&protinfo, ni_lldp_receive);
+	return ni_lldp_engine.capture != NULL;
+}
+
+static void
+ni_lldp_engine_release(void)
+{
+	if (ni_lldp_engine.index.count)
+		return;
+
+	if (ni_lldp_engine.timer)
+		ni_timer_cancel(ni_lldp_engine.timer);
+	ni_lldp_engine.timer = NULL;
+	ni_capture_free(ni_lldp_engine.capture);
+	ni_lldp_engine.capture = NULL;
+	ni_hashtable_destroy(&ni_lldp_engine.index);
+}
+
 static int
 __ni_lldp_agent_configure(ni_netdev_t *dev, ni_lldp_t *lldp)
 {
@@ -446,59 +592,77 @@ ni_lldp_agent_configure(ni_lldp_agent_t *agent, ni_netdev_t *dev, ni_lldp_t *lld
 static int
 ni_lldp_agent_start(ni_netdev_t *dev, ni_lldp_t *lldp, ni_dcbx_state_t *dcbx)
 {
-	ni_lldp_agent_t *agent, **pos;
-	ni_capture_t *capture = NULL;
+	ni_lldp_agent_t *agent;
 
-	if ((agent = __ni_lldp_take_agent(dev->link.ifindex, &pos)) != NULL) {
-		capture = agent->capture;
-		agent->capture = NULL;
+	if ((agent = __ni_lldp_take_agent(dev->link.ifindex)) != NULL)
 		ni_lldp_agent_free(agent);
-	}
 
 	agent = ni_lldp_agent_new(dev, 1500);
-	agent->next = *pos;
-	*pos = agent;
-
-	if (ni_lldp_agent_configure(agent, dev, lldp, dcbx) < 0)
+	if (ni_lldp_agent_configure(agent, dev, lldp, dcbx) < 0
+	 || agent->config->destination >= __NI_LLDP_DEST_MAX
+	 || !ni_lldp_engine_open()) {
+		ni_lldp_agent_free(agent);
+		ni_lldp_engine_release();
 		return -1;
-
-	if (capture == NULL) {
-		ni_capture_devinfo_t devinfo;
-		ni_capture_protinfo_t protinfo;
-
-		memset(&protinfo, 0, sizeof(protinfo));
-		protinfo.eth_protocol = ETHERTYPE_LLDP;
-
-		if (agent->config->destination >= __NI_LLDP_DEST_MAX)
-			return -1;
-		protinfo.eth_destaddr = ni_lldp_destaddr[agent->config->destination];
-
-		if (ni_capture_devinfo_init(&devinfo, dev->name, &dev->link) < 0)
-			return -1;
-
-		capture = ni_capture_open(&devinfo, &protinfo, ni_lldp_receive);
 	}
-	agent->capture = capture;
 
-	ni_capture_set_user_data(capture, agent);
+	ni_hashtable_insert(&ni_lldp_engine.index, ni_hash_uint(agent->ifindex), agent);
 
-	ni_lldp_agent_send(agent);
+	/* The first PDU goes out with the next tx burst */
+	ni_lldp_tx_timer_arm_now(agent);
 	return 0;
 }
 
+static void
+ni_lldp_stats_debug(const char *name, const ni_lldp_stats_t *stats)
+{
+	ni_debug_lldp("%s: %u agents, %u peers (max %u), %lu rx, %lu rx errors, "
+			"%lu rx unknown, %lu inserts, %lu updates, %lu expired, "
+			"%lu shutdowns, %lu overflows, %lu tx, %lu tx deferred",
+			name, stats->agents, stats->peers, stats->peers_max,
+			stats->rx_frames, stats->rx_errors, stats->rx_unknown,
+			stats->inserts, stats->updates, stats->expired,
+			stats->shutdowns, stats->overflows,
+			stats->tx_frames, stats->tx_deferred);
+}
+
 void
 ni_lldp_agent_stop(ni_netdev_t *dev)
 {
-	ni_lldp_agent_t *agent, **pos;
+	ni_lldp_agent_t *agent;
+	ni_lldp_stats_t stats;
+
+	if (ni_debug_guard(NI_LOG_DEBUG, NI_TRACE_LLDP)) {
+		if (ni_lldp_get_stats(dev->link.ifindex, &stats))
+			ni_lldp_stats_debug(dev->name, &stats);
+		if (ni_lldp_get_stats(0, &stats) && stats.agents)
+			ni_lldp_stats_debug("LLDP engine", &stats);
+	}
 
-	if ((agent = __ni_lldp_take_agent(dev->link.ifindex, &pos)) != NULL) {
+	if ((agent = __ni_lldp_take_agent(dev->link.ifindex)) != NULL) {
 		/* While the device is still up, try to send a shutdown PDU */
 		if (ni_netdev_device_is_up(dev))
 			ni_lldp_agent_send_shutdown(agent);
+
+		ni_debug_lldp("%s: LLDP agent stopped", dev->name);
 		ni_lldp_agent_free(agent);
+		ni_lldp_engine_release();
 	}
 }
 
+static ni_bool_t
+ni_lldp_agent_xmit(ni_lldp_agent_t *agent)
+{
+	const ni_hwaddr_t *destaddr = &ni_lldp_destaddr[agent->config->destination];
+
+	if (ni_capture_send_to(ni_lldp_engine.capture, &agent->sendbuf,
+				agent->ifindex, destaddr) < 0)
+		return FALSE;
+
+	agent->stats.tx_frames++;
+	return TRUE;
+}
+
 static ni_bool_t
 ni_lldp_agent_send(ni_lldp_agent_t *agent)
 {
@@ -509,7 +673,8 @@ ni_lldp_agent_send(ni_lldp_agent_t *agent)
 	if (ni_buffer_count(&agent->sendbuf) == 0
 	 && ni_lldp_pdu_build(agent->config, agent->dcbx, &agent->sendbuf) < 0) {
 		ni_error("%s: error building LLDP PDU", agent->dev->name);
-		return -1;
+		ni_lldp_tx_timer_arm(agent);
+		return FALSE;
 	}
 
 	ni_timer_get_time(&now);
@@ -538,7 +703,7 @@ ni_lldp_agent_send(ni_lldp_agent_t *agent)
 
 		ni_debug_lldp("%s: sending LLDP packet (PDU len=%u)", agent->dev->name, ni_buffer_count(bp));
 		/* ni_debug_lldp(PDU=%s", ni_print_hex(ni_buffer_head(bp), ni_buffer_count(bp))); */
-		ni_capture_send(agent->capture, &agent->sendbuf, NULL);
+		ni_lldp_agent_xmit(agent);
 		agent->txCredit--;
 
 		/* Decrement txFast if we're in a fast retrans cycle */
@@ -550,6 +715,7 @@ ni_lldp_agent_send(ni_lldp_agent_t *agent)
 		rv = TRUE;
 	} else {
 		ni_debug_lldp("%s: cannot send LLDP packet (no credits)", agent->dev->name);
+		agent->stats.tx_deferred++;
 		ni_lldp_tx_timer_arm_quick(agent);
 	}
 
@@ -567,7 +733,7 @@ ni_lldp_agent_send_shutdown(ni_lldp_agent_t *agent)
 		return -1;
 	}
 
-	ni_capture_send(agent->capture, &agent->sendbuf, NULL);
+	ni_lldp_agent_xmit(agent);
 	return 0;
 }
 
@@ -585,22 +751,113 @@ ni_lldp_agent_enter_fast_rx(ni_lldp_agent_t *agent)
 	/* Do nothing if we're already in fast mode */
 	agent->txFast = agent->txFastInit;
 	if (!already_in_fast_mode)
-		ni_lldp_agent_send(agent);
+		ni_lldp_tx_timer_arm_now(agent);
+}
+
+static void
+ni_lldp_agent_expire_peers(ni_lldp_agent_t *agent, time_t now)
+{
+	ni_lldp_peer_t *peer;
+
+	/* Peers are sorted by order of increasing expiry timeout */
+	while ((peer = agent->peers) != NULL && peer->expires <= now) {
+		ni_lldp_peer_drop(agent, peer);
+		agent->stats.expired++;
+	}
 }
 
+/*
+ * LLDP tx schedule
+ *
+ * The agents are sent in order of their tx_due time; when more than
+ * NI_LLDP_TX_BURST are due at once, the rest follow in further bursts.
+ */
 static void
 ni_lldp_tx_timer_expires(void *user_data, const ni_timer_t *timer)
 {
-	ni_lldp_agent_t *agent = (ni_lldp_agent_t *) user_data;
+	ni_lldp_agent_t *agent;
+	unsigned int count = 0;
+	struct timeval now;
 
-	if (agent->txTTR != timer) {
+	if (ni_lldp_engine.timer != timer) {
 		ni_error("ni_lldp_tx_timer_expires: bad timer handle");
 		return;
 	}
-	agent->txTTR = NULL;
+	ni_lldp_engine.timer = NULL;
+
+	ni_timer_get_time(&now);
+	ni_lldp_engine.tx_running = TRUE;
+	while ((agent = ni_lldp_engine.agents) != NULL && count++ < NI_LLDP_TX_BURST) {
+		if (timercmp(&agent->tx_due, &now, >))
+			break;
+
+		/* FIXME: rebuild the packet? */
+		ni_lldp_agent_expire_peers(agent, now.tv_sec);
+		ni_lldp_agent_send(agent);
+	}
+	ni_lldp_engine.tx_running = FALSE;
+
+	ni_lldp_tx_timer_update(NI_LLDP_TX_SPACING);
+}
+
+static void
+ni_lldp_tx_timer_update(unsigned long min_timeout)
+{
+	ni_lldp_agent_t *head = ni_lldp_engine.agents;
+	unsigned long timeout = min_timeout;
+	struct timeval now, delta;
+	unsigned long msec;
+
+	if (ni_lldp_engine.tx_running)
+		return;
+
+	if (head == NULL) {
+		if (ni_lldp_engine.timer)
+			ni_timer_cancel(ni_lldp_engine.timer);
+		ni_lldp_engine.timer = NULL;
+		return;
+	}
+
+	if (ni_lldp_engine.timer && timercmp(&ni_lldp_engine.timer_due, &head->tx_due, ==))
+		return;
+
+	ni_timer_get_time(&now);
+	if (timercmp(&head->tx_due, &now, >)) {
+		timersub(&head->tx_due, &now, &delta);
+		msec = delta.tv_sec * 1000UL + delta.tv_usec / 1000;
+		if (timeout < msec)
+			timeout = msec;
+	}
+
+	ni_lldp_engine.timer_due = head->tx_due;
+	if (ni_lldp_engine.timer)
+		ni_lldp_engine.timer = ni_timer_rearm(ni_lldp_engine.timer, timeout);
+	if (ni_lldp_engine.timer == NULL)
+		ni_lldp_engine.timer = ni_timer_register(timeout, ni_lldp_tx_timer_expires, NULL);
+	if (ni_lldp_engine.timer == NULL)
+		ni_error("failed to arm LLDP tx timer");
+}
+
+static void
+ni_lldp_tx_schedule(ni_lldp_agent_t *agent, unsigned long timeout)
+{
+	ni_lldp_agent_t **pos, *cur;
+	struct timeval now, delta;
+
+	ni_timer_get_time(&now);
+	delta.tv_sec = timeout / 1000;
+	delta.tv_usec = (timeout % 1000) * 1000;
+	timeradd(&now, &delta, &agent->tx_due);
+
+	ni_lldp_agent_unschedule(agent);
+	for (pos = &ni_lldp_engine.agents; (cur = *pos) != NULL; pos = &cur->next) {
+		if (timercmp(&cur->tx_due, &agent->tx_due, >))
+			break;
+	}
+	agent->next = *pos;
+	*pos = agent;
 
-	/* FIXME: rebuild the packet? */
-	ni_lldp_agent_send(agent);
+	ni_lldp_tx_timer_update(0);
 }
 
 static void
@@ -609,13 +866,7 @@ __ni_lldp_tx_timer_arm(ni_lldp_agent_t *agent, unsigned int timeout)
 	static const ni_int_range_t jitter = { .min = 0, .max = 400 };
 
 	/* Apply a jitter between 0 and 0.4 sec */
-	timeout = ni_timeout_randomize(timeout, &jitter);
-
-	if (agent->txTTR)
-		ni_timer_cancel(agent->txTTR);
-	agent->txTTR = ni_timer_register(timeout, ni_lldp_tx_timer_expires, agent);
-	if (agent->txTTR == NULL)
-		ni_error("%s: failed to arm LLDP timer", agent->dev->name);
+	ni_lldp_tx_schedule(agent, ni_timeout_randomize(timeout, &jitter));
 }
 
 void
@@ -631,46 +882,45 @@ ni_lldp_tx_timer_arm_quick(ni_lldp_agent_t *agent)
 	__ni_lldp_tx_timer_arm(agent, 1000);
 }
 
+void
+ni_lldp_tx_timer_arm_now(ni_lldp_agent_t *agent)
+{
+	ni_lldp_tx_schedule(agent, 0);
+}
+
 /*
  * LLDP rx agent
  */
 static int
 ni_lldp_agent_update(ni_lldp_agent_t *agent, ni_lldp_t *lldp, const void *raw_id, unsigned int raw_id_len)
 {
-	ni_lldp_peer_t **pos, *peer, *found = NULL;
-	unsigned int npeers = 0;
+	ni_lldp_peer_t *peer;
+	unsigned int npeers;
 	time_t now;
 
 	now = time(NULL);
 
-	pos = &agent->peers;
+	/* First, expire any old entries */
+	ni_lldp_agent_expire_peers(agent, now);
 
-	/* First, expire any old entries. Note that peers are sorted by order
-	 * of increasing expiry timeout. */
-	while ((peer = *pos) != NULL && peer->expires <= now)
-		ni_lldp_peer_unlink_and_free(pos);
-
-	while ((peer = *pos) != NULL) {
-		if (peer->raw_id_len == raw_id_len
-		 && !memcmp(peer->raw_id, raw_id, raw_id_len)) {
-			found = peer;
-			*pos = peer->next;
-			peer->next = NULL;
-		} else {
-			*pos = peer->next;
-			npeers++;
-		}
-	}
-
-	if (found != NULL) {
-		ni_lldp_free(found->data);
-		found->data = NULL;
+	if ((peer = ni_lldp_peer_find(agent, raw_id, raw_id_len)) != NULL) {
+		ni_lldp_peer_unlink(agent, peer);
+		ni_lldp_free(peer->data);
+		peer->data = NULL;
+	} else if (lldp->ttl == 0) {
+		/* Bye from a peer we do not know */
+		ni_lldp_free(lldp);
+		return 0;
 	} else {
-		if (npeers >= NI_LLDP_MAX_PEERS) {
-			ni_debug_lldp("%s: too many LLDP peers, ignoring this PDU", __func__);
+		if (agent->peer_index.count >= NI_LLDP_MAX_PEERS) {
+			ni_debug_lldp("%s: too many LLDP peers, ignoring this PDU", agent->dev->name);
+			agent->stats.overflows++;
+			ni_lldp_free(lldp);
 			return -1;
 		}
-		found = ni_lldp_peer_new(raw_id, raw_id_len);
+		peer = ni_lldp_peer_new(raw_id, raw_id_len);
+		ni_hashtable_insert(&agent->peer_index, peer->hash, peer);
+		agent->stats.inserts++;
 
 		/* A new agent was found. Enter fast transmission mode */
 		ni_lldp_agent_enter_fast_rx(agent);
@@ -678,22 +928,22 @@ ni_lldp_agent_update(ni_lldp_agent_t *agent, ni_lldp_t *lldp, const void *raw_id
 
 	if (lldp->ttl == 0) {
 		/* The peer agent wanted to say bye */
-		ni_lldp_peer_free(found);
+		ni_lldp_peer_drop(agent, peer);
+		agent->stats.shutdowns++;
+		ni_lldp_free(lldp);
 		return 0;
 	}
 
 	/* Update/init the peer info */
-	found->expires = now + lldp->ttl;
-	found->data = lldp;
-
-	/* Insert in order of increasing timeout */
-	pos = &agent->peers;
-	while ((peer = *pos) != NULL && peer->expires < found->expires)
-		*pos = peer->next;
+	if (peer->expires)
+		agent->stats.updates++;
+	peer->expires = now + lldp->ttl;
+	peer->data = lldp;
+	ni_lldp_peer_link(agent, peer);
 
-	found->next = *pos;
-	*pos = found;
-	npeers++;
+	npeers = agent->peer_index.count;
+	if (npeers > agent->stats.peers_max)
+		agent->stats.peers_max = npeers;
 
 	/* If there is exactly one peer on the link, and that peer
 	 * announces its DCB configuration via DCBX, we should invoke
@@ -726,27 +976,43 @@ static void
 ni_lldp_receive(ni_socket_t *sock)
 {
 	ni_capture_t *capture = sock->user_data;
+	const struct sockaddr_ll *sll;
+	ni_lldp_agent_t *agent;
 	ni_sockaddr_t from;
 	ni_buffer_t buf;
 
 	/* FIXME: we need to store the MAC address we received this packet from.
 	 * This is needed for DCBX tie-breaking among other things. */
 	if (ni_capture_recv(capture, &buf, &from, "lldp") >= 0) {
-		ni_lldp_agent_t *agent = ni_capture_get_user_data(capture);
 		ni_buffer_t raw_id_buf;
 		const void *raw_id;
 		unsigned int raw_id_len;
 		ni_lldp_t *lldp;
 
+		/* The capture sees all interfaces, including what
+		 * other sockets send */
+		sll = (const struct sockaddr_ll *) &from.ss;
+		if (from.ss_family != AF_PACKET || sll->sll_pkttype == PACKET_OUTGOING)
+			return;
+
+		if (!(agent = ni_lldp_agent_find(sll->sll_ifindex))) {
+			ni_lldp_engine.rx_unknown++;
+			return;
+		}
+		agent->stats.rx_frames++;
+
 		/* Get the chassis and port ID TLVs as a raw string
 		 * of bytes. */
 		raw_id_buf = buf;
-		if (ni_lldp_pdu_get_raw_id(&raw_id_buf, &raw_id, &raw_id_len) < 0)
+		if (ni_lldp_pdu_get_raw_id(&raw_id_buf, &raw_id, &raw_id_len) < 0) {
+			agent->stats.rx_errors++;
 			return;
+		}
 
 		lldp = ni_lldp_new();
 		if (ni_lldp_pdu_parse(lldp, &buf) < 0) {
 			ni_debug_lldp("%s: failed to parse LLDP PDU", agent->dev->name);
+			agent->stats.rx_errors++;
 			ni_lldp_free(lldp);
 			return;
 		}
@@ -756,6 +1022,50 @@ ni_lldp_receive(ni_socket_t *sock)
 
 }
 
+/*
+ * Peer table statistics of the agent on @ifindex, or the sum
+ * over all agents when @ifindex is 0.
+ */
+static void
+ni_lldp_stats_add(ni_lldp_stats_t *sum, const ni_lldp_agent_t *agent)
+{
+	const ni_lldp_stats_t *stats = &agent->stats;
+
+	sum->agents++;
+	sum->peers += agent->peer_index.count;
+	sum->peers_max += stats->peers_max;
+	sum->rx_frames += stats->rx_frames;
+	sum->rx_errors += stats->rx_errors;
+	sum->inserts += stats->inserts;
+	sum->updates += stats->updates;
+	sum->expired += stats->expired;
+	sum->shutdowns += stats->shutdowns;
+	sum->overflows += stats->overflows;
+	sum->tx_frames += stats->tx_frames;
+	sum->tx_deferred += stats->tx_deferred;
+}
+
+ni_bool_t
+ni_lldp_get_stats(unsigned int ifindex, ni_lldp_stats_t *stats)
+{
+	const ni_lldp_agent_t *agent;
+
+	if (!stats)
+		return FALSE;
+
+	memset(stats, 0, sizeof(*stats));
+	if (ifindex) {
+		if (!(agent = ni_lldp_agent_find(ifindex)))
+			return FALSE;
+		ni_lldp_stats_add(stats, agent);
+	} else {
+		for (agent = ni_lldp_engine.agents; agent; agent = agent->next)
+			ni_lldp_stats_add(stats, agent);
+		stats->rx_unknown = ni_lldp_engine.rx_unknown;
+	}
+	return TRUE;
+}
+
 /*
  * Handling of IEEE 802.1 org-specific information
  */
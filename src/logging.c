@@ -8,11 +8,15 @@
 #endif
 
 #include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <syslog.h>
+#include <signal.h>
 #include <unistd.h>
+#include <errno.h>
 #include <sys/time.h>
 #include <time.h>
 
@@ -30,12 +34,15 @@
 
 unsigned int		ni_debug = 0;
 unsigned int		ni_log_level = NI_LOG_NOTICE;
+unsigned int		ni_log_trace_mask[NI_LOG_DEBUG3 + 1];
 static ni_bool_t	ni_debug_user_specified = FALSE;
 static unsigned int	ni_log_syslog;
 static const char *	ni_log_ident;
 static unsigned int	ni_log_opts;
 
 static void		__ni_log_level_set(unsigned int level);
+static void		__ni_log_stderr(const char *, const struct timeval *,
+					const char *, va_list, const char *);
 
 /*
  * debug options short text representation
@@ -169,6 +176,19 @@ ni_debug_facility_to_description(unsigned int facility)
 	return ni_format_uint_mapped(facility, __debug_flags_descriptions);
 }
 
+/*
+ * Precompute the enabled facilities per log level, so the
+ * debug macros need a single test
+ */
+static void
+__ni_log_trace_mask_update(void)
+{
+	unsigned int level;
+
+	for (level = 0; level <= NI_LOG_DEBUG3; ++level)
+		ni_log_trace_mask[level] = ni_log_level >= level ? ni_debug : 0;
+}
+
 static int
 __ni_enable_debug(const char *fac)
 {
@@ -201,6 +221,7 @@ __ni_enable_debug(const char *fac)
 		ni_debug = _debug;
 		if (ni_log_level < NI_LOG_DEBUG)
 			__ni_log_level_set(NI_LOG_DEBUG);
+		__ni_log_trace_mask_update();
 	}
 	return rv;
 }
@@ -251,6 +272,13 @@ ni_log_init(void)
 	if ((var = getenv("WICKED_LOG_LEVEL"))) {
 		ni_log_level_set(var);
 	}
+
+	if ((var = getenv("WICKED_LOG_RING"))) {
+		unsigned int size;
+
+		if (ni_parse_uint(var, &size, 10) == 0)
+			ni_log_ring_enable(size);
+	}
 }
 
 unsigned int
@@ -281,6 +309,7 @@ __ni_log_level_set(unsigned int level)
 		setlogmask(LOG_UPTO(LOG_DEBUG));
 		break;
 	}
+	__ni_log_trace_mask_update();
 }
 
 ni_bool_t
@@ -469,8 +498,8 @@ ni_log_destination(const char *progname, const char *destination)
 	return FALSE;
 }
 
-static inline void
-__ni_log_stderr(const char *tag, const char *fmt, va_list ap, const char *end)
+static void
+__ni_log_stderr(const char *tag, const struct timeval *when, const char *fmt, va_list ap, const char *end)
 {
 	/* rfc5424 / rfc3339 timestamp with ms precision, e.g.:
 	 * 	2013-11-07T19:29:38.663870+01:00
@@ -480,7 +509,10 @@ __ni_log_stderr(const char *tag, const char *fmt, va_list ap, const char *end)
 		struct tm lt;
 		char tzsign;
 
-		gettimeofday(&tv, NULL);
+		if (when)
+			tv = *when;
+		else
+			gettimeofday(&tv, NULL);
 		localtime_r(&tv.tv_sec, &lt);
 		if (lt.tm_gmtoff < 0) {
 			lt.tm_gmtoff *= -1;
@@ -518,7 +550,7 @@ ni_info(const char *fmt, ...)
 
 	va_start(ap, fmt);
 	if (!ni_log_syslog) {
-		__ni_log_stderr("Info: ", fmt, ap, "");
+		__ni_log_stderr("Info: ", NULL, fmt, ap, "");
 	} else {
 		vsyslog(LOG_INFO, fmt, ap);
 	}
@@ -535,7 +567,7 @@ ni_note(const char *fmt, ...)
 
 	va_start(ap, fmt);
 	if (!ni_log_syslog) {
-		__ni_log_stderr("Notice: ", fmt, ap, "");
+		__ni_log_stderr("Notice: ", NULL, fmt, ap, "");
 	} else {
 		vsyslog(LOG_NOTICE, fmt, ap);
 	}
@@ -552,7 +584,7 @@ ni_warn(const char *fmt, ...)
 
 	va_start(ap, fmt);
 	if (!ni_log_syslog) {
-		__ni_log_stderr("Warning: ", fmt, ap, "");
+		__ni_log_stderr("Warning: ", NULL, fmt, ap, "");
 	} else {
 		vsyslog(LOG_WARNING, fmt, ap);
 	}
@@ -566,7 +598,7 @@ ni_error(const char *fmt, ...)
 
 	va_start(ap, fmt);
 	if (!ni_log_syslog) {
-		__ni_log_stderr("Error: ", fmt, ap, "");
+		__ni_log_stderr("Error: ", NULL, fmt, ap, "");
 	} else {
 		vsyslog(LOG_ERR, fmt, ap);
 	}
@@ -584,13 +616,28 @@ ni_error_extra(const char *fmt, ...)
 
 	va_start(ap, fmt);
 	if (!ni_log_syslog) {
-		__ni_log_stderr("       ", fmt, ap, "");
+		__ni_log_stderr("       ", NULL, fmt, ap, "");
 	} else {
 		vsyslog(LOG_ERR, fmt, ap);
 	}
 	va_end(ap);
 }
 
+static ni_bool_t	ni_log_ring_record(unsigned int, const char *, va_list);
+
+static void
+__ni_trace(unsigned int facility, const char *fmt, va_list ap)
+{
+	if (ni_log_ring_record(facility, fmt, ap))
+		return;
+
+	if (!ni_log_syslog) {
+		__ni_log_stderr("::: ", NULL, fmt, ap, "");
+	} else {
+		vsyslog(LOG_DEBUG, fmt, ap);
+	}
+}
+
 void
 ni_trace(const char *fmt, ...)
 {
@@ -600,11 +647,20 @@ ni_trace(const char *fmt, ...)
 		return;
 
 	va_start(ap, fmt);
-	if (!ni_log_syslog) {
-		__ni_log_stderr("::: ", fmt, ap, "");
-	} else {
-		vsyslog(LOG_DEBUG, fmt, ap);
-	}
+	__ni_trace(0, fmt, ap);
+	va_end(ap);
+}
+
+/*
+ * Called by the debug macros after checking the facility
+ */
+void
+ni_debug_trace(unsigned int facility, const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	__ni_trace(facility, fmt, ap);
 	va_end(ap);
 }
 
@@ -613,9 +669,11 @@ ni_fatal(const char *fmt, ...)
 {
 	va_list ap;
 
+	ni_log_ring_dump();
+
 	va_start(ap, fmt);
 	if (!ni_log_syslog) {
-		__ni_log_stderr("FATAL ERROR: *** ", fmt, ap, " ***");
+		__ni_log_stderr("FATAL ERROR: *** ", NULL, fmt, ap, " ***");
 	} else {
 		vsyslog(LOG_CRIT, fmt, ap);
 	}
@@ -624,3 +682,445 @@ ni_fatal(const char *fmt, ...)
 	exit(1);
 }
 
+
+/*
+ * Trace ring
+ *
+ * With the ring enabled, debug messages are not formatted when they
+ * are logged: a fixed size record keeps the time, facility, format
+ * and arguments, with copies of string arguments and of the %m text.
+ * The oldest records are overwritten when the ring is full.
+ *
+ * The records are formatted and sent to the log destination when the
+ * process receives SIGUSR2 (at the next main loop iteration), before
+ * a fatal error and at exit. The signal handler only sets a flag and
+ * the daemons are single threaded, so the ring needs no locking.
+ */
+#define NI_LOG_RING_MAX_ARGS	8
+#define NI_LOG_RING_STRSIZE	192
+#define NI_LOG_RING_LINESIZE	1024
+
+typedef enum {
+	NI_LOG_ARG_NONE,
+	NI_LOG_ARG_INT,
+	NI_LOG_ARG_LONG,
+	NI_LOG_ARG_LLONG,
+	NI_LOG_ARG_SIZE,
+	NI_LOG_ARG_INTMAX,
+	NI_LOG_ARG_PTRDIFF,
+	NI_LOG_ARG_DOUBLE,
+	NI_LOG_ARG_LDOUBLE,
+	NI_LOG_ARG_PTR,
+	NI_LOG_ARG_STRING,
+	NI_LOG_ARG_ERRNO,
+	NI_LOG_ARG_INVALID,
+} ni_log_arg_type_t;
+
+typedef struct ni_log_ring_spec {
+	size_t			len;
+	unsigned int		stars;
+	ni_log_arg_type_t	type;
+} ni_log_ring_spec_t;
+
+typedef union ni_log_ring_arg {
+	intmax_t		i;
+	long double		ld;
+	const void *		p;
+	unsigned int		str;	/* offset into record strings */
+} ni_log_ring_arg_t;
+
+typedef struct ni_log_ring_record {
+	struct timeval		time;
+	unsigned int		facility;
+	const char *		fmt;	/* NULL when formatted into strings */
+	ni_log_ring_arg_t	args[NI_LOG_RING_MAX_ARGS];
+	char			strings[NI_LOG_RING_STRSIZE];
+} ni_log_ring_record_t;
+
+static struct ni_log_ring {
+	ni_log_ring_record_t *	records;
+	unsigned int		size;
+	unsigned long		head;	/* records logged */
+	unsigned long		tail;	/* records dumped */
+	volatile sig_atomic_t	dump;
+} ni_log_ring;
+
+/*
+ * Parse the conversion specification at fmt, which points to a '%'
+ */
+static const char *
+ni_log_ring_parse_spec(const char *fmt, ni_log_ring_spec_t *spec)
+{
+	const char *p = fmt + 1;
+	unsigned int longs = 0;
+	char size = 0;
+
+	spec->stars = 0;
+	spec->type = NI_LOG_ARG_INVALID;
+
+	while (*p == '#' || *p == '0' || *p == '-' || *p == ' ' || *p == '+' || *p == '\'')
+		p++;
+	if (*p == '*') {
+		spec->stars++;
+		p++;
+	} else {
+		while (*p >= '0' && *p <= '9')
+			p++;
+	}
+	if (*p == '.') {
+		p++;
+		if (*p == '*') {
+			spec->stars++;
+			p++;
+		} else {
+			while (*p >= '0' && *p <= '9')
+				p++;
+		}
+	}
+
+	for (;; ++p) {
+		if (*p == 'l')
+			longs++;
+		else if (*p == 'q')
+			longs += 2;
+		else if (*p == 'h' || *p == 'L' || *p == 'j' || *p == 'z' || *p == 't')
+			size = *p;
+		else
+			break;
+	}
+
+	switch (*p) {
+	case '%':
+		spec->type = NI_LOG_ARG_NONE;
+		break;
+	case 'd': case 'i': case 'o': case 'u': case 'x': case 'X': case 'c':
+		if (size == 'z')
+			spec->type = NI_LOG_ARG_SIZE;
+		else if (size == 'j')
+			spec->type = NI_LOG_ARG_INTMAX;
+		else if (size == 't')
+			spec->type = NI_LOG_ARG_PTRDIFF;
+		else if (longs > 1)
+			spec->type = NI_LOG_ARG_LLONG;
+		else if (longs == 1)
+			spec->type = NI_LOG_ARG_LONG;
+		else
+			spec->type = NI_LOG_ARG_INT;
+		break;
+	case 'e': case 'E': case 'f': case 'F':
+	case 'g': case 'G': case 'a': case 'A':
+		spec->type = size == 'L' ? NI_LOG_ARG_LDOUBLE : NI_LOG_ARG_DOUBLE;
+		break;
+	case 'p':
+		spec->type = NI_LOG_ARG_PTR;
+		break;
+	case 's':
+		if (!longs)
+			spec->type = NI_LOG_ARG_STRING;
+		break;
+	case 'm':
+		spec->type = NI_LOG_ARG_ERRNO;
+		break;
+	default:
+		return NULL;
+	}
+
+	spec->len = p + 1 - fmt;
+	return p + 1;
+}
+
+static unsigned int
+ni_log_ring_copy_string(ni_log_ring_record_t *rec, unsigned int *used, const char *str)
+{
+	unsigned int off = *used;
+	size_t len;
+
+	if (off >= sizeof(rec->strings))
+		off = sizeof(rec->strings) - 1;
+
+	len = strlen(str ? str : "(null)");
+	if (len > sizeof(rec->strings) - off - 1)
+		len = sizeof(rec->strings) - off - 1;
+	memcpy(rec->strings + off, str ? str : "(null)", len);
+	rec->strings[off + len] = '\0';
+	*used = off + len + 1;
+	return off;
+}
+
+/*
+ * Store the arguments described by the format into the record
+ */
+static ni_bool_t
+ni_log_ring_capture(ni_log_ring_record_t *rec, const char *fmt, va_list ap, int err)
+{
+	ni_log_ring_arg_t *arg = rec->args;
+	ni_log_ring_spec_t spec;
+	unsigned int i, used = 0;
+	const char *p = fmt;
+
+	while ((p = strchr(p, '%')) != NULL) {
+		if (!(p = ni_log_ring_parse_spec(p, &spec)) ||
+		    spec.type == NI_LOG_ARG_INVALID)
+			return FALSE;
+
+		if (spec.type == NI_LOG_ARG_NONE)
+			continue;
+
+		if (arg + spec.stars + 1 > rec->args + NI_LOG_RING_MAX_ARGS)
+			return FALSE;
+
+		for (i = 0; i < spec.stars; ++i)
+			(arg++)->i = va_arg(ap, int);
+
+		switch (spec.type) {
+		case NI_LOG_ARG_INT:
+			arg->i = va_arg(ap, int);
+			break;
+		case NI_LOG_ARG_LONG:
+			arg->i = va_arg(ap, long);
+			break;
+		case NI_LOG_ARG_LLONG:
+			arg->i = va_arg(ap, long long);
+			break;
+		case NI_LOG_ARG_SIZE:
+			arg->i = va_arg(ap, size_t);
+			break;
+		case NI_LOG_ARG_INTMAX:
+			arg->i = va_arg(ap, intmax_t);
+			break;
+		case NI_LOG_ARG_PTRDIFF:
+			arg->i = va_arg(ap, ptrdiff_t);
+			break;
+		case NI_LOG_ARG_DOUBLE:
+			arg->ld = va_arg(ap, double);
+			break;
+		case NI_LOG_ARG_LDOUBLE:
+			arg->ld = va_arg(ap, long double);
+			break;
+		case NI_LOG_ARG_PTR:
+			arg->p = va_arg(ap, void *);
+			break;
+		case NI_LOG_ARG_STRING:
+			arg->str = ni_log_ring_copy_string(rec, &used, va_arg(ap, const char *));
+			break;
+		case NI_LOG_ARG_ERRNO:
+			arg->str = ni_log_ring_copy_string(rec, &used, strerror(err));
+			break;
+		default:
+			return FALSE;
+		}
+		arg++;
+	}
+	return TRUE;
+}
+
+static ni_bool_t
+ni_log_ring_record(unsigned int facility, const char *fmt, va_list ap)
+{
+	struct ni_log_ring *ring = &ni_log_ring;
+	ni_log_ring_record_t *rec;
+	int err = errno;
+	va_list cp;
+
+	if (!ring->records)
+		return FALSE;
+
+	rec = &ring->records[ring->head++ % ring->size];
+	gettimeofday(&rec->time, NULL);
+	rec->facility = facility;
+	rec->fmt = fmt;
+
+	va_copy(cp, ap);
+	if (!ni_log_ring_capture(rec, fmt, cp, err)) {
+		/* too many or unknown conversions: format right away */
+		errno = err;
+		vsnprintf(rec->strings, sizeof(rec->strings), fmt, ap);
+		rec->fmt = NULL;
+	}
+	va_end(cp);
+
+	errno = err;
+	return TRUE;
+}
+
+#define ni_log_ring_print(buf, size, spec, arg, value) \
+	((spec)->stars == 2 ? snprintf(buf, size, tmp, (int)arg[0].i, (int)arg[1].i, value) : \
+	 (spec)->stars == 1 ? snprintf(buf, size, tmp, (int)arg[0].i, value) : \
+			      snprintf(buf, size, tmp, value))
+
+static void
+ni_log_ring_format(const ni_log_ring_record_t *rec, char *buf, size_t size)
+{
+	const ni_log_ring_arg_t *arg = rec->args;
+	const char *p = rec->fmt, *next;
+	ni_log_ring_spec_t spec;
+	size_t len = 0;
+	char tmp[32];
+	int n;
+
+	if (!p) {
+		snprintf(buf, size, "%s", rec->strings);
+		return;
+	}
+
+	while (*p && len < size - 1) {
+		if (*p != '%') {
+			buf[len++] = *p++;
+			continue;
+		}
+
+		next = ni_log_ring_parse_spec(p, &spec);
+		if (spec.type == NI_LOG_ARG_NONE) {
+			buf[len++] = '%';
+			p = next;
+			continue;
+		}
+		if (spec.len >= sizeof(tmp))
+			break;
+
+		memcpy(tmp, p, spec.len);
+		tmp[spec.len] = '\0';
+		if (spec.type == NI_LOG_ARG_ERRNO)
+			tmp[spec.len - 1] = 's';
+
+		switch (spec.type) {
+		case NI_LOG_ARG_INT:
+			n = ni_log_ring_print(buf + len, size - len, &spec, arg, (int)arg[spec.stars].i);
+			break;
+		case NI_LOG_ARG_LONG:
+			n = ni_log_ring_print(buf + len, size - len, &spec, arg, (long)arg[spec.stars].i);
+			break;
+		case NI_LOG_ARG_LLONG:
+			n = ni_log_ring_print(buf + len, size - len, &spec, arg, (long long)arg[spec.stars].i);
+			break;
+		case NI_LOG_ARG_SIZE:
+			n = ni_log_ring_print(buf + len, size - len, &spec, arg, (size_t)arg[spec.stars].i);
+			break;
+		case NI_LOG_ARG_INTMAX:
+			n = ni_log_ring_print(buf + len, size - len, &spec, arg, arg[spec.stars].i);
+			break;
+		case NI_LOG_ARG_PTRDIFF:
+			n = ni_log_ring_print(buf + len, size - len, &spec, arg, (ptrdiff_t)arg[spec.stars].i);
+			break;
+		case NI_LOG_ARG_DOUBLE:
+			n = ni_log_ring_print(buf + len, size - len, &spec, arg, (double)arg[spec.stars].ld);
+			break;
+		case NI_LOG_ARG_LDOUBLE:
+			n = ni_log_ring_print(buf + len, size - len, &spec, arg, arg[spec.stars].ld);
+			break;
+		case NI_LOG_ARG_PTR:
+			n = ni_log_ring_print(buf + len, size - len, &spec, arg, arg[spec.stars].p);
+			break;
+		case NI_LOG_ARG_STRING:
+		case NI_LOG_ARG_ERRNO:
+			n = ni_log_ring_print(buf + len, size - len, &spec, arg,
+					rec->strings + arg[spec.stars].str);
+			break;
+		default:
+			n = 0;
+			break;
+		}
+
+		if (n < 0)
+			break;
+		len += (size_t)n < size - len ? (size_t)n : size - len - 1;
+		arg += spec.stars + 1;
+		p = next;
+	}
+	buf[len] = '\0';
+}
+
+static void
+__ni_log_stderr_print(const char *tag, const struct timeval *when, const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	__ni_log_stderr(tag, when, fmt, ap, "");
+	va_end(ap);
+}
+
+/*
+ * Format the records logged since the last dump
+ */
+void
+ni_log_ring_dump(void)
+{
+	struct ni_log_ring *ring = &ni_log_ring;
+	const ni_log_ring_record_t *rec;
+	char line[NI_LOG_RING_LINESIZE];
+	unsigned long lost = 0;
+
+	if (!ring->records || ring->tail == ring->head)
+		return;
+
+	if (ring->head - ring->tail > ring->size) {
+		lost = ring->head - ring->tail - ring->size;
+		ring->tail = ring->head - ring->size;
+	}
+
+	if (!ni_log_syslog)
+		__ni_log_stderr_print("::: ", NULL, "trace ring: %lu records, %lu overwritten",
+				ring->head - ring->tail, lost);
+	else
+		syslog(LOG_DEBUG, "trace ring: %lu records, %lu overwritten",
+				ring->head - ring->tail, lost);
+
+	while (ring->tail != ring->head) {
+		rec = &ring->records[ring->tail++ % ring->size];
+
+		ni_log_ring_format(rec, line, sizeof(line));
+		if (!ni_log_syslog) {
+			__ni_log_stderr_print("::: ", &rec->time, "%s", line);
+		} else {
+			syslog(LOG_DEBUG, "[%ld.%06ld] %s", (long)rec->time.tv_sec,
+					(long)rec->time.tv_usec, line);
+		}
+	}
+}
+
+static void
+ni_log_ring_signal(int sig)
+{
+	ni_log_ring.dump = 1;
+}
+
+/*
+ * Dump the ring when requested by signal; called from the main loop
+ */
+void
+ni_log_ring_service(void)
+{
+	if (ni_log_ring.dump) {
+		ni_log_ring.dump = 0;
+		ni_log_ring_dump();
+	}
+}
+
+/*
+ * Enable a trace ring of the given number of records,
+ * or disable it when the size is 0.
+ */
+ni_bool_t
+ni_log_ring_enable(unsigned int size)
+{
+	struct ni_log_ring *ring = &ni_log_ring;
+	static ni_bool_t registered = FALSE;
+	ni_log_ring_record_t *records = NULL;
+
+	if (size && !(records = calloc(size, sizeof(*records))))
+		return FALSE;
+
+	ni_log_ring_dump();
+	free(ring->records);
+	ring->records = records;
+	ring->size = size;
+	ring->head = ring->tail = 0;
+
+	if (records && !registered) {
+		signal(SIGUSR2, ni_log_ring_signal);
+		atexit(ni_log_ring_dump);
+		registered = TRUE;
+	}
+	return TRUE;
+}
@@ -152,10 +152,13 @@ typedef struct ni_capture_protinfo {
 extern int		ni_capture_devinfo_init(ni_capture_devinfo_t *, const char *, const ni_linkinfo_t *);
 extern int		ni_capture_devinfo_refresh(ni_capture_devinfo_t *, const char *, const ni_linkinfo_t *);
 extern ni_capture_t *	ni_capture_open(const ni_capture_devinfo_t *, const ni_capture_protinfo_t *, void (*)(ni_socket_t *));
+extern ni_capture_t *	ni_capture_open_any(const ni_capture_protinfo_t *, void (*)(ni_socket_t *));
 extern int		ni_capture_recv(ni_capture_t *, ni_buffer_t *, ni_sockaddr_t *, const char *);
 extern ni_bool_t	ni_capture_from_hwaddr_set(ni_hwaddr_t *, const ni_sockaddr_t *);
 extern const char *	ni_capture_from_hwaddr_print(const ni_sockaddr_t *);
 extern ssize_t		ni_capture_send(ni_capture_t *, const ni_buffer_t *, const ni_timeout_param_t *);
+extern ssize_t		ni_capture_send_to(const ni_capture_t *, const ni_buffer_t *,
+					unsigned int, const ni_hwaddr_t *);
 extern void		ni_capture_disarm_retransmit(ni_capture_t *);
 extern void		ni_capture_force_retransmit(ni_capture_t *, unsigned int);
 extern void		ni_capture_free(ni_capture_t *);
@@ -179,7 +182,17 @@ typedef struct ni_arp_packet {
 
 typedef void		ni_arp_callback_t(ni_arp_socket_t *, const ni_arp_packet_t *, void *);
 
+/*
+ * ARP sockets of the same interface share one capture; every
+ * received packet is parsed once and passed to all of them.
+ */
+typedef struct ni_arp_link	ni_arp_link_t;
+
 struct ni_arp_socket {
+	ni_arp_socket_t *	next;
+	ni_arp_link_t *		link;
+	ni_bool_t		closed;
+
 	ni_capture_t *		capture;
 	ni_capture_devinfo_t	dev_info;
 
@@ -199,6 +212,7 @@ extern int		ni_arp_send(ni_arp_socket_t *, const ni_arp_packet_t *);
 
 typedef struct ni_arp_verify {
 	unsigned int		nprobes;
+	unsigned int		ifindex;	/* of the pending probes */
 
 	unsigned int		wait_ms;
 	struct timeval		started;
@@ -255,6 +269,7 @@ struct ni_addrconf_updater {
 	unsigned int			timeout;
 	struct timeval			started;	/* updater */
 	unsigned int			deadline;
+	ni_bool_t			resync;		/* action (re)started by timer */
 
 	ni_addrconf_updater_cleanup_t *	cleanup;
 	void *				user_data;
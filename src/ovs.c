@@ -30,6 +30,7 @@
 #include <wicked/util.h>
 #include <wicked/netinfo.h>
 #include "ovs.h"
+#include "ovsdb.h"
 #include "buffer.h"
 #include "process.h"
 #include "util_priv.h"
@@ -196,6 +197,9 @@ ni_ovs_bridge_port_config_destroy(ni_ovs_bridge_port_config_t *conf)
 }
 
 
+/*
+ * ovs-vsctl tool fallback while the ovsdb-server socket is not reachable
+ */
 static const char *
 ni_ovs_vsctl_tool_path(void)
 {
@@ -210,7 +214,7 @@ ni_ovs_vsctl_tool_path(void)
 	return path;
 }
 
-int /* process run codes (for now) */
+static int /* process run codes (for now) */
 ni_ovs_vsctl_bridge_exists(const char *brname)
 {
 	const char *ovs_vsctl;
@@ -249,7 +253,7 @@ failure:
 	return rv;
 }
 
-int /* process run codes (for now) */
+static int /* process run codes (for now) */
 ni_ovs_vsctl_bridge_to_vlan(const char *brname, uint16_t *vlan)
 {
 	const char *ovs_vsctl;
@@ -312,7 +316,7 @@ failure:
 	return rv;
 }
 
-int /* process run codes (for now) */
+static int /* process run codes (for now) */
 ni_ovs_vsctl_bridge_to_parent(const char *brname, char **parent)
 {
 	const char *ovs_vsctl;
@@ -366,8 +370,7 @@ failure:
 	return rv;
 }
 
-
-int /* process run codes (for now) */
+static int /* process run codes (for now) */
 ni_ovs_vsctl_bridge_ports(const char *brname, ni_ovs_bridge_port_array_t *ports)
 {
 	ni_stringbuf_t pname = NI_STRINGBUF_INIT_DYNAMIC;
@@ -430,7 +433,7 @@ failure:
 	return rv;
 }
 
-int /* process run codes (for now) */
+static int /* process run codes (for now) */
 ni_ovs_vsctl_bridge_add(const ni_netdev_t *cfg, ni_bool_t may_exist)
 {
 	const char *ovs_vsctl;
@@ -484,7 +487,7 @@ failure:
 	return rv;
 }
 
-int /* process run codes (for now) */
+static int /* process run codes (for now) */
 ni_ovs_vsctl_bridge_del(const char *brname)
 {
 	const char *ovs_vsctl;
@@ -523,7 +526,7 @@ failure:
 	return rv;
 }
 
-int /* process run codes (for now) */
+static int /* process run codes (for now) */
 ni_ovs_vsctl_bridge_port_add(const char *pname, const ni_ovs_bridge_port_config_t *pconf, ni_bool_t may_exist)
 {
 	const char *ovs_vsctl;
@@ -569,7 +572,7 @@ failure:
 }
 
 
-int /* process run codes (for now) */
+static int /* process run codes (for now) */
 ni_ovs_vsctl_bridge_port_del(const char *brname, const char *pname)
 {
 	const char *ovs_vsctl;
@@ -611,7 +614,7 @@ failure:
 	return rv;
 }
 
-int /* process run codes (for now) */
+static int /* process run codes (for now) */
 ni_ovs_vsctl_bridge_port_to_bridge(const char *pname, char **brname)
 {
 	const char *ovs_vsctl;
@@ -663,6 +666,159 @@ failure:
 	return rv;
 }
 
+/*
+ * Bridge and port operations: use the ovsdb client while the
+ * ovsdb-server socket is reachable and run ovs-vsctl otherwise.
+ */
+static int
+ni_ovs_ctl_txn_commit(ni_ovsdb_txn_t *txn, ni_bool_t queued)
+{
+	int rv = NI_PROCESS_FAILURE;
+
+	if (queued && ni_ovsdb_txn_commit(txn) == 0)
+		rv = NI_PROCESS_SUCCESS;
+	ni_ovsdb_txn_free(txn);
+	return rv;
+}
+
+int /* process run codes (for now) */
+ni_ovs_ctl_bridge_exists(const char *brname)
+{
+	if (ni_string_empty(brname))
+		return NI_PROCESS_FAILURE;
+
+	if (ni_ovsdb_available())
+		return ni_ovsdb_bridge_exists(brname);
+
+	return ni_ovs_vsctl_bridge_exists(brname);
+}
+
+int /* process run codes (for now) */
+ni_ovs_ctl_bridge_to_vlan(const char *brname, uint16_t *vlan)
+{
+	if (ni_string_empty(brname) || !vlan)
+		return NI_PROCESS_FAILURE;
+
+	if (ni_ovsdb_available())
+		return ni_ovsdb_bridge_to_parent(brname, NULL, vlan);
+
+	return ni_ovs_vsctl_bridge_to_vlan(brname, vlan);
+}
+
+int /* process run codes (for now) */
+ni_ovs_ctl_bridge_to_parent(const char *brname, char **parent)
+{
+	if (ni_string_empty(brname) || !parent)
+		return NI_PROCESS_FAILURE;
+
+	if (ni_ovsdb_available())
+		return ni_ovsdb_bridge_to_parent(brname, parent, NULL);
+
+	return ni_ovs_vsctl_bridge_to_parent(brname, parent);
+}
+
+int /* process run codes (for now) */
+ni_ovs_ctl_bridge_ports(const char *brname, ni_ovs_bridge_port_array_t *ports)
+{
+	if (ni_string_empty(brname) || !ports)
+		return NI_PROCESS_FAILURE;
+
+	if (ni_ovsdb_available())
+		return ni_ovsdb_bridge_ports(brname, ports);
+
+	return ni_ovs_vsctl_bridge_ports(brname, ports);
+}
+
+/*
+ * Create the bridge; with ovsdb, the configured ports existing in nc
+ * are added in the same transaction, ovs-vsctl adds them one by one
+ * while they're enslaved.
+ */
+int /* process run codes (for now) */
+ni_ovs_ctl_bridge_add(const ni_netdev_t *cfg, ni_netconfig_t *nc, ni_bool_t may_exist)
+{
+	const ni_ovs_bridge_t *ovsbr;
+	ni_ovsdb_txn_t *txn;
+	ni_bool_t queued;
+	unsigned int i;
+
+	if (!cfg || ni_string_empty(cfg->name) || !(ovsbr = cfg->ovsbr))
+		return NI_PROCESS_FAILURE;
+
+	if (!ni_ovsdb_available())
+		return ni_ovs_vsctl_bridge_add(cfg, may_exist);
+
+	txn = ni_ovsdb_txn_new();
+	queued = ni_ovsdb_txn_bridge_add(txn, cfg->name, ovsbr->config.vlan.parent.name,
+					ovsbr->config.vlan.tag, may_exist);
+
+	for (i = 0; queued && nc && i < ovsbr->ports.count; ++i) {
+		const ni_ovs_bridge_port_t *port = ovsbr->ports.data[i];
+
+		if (port && port->device.name && ni_netdev_by_name(nc, port->device.name))
+			ni_ovsdb_txn_port_add(txn, cfg->name, port->device.name, TRUE);
+	}
+	return ni_ovs_ctl_txn_commit(txn, queued);
+}
+
+int /* process run codes (for now) */
+ni_ovs_ctl_bridge_del(const char *brname)
+{
+	ni_ovsdb_txn_t *txn;
+
+	if (ni_string_empty(brname))
+		return NI_PROCESS_FAILURE;
+
+	if (!ni_ovsdb_available())
+		return ni_ovs_vsctl_bridge_del(brname);
+
+	txn = ni_ovsdb_txn_new();
+	return ni_ovs_ctl_txn_commit(txn, ni_ovsdb_txn_bridge_del(txn, brname));
+}
+
+int /* process run codes (for now) */
+ni_ovs_ctl_bridge_port_add(const char *pname, const ni_ovs_bridge_port_config_t *pconf, ni_bool_t may_exist)
+{
+	ni_ovsdb_txn_t *txn;
+
+	if (ni_string_empty(pname) || !pconf || ni_string_empty(pconf->bridge.name))
+		return NI_PROCESS_FAILURE;
+
+	if (!ni_ovsdb_available())
+		return ni_ovs_vsctl_bridge_port_add(pname, pconf, may_exist);
+
+	txn = ni_ovsdb_txn_new();
+	return ni_ovs_ctl_txn_commit(txn, ni_ovsdb_txn_port_add(txn,
+				pconf->bridge.name, pname, may_exist));
+}
+
+int /* process run codes (for now) */
+ni_ovs_ctl_bridge_port_del(const char *brname, const char *pname)
+{
+	ni_ovsdb_txn_t *txn;
+
+	if (ni_string_empty(brname) || ni_string_empty(pname))
+		return NI_PROCESS_FAILURE;
+
+	if (!ni_ovsdb_available())
+		return ni_ovs_vsctl_bridge_port_del(brname, pname);
+
+	txn = ni_ovsdb_txn_new();
+	return ni_ovs_ctl_txn_commit(txn, ni_ovsdb_txn_port_del(txn, brname, pname));
+}
+
+int /* process run codes (for now) */
+ni_ovs_ctl_bridge_port_to_bridge(const char *pname, char **brname)
+{
+	if (ni_string_empty(pname) || !brname)
+		return NI_PROCESS_FAILURE;
+
+	if (ni_ovsdb_available())
+		return ni_ovsdb_port_to_bridge(pname, brname);
+
+	return ni_ovs_vsctl_bridge_port_to_bridge(pname, brname);
+}
+
 int
 ni_ovs_bridge_discover(ni_netdev_t *dev, ni_netconfig_t *nc)
 {
@@ -673,9 +829,9 @@ ni_ovs_bridge_discover(ni_netdev_t *dev, ni_netconfig_t *nc)
 		return -1;
 
 	ovsbr = ni_ovs_bridge_new();
-	if (ni_ovs_vsctl_bridge_to_parent(dev->name, &ovsbr->config.vlan.parent.name) ||
-	    ni_ovs_vsctl_bridge_to_vlan(dev->name, &ovsbr->config.vlan.tag) ||
-	    ni_ovs_vsctl_bridge_ports(dev->name, &ovsbr->ports)) {
+	if (ni_ovs_ctl_bridge_to_parent(dev->name, &ovsbr->config.vlan.parent.name) ||
+	    ni_ovs_ctl_bridge_to_vlan(dev->name, &ovsbr->config.vlan.tag) ||
+	    ni_ovs_ctl_bridge_ports(dev->name, &ovsbr->ports)) {
 		ni_ovs_bridge_free(ovsbr);
 		return -1;
 	}
@@ -27,17 +27,17 @@
 #include <wicked/types.h>
 #include <wicked/ovs.h>
 
-extern int	ni_ovs_vsctl_bridge_add(const ni_netdev_t *, ni_bool_t);
-extern int	ni_ovs_vsctl_bridge_del(const char *);
-extern int	ni_ovs_vsctl_bridge_exists(const char *);
-extern int	ni_ovs_vsctl_bridge_to_vlan(const char *, uint16_t *);
-extern int	ni_ovs_vsctl_bridge_to_parent(const char *, char **);
-extern int	ni_ovs_vsctl_bridge_ports(const char *, ni_ovs_bridge_port_array_t *);
+extern int	ni_ovs_ctl_bridge_add(const ni_netdev_t *, ni_netconfig_t *, ni_bool_t);
+extern int	ni_ovs_ctl_bridge_del(const char *);
+extern int	ni_ovs_ctl_bridge_exists(const char *);
+extern int	ni_ovs_ctl_bridge_to_vlan(const char *, uint16_t *);
+extern int	ni_ovs_ctl_bridge_to_parent(const char *, char **);
+extern int	ni_ovs_ctl_bridge_ports(const char *, ni_ovs_bridge_port_array_t *);
 
-extern int	ni_ovs_vsctl_bridge_port_add(const char *, const ni_ovs_bridge_port_config_t *,
+extern int	ni_ovs_ctl_bridge_port_add(const char *, const ni_ovs_bridge_port_config_t *,
 							ni_bool_t);
-extern int	ni_ovs_vsctl_bridge_port_del(const char *, const char *);
-extern int	ni_ovs_vsctl_bridge_port_to_bridge(const char *, char **);
+extern int	ni_ovs_ctl_bridge_port_del(const char *, const char *);
+extern int	ni_ovs_ctl_bridge_port_to_bridge(const char *, char **);
 
 extern int	ni_ovs_bridge_discover(ni_netdev_t *, ni_netconfig_t *);
 
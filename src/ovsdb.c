@@ -0,0 +1,1340 @@
+/*
+ *	OVSDB JSON-RPC client (RFC 7047)
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License along
+ *	with this program; if not, see <http://www.gnu.org/licenses/> or write
+ *	to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *	Boston, MA 02110-1301 USA.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+
+#include <wicked/util.h>
+#include <wicked/logging.h>
+#include <wicked/socket.h>
+#include "ovsdb.h"
+#include "json.h"
+#include "socket_priv.h"
+#include "util_priv.h"
+
+#define NI_OVSDB_DATABASE		"Open_vSwitch"
+#define NI_OVSDB_READ_CHUNK		4096
+
+typedef struct ni_ovsdb_row		ni_ovsdb_row_t;
+struct ni_ovsdb_row {
+	ni_ovsdb_row_t *	next;
+	char *			uuid;
+	char *			name;
+	ni_json_t *		data;
+};
+
+typedef struct ni_ovsdb_table {
+	const char *		name;
+	const char *		columns[5];
+	ni_ovsdb_row_t *	rows;
+	ni_hashtable_t		by_uuid;
+	ni_hashtable_t		by_name;
+} ni_ovsdb_table_t;
+
+enum {
+	NI_OVSDB_TABLE_ROOT,
+	NI_OVSDB_TABLE_BRIDGE,
+	NI_OVSDB_TABLE_PORT,
+
+	NI_OVSDB_TABLE_MAX
+};
+
+/* bridges inserted by a transaction, for the ports added with them */
+typedef struct ni_ovsdb_txn_bridge	ni_ovsdb_txn_bridge_t;
+struct ni_ovsdb_txn_bridge {
+	ni_ovsdb_txn_bridge_t *	next;
+	char *			name;
+	char *			parent;
+	uint16_t		vlan;
+};
+
+struct ni_ovsdb_txn {
+	ni_json_t *		ops;
+	unsigned int		named;
+	ni_ovsdb_txn_bridge_t *	bridges;
+};
+
+static struct {
+	ni_socket_t *		sock;
+	unsigned int		seqno;
+
+	ni_stringbuf_t		rbuf;
+	size_t			scan_pos;
+	unsigned int		scan_depth;
+	ni_bool_t		scan_string;
+	ni_bool_t		scan_escape;
+
+	unsigned int		reply_id;
+	ni_json_t *		reply;
+
+	ni_ovsdb_table_t	tables[NI_OVSDB_TABLE_MAX];
+} ni_ovsdb = {
+	.rbuf = NI_STRINGBUF_INIT_DYNAMIC,
+	.tables = {
+		[NI_OVSDB_TABLE_ROOT]	= {
+			.name = "Open_vSwitch",
+			.columns = { "bridges", "next_cfg", "cur_cfg", NULL }
+		},
+		[NI_OVSDB_TABLE_BRIDGE]	= {
+			.name = "Bridge",
+			.columns = { "name", "ports", NULL }
+		},
+		[NI_OVSDB_TABLE_PORT]	= {
+			.name = "Port",
+			.columns = { "name", "interfaces", "tag", "fake_bridge", NULL }
+		},
+	},
+};
+
+static ni_json_t *	ni_ovsdb_call(const char *, ni_json_t *);
+static void		ni_ovsdb_disconnect(void);
+
+/*
+ * json helpers
+ */
+static ni_bool_t
+ni_ovsdb_json_string_eq(ni_json_t *json, const char *str)
+{
+	char *value = NULL;
+	ni_bool_t ret;
+
+	if (!ni_json_string_get(json, &value))
+		return FALSE;
+	ret = ni_string_eq(value, str);
+	ni_string_free(&value);
+	return ret;
+}
+
+static ni_json_t *
+ni_ovsdb_json_pair(const char *type, ni_json_t *value)
+{
+	ni_json_t *atom = ni_json_new_array();
+
+	ni_json_array_append(atom, ni_json_new_string(type));
+	ni_json_array_append(atom, value);
+	return atom;
+}
+
+static ni_json_t *
+ni_ovsdb_json_set(ni_json_t *atom)
+{
+	ni_json_t *set = ni_json_new_array();
+
+	if (atom)
+		ni_json_array_append(set, atom);
+	return ni_ovsdb_json_pair("set", set);
+}
+
+static ni_json_t *
+ni_ovsdb_json_uuid(const char *uuid)
+{
+	return ni_ovsdb_json_pair("uuid", ni_json_new_string(uuid));
+}
+
+static ni_json_t *
+ni_ovsdb_json_named_uuid(const char *name)
+{
+	return ni_ovsdb_json_pair("named-uuid", ni_json_new_string(name));
+}
+
+static ni_json_t *
+ni_ovsdb_json_where_name(const char *name)
+{
+	ni_json_t *where = ni_json_new_array();
+	ni_json_t *cond = ni_json_new_array();
+
+	if (name) {
+		ni_json_array_append(cond, ni_json_new_string("name"));
+		ni_json_array_append(cond, ni_json_new_string("=="));
+		ni_json_array_append(cond, ni_json_new_string(name));
+		ni_json_array_append(where, cond);
+	} else {
+		ni_json_free(cond);
+	}
+	return where;
+}
+
+/*
+ * Scalar value of an optional column, given as atom or as a set
+ * with zero or one element.
+ */
+static ni_json_t *
+ni_ovsdb_json_scalar(ni_json_t *value)
+{
+	if (ni_json_is_array(value)) {
+		if (!ni_ovsdb_json_string_eq(ni_json_array_get(value, 0), "set"))
+			return value;
+		return ni_json_array_get(ni_json_array_get(value, 1), 0);
+	}
+	return value;
+}
+
+static ni_bool_t
+ni_ovsdb_row_get_int(const ni_ovsdb_row_t *row, const char *column, int64_t *value)
+{
+	ni_json_t *json;
+
+	json = ni_ovsdb_json_scalar(ni_json_object_get_value(row->data, column));
+	return ni_json_int64_get(json, value);
+}
+
+static ni_bool_t
+ni_ovsdb_row_is_true(const ni_ovsdb_row_t *row, const char *column)
+{
+	ni_json_t *json;
+	ni_bool_t value;
+
+	json = ni_ovsdb_json_scalar(ni_json_object_get_value(row->data, column));
+	return ni_json_bool_get(json, &value) && value;
+}
+
+/*
+ * Collect the uuids referenced by a column, given as a single
+ * ["uuid", ...] atom or a ["set", [atoms]].
+ */
+static void
+ni_ovsdb_row_get_uuids(const ni_ovsdb_row_t *row, const char *column, ni_string_array_t *uuids)
+{
+	ni_json_t *value, *atoms, *atom;
+	char *uuid = NULL;
+	unsigned int i, n;
+
+	value = ni_json_object_get_value(row->data, column);
+	if (ni_ovsdb_json_string_eq(ni_json_array_get(value, 0), "uuid")) {
+		if (ni_json_string_get(ni_json_array_get(value, 1), &uuid))
+			ni_string_array_append(uuids, uuid);
+	} else {
+		atoms = ni_json_array_get(value, 1);
+		n = ni_json_array_entries(atoms);
+		for (i = 0; i < n; ++i) {
+			atom = ni_json_array_get(atoms, i);
+			if (ni_json_string_get(ni_json_array_get(atom, 1), &uuid))
+				ni_string_array_append(uuids, uuid);
+		}
+	}
+	ni_string_free(&uuid);
+}
+
+/*
+ * cache tables
+ */
+static void
+ni_ovsdb_row_free(ni_ovsdb_row_t *row)
+{
+	if (row) {
+		ni_string_free(&row->uuid);
+		ni_string_free(&row->name);
+		ni_json_free(row->data);
+		free(row);
+	}
+}
+
+static ni_ovsdb_row_t *
+ni_ovsdb_table_find_uuid(const ni_ovsdb_table_t *table, const char *uuid)
+{
+	ni_hashtable_iter_t iter;
+	ni_ovsdb_row_t *row;
+
+	row = ni_hashtable_lookup(&table->by_uuid, ni_hash_string(uuid), &iter);
+	for ( ; row; row = ni_hashtable_lookup_next(&iter)) {
+		if (ni_string_eq(row->uuid, uuid))
+			return row;
+	}
+	return NULL;
+}
+
+static ni_ovsdb_row_t *
+ni_ovsdb_table_find_name(const ni_ovsdb_table_t *table, const char *name)
+{
+	ni_hashtable_iter_t iter;
+	ni_ovsdb_row_t *row;
+
+	if (ni_string_empty(name))
+		return NULL;
+
+	row = ni_hashtable_lookup(&table->by_name, ni_hash_string(name), &iter);
+	for ( ; row; row = ni_hashtable_lookup_next(&iter)) {
+		if (ni_string_eq(row->name, name))
+			return row;
+	}
+	return NULL;
+}
+
+static void
+ni_ovsdb_table_remove(ni_ovsdb_table_t *table, ni_ovsdb_row_t *row)
+{
+	ni_ovsdb_row_t **pos;
+
+	for (pos = &table->rows; *pos; pos = &(*pos)->next) {
+		if (*pos == row) {
+			*pos = row->next;
+			break;
+		}
+	}
+	ni_hashtable_remove(&table->by_uuid, ni_hash_string(row->uuid), row);
+	if (row->name)
+		ni_hashtable_remove(&table->by_name, ni_hash_string(row->name), row);
+	ni_ovsdb_row_free(row);
+}
+
+static void
+ni_ovsdb_table_update(ni_ovsdb_table_t *table, const char *uuid, ni_json_t *data)
+{
+	ni_ovsdb_row_t *row;
+
+	if ((row = ni_ovsdb_table_find_uuid(table, uuid)))
+		ni_ovsdb_table_remove(table, row);
+
+	if (!ni_json_is_object(data))
+		return;
+
+	row = xcalloc(1, sizeof(*row));
+	ni_string_dup(&row->uuid, uuid);
+	ni_json_string_get(ni_json_object_get_value(data, "name"), &row->name);
+	row->data = ni_json_ref(data);
+
+	row->next = table->rows;
+	table->rows = row;
+	ni_hashtable_insert(&table->by_uuid, ni_hash_string(row->uuid), row);
+	if (row->name)
+		ni_hashtable_insert(&table->by_name, ni_hash_string(row->name), row);
+}
+
+static void
+ni_ovsdb_table_clear(ni_ovsdb_table_t *table)
+{
+	ni_ovsdb_row_t *row;
+
+	while ((row = table->rows)) {
+		table->rows = row->next;
+		ni_ovsdb_row_free(row);
+	}
+	ni_hashtable_destroy(&table->by_uuid);
+	ni_hashtable_destroy(&table->by_name);
+}
+
+/*
+ * Apply the <table-updates> of a monitor reply or update notification
+ */
+static void
+ni_ovsdb_apply_updates(ni_json_t *updates)
+{
+	ni_ovsdb_table_t *table;
+	ni_json_pair_t *pair;
+	ni_json_t *rows;
+	unsigned int t, i, n;
+
+	for (t = 0; t < NI_OVSDB_TABLE_MAX; ++t) {
+		table = &ni_ovsdb.tables[t];
+		if (!(rows = ni_json_object_get_value(updates, table->name)))
+			continue;
+
+		n = ni_json_object_entries(rows);
+		for (i = 0; i < n; ++i) {
+			if (!(pair = ni_json_object_get_pair_at(rows, i)))
+				continue;
+
+			ni_ovsdb_table_update(table, ni_json_pair_get_name(pair),
+				ni_json_object_get_value(ni_json_pair_get_value(pair), "new"));
+		}
+	}
+}
+
+static ni_ovsdb_row_t *
+ni_ovsdb_root(void)
+{
+	return ni_ovsdb.tables[NI_OVSDB_TABLE_ROOT].rows;
+}
+
+static ni_ovsdb_row_t *
+ni_ovsdb_bridge_by_name(const char *name)
+{
+	return ni_ovsdb_table_find_name(&ni_ovsdb.tables[NI_OVSDB_TABLE_BRIDGE], name);
+}
+
+static ni_ovsdb_row_t *
+ni_ovsdb_port_by_name(const char *name)
+{
+	return ni_ovsdb_table_find_name(&ni_ovsdb.tables[NI_OVSDB_TABLE_PORT], name);
+}
+
+static ni_ovsdb_row_t *
+ni_ovsdb_port_by_uuid(const char *uuid)
+{
+	return ni_ovsdb_table_find_uuid(&ni_ovsdb.tables[NI_OVSDB_TABLE_PORT], uuid);
+}
+
+/* the bridge the port is attached to */
+static ni_ovsdb_row_t *
+ni_ovsdb_port_bridge(const ni_ovsdb_row_t *port)
+{
+	ni_string_array_t uuids = NI_STRING_ARRAY_INIT;
+	ni_ovsdb_row_t *br;
+
+	for (br = ni_ovsdb.tables[NI_OVSDB_TABLE_BRIDGE].rows; br; br = br->next) {
+		ni_ovsdb_row_get_uuids(br, "ports", &uuids);
+		if (ni_string_array_index(&uuids, port->uuid) >= 0)
+			break;
+		ni_string_array_destroy(&uuids);
+	}
+	ni_string_array_destroy(&uuids);
+	return br;
+}
+
+/* the port representing a fake (vlan) bridge */
+static ni_ovsdb_row_t *
+ni_ovsdb_fake_bridge_by_name(const char *name)
+{
+	ni_ovsdb_row_t *port;
+
+	if ((port = ni_ovsdb_port_by_name(name)) && ni_ovsdb_row_is_true(port, "fake_bridge"))
+		return port;
+	return NULL;
+}
+
+/*
+ * connection i/o
+ */
+static int
+ni_ovsdb_send(ni_json_t *msg)
+{
+	ni_stringbuf_t buf = NI_STRINGBUF_INIT_DYNAMIC;
+	struct pollfd pfd;
+	size_t off = 0;
+	ssize_t len;
+	int ret = -1;
+
+	if (!ni_ovsdb.sock || !ni_json_format_string(&buf, msg, NULL))
+		goto done;
+
+	pfd.fd = ni_ovsdb.sock->__fd;
+	pfd.events = POLLOUT;
+	while (off < buf.len) {
+		len = write(pfd.fd, buf.string + off, buf.len - off);
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN &&
+			    poll(&pfd, 1, NI_OVSDB_CALL_TIMEOUT) > 0)
+				continue;
+			ni_error("ovsdb: unable to send request: %m");
+			goto done;
+		}
+		off += len;
+	}
+	ret = 0;
+done:
+	ni_stringbuf_destroy(&buf);
+	return ret;
+}
+
+static void
+ni_ovsdb_dispatch(ni_json_t *msg)
+{
+	ni_json_t *method, *params, *reply;
+	int64_t id;
+
+	if ((method = ni_json_object_get_value(msg, "method"))) {
+		params = ni_json_object_get_value(msg, "params");
+
+		if (ni_ovsdb_json_string_eq(method, "update")) {
+			ni_ovsdb_apply_updates(ni_json_array_get(params, 1));
+		} else
+		if (ni_ovsdb_json_string_eq(method, "echo")) {
+			reply = ni_json_new_object();
+			ni_json_object_set(reply, "id", ni_json_object_ref_value(msg, "id"));
+			ni_json_object_set(reply, "result", params ?
+					ni_json_ref(params) : ni_json_new_array());
+			ni_json_object_set(reply, "error", ni_json_new_null());
+			ni_ovsdb_send(reply);
+			ni_json_free(reply);
+		}
+		return;
+	}
+
+	if (ni_json_int64_get(ni_json_object_get_value(msg, "id"), &id) &&
+	    ni_ovsdb.reply_id && id == ni_ovsdb.reply_id) {
+		ni_json_free(ni_ovsdb.reply);
+		ni_ovsdb.reply = ni_json_ref(msg);
+	}
+}
+
+/*
+ * The messages on the stream are not delimited, split them by
+ * tracking the nesting of the json text.
+ */
+static void
+ni_ovsdb_process_input(void)
+{
+	ni_stringbuf_t *rbuf = &ni_ovsdb.rbuf;
+	size_t start = 0, pos;
+	ni_json_t *msg;
+	char cc;
+
+	for (pos = ni_ovsdb.scan_pos; pos < rbuf->len; ++pos) {
+		cc = rbuf->string[pos];
+
+		if (ni_ovsdb.scan_string) {
+			if (ni_ovsdb.scan_escape)
+				ni_ovsdb.scan_escape = FALSE;
+			else if (cc == '\\')
+				ni_ovsdb.scan_escape = TRUE;
+			else if (cc == '"')
+				ni_ovsdb.scan_string = FALSE;
+			continue;
+		}
+
+		switch (cc) {
+		case '"':
+			ni_ovsdb.scan_string = TRUE;
+			break;
+		case '{':
+		case '[':
+			if (ni_ovsdb.scan_depth++ == 0)
+				start = pos;
+			break;
+		case '}':
+		case ']':
+			if (ni_ovsdb.scan_depth == 0 || --ni_ovsdb.scan_depth)
+				break;
+
+			cc = rbuf->string[pos + 1];
+			rbuf->string[pos + 1] = '\0';
+			msg = ni_json_parse_string(rbuf->string + start);
+			rbuf->string[pos + 1] = cc;
+
+			if (msg) {
+				ni_ovsdb_dispatch(msg);
+				ni_json_free(msg);
+			} else {
+				ni_warn("ovsdb: unable to parse message");
+			}
+			start = pos + 1;
+			break;
+		default:
+			if (ni_ovsdb.scan_depth == 0)
+				start = pos + 1;
+			break;
+		}
+	}
+
+	/* drop the processed messages */
+	if (start) {
+		rbuf->len -= start;
+		memmove(rbuf->string, rbuf->string + start, rbuf->len);
+		rbuf->string[rbuf->len] = '\0';
+	}
+	ni_ovsdb.scan_pos = rbuf->len;
+}
+
+static int
+ni_ovsdb_read(void)
+{
+	char buf[NI_OVSDB_READ_CHUNK];
+	ssize_t len;
+	int total = 0;
+
+	if (!ni_ovsdb.sock)
+		return -1;
+
+	while (1) {
+		len = read(ni_ovsdb.sock->__fd, buf, sizeof(buf));
+		if (len > 0) {
+			ni_stringbuf_put(&ni_ovsdb.rbuf, buf, len);
+			total += len;
+			continue;
+		}
+		if (len < 0 && errno == EINTR)
+			continue;
+		if (len < 0 && errno == EAGAIN)
+			break;
+
+		if (len < 0)
+			ni_error("ovsdb: unable to receive: %m");
+		else
+			ni_debug_application("ovsdb: connection closed by server");
+		ni_ovsdb_disconnect();
+		return -1;
+	}
+
+	ni_ovsdb_process_input();
+	return total;
+}
+
+/*
+ * Wait for and process input until the deadline.
+ * Returns 1 on input, 0 on timeout and -1 on error.
+ */
+static int
+ni_ovsdb_wait_input(const struct timeval *deadline)
+{
+	struct timeval now, delta;
+	struct pollfd pfd;
+	int ret;
+
+	if (!ni_ovsdb.sock)
+		return -1;
+
+	ni_timer_get_time(&now);
+	if (timercmp(&now, deadline, >=))
+		return 0;
+	timersub(deadline, &now, &delta);
+
+	pfd.fd = ni_ovsdb.sock->__fd;
+	pfd.events = POLLIN;
+	ret = poll(&pfd, 1, delta.tv_sec * 1000 + delta.tv_usec / 1000 + 1);
+	if (ret < 0)
+		return errno == EINTR ? 1 : -1;
+	if (ret == 0)
+		return 0;
+	return ni_ovsdb_read() < 0 ? -1 : 1;
+}
+
+static void
+ni_ovsdb_deadline(struct timeval *deadline, unsigned int msec)
+{
+	struct timeval delta;
+
+	ni_timer_get_time(deadline);
+	delta.tv_sec = msec / 1000;
+	delta.tv_usec = (msec % 1000) * 1000;
+	timeradd(deadline, &delta, deadline);
+}
+
+/*
+ * Send a request and wait for the reply, processing notifications
+ * received meanwhile. Consumes the params and returns the result.
+ */
+static ni_json_t *
+ni_ovsdb_call(const char *method, ni_json_t *params)
+{
+	ni_stringbuf_t err = NI_STRINGBUF_INIT_DYNAMIC;
+	ni_json_t *msg, *error, *result = NULL;
+	struct timeval deadline;
+	int ret;
+
+	msg = ni_json_new_object();
+	ni_json_object_set(msg, "method", ni_json_new_string(method));
+	ni_json_object_set(msg, "params", params);
+	if (!++ni_ovsdb.seqno)
+		++ni_ovsdb.seqno;
+	ni_json_object_set(msg, "id", ni_json_new_int64(ni_ovsdb.seqno));
+
+	ni_ovsdb.reply_id = ni_ovsdb.seqno;
+	ret = ni_ovsdb_send(msg);
+	ni_json_free(msg);
+	if (ret < 0) {
+		ni_ovsdb_disconnect();
+		return NULL;
+	}
+
+	ni_ovsdb_deadline(&deadline, NI_OVSDB_CALL_TIMEOUT);
+	while (!ni_ovsdb.reply) {
+		if ((ret = ni_ovsdb_wait_input(&deadline)) <= 0) {
+			if (ret == 0)
+				ni_error("ovsdb: %s request timed out", method);
+			ni_ovsdb.reply_id = 0;
+			return NULL;
+		}
+	}
+
+	msg = ni_ovsdb.reply;
+	ni_ovsdb.reply = NULL;
+	ni_ovsdb.reply_id = 0;
+
+	error = ni_json_object_get_value(msg, "error");
+	if (error && !ni_json_is_null(error)) {
+		ni_error("ovsdb: %s request failed: %s", method,
+				ni_json_format_string(&err, error, NULL));
+		ni_stringbuf_destroy(&err);
+	} else {
+		result = ni_json_object_ref_value(msg, "result");
+	}
+	ni_json_free(msg);
+	return result;
+}
+
+static void
+ni_ovsdb_sock_receive(ni_socket_t *sock)
+{
+	ni_ovsdb_read();
+}
+
+static void
+ni_ovsdb_sock_hangup(ni_socket_t *sock)
+{
+	ni_debug_application("ovsdb: connection hangup");
+	ni_ovsdb_disconnect();
+}
+
+static void
+ni_ovsdb_disconnect(void)
+{
+	ni_socket_t *sock;
+	unsigned int t;
+
+	if ((sock = ni_ovsdb.sock)) {
+		ni_ovsdb.sock = NULL;
+		ni_socket_deactivate(sock);
+		ni_socket_release(sock);
+	}
+
+	ni_json_free(ni_ovsdb.reply);
+	ni_ovsdb.reply = NULL;
+	ni_ovsdb.reply_id = 0;
+
+	ni_stringbuf_destroy(&ni_ovsdb.rbuf);
+	ni_ovsdb.scan_pos = 0;
+	ni_ovsdb.scan_depth = 0;
+	ni_ovsdb.scan_string = FALSE;
+	ni_ovsdb.scan_escape = FALSE;
+
+	for (t = 0; t < NI_OVSDB_TABLE_MAX; ++t)
+		ni_ovsdb_table_clear(&ni_ovsdb.tables[t]);
+}
+
+static ni_json_t *
+ni_ovsdb_monitor_requests(void)
+{
+	ni_json_t *requests, *request, *columns;
+	const ni_ovsdb_table_t *table;
+	unsigned int t, c;
+
+	requests = ni_json_new_object();
+	for (t = 0; t < NI_OVSDB_TABLE_MAX; ++t) {
+		table = &ni_ovsdb.tables[t];
+
+		columns = ni_json_new_array();
+		for (c = 0; table->columns[c]; ++c)
+			ni_json_array_append(columns, ni_json_new_string(table->columns[c]));
+
+		request = ni_json_new_object();
+		ni_json_object_set(request, "columns", columns);
+		ni_json_object_set(requests, table->name, request);
+	}
+	return requests;
+}
+
+/*
+ * Like the ovs tools, prefer the db.sock in $OVS_RUNDIR when set
+ */
+static const char *
+ni_ovsdb_rundir_socket(void)
+{
+	static char path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+	const char *rundir;
+
+	if (ni_string_empty(rundir = getenv("OVS_RUNDIR")))
+		return NULL;
+	if ((size_t)snprintf(path, sizeof(path), "%s/db.sock", rundir) >= sizeof(path))
+		return NULL;
+	return path;
+}
+
+static ni_bool_t
+ni_ovsdb_connect(void)
+{
+	static const char *defaults[] = NI_OVSDB_SOCKET_PATHS;
+	const char *paths[sizeof(defaults)/sizeof(defaults[0]) + 1];
+	struct sockaddr_un sun;
+	ni_json_t *params, *updates;
+	ni_socket_t *sock;
+	unsigned int i, n = 0;
+	int fd = -1;
+
+	if ((paths[n] = ni_ovsdb_rundir_socket()))
+		n++;
+	for (i = 0; (paths[n] = defaults[i]); ++i)
+		n++;
+
+	for (i = 0; paths[i]; ++i) {
+		memset(&sun, 0, sizeof(sun));
+		sun.sun_family = AF_UNIX;
+		strncpy(sun.sun_path, paths[i], sizeof(sun.sun_path) - 1);
+
+		if ((fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0)
+			return FALSE;
+		if (connect(fd, (struct sockaddr *)&sun, sizeof(sun)) == 0)
+			break;
+
+		if (errno != ENOENT && errno != ECONNREFUSED)
+			ni_debug_application("ovsdb: unable to connect to %s: %m", paths[i]);
+		close(fd);
+		fd = -1;
+	}
+	if (fd < 0)
+		return FALSE;
+
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	if (!(sock = ni_socket_wrap(fd, SOCK_STREAM))) {
+		close(fd);
+		return FALSE;
+	}
+	sock->receive = ni_ovsdb_sock_receive;
+	sock->handle_hangup = ni_ovsdb_sock_hangup;
+	sock->handle_error = ni_ovsdb_sock_hangup;
+	ni_ovsdb.sock = sock;
+
+	params = ni_json_new_array();
+	ni_json_array_append(params, ni_json_new_string(NI_OVSDB_DATABASE));
+	ni_json_array_append(params, ni_json_new_null());
+	ni_json_array_append(params, ni_ovsdb_monitor_requests());
+	if (!(updates = ni_ovsdb_call("monitor", params))) {
+		ni_ovsdb_disconnect();
+		return FALSE;
+	}
+	ni_ovsdb_apply_updates(updates);
+	ni_json_free(updates);
+
+	/* process the update notifications in the main loop */
+	ni_socket_activate(sock);
+	ni_debug_application("ovsdb: connected to %s", paths[i]);
+	return TRUE;
+}
+
+ni_bool_t
+ni_ovsdb_available(void)
+{
+	if (ni_ovsdb.sock) {
+		/* catch up with pending updates */
+		ni_ovsdb_read();
+	}
+	return ni_ovsdb.sock || ni_ovsdb_connect();
+}
+
+void
+ni_ovsdb_close(void)
+{
+	ni_ovsdb_disconnect();
+}
+
+/*
+ * Queries answered from the cache, with the exit codes ovs-vsctl
+ * would return.
+ */
+int
+ni_ovsdb_bridge_exists(const char *brname)
+{
+	if (ni_string_empty(brname) || !ni_ovsdb_available())
+		return -1;
+
+	if (ni_ovsdb_bridge_by_name(brname) || ni_ovsdb_fake_bridge_by_name(brname))
+		return 0;
+	return 2;
+}
+
+int
+ni_ovsdb_bridge_to_parent(const char *brname, char **parent, uint16_t *vlan)
+{
+	ni_ovsdb_row_t *port, *br;
+	int64_t tag = 0;
+
+	if (ni_string_empty(brname) || !ni_ovsdb_available())
+		return -1;
+
+	if (ni_ovsdb_bridge_by_name(brname)) {
+		if (vlan)
+			*vlan = 0;
+		return 0;
+	}
+
+	if (!(port = ni_ovsdb_fake_bridge_by_name(brname)) ||
+	    !(br = ni_ovsdb_port_bridge(port))) {
+		ni_error("%s: no ovs bridge with this name", brname);
+		return -1;
+	}
+
+	ni_ovsdb_row_get_int(port, "tag", &tag);
+	if (parent)
+		ni_string_dup(parent, br->name);
+	if (vlan)
+		*vlan = tag;
+	return 0;
+}
+
+int
+ni_ovsdb_bridge_ports(const char *brname, ni_ovs_bridge_port_array_t *ports)
+{
+	ni_string_array_t uuids = NI_STRING_ARRAY_INIT;
+	ni_uint_array_t fake_tags = NI_UINT_ARRAY_INIT;
+	ni_ovsdb_row_t *br, *fake, *port;
+	int64_t vlan = 0, tag;
+	unsigned int i;
+
+	if (ni_string_empty(brname) || !ports || !ni_ovsdb_available())
+		return -1;
+
+	if (!(br = ni_ovsdb_bridge_by_name(brname))) {
+		if (!(fake = ni_ovsdb_fake_bridge_by_name(brname)) ||
+		    !(br = ni_ovsdb_port_bridge(fake))) {
+			ni_error("%s: no ovs bridge with this name", brname);
+			return -1;
+		}
+		ni_ovsdb_row_get_int(fake, "tag", &vlan);
+	}
+
+	/* ports with the vlan tag of a fake bridge belong to it */
+	ni_ovsdb_row_get_uuids(br, "ports", &uuids);
+	for (i = 0; i < uuids.count; ++i) {
+		if (!(port = ni_ovsdb_port_by_uuid(uuids.data[i])))
+			continue;
+		if (ni_ovsdb_row_is_true(port, "fake_bridge") &&
+		    ni_ovsdb_row_get_int(port, "tag", &tag))
+			ni_uint_array_append(&fake_tags, tag);
+	}
+
+	for (i = 0; i < uuids.count; ++i) {
+		if (!(port = ni_ovsdb_port_by_uuid(uuids.data[i])) || !port->name)
+			continue;
+		if (ni_string_eq(port->name, brname) || ni_ovsdb_row_is_true(port, "fake_bridge"))
+			continue;
+
+		tag = 0;
+		ni_ovsdb_row_get_int(port, "tag", &tag);
+		if (vlan ? tag != vlan : ni_uint_array_contains(&fake_tags, tag))
+			continue;
+
+		ni_ovs_bridge_port_array_add_new(ports, port->name);
+	}
+
+	ni_uint_array_destroy(&fake_tags);
+	ni_string_array_destroy(&uuids);
+	return 0;
+}
+
+int
+ni_ovsdb_port_to_bridge(const char *pname, char **brname)
+{
+	ni_string_array_t uuids = NI_STRING_ARRAY_INIT;
+	ni_ovsdb_row_t *port, *br, *fake;
+	int64_t tag = 0, ftag;
+	unsigned int i;
+
+	if (ni_string_empty(pname) || !brname || !ni_ovsdb_available())
+		return -1;
+
+	if (!(port = ni_ovsdb_port_by_name(pname)) || !(br = ni_ovsdb_port_bridge(port))) {
+		ni_error("%s: no ovs port with this name", pname);
+		return -1;
+	}
+
+	ni_string_dup(brname, br->name);
+	if (!ni_ovsdb_row_get_int(port, "tag", &tag))
+		return 0;
+
+	ni_ovsdb_row_get_uuids(br, "ports", &uuids);
+	for (i = 0; i < uuids.count; ++i) {
+		if (!(fake = ni_ovsdb_port_by_uuid(uuids.data[i])) || fake == port)
+			continue;
+		if (ni_ovsdb_row_is_true(fake, "fake_bridge") &&
+		    ni_ovsdb_row_get_int(fake, "tag", &ftag) && ftag == tag) {
+			ni_string_dup(brname, fake->name);
+			break;
+		}
+	}
+	ni_string_array_destroy(&uuids);
+	return 0;
+}
+
+/*
+ * Transactions
+ */
+ni_ovsdb_txn_t *
+ni_ovsdb_txn_new(void)
+{
+	ni_ovsdb_txn_t *txn;
+
+	txn = xcalloc(1, sizeof(*txn));
+	txn->ops = ni_json_new_array();
+	return txn;
+}
+
+void
+ni_ovsdb_txn_free(ni_ovsdb_txn_t *txn)
+{
+	ni_ovsdb_txn_bridge_t *br;
+
+	if (txn) {
+		while ((br = txn->bridges)) {
+			txn->bridges = br->next;
+			ni_string_free(&br->name);
+			ni_string_free(&br->parent);
+			free(br);
+		}
+		ni_json_free(txn->ops);
+		free(txn);
+	}
+}
+
+static ni_ovsdb_txn_bridge_t *
+ni_ovsdb_txn_bridge_find(const ni_ovsdb_txn_t *txn, const char *brname)
+{
+	ni_ovsdb_txn_bridge_t *br;
+
+	for (br = txn->bridges; br; br = br->next) {
+		if (ni_string_eq(br->name, brname))
+			return br;
+	}
+	return NULL;
+}
+
+static void
+ni_ovsdb_txn_bridge_remember(ni_ovsdb_txn_t *txn, const char *brname,
+			const char *parent, uint16_t vlan)
+{
+	ni_ovsdb_txn_bridge_t *br;
+
+	br = xcalloc(1, sizeof(*br));
+	ni_string_dup(&br->name, brname);
+	ni_string_dup(&br->parent, parent);
+	br->vlan = vlan;
+	br->next = txn->bridges;
+	txn->bridges = br;
+}
+
+/*
+ * Resolve a (fake) bridge existing or inserted by the transaction
+ * to the real bridge name and the vlan tag of its ports.
+ */
+static const char *
+ni_ovsdb_txn_bridge_resolve(const ni_ovsdb_txn_t *txn, const char *brname, int64_t *tag)
+{
+	ni_ovsdb_txn_bridge_t *pending;
+	ni_ovsdb_row_t *br, *fake;
+
+	*tag = 0;
+	if ((pending = ni_ovsdb_txn_bridge_find(txn, brname))) {
+		if (ni_string_empty(pending->parent))
+			return pending->name;
+		*tag = pending->vlan;
+		return pending->parent;
+	}
+
+	if ((br = ni_ovsdb_bridge_by_name(brname)))
+		return br->name;
+
+	if ((fake = ni_ovsdb_fake_bridge_by_name(brname)) &&
+	    (br = ni_ovsdb_port_bridge(fake))) {
+		ni_ovsdb_row_get_int(fake, "tag", tag);
+		return br->name;
+	}
+	return NULL;
+}
+
+static const char *
+ni_ovsdb_txn_uuid_name(ni_ovsdb_txn_t *txn, const char *type, char *buf, size_t len)
+{
+	snprintf(buf, len, "%s%u", type, ++txn->named);
+	return buf;
+}
+
+static void
+ni_ovsdb_txn_insert(ni_ovsdb_txn_t *txn, const char *table, ni_json_t *row, const char *uuid_name)
+{
+	ni_json_t *op = ni_json_new_object();
+
+	ni_json_object_set(op, "op", ni_json_new_string("insert"));
+	ni_json_object_set(op, "table", ni_json_new_string(table));
+	ni_json_object_set(op, "row", row);
+	ni_json_object_set(op, "uuid-name", ni_json_new_string(uuid_name));
+	ni_json_array_append(txn->ops, op);
+}
+
+static void
+ni_ovsdb_txn_mutate(ni_ovsdb_txn_t *txn, const char *table, ni_json_t *where,
+			const char *column, const char *mutator, ni_json_t *value)
+{
+	ni_json_t *op, *mutations, *mutation;
+
+	mutation = ni_json_new_array();
+	ni_json_array_append(mutation, ni_json_new_string(column));
+	ni_json_array_append(mutation, ni_json_new_string(mutator));
+	ni_json_array_append(mutation, value);
+	mutations = ni_json_new_array();
+	ni_json_array_append(mutations, mutation);
+
+	op = ni_json_new_object();
+	ni_json_object_set(op, "op", ni_json_new_string("mutate"));
+	ni_json_object_set(op, "table", ni_json_new_string(table));
+	ni_json_object_set(op, "where", where);
+	ni_json_object_set(op, "mutations", mutations);
+	ni_json_array_append(txn->ops, op);
+}
+
+/*
+ * Insert an interface and a port using it, returns the port uuid-name
+ */
+static const char *
+ni_ovsdb_txn_insert_port(ni_ovsdb_txn_t *txn, const char *name, const char *type,
+			int64_t tag, ni_bool_t fake_bridge, char *buf, size_t len)
+{
+	char iface[32];
+	ni_json_t *row;
+
+	ni_ovsdb_txn_uuid_name(txn, "iface", iface, sizeof(iface));
+	row = ni_json_new_object();
+	ni_json_object_set(row, "name", ni_json_new_string(name));
+	if (type)
+		ni_json_object_set(row, "type", ni_json_new_string(type));
+	ni_ovsdb_txn_insert(txn, "Interface", row, iface);
+
+	ni_ovsdb_txn_uuid_name(txn, "port", buf, len);
+	row = ni_json_new_object();
+	ni_json_object_set(row, "name", ni_json_new_string(name));
+	ni_json_object_set(row, "interfaces", ni_ovsdb_json_set(ni_ovsdb_json_named_uuid(iface)));
+	if (tag)
+		ni_json_object_set(row, "tag", ni_json_new_int64(tag));
+	if (fake_bridge)
+		ni_json_object_set(row, "fake_bridge", ni_json_new_bool(TRUE));
+	ni_ovsdb_txn_insert(txn, "Port", row, buf);
+	return buf;
+}
+
+ni_bool_t
+ni_ovsdb_txn_bridge_add(ni_ovsdb_txn_t *txn, const char *brname,
+			const char *parent, uint16_t vlan, ni_bool_t may_exist)
+{
+	char port[32], bridge[32];
+	ni_json_t *row;
+
+	if (!txn || ni_string_empty(brname) || !ni_ovsdb_available())
+		return FALSE;
+
+	if (ni_ovsdb_bridge_by_name(brname) || ni_ovsdb_fake_bridge_by_name(brname) ||
+	    ni_ovsdb_txn_bridge_find(txn, brname)) {
+		if (may_exist)
+			return TRUE;
+		ni_error("%s: ovs bridge already exists", brname);
+		return FALSE;
+	}
+
+	if (!ni_string_empty(parent)) {
+		if (!ni_ovsdb_bridge_by_name(parent)) {
+			ni_error("%s: ovs parent bridge %s does not exist", brname, parent);
+			return FALSE;
+		}
+		ni_ovsdb_txn_insert_port(txn, brname, "internal", vlan, TRUE,
+						port, sizeof(port));
+		ni_ovsdb_txn_mutate(txn, "Bridge", ni_ovsdb_json_where_name(parent),
+				"ports", "insert", ni_ovsdb_json_set(ni_ovsdb_json_named_uuid(port)));
+		ni_ovsdb_txn_bridge_remember(txn, brname, parent, vlan);
+		return TRUE;
+	}
+
+	ni_ovsdb_txn_insert_port(txn, brname, "internal", 0, FALSE, port, sizeof(port));
+
+	ni_ovsdb_txn_uuid_name(txn, "bridge", bridge, sizeof(bridge));
+	row = ni_json_new_object();
+	ni_json_object_set(row, "name", ni_json_new_string(brname));
+	ni_json_object_set(row, "ports", ni_ovsdb_json_set(ni_ovsdb_json_named_uuid(port)));
+	ni_ovsdb_txn_insert(txn, "Bridge", row, bridge);
+
+	ni_ovsdb_txn_mutate(txn, NI_OVSDB_DATABASE, ni_ovsdb_json_where_name(NULL),
+			"bridges", "insert", ni_ovsdb_json_set(ni_ovsdb_json_named_uuid(bridge)));
+	ni_ovsdb_txn_bridge_remember(txn, brname, NULL, 0);
+	return TRUE;
+}
+
+ni_bool_t
+ni_ovsdb_txn_bridge_del(ni_ovsdb_txn_t *txn, const char *brname)
+{
+	ni_ovsdb_row_t *br, *port;
+
+	if (!txn || ni_string_empty(brname) || !ni_ovsdb_available())
+		return FALSE;
+
+	/* unreferenced ports and interfaces are garbage collected */
+	if ((br = ni_ovsdb_bridge_by_name(brname))) {
+		ni_ovsdb_txn_mutate(txn, NI_OVSDB_DATABASE, ni_ovsdb_json_where_name(NULL),
+				"bridges", "delete", ni_ovsdb_json_set(ni_ovsdb_json_uuid(br->uuid)));
+		return TRUE;
+	}
+
+	if ((port = ni_ovsdb_fake_bridge_by_name(brname)) && (br = ni_ovsdb_port_bridge(port))) {
+		ni_ovsdb_txn_mutate(txn, "Bridge", ni_ovsdb_json_where_name(br->name),
+				"ports", "delete", ni_ovsdb_json_set(ni_ovsdb_json_uuid(port->uuid)));
+		return TRUE;
+	}
+
+	ni_error("%s: no ovs bridge with this name", brname);
+	return FALSE;
+}
+
+ni_bool_t
+ni_ovsdb_txn_port_add(ni_ovsdb_txn_t *txn, const char *brname, const char *pname,
+			ni_bool_t may_exist)
+{
+	const char *bridge;
+	char *current = NULL;
+	int64_t tag = 0;
+	char name[32];
+
+	if (!txn || ni_string_empty(brname) || ni_string_empty(pname) || !ni_ovsdb_available())
+		return FALSE;
+
+	if (!(bridge = ni_ovsdb_txn_bridge_resolve(txn, brname, &tag))) {
+		ni_error("%s: no ovs bridge with this name", brname);
+		return FALSE;
+	}
+
+	if (ni_ovsdb_port_by_name(pname)) {
+		ni_ovsdb_port_to_bridge(pname, &current);
+		if (may_exist && ni_string_eq(current, brname)) {
+			ni_string_free(&current);
+			return TRUE;
+		}
+		ni_error("%s: ovs port already exists on bridge %s", pname,
+				current ? current : "");
+		ni_string_free(&current);
+		return FALSE;
+	}
+
+	ni_ovsdb_txn_insert_port(txn, pname, NULL, tag, FALSE, name, sizeof(name));
+	ni_ovsdb_txn_mutate(txn, "Bridge", ni_ovsdb_json_where_name(bridge),
+			"ports", "insert", ni_ovsdb_json_set(ni_ovsdb_json_named_uuid(name)));
+	return TRUE;
+}
+
+ni_bool_t
+ni_ovsdb_txn_port_del(ni_ovsdb_txn_t *txn, const char *brname, const char *pname)
+{
+	ni_ovsdb_row_t *br, *port;
+	char *current = NULL;
+	ni_bool_t ok;
+
+	if (!txn || ni_string_empty(brname) || ni_string_empty(pname) || !ni_ovsdb_available())
+		return FALSE;
+
+	if (!(port = ni_ovsdb_port_by_name(pname)) || !(br = ni_ovsdb_port_bridge(port))) {
+		ni_error("%s: no ovs port with this name", pname);
+		return FALSE;
+	}
+
+	ni_ovsdb_port_to_bridge(pname, &current);
+	if ((ok = ni_string_eq(current, brname))) {
+		ni_ovsdb_txn_mutate(txn, "Bridge", ni_ovsdb_json_where_name(br->name),
+			"ports", "delete", ni_ovsdb_json_set(ni_ovsdb_json_uuid(port->uuid)));
+	} else {
+		ni_error("%s: ovs port is not attached to bridge %s", pname, brname);
+	}
+	ni_string_free(&current);
+	return ok;
+}
+
+/*
+ * Wait until ovs-vswitchd applied the configuration, as ovs-vsctl does
+ */
+static void
+ni_ovsdb_wait_applied(int64_t next_cfg)
+{
+	struct timeval deadline;
+	ni_ovsdb_row_t *root;
+	int64_t cur_cfg;
+
+	ni_ovsdb_deadline(&deadline, NI_OVSDB_APPLY_TIMEOUT);
+	while (1) {
+		if ((root = ni_ovsdb_root()) &&
+		    ni_ovsdb_row_get_int(root, "cur_cfg", &cur_cfg) &&
+		    cur_cfg >= next_cfg)
+			return;
+
+		if (ni_ovsdb_wait_input(&deadline) <= 0)
+			break;
+	}
+	ni_warn("ovsdb: ovs-vswitchd did not apply the configuration in time");
+}
+
+int
+ni_ovsdb_txn_commit(ni_ovsdb_txn_t *txn)
+{
+	ni_stringbuf_t err = NI_STRINGBUF_INIT_DYNAMIC;
+	ni_json_t *params, *result, *op, *error, *select, *mutations;
+	unsigned int i, n, count;
+	int64_t next_cfg = 0;
+	int ret = -1;
+
+	if (!txn || !(count = ni_json_array_entries(txn->ops)))
+		return 0;
+
+	if (!ni_ovsdb_available())
+		return -1;
+
+	params = ni_json_new_array();
+	ni_json_array_append(params, ni_json_new_string(NI_OVSDB_DATABASE));
+	for (i = 0; i < count; ++i)
+		ni_json_array_append(params, ni_json_array_ref(txn->ops, i));
+
+	/* request a reconfiguration and fetch its sequence number */
+	op = ni_json_new_object();
+	ni_json_object_set(op, "op", ni_json_new_string("mutate"));
+	ni_json_object_set(op, "table", ni_json_new_string(NI_OVSDB_DATABASE));
+	ni_json_object_set(op, "where", ni_json_new_array());
+	select = ni_json_new_array();
+	ni_json_array_append(select, ni_json_new_string("next_cfg"));
+	ni_json_array_append(select, ni_json_new_string("+="));
+	ni_json_array_append(select, ni_json_new_int64(1));
+	mutations = ni_json_new_array();
+	ni_json_array_append(mutations, select);
+	ni_json_object_set(op, "mutations", mutations);
+	ni_json_array_append(params, op);
+
+	op = ni_json_new_object();
+	ni_json_object_set(op, "op", ni_json_new_string("select"));
+	ni_json_object_set(op, "table", ni_json_new_string(NI_OVSDB_DATABASE));
+	ni_json_object_set(op, "where", ni_json_new_array());
+	select = ni_json_new_array();
+	ni_json_array_append(select, ni_json_new_string("next_cfg"));
+	ni_json_object_set(op, "columns", select);
+	ni_json_array_append(params, op);
+
+	if (!(result = ni_ovsdb_call("transact", params)))
+		return -1;
+
+	n = ni_json_array_entries(result);
+	for (i = 0; i < n; ++i) {
+		op = ni_json_array_get(result, i);
+		error = ni_json_object_get_value(op, "error");
+		if (error && !ni_json_is_null(error)) {
+			ni_stringbuf_clear(&err);
+			ni_error("ovsdb: transaction failed: %s",
+				ni_json_format_string(&err, op, NULL));
+			goto done;
+		}
+	}
+
+	op = ni_json_array_get(result, count + 1);
+	op = ni_json_array_get(ni_json_object_get_value(op, "rows"), 0);
+	ni_json_int64_get(ni_json_object_get_value(op, "next_cfg"), &next_cfg);
+	ni_ovsdb_wait_applied(next_cfg);
+	ret = 0;
+done:
+	ni_stringbuf_destroy(&err);
+	ni_json_free(result);
+	return ret;
+}
@@ -0,0 +1,60 @@
+/*
+ *	OVSDB JSON-RPC client
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License along
+ *	with this program; if not, see <http://www.gnu.org/licenses/> or write
+ *	to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *	Boston, MA 02110-1301 USA.
+ */
+#ifndef NI_WICKED_OVSDB_H
+#define NI_WICKED_OVSDB_H
+
+#include <wicked/types.h>
+#include <wicked/ovs.h>
+
+/*
+ * The client connects to the ovsdb-server unix socket and monitors
+ * the Open_vSwitch, Bridge and Port tables, so queries are answered
+ * from the cache kept current by the update notifications.
+ *
+ * Changes are collected in a transaction and committed at once; the
+ * commit waits until ovs-vswitchd applied the new configuration.
+ */
+#define NI_OVSDB_SOCKET_PATHS		{ "/run/openvswitch/db.sock",		\
+					  "/var/run/openvswitch/db.sock",	\
+					  NULL }
+#define NI_OVSDB_CALL_TIMEOUT		5000		/* msec */
+#define NI_OVSDB_APPLY_TIMEOUT		10000		/* msec */
+
+typedef struct ni_ovsdb_txn		ni_ovsdb_txn_t;
+
+extern ni_bool_t	ni_ovsdb_available(void);
+extern void		ni_ovsdb_close(void);
+
+extern int		ni_ovsdb_bridge_exists(const char *);
+extern int		ni_ovsdb_bridge_to_parent(const char *, char **, uint16_t *);
+extern int		ni_ovsdb_bridge_ports(const char *, ni_ovs_bridge_port_array_t *);
+extern int		ni_ovsdb_port_to_bridge(const char *, char **);
+
+extern ni_ovsdb_txn_t *	ni_ovsdb_txn_new(void);
+extern void		ni_ovsdb_txn_free(ni_ovsdb_txn_t *);
+extern ni_bool_t	ni_ovsdb_txn_bridge_add(ni_ovsdb_txn_t *, const char *,
+					const char *, uint16_t, ni_bool_t);
+extern ni_bool_t	ni_ovsdb_txn_bridge_del(ni_ovsdb_txn_t *, const char *);
+extern ni_bool_t	ni_ovsdb_txn_port_add(ni_ovsdb_txn_t *, const char *,
+					const char *, ni_bool_t);
+extern ni_bool_t	ni_ovsdb_txn_port_del(ni_ovsdb_txn_t *, const char *,
+					const char *);
+extern int		ni_ovsdb_txn_commit(ni_ovsdb_txn_t *);
+
+#endif /* NI_WICKED_OVSDB_H */
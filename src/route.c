@@ -1503,23 +1503,15 @@ ni_route_array_destroy(ni_route_array_t *nra)
 }
 
 static ni_bool_t
-ni_route_array_realloc(ni_route_array_t *nra, unsigned int newsize)
+ni_route_array_realloc(ni_route_array_t *nra, unsigned int add)
 {
 	ni_route_t **newdata;
-	unsigned int i;
-
-	if ((UINT_MAX - NI_ROUTE_ARRAY_CHUNK) <= newsize)
-		return FALSE;
 
-	newsize = (newsize + NI_ROUTE_ARRAY_CHUNK);
-	newdata = xrealloc(nra->data, newsize * sizeof(ni_route_t *));
+	newdata = ni_array_grow_typed(nra, add, NI_ROUTE_ARRAY_CHUNK, 0);
 	if (!newdata)
 		return FALSE;
 
 	nra->data = newdata;
-	for (i = nra->count; i < newsize; ++i) {
-		nra->data[i] = NULL;
-	}
 	return TRUE;
 }
 
@@ -1529,8 +1521,7 @@ ni_route_array_append(ni_route_array_t *nra, ni_route_t *rp)
 	if (!nra || !rp)
 		return FALSE;
 
-	if ((nra->count % NI_ROUTE_ARRAY_CHUNK) == 0 &&
-	    !ni_route_array_realloc(nra, nra->count))
+	if (!ni_route_array_realloc(nra, 1))
 		return FALSE;
 
 	nra->data[nra->count++] = rp;
@@ -2338,23 +2329,15 @@ ni_rule_array_index(const ni_rule_array_t *rules, const ni_rule_t *rule)
 }
 
 static ni_bool_t
-ni_rule_array_realloc(ni_rule_array_t *rules, unsigned int newsize)
+ni_rule_array_realloc(ni_rule_array_t *rules, unsigned int add)
 {
 	ni_rule_t **newdata;
-	unsigned int i;
-
-	if ((UINT_MAX - NI_RULE_ARRAY_CHUNK) <= newsize)
-		return FALSE;
 
-	newsize = (newsize + NI_RULE_ARRAY_CHUNK);
-	newdata = xrealloc(rules->data, newsize * sizeof(ni_rule_t *));
+	newdata = ni_array_grow_typed(rules, add, NI_RULE_ARRAY_CHUNK, 0);
 	if (!newdata)
 		return FALSE;
 
 	rules->data = newdata;
-	for (i = rules->count; i < newsize; ++i)
-		rules->data[i] = NULL;
-
 	return TRUE;
 }
 
@@ -2364,8 +2347,7 @@ ni_rule_array_append(ni_rule_array_t *rules, ni_rule_t *rule)
 	if (!rules || !rule)
 		return FALSE;
 
-	if ((rules->count % NI_RULE_ARRAY_CHUNK) == 0 &&
-	    !ni_rule_array_realloc(rules, rules->count))
+	if (!ni_rule_array_realloc(rules, 1))
 		return FALSE;
 
 	rules->data[rules->count++] = rule;
@@ -2381,8 +2363,7 @@ ni_rule_array_insert(ni_rule_array_t *rules, unsigned int index, ni_rule_t *rule
 	if (index >= rules->count)
 		return ni_rule_array_append(rules, rule);
 
-	if ((rules->count % NI_RULE_ARRAY_CHUNK) == 0 &&
-	    !ni_rule_array_realloc(rules, rules->count))
+	if (!ni_rule_array_realloc(rules, 1))
 		return FALSE;
 
 	memmove(&rules->data[index + 1], &rules->data[index],
@@ -10,6 +10,8 @@
 #include <wicked/util.h>
 #include "util_priv.h"
 
+#define NI_SECRET_ARRAY_CHUNK		4
+
 	
 static ni_bool_t	ni_security_id_greater_equal(const ni_security_id_t *, const ni_security_id_t *);
 
@@ -162,8 +164,9 @@ ni_secret_array_append(ni_secret_array_t *array, ni_secret_t *sec)
 	if (sec == NULL)
 		return;
 
-	array->data = xrealloc(array->data, (array->count + 1) * sizeof(sec));
-	array->data[array->count + 1] = ni_secret_get(sec);
+	if (!ni_array_reserve(array, 1, NI_SECRET_ARRAY_CHUNK, 0))
+		ni_fatal("%s: out of memory", __func__);
+	array->data[array->count++] = ni_secret_get(sec);
 }
 
 void
@@ -0,0 +1,899 @@
+/*
+ *	Shared memory snapshot of the network interface state.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include <wicked/netinfo.h>
+#include <wicked/address.h>
+#include <wicked/route.h>
+#include <wicked/addrconf.h>
+#include <wicked/vlan.h>
+#include <wicked/bonding.h>
+#include <wicked/logging.h>
+#include "netinfo_priv.h"
+#include "client/client_state.h"
+#include "buffer.h"
+#include "snapshot.h"
+
+#define NI_STATE_SNAPSHOT_MIN_CAPACITY	65536
+#define NI_STATE_SNAPSHOT_READ_RETRIES	100
+
+typedef struct ni_state_snapshot_record	ni_state_snapshot_record_t;
+
+struct ni_state_snapshot_record {
+	ni_state_snapshot_record_t *	next;
+	unsigned int			ifindex;
+	ni_buffer_t			data;
+
+	size_t				offset;		/* in the published payload */
+	ni_bool_t			changed;	/* since it was published */
+};
+
+#define NI_STATE_SNAPSHOT_UNPUBLISHED	((size_t)-1)
+
+static struct ni_state_snapshot_writer {
+	char *				path;
+	int				fd;
+	ni_state_snapshot_header_t *	map;
+	size_t				size;
+
+	ni_state_snapshot_record_t *	records;
+	ni_hashtable_t			index;
+	ni_buffer_t			scratch;
+
+	ni_uint_array_t			dirty;
+	ni_bool_t			dirty_all;
+} ni_state_snapshot_writer = {
+	.fd		= -1,
+	.index		= NI_HASHTABLE_INIT,
+	.dirty		= NI_UINT_ARRAY_INIT,
+};
+
+/*
+ * Record encoding
+ */
+static inline void
+ni_state_snapshot_put(ni_buffer_t *bp, const void *data, size_t len)
+{
+	ni_buffer_ensure_tailroom(bp, len);
+	ni_buffer_put(bp, data, len);
+}
+
+static inline void
+ni_state_snapshot_put_uint(ni_buffer_t *bp, unsigned int value)
+{
+	uint32_t v = value;
+
+	ni_state_snapshot_put(bp, &v, sizeof(v));
+}
+
+static inline void
+ni_state_snapshot_put_string(ni_buffer_t *bp, const char *str)
+{
+	size_t len = str ? strlen(str) : 0;
+
+	ni_state_snapshot_put_uint(bp, len);
+	ni_state_snapshot_put(bp, str, len);
+}
+
+/*
+ * Addresses are encoded by their significant bytes only: the padding
+ * of the structs is undefined and would defeat the record compare.
+ */
+static void
+ni_state_snapshot_put_sockaddr(ni_buffer_t *bp, const ni_sockaddr_t *sa)
+{
+	unsigned int offset = 0, len = 0;
+
+	if (!ni_af_sockaddr_info(sa->ss_family, &offset, &len))
+		offset = len = 0;
+	ni_state_snapshot_put_uint(bp, len ? sa->ss_family : AF_UNSPEC);
+	ni_state_snapshot_put_uint(bp, len);
+	ni_state_snapshot_put(bp, (const unsigned char *)sa + offset, len);
+}
+
+static void
+ni_state_snapshot_put_hwaddr(ni_buffer_t *bp, const ni_hwaddr_t *hwa)
+{
+	unsigned int len = min_t(unsigned int, hwa->len, sizeof(hwa->data));
+
+	ni_state_snapshot_put_uint(bp, hwa->type);
+	ni_state_snapshot_put_uint(bp, len);
+	ni_state_snapshot_put(bp, hwa->data, len);
+}
+
+static inline ni_bool_t
+ni_state_snapshot_get_uint(ni_buffer_t *bp, unsigned int *value)
+{
+	uint32_t v;
+
+	if (ni_buffer_get(bp, &v, sizeof(v)) < 0)
+		return FALSE;
+	*value = v;
+	return TRUE;
+}
+
+static inline ni_bool_t
+ni_state_snapshot_get_string(ni_buffer_t *bp, char **str)
+{
+	unsigned int len;
+
+	if (!ni_state_snapshot_get_uint(bp, &len) || len > ni_buffer_count(bp))
+		return FALSE;
+
+	ni_string_free(str);
+	if (len) {
+		*str = xmalloc(len + 1);
+		memcpy(*str, ni_buffer_head(bp), len);
+		(*str)[len] = '\0';
+	}
+	bp->head += len;
+	return TRUE;
+}
+
+static ni_bool_t
+ni_state_snapshot_get_sockaddr(ni_buffer_t *bp, ni_sockaddr_t *sa)
+{
+	unsigned int family, len, offset, size;
+
+	memset(sa, 0, sizeof(*sa));
+	if (!ni_state_snapshot_get_uint(bp, &family) ||
+	    !ni_state_snapshot_get_uint(bp, &len))
+		return FALSE;
+	if (!len)
+		return TRUE;
+
+	if (!ni_af_sockaddr_info(family, &offset, &size) || len != size ||
+	    ni_buffer_get(bp, (unsigned char *)sa + offset, len) < 0)
+		return FALSE;
+	sa->ss_family = family;
+	return TRUE;
+}
+
+static ni_bool_t
+ni_state_snapshot_get_hwaddr(ni_buffer_t *bp, ni_hwaddr_t *hwa)
+{
+	unsigned int type, len;
+
+	ni_link_address_init(hwa);
+	if (!ni_state_snapshot_get_uint(bp, &type) ||
+	    !ni_state_snapshot_get_uint(bp, &len) || len > sizeof(hwa->data) ||
+	    ni_buffer_get(bp, hwa->data, len) < 0)
+		return FALSE;
+	hwa->type = type;
+	hwa->len = len;
+	return TRUE;
+}
+
+static void
+ni_state_snapshot_encode_netdev(ni_buffer_t *bp, const ni_netdev_t *dev)
+{
+	const ni_client_state_t *cs = dev->client_state;
+	const ni_addrconf_lease_t *lease;
+	const ni_route_nexthop_t *nh;
+	const ni_route_table_t *tab;
+	const ni_address_t *ap;
+	const ni_route_t *rp;
+	unsigned int i, n;
+
+	ni_state_snapshot_put_uint(bp, dev->link.ifindex);
+	ni_state_snapshot_put_uint(bp, dev->link.type);
+	ni_state_snapshot_put_uint(bp, dev->link.ifflags);
+	ni_state_snapshot_put_uint(bp, dev->link.mtu);
+	ni_state_snapshot_put_string(bp, dev->name);
+	ni_state_snapshot_put_string(bp, dev->link.alias);
+	ni_state_snapshot_put_string(bp, dev->link.masterdev.name);
+	ni_state_snapshot_put_string(bp, dev->link.lowerdev.name);
+	ni_state_snapshot_put_hwaddr(bp, &dev->link.hwaddr);
+	ni_state_snapshot_put_hwaddr(bp, &dev->link.hwpeer);
+
+	ni_state_snapshot_put_uint(bp, dev->vlan != NULL);
+	if (dev->vlan) {
+		ni_state_snapshot_put_uint(bp, dev->vlan->protocol);
+		ni_state_snapshot_put_uint(bp, dev->vlan->tag);
+	}
+	ni_state_snapshot_put_uint(bp, dev->bonding != NULL);
+	if (dev->bonding)
+		ni_state_snapshot_put_uint(bp, dev->bonding->mode);
+
+	ni_state_snapshot_put_uint(bp, cs != NULL);
+	if (cs) {
+		ni_state_snapshot_put_uint(bp, cs->control.persistent);
+		ni_state_snapshot_put_uint(bp, cs->control.usercontrol);
+		ni_state_snapshot_put_uint(bp, cs->control.require_link);
+		ni_state_snapshot_put_string(bp, cs->config.origin);
+		ni_state_snapshot_put(bp, &cs->config.uuid, sizeof(cs->config.uuid));
+		ni_state_snapshot_put_uint(bp, cs->config.owner);
+	}
+
+	for (n = 0, ap = dev->addrs; ap; ap = ap->next)
+		n++;
+	ni_state_snapshot_put_uint(bp, n);
+	for (ap = dev->addrs; ap; ap = ap->next) {
+		ni_state_snapshot_put_uint(bp, ap->family);
+		ni_state_snapshot_put_uint(bp, ap->prefixlen);
+		ni_state_snapshot_put_uint(bp, ap->flags);
+		ni_state_snapshot_put_uint(bp, ap->scope);
+		ni_state_snapshot_put_uint(bp, ap->owner);
+		ni_state_snapshot_put_sockaddr(bp, &ap->local_addr);
+		ni_state_snapshot_put_sockaddr(bp, &ap->peer_addr);
+	}
+
+	for (n = 0, tab = dev->routes; tab; tab = tab->next)
+		n += tab->routes.count;
+	ni_state_snapshot_put_uint(bp, n);
+	for (tab = dev->routes; tab; tab = tab->next) {
+		for (i = 0; i < tab->routes.count; ++i) {
+			rp = tab->routes.data[i];
+
+			ni_state_snapshot_put_uint(bp, rp->family);
+			ni_state_snapshot_put_uint(bp, rp->prefixlen);
+			ni_state_snapshot_put_uint(bp, rp->table);
+			ni_state_snapshot_put_uint(bp, rp->type);
+			ni_state_snapshot_put_uint(bp, rp->scope);
+			ni_state_snapshot_put_uint(bp, rp->protocol);
+			ni_state_snapshot_put_uint(bp, rp->priority);
+			ni_state_snapshot_put_uint(bp, rp->owner);
+			ni_state_snapshot_put_sockaddr(bp, &rp->destination);
+
+			for (n = 0, nh = &rp->nh; nh; nh = nh->next)
+				n++;
+			ni_state_snapshot_put_uint(bp, n);
+			for (nh = &rp->nh; nh; nh = nh->next)
+				ni_state_snapshot_put_sockaddr(bp, &nh->gateway);
+		}
+	}
+
+	for (n = 0, lease = dev->leases; lease; lease = lease->next)
+		n++;
+	ni_state_snapshot_put_uint(bp, n);
+	for (lease = dev->leases; lease; lease = lease->next) {
+		ni_state_snapshot_put_uint(bp, lease->family);
+		ni_state_snapshot_put_uint(bp, lease->type);
+		ni_state_snapshot_put_uint(bp, lease->state);
+		ni_state_snapshot_put_uint(bp, lease->flags);
+	}
+}
+
+static ni_bool_t
+ni_state_snapshot_decode_addrs(ni_buffer_t *bp, ni_netdev_t *dev)
+{
+	unsigned int n, family, prefixlen, flags, scope, owner;
+	ni_sockaddr_t local, peer;
+	ni_address_t *ap;
+
+	if (!ni_state_snapshot_get_uint(bp, &n))
+		return FALSE;
+
+	while (n--) {
+		if (!ni_state_snapshot_get_uint(bp, &family) ||
+		    !ni_state_snapshot_get_uint(bp, &prefixlen) ||
+		    !ni_state_snapshot_get_uint(bp, &flags) ||
+		    !ni_state_snapshot_get_uint(bp, &scope) ||
+		    !ni_state_snapshot_get_uint(bp, &owner) ||
+		    !ni_state_snapshot_get_sockaddr(bp, &local) ||
+		    !ni_state_snapshot_get_sockaddr(bp, &peer))
+			return FALSE;
+
+		if (!(ap = ni_address_new(family, prefixlen, &local, &dev->addrs)))
+			continue;
+		ap->flags = flags;
+		ap->scope = (int)scope;
+		ap->owner = owner;
+		ap->peer_addr = peer;
+	}
+	return TRUE;
+}
+
+static ni_bool_t
+ni_state_snapshot_decode_routes(ni_buffer_t *bp, ni_netdev_t *dev)
+{
+	unsigned int n, owner, hops;
+	ni_route_nexthop_t **tail;
+	ni_route_t *rp;
+
+	if (!ni_state_snapshot_get_uint(bp, &n))
+		return FALSE;
+
+	while (n--) {
+		rp = ni_route_new();
+		if (!ni_state_snapshot_get_uint(bp, &rp->family) ||
+		    !ni_state_snapshot_get_uint(bp, &rp->prefixlen) ||
+		    !ni_state_snapshot_get_uint(bp, &rp->table) ||
+		    !ni_state_snapshot_get_uint(bp, &rp->type) ||
+		    !ni_state_snapshot_get_uint(bp, &rp->scope) ||
+		    !ni_state_snapshot_get_uint(bp, &rp->protocol) ||
+		    !ni_state_snapshot_get_uint(bp, &rp->priority) ||
+		    !ni_state_snapshot_get_uint(bp, &owner) ||
+		    !ni_state_snapshot_get_sockaddr(bp, &rp->destination) ||
+		    !ni_state_snapshot_get_uint(bp, &hops) || !hops ||
+		    !ni_state_snapshot_get_sockaddr(bp, &rp->nh.gateway)) {
+			ni_route_free(rp);
+			return FALSE;
+		}
+		rp->owner = owner;
+
+		for (tail = &rp->nh.next; --hops; tail = &(*tail)->next) {
+			*tail = ni_route_nexthop_new();
+			if (!ni_state_snapshot_get_sockaddr(bp, &(*tail)->gateway)) {
+				ni_route_free(rp);
+				return FALSE;
+			}
+		}
+
+		if (!ni_route_tables_add_route(&dev->routes, rp))
+			ni_route_free(rp);
+	}
+	return TRUE;
+}
+
+static ni_bool_t
+ni_state_snapshot_decode_leases(ni_buffer_t *bp, ni_netdev_t *dev)
+{
+	unsigned int n, family, type, state, flags;
+	ni_addrconf_lease_t *lease;
+
+	if (!ni_state_snapshot_get_uint(bp, &n))
+		return FALSE;
+
+	while (n--) {
+		if (!ni_state_snapshot_get_uint(bp, &family) ||
+		    !ni_state_snapshot_get_uint(bp, &type) ||
+		    !ni_state_snapshot_get_uint(bp, &state) ||
+		    !ni_state_snapshot_get_uint(bp, &flags))
+			return FALSE;
+
+		if (!(lease = ni_addrconf_lease_new(type, family)))
+			continue;
+		lease->state = state;
+		lease->flags = flags;
+		ni_netdev_set_lease(dev, lease);
+	}
+	return TRUE;
+}
+
+static ni_netdev_t *
+ni_state_snapshot_decode_netdev(ni_buffer_t *bp)
+{
+	unsigned int ifindex, value;
+	ni_client_state_t *cs;
+	ni_netdev_t *dev;
+
+	if (!ni_state_snapshot_get_uint(bp, &ifindex))
+		return NULL;
+
+	if (!(dev = ni_netdev_new(NULL, ifindex)))
+		return NULL;
+	if (!ni_state_snapshot_get_uint(bp, &value))
+		goto failure;
+	dev->link.type = value;
+	if (!ni_state_snapshot_get_uint(bp, &dev->link.ifflags) ||
+	    !ni_state_snapshot_get_uint(bp, &dev->link.mtu) ||
+	    !ni_state_snapshot_get_string(bp, &dev->name) ||
+	    !ni_state_snapshot_get_string(bp, &dev->link.alias) ||
+	    !ni_state_snapshot_get_string(bp, &dev->link.masterdev.name) ||
+	    !ni_state_snapshot_get_string(bp, &dev->link.lowerdev.name) ||
+	    !ni_state_snapshot_get_hwaddr(bp, &dev->link.hwaddr) ||
+	    !ni_state_snapshot_get_hwaddr(bp, &dev->link.hwpeer))
+		goto failure;
+
+	if (!ni_state_snapshot_get_uint(bp, &value))
+		goto failure;
+	if (value) {
+		ni_vlan_t *vlan = ni_netdev_get_vlan(dev);
+
+		if (!ni_state_snapshot_get_uint(bp, &value))
+			goto failure;
+		vlan->protocol = value;
+		if (!ni_state_snapshot_get_uint(bp, &value))
+			goto failure;
+		vlan->tag = value;
+	}
+
+	if (!ni_state_snapshot_get_uint(bp, &value))
+		goto failure;
+	if (value) {
+		ni_bonding_t *bond = ni_netdev_get_bonding(dev);
+
+		if (!ni_state_snapshot_get_uint(bp, &value))
+			goto failure;
+		bond->mode = value;
+	}
+
+	if (!ni_state_snapshot_get_uint(bp, &value))
+		goto failure;
+	if (value) {
+		cs = ni_netdev_get_client_state(dev);
+		if (!ni_state_snapshot_get_uint(bp, &value))
+			goto failure;
+		cs->control.persistent = !!value;
+		if (!ni_state_snapshot_get_uint(bp, &value))
+			goto failure;
+		cs->control.usercontrol = !!value;
+		if (!ni_state_snapshot_get_uint(bp, &value))
+			goto failure;
+		cs->control.require_link = (ni_tristate_t)value;
+		if (!ni_state_snapshot_get_string(bp, &cs->config.origin) ||
+		    ni_buffer_get(bp, &cs->config.uuid, sizeof(cs->config.uuid)) < 0 ||
+		    !ni_state_snapshot_get_uint(bp, &value))
+			goto failure;
+		cs->config.owner = value;
+	}
+
+	if (!ni_state_snapshot_decode_addrs(bp, dev) ||
+	    !ni_state_snapshot_decode_routes(bp, dev) ||
+	    !ni_state_snapshot_decode_leases(bp, dev))
+		goto failure;
+
+	return dev;
+
+failure:
+	ni_netdev_put(dev);
+	return NULL;
+}
+
+/*
+ * Writer side, used by wickedd
+ */
+static ni_bool_t
+ni_state_snapshot_create(size_t capacity)
+{
+	struct ni_state_snapshot_writer *wr = &ni_state_snapshot_writer;
+	ni_state_snapshot_record_t *rec;
+	ni_state_snapshot_header_t *map;
+	char *tmpname = NULL;
+	size_t size;
+	int fd;
+
+	size = sizeof(*map) + capacity;
+	if (!ni_string_printf(&tmpname, "%s.XXXXXX", wr->path))
+		return FALSE;
+
+	if ((fd = mkstemp(tmpname)) < 0) {
+		ni_error("unable to create state snapshot %s: %m", tmpname);
+		ni_string_free(&tmpname);
+		return FALSE;
+	}
+	if (fchmod(fd, 0644) < 0 || ftruncate(fd, size) < 0) {
+		ni_error("unable to resize state snapshot %s: %m", tmpname);
+		goto failure;
+	}
+
+	map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		ni_error("unable to map state snapshot %s: %m", tmpname);
+		goto failure;
+	}
+
+	memset(map, 0, sizeof(*map));
+	map->magic = NI_STATE_SNAPSHOT_MAGIC;
+	map->version = NI_STATE_SNAPSHOT_VERSION;
+	map->pid = getpid();
+	map->capacity = capacity;
+	if (wr->map)
+		map->generation = wr->map->generation;
+
+	if (rename(tmpname, wr->path) < 0) {
+		ni_error("unable to rename state snapshot %s: %m", tmpname);
+		munmap(map, size);
+		goto failure;
+	}
+	ni_string_free(&tmpname);
+
+	if (wr->map) {
+		wr->map->retired = 1;
+		munmap(wr->map, wr->size);
+		close(wr->fd);
+	}
+	wr->map = map;
+	wr->size = size;
+	wr->fd = fd;
+
+	/* the new file has an empty payload */
+	for (rec = wr->records; rec; rec = rec->next)
+		rec->offset = NI_STATE_SNAPSHOT_UNPUBLISHED;
+	return TRUE;
+
+failure:
+	unlink(tmpname);
+	ni_string_free(&tmpname);
+	close(fd);
+	return FALSE;
+}
+
+ni_bool_t
+ni_state_snapshot_open(void)
+{
+	struct ni_state_snapshot_writer *wr = &ni_state_snapshot_writer;
+
+	if (wr->map)
+		return TRUE;
+
+	if (!ni_string_printf(&wr->path, "%s/%s", ni_config_statedir(),
+				NI_STATE_SNAPSHOT_FILE))
+		return FALSE;
+
+	if (!ni_state_snapshot_create(NI_STATE_SNAPSHOT_MIN_CAPACITY)) {
+		ni_string_free(&wr->path);
+		return FALSE;
+	}
+	wr->dirty_all = TRUE;
+	return TRUE;
+}
+
+static void
+ni_state_snapshot_record_free(ni_state_snapshot_record_t *rec)
+{
+	ni_buffer_destroy(&rec->data);
+	free(rec);
+}
+
+static void
+ni_state_snapshot_record_remove(unsigned int ifindex)
+{
+	struct ni_state_snapshot_writer *wr = &ni_state_snapshot_writer;
+	ni_state_snapshot_record_t **pos, *rec;
+
+	for (pos = &wr->records; (rec = *pos); pos = &rec->next) {
+		if (rec->ifindex == ifindex) {
+			ni_hashtable_remove(&wr->index, ni_hash_uint(ifindex), rec);
+			*pos = rec->next;
+			ni_state_snapshot_record_free(rec);
+			return;
+		}
+	}
+}
+
+static ni_state_snapshot_record_t *
+ni_state_snapshot_record_get(unsigned int ifindex)
+{
+	struct ni_state_snapshot_writer *wr = &ni_state_snapshot_writer;
+	ni_state_snapshot_record_t *rec;
+	ni_hashtable_iter_t iter;
+	unsigned int hash;
+
+	hash = ni_hash_uint(ifindex);
+	for (rec = ni_hashtable_lookup(&wr->index, hash, &iter); rec;
+	     rec = ni_hashtable_lookup_next(&iter)) {
+		if (rec->ifindex == ifindex)
+			return rec;
+	}
+	return NULL;
+}
+
+void
+ni_state_snapshot_close(void)
+{
+	struct ni_state_snapshot_writer *wr = &ni_state_snapshot_writer;
+	ni_state_snapshot_record_t *rec;
+
+	if (wr->map) {
+		munmap(wr->map, wr->size);
+		close(wr->fd);
+		unlink(wr->path);
+		wr->map = NULL;
+		wr->size = 0;
+		wr->fd = -1;
+	}
+	while ((rec = wr->records)) {
+		wr->records = rec->next;
+		ni_state_snapshot_record_free(rec);
+	}
+	ni_hashtable_destroy(&wr->index);
+	ni_buffer_destroy(&wr->scratch);
+	ni_uint_array_destroy(&wr->dirty);
+	ni_string_free(&wr->path);
+	wr->dirty_all = FALSE;
+}
+
+void
+ni_state_snapshot_mark(unsigned int ifindex)
+{
+	struct ni_state_snapshot_writer *wr = &ni_state_snapshot_writer;
+
+	if (!wr->map || wr->dirty_all || !ifindex)
+		return;
+
+	if (!ni_uint_array_contains(&wr->dirty, ifindex))
+		ni_uint_array_append(&wr->dirty, ifindex);
+}
+
+void
+ni_state_snapshot_mark_all(void)
+{
+	struct ni_state_snapshot_writer *wr = &ni_state_snapshot_writer;
+
+	if (wr->map)
+		wr->dirty_all = TRUE;
+}
+
+/*
+ * Re-encode the devices marked since the last commit and update
+ * the published records. Records of devices that did not change
+ * and kept their position in the payload are not written again.
+ */
+static ni_bool_t
+ni_state_snapshot_record_encode(ni_state_snapshot_record_t *rec, const ni_netdev_t *dev)
+{
+	struct ni_state_snapshot_writer *wr = &ni_state_snapshot_writer;
+	size_t len;
+
+	if (!wr->scratch.size)
+		ni_buffer_init_dynamic(&wr->scratch, 512);
+	else
+		ni_buffer_clear(&wr->scratch);
+	ni_state_snapshot_encode_netdev(&wr->scratch, dev);
+
+	len = ni_buffer_count(&wr->scratch);
+	if (len == ni_buffer_count(&rec->data) &&
+	    !memcmp(ni_buffer_head(&wr->scratch), ni_buffer_head(&rec->data), len))
+		return FALSE;
+
+	ni_buffer_clear(&rec->data);
+	ni_state_snapshot_put(&rec->data, ni_buffer_head(&wr->scratch), len);
+	rec->changed = TRUE;
+	return TRUE;
+}
+
+void
+ni_state_snapshot_commit(ni_netconfig_t *nc)
+{
+	struct ni_state_snapshot_writer *wr = &ni_state_snapshot_writer;
+	ni_state_snapshot_header_t *map;
+	ni_state_snapshot_record_t *rec, *next;
+	unsigned char *payload;
+	unsigned int i, count;
+	ni_bool_t writing;
+	size_t length;
+	ni_netdev_t *dev;
+
+	if (!wr->map || !nc || (!wr->dirty_all && !wr->dirty.count))
+		return;
+
+	if (wr->dirty_all) {
+		for (rec = wr->records; rec; rec = next) {
+			next = rec->next;
+			if (!ni_netdev_by_index(nc, rec->ifindex))
+				ni_state_snapshot_record_remove(rec->ifindex);
+		}
+	} else {
+		for (i = 0; i < wr->dirty.count; ++i) {
+			if (!ni_netdev_by_index(nc, wr->dirty.data[i]))
+				ni_state_snapshot_record_remove(wr->dirty.data[i]);
+		}
+	}
+
+	length = 0;
+	count = 0;
+	for (dev = ni_netconfig_devlist(nc); dev; dev = dev->next) {
+		if (!dev->link.ifindex)
+			continue;
+
+		if (!(rec = ni_state_snapshot_record_get(dev->link.ifindex))) {
+			rec = xcalloc(1, sizeof(*rec));
+			rec->ifindex = dev->link.ifindex;
+			rec->offset = NI_STATE_SNAPSHOT_UNPUBLISHED;
+			ni_buffer_init_dynamic(&rec->data, 512);
+			rec->next = wr->records;
+			wr->records = rec;
+			ni_hashtable_insert(&wr->index, ni_hash_uint(rec->ifindex), rec);
+			ni_state_snapshot_record_encode(rec, dev);
+		} else
+		if (wr->dirty_all || ni_uint_array_contains(&wr->dirty, rec->ifindex)) {
+			ni_state_snapshot_record_encode(rec, dev);
+		}
+
+		length += sizeof(uint32_t) + ni_buffer_count(&rec->data);
+		count++;
+	}
+
+	ni_uint_array_destroy(&wr->dirty);
+	wr->dirty_all = FALSE;
+
+	if (length > wr->map->capacity) {
+		size_t capacity = wr->map->capacity;
+
+		while (capacity < length)
+			capacity *= 2;
+		if (!ni_state_snapshot_create(capacity)) {
+			/* retry with the next commit */
+			wr->dirty_all = TRUE;
+			return;
+		}
+	}
+
+	map = wr->map;
+	payload = (unsigned char *)(map + 1);
+	writing = FALSE;
+	length = 0;
+	for (dev = ni_netconfig_devlist(nc); dev; dev = dev->next) {
+		uint32_t len;
+
+		if (!dev->link.ifindex || !(rec = ni_state_snapshot_record_get(dev->link.ifindex)))
+			continue;
+
+		len = ni_buffer_count(&rec->data);
+		if (rec->changed || rec->offset != length) {
+			if (!writing) {
+				writing = TRUE;
+				map->seq++;
+				__sync_synchronize();
+			}
+			memcpy(payload + length, &len, sizeof(len));
+			memcpy(payload + length + sizeof(len), ni_buffer_head(&rec->data), len);
+			rec->offset = length;
+			rec->changed = FALSE;
+		}
+		length += sizeof(len) + len;
+	}
+
+	if (!writing && map->length == length && map->count == count)
+		return;
+
+	if (!writing) {
+		map->seq++;
+		__sync_synchronize();
+	}
+	map->length = length;
+	map->count = count;
+	map->generation++;
+
+	__sync_synchronize();
+	map->seq++;
+}
+
+/*
+ * Reader side
+ */
+static ni_bool_t
+ni_state_snapshot_writer_alive(const ni_state_snapshot_header_t *hdr)
+{
+	if (!hdr->pid)
+		return FALSE;
+	return kill(hdr->pid, 0) == 0 || errno == EPERM;
+}
+
+static void *
+ni_state_snapshot_copy(const char *path, uint32_t *length, uint32_t *count)
+{
+	const ni_state_snapshot_header_t *hdr;
+	unsigned char *copy = NULL;
+	unsigned int retry, reopen;
+	struct stat stb;
+	void *map;
+	int fd;
+
+	for (reopen = 0; reopen < 3; ++reopen) {
+		if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+			return NULL;
+
+		if (fstat(fd, &stb) < 0 || (size_t)stb.st_size < sizeof(*hdr)) {
+			close(fd);
+			return NULL;
+		}
+
+		map = mmap(NULL, stb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		if (map == MAP_FAILED)
+			return NULL;
+
+		hdr = map;
+		if (hdr->magic != NI_STATE_SNAPSHOT_MAGIC ||
+		    hdr->version != NI_STATE_SNAPSHOT_VERSION ||
+		    sizeof(*hdr) + hdr->capacity > (size_t)stb.st_size ||
+		    !ni_state_snapshot_writer_alive(hdr)) {
+			munmap(map, stb.st_size);
+			return NULL;
+		}
+
+		for (retry = 0; retry < NI_STATE_SNAPSHOT_READ_RETRIES; ++retry) {
+			uint32_t seq;
+
+			if (hdr->retired)
+				break;
+
+			seq = hdr->seq;
+			__sync_synchronize();
+			if (seq & 1) {
+				sched_yield();
+				continue;
+			}
+
+			*length = hdr->length;
+			*count = hdr->count;
+			if (*length > hdr->capacity)
+				continue;
+
+			copy = xrealloc(copy, *length + 1);
+			memcpy(copy, hdr + 1, *length);
+
+			__sync_synchronize();
+			if (hdr->seq == seq) {
+				munmap(map, stb.st_size);
+				return copy;
+			}
+		}
+
+		munmap(map, stb.st_size);
+		if (retry == NI_STATE_SNAPSHOT_READ_RETRIES)
+			break;
+	}
+
+	free(copy);
+	return NULL;
+}
+
+/*
+ * Build a netconfig with the devices published by wickedd.
+ * Returns NULL when there is no (valid) snapshot and the
+ * caller has to fall back to query the state over dbus.
+ */
+ni_netconfig_t *
+ni_state_snapshot_load(const char *path)
+{
+	char *defpath = NULL;
+	uint32_t length, count, len;
+	ni_netconfig_t *nc;
+	ni_netdev_t *dev;
+	ni_buffer_t buf, rec;
+	void *payload;
+
+	if (ni_string_empty(path)) {
+		if (!ni_string_printf(&defpath, "%s/%s", ni_config_statedir(),
+					NI_STATE_SNAPSHOT_FILE))
+			return NULL;
+		path = defpath;
+	}
+
+	payload = ni_state_snapshot_copy(path, &length, &count);
+	ni_string_free(&defpath);
+	if (!payload)
+		return NULL;
+
+	nc = ni_netconfig_new();
+	ni_buffer_init_reader(&buf, payload, length);
+	while (count--) {
+		if (ni_buffer_get(&buf, &len, sizeof(len)) < 0 || len > ni_buffer_count(&buf))
+			goto failure;
+
+		ni_buffer_init_reader(&rec, ni_buffer_head(&buf), len);
+		buf.head += len;
+
+		if (!(dev = ni_state_snapshot_decode_netdev(&rec)))
+			goto failure;
+		ni_netconfig_device_append(nc, dev);
+	}
+	free(payload);
+	return nc;
+
+failure:
+	ni_error("%s: discarding corrupted state snapshot", path);
+	ni_netconfig_free(nc);
+	free(payload);
+	return NULL;
+}
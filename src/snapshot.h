@@ -0,0 +1,65 @@
+/*
+ *	Shared memory snapshot of the network interface state.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef   __WICKED_SNAPSHOT_H__
+#define   __WICKED_SNAPSHOT_H__
+
+#include <stdint.h>
+#include <wicked/types.h>
+
+/*
+ * wickedd publishes the state of its interfaces (link, addresses,
+ * routes, leases and client state) in a file in the state directory,
+ * which read-only clients such as "wicked show" mmap instead of
+ * fetching all objects over dbus.
+ *
+ * The file starts with a header followed by a sequence of records,
+ * one per device, each prefixed by its 32bit length. The payload is
+ * protected by a sequence lock: the writer makes the sequence number
+ * odd while it modifies the payload. Readers copy the payload and
+ * retry when the sequence number was odd or changed meanwhile.
+ *
+ * When the payload outgrows the file, the writer replaces the file
+ * and sets the retired flag in the old one.
+ */
+#define NI_STATE_SNAPSHOT_FILE		"state.snapshot"
+#define NI_STATE_SNAPSHOT_MAGIC		0x6e697373	/* "niss" */
+#define NI_STATE_SNAPSHOT_VERSION	2
+
+typedef struct ni_state_snapshot_header {
+	uint32_t		magic;
+	uint32_t		version;
+	uint32_t		pid;		/* of the writer */
+	uint32_t		retired;
+	volatile uint32_t	seq;
+	uint32_t		generation;	/* incremented on each update */
+	uint32_t		capacity;	/* payload bytes available */
+	uint32_t		length;		/* payload bytes used */
+	uint32_t		count;		/* number of records */
+	uint32_t		reserved[7];
+} ni_state_snapshot_header_t;
+
+/* wickedd */
+extern ni_bool_t		ni_state_snapshot_open(void);
+extern void			ni_state_snapshot_close(void);
+extern void			ni_state_snapshot_mark(unsigned int);
+extern void			ni_state_snapshot_mark_all(void);
+extern void			ni_state_snapshot_commit(ni_netconfig_t *);
+
+/* read-only clients */
+extern ni_netconfig_t *		ni_state_snapshot_load(const char *);
+
+#endif /* __WICKED_SNAPSHOT_H__ */
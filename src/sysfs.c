@@ -9,6 +9,9 @@
 
 #include <unistd.h>
 #include <limits.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stddef.h>
 #include <net/if_arp.h>
 
 #include <wicked/netinfo.h>
@@ -45,8 +48,31 @@
 #define NI_SYSFS_IBFT_TGT_PREFIX        "target"
 
 
+/*
+ * Attribute groups, read through one directory fd in a single pass
+ */
+typedef enum {
+	NI_SYSFS_ATTR_INT,
+	NI_SYSFS_ATTR_UINT,
+	NI_SYSFS_ATTR_ULONG,
+	NI_SYSFS_ATTR_STRING,
+} ni_sysfs_attr_type_t;
+
+typedef struct ni_sysfs_attr {
+	const char *		name;
+	ni_sysfs_attr_type_t	type;
+	size_t			offset;
+} ni_sysfs_attr_t;
+
+#define NI_SYSFS_ATTR(type, st, member, name)	\
+	{ name, NI_SYSFS_ATTR_##type, offsetof(st, member) }
+
 static const char *	__ni_sysfs_netif_attrpath(const char *ifname, const char *attr);
 static const char *	__ni_sysfs_netif_get_attr(const char *ifname, const char *attr);
+static int		__ni_sysfs_netif_opendir(const char *ifname, const char *subdir);
+static ssize_t		__ni_sysfs_dir_read(int dirfd, const char *, char *, size_t);
+static const char *	__ni_sysfs_dir_get_attr(int dirfd, const char *attr);
+static unsigned int	__ni_sysfs_dir_get_attrs(int dirfd, const ni_sysfs_attr_t *, void *);
 static int		__ni_sysfs_netif_put_attr(const char *, const char *, const char *);
 static int		__ni_sysfs_printf(const char *, const char *, ...);
 static int		__ni_sysfs_read_list(const char *, ni_string_array_t *);
@@ -197,22 +223,85 @@ ni_sysfs_netif_readlink(const char *ifname, const char *attr_name, char **link)
 
 static const char *
 __ni_sysfs_netif_get_attr(const char *ifname, const char *attr_name)
+{
+	return __ni_sysfs_dir_get_attr(AT_FDCWD,
+			__ni_sysfs_netif_attrpath(ifname, attr_name));
+}
+
+/*
+ * Read an attribute relative to dirfd. Unlike stdio, this is one
+ * open, read and close without any buffer allocation.
+ */
+static ssize_t
+__ni_sysfs_dir_read(int dirfd, const char *attr_name, char *buffer, size_t size)
+{
+	ssize_t len;
+	int fd;
+
+	if ((fd = openat(dirfd, attr_name, O_RDONLY | O_CLOEXEC)) < 0)
+		return -1;
+
+	do {
+		len = read(fd, buffer, size - 1);
+	} while (len < 0 && errno == EINTR);
+	close(fd);
+
+	if (len >= 0)
+		buffer[len] = '\0';
+	return len;
+}
+
+static const char *
+__ni_sysfs_dir_get_attr(int dirfd, const char *attr_name)
 {
 	static char buffer[256];
-	const char *filename;
-	char *result = NULL;
-	FILE *fp;
 
-	filename = __ni_sysfs_netif_attrpath(ifname, attr_name);
-	if (!(fp = fopen(filename, "r")))
+	if (__ni_sysfs_dir_read(dirfd, attr_name, buffer, sizeof(buffer)) <= 0)
 		return NULL;
 
-	if (fgets(buffer, sizeof(buffer), fp) != NULL) {
-		buffer[strcspn(buffer, "\n")] = '\0';
-		result = buffer;
+	buffer[strcspn(buffer, "\n")] = '\0';
+	return buffer;
+}
+
+static unsigned int
+__ni_sysfs_dir_get_attrs(int dirfd, const ni_sysfs_attr_t *attrs, void *base)
+{
+	const ni_sysfs_attr_t *attr;
+	unsigned int count = 0;
+	const char *value;
+	void *ptr;
+
+	for (attr = attrs; attr->name; ++attr) {
+		if (!(value = __ni_sysfs_dir_get_attr(dirfd, attr->name)))
+			continue;
+
+		ptr = (char *)base + attr->offset;
+		switch (attr->type) {
+		case NI_SYSFS_ATTR_INT:
+			*(int *)ptr = strtol(value, NULL, 0);
+			break;
+		case NI_SYSFS_ATTR_UINT:
+			*(unsigned int *)ptr = strtoul(value, NULL, 0);
+			break;
+		case NI_SYSFS_ATTR_ULONG:
+			*(unsigned long *)ptr = strtoul(value, NULL, 0);
+			break;
+		case NI_SYSFS_ATTR_STRING:
+			ni_string_dup((char **)ptr, value);
+			break;
+		default:
+			continue;
+		}
+		count++;
 	}
-	fclose(fp);
-	return result;
+	return count;
+}
+
+static int
+__ni_sysfs_netif_opendir(const char *ifname, const char *subdir)
+{
+	return open(__ni_sysfs_netif_attrpath(ifname, subdir),
+			O_RDONLY | O_DIRECTORY | O_CLOEXEC);
 }
 
 static int
@@ -410,26 +499,65 @@ done:
  * Bridge support
  * This should really be in bridge.c
  */
+static const ni_sysfs_attr_t	__ni_sysfs_bridge_status_attrs[] = {
+	NI_SYSFS_ATTR(UINT,   ni_bridge_status_t, stp_state,	"stp_state"),
+	NI_SYSFS_ATTR(STRING, ni_bridge_status_t, root_id,	"root_id"),
+	NI_SYSFS_ATTR(STRING, ni_bridge_status_t, bridge_id,	"bridge_id"),
+	NI_SYSFS_ATTR(STRING, ni_bridge_status_t, group_addr,	"group_addr"),
+	NI_SYSFS_ATTR(UINT,   ni_bridge_status_t, root_port,	"root_port"),
+	NI_SYSFS_ATTR(UINT,   ni_bridge_status_t, root_path_cost, "root_path_cost"),
+	NI_SYSFS_ATTR(UINT,   ni_bridge_status_t, topology_change, "topology_change"),
+	NI_SYSFS_ATTR(UINT,   ni_bridge_status_t, topology_change_detected, "topology_change_detected"),
+	NI_SYSFS_ATTR(ULONG,  ni_bridge_status_t, gc_timer,	"gc_timer"),
+	NI_SYSFS_ATTR(ULONG,  ni_bridge_status_t, tcn_timer,	"tcn_timer"),
+	NI_SYSFS_ATTR(ULONG,  ni_bridge_status_t, hello_timer,	"hello_timer"),
+	NI_SYSFS_ATTR(ULONG,  ni_bridge_status_t, topology_change_timer, "topology_change_timer"),
+	{ NULL }
+};
+
+static const ni_sysfs_attr_t	__ni_sysfs_bridge_port_status_attrs[] = {
+	NI_SYSFS_ATTR(UINT,   ni_bridge_port_status_t, priority,	"priority"),
+	NI_SYSFS_ATTR(UINT,   ni_bridge_port_status_t, path_cost,	"path_cost"),
+	NI_SYSFS_ATTR(INT,    ni_bridge_port_status_t, state,		"state"),
+	NI_SYSFS_ATTR(UINT,   ni_bridge_port_status_t, port_no,		"port_no"),
+	NI_SYSFS_ATTR(UINT,   ni_bridge_port_status_t, port_id,		"port_id"),
+	NI_SYSFS_ATTR(STRING, ni_bridge_port_status_t, designated_root,	"designated_root"),
+	NI_SYSFS_ATTR(STRING, ni_bridge_port_status_t, designated_bridge, "designated_bridge"),
+	NI_SYSFS_ATTR(UINT,   ni_bridge_port_status_t, designated_port,	"designated_port"),
+	NI_SYSFS_ATTR(UINT,   ni_bridge_port_status_t, designated_cost,	"designated_cost"),
+	NI_SYSFS_ATTR(UINT,   ni_bridge_port_status_t, change_ack,	"change_ack"),
+	NI_SYSFS_ATTR(UINT,   ni_bridge_port_status_t, hairpin_mode,	"hairpin_mode"),
+	NI_SYSFS_ATTR(UINT,   ni_bridge_port_status_t, config_pending,	"config_pending"),
+	NI_SYSFS_ATTR(ULONG,  ni_bridge_port_status_t, hold_timer,	"hold_timer"),
+	NI_SYSFS_ATTR(ULONG,  ni_bridge_port_status_t, message_age_timer, "message_age_timer"),
+	NI_SYSFS_ATTR(ULONG,  ni_bridge_port_status_t, forward_delay_timer, "forward_delay_timer"),
+	{ NULL }
+};
+
 void
 ni_sysfs_bridge_get_config(const char *ifname, ni_bridge_t *bridge)
 {
-	unsigned int  ui;
-	unsigned long ul;
-
-	if (ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_ATTR "/stp_state", &ui) == 0)
-		bridge->stp = ui ? TRUE : FALSE;
-
-	if (ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_ATTR "/priority", &ui) == 0)
-		bridge->priority = ui;
-
-	if (ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_ATTR "/forward_delay", &ui) == 0)
-		bridge->forward_delay = (double)ui / 100.0;
-	if (ni_sysfs_netif_get_ulong(ifname, SYSFS_BRIDGE_ATTR "/ageing_time", &ul) == 0)
-		bridge->ageing_time = (double)ui / 100.0;
-	if (ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_ATTR "/hello_time", &ui) == 0)
-		bridge->hello_time = (double)ui / 100.0;
-	if (ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_ATTR "/max_age", &ui) == 0)
-		bridge->max_age = (double)ui / 100.0;
+	const char *value;
+	int dirfd;
+
+	if ((dirfd = __ni_sysfs_netif_opendir(ifname, SYSFS_BRIDGE_ATTR)) < 0)
+		return;
+
+	if ((value = __ni_sysfs_dir_get_attr(dirfd, "stp_state")))
+		bridge->stp = strtoul(value, NULL, 0) ? TRUE : FALSE;
+	if ((value = __ni_sysfs_dir_get_attr(dirfd, "priority")))
+		bridge->priority = strtoul(value, NULL, 0);
+
+	if ((value = __ni_sysfs_dir_get_attr(dirfd, "forward_delay")))
+		bridge->forward_delay = (double)strtoul(value, NULL, 0) / 100.0;
+	if ((value = __ni_sysfs_dir_get_attr(dirfd, "ageing_time")))
+		bridge->ageing_time = (double)strtoul(value, NULL, 0) / 100.0;
+	if ((value = __ni_sysfs_dir_get_attr(dirfd, "hello_time")))
+		bridge->hello_time = (double)strtoul(value, NULL, 0) / 100.0;
+	if ((value = __ni_sysfs_dir_get_attr(dirfd, "max_age")))
+		bridge->max_age = (double)strtoul(value, NULL, 0) / 100.0;
+
+	close(dirfd);
 }
 
 int
@@ -470,18 +598,13 @@ ni_sysfs_bridge_update_config(const char *ifname, const ni_bridge_t *bridge)
 void
 ni_sysfs_bridge_get_status(const char *ifname, ni_bridge_status_t *bs)
 {
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_ATTR "/stp_state", &bs->stp_state);
-	ni_sysfs_netif_get_string(ifname, SYSFS_BRIDGE_ATTR "/root_id", &bs->root_id);
-	ni_sysfs_netif_get_string(ifname, SYSFS_BRIDGE_ATTR "/bridge_id", &bs->bridge_id);
-	ni_sysfs_netif_get_string(ifname, SYSFS_BRIDGE_ATTR "/group_addr", &bs->group_addr);
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_ATTR "/root_port", &bs->root_port);
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_ATTR "/root_path_cost", &bs->root_path_cost);
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_ATTR "/topology_change", &bs->topology_change);
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_ATTR "/topology_change_detected", &bs->topology_change_detected);
-	ni_sysfs_netif_get_ulong(ifname, SYSFS_BRIDGE_ATTR "/gc_timer", &bs->gc_timer);
-	ni_sysfs_netif_get_ulong(ifname, SYSFS_BRIDGE_ATTR "/tcn_timer", &bs->tcn_timer);
-	ni_sysfs_netif_get_ulong(ifname, SYSFS_BRIDGE_ATTR "/hello_timer", &bs->hello_timer);
-	ni_sysfs_netif_get_ulong(ifname, SYSFS_BRIDGE_ATTR "/topology_change_timer", &bs->topology_change_timer);
+	int dirfd;
+
+	if ((dirfd = __ni_sysfs_netif_opendir(ifname, SYSFS_BRIDGE_ATTR)) < 0)
+		return;
+
+	__ni_sysfs_dir_get_attrs(dirfd, __ni_sysfs_bridge_status_attrs, bs);
+	close(dirfd);
 }
 
 int
@@ -490,11 +613,50 @@ ni_sysfs_bridge_get_port_names(const char *ifname, ni_string_array_t *names)
 	return ni_scandir(__ni_sysfs_netif_attrpath(ifname, SYSFS_BRIDGE_PORT_SUBDIR), NULL, names);
 }
 
+/*
+ * Read the ifindex and the whole brport status group of a bridge
+ * port, using one directory fd for the port device.
+ */
+int
+ni_sysfs_bridge_port_get_info(const char *ifname, unsigned int *ifindex, ni_bridge_port_status_t *ps)
+{
+	const char *value;
+	int dirfd, fd;
+
+	if ((dirfd = __ni_sysfs_netif_opendir(ifname, ".")) < 0)
+		return -1;
+
+	value = __ni_sysfs_dir_get_attr(dirfd, "ifindex");
+	if (!value || ni_parse_uint(value, ifindex, 10) < 0) {
+		close(dirfd);
+		return -1;
+	}
+
+	fd = openat(dirfd, SYSFS_BRIDGE_PORT_ATTR, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	close(dirfd);
+	if (fd < 0)
+		return -1;
+
+	__ni_sysfs_dir_get_attrs(fd, __ni_sysfs_bridge_port_status_attrs, ps);
+	close(fd);
+	return 0;
+}
+
 void
 ni_sysfs_bridge_port_get_config(const char *ifname, ni_bridge_port_t *port)
 {
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_PORT_ATTR "/priority", &port->priority);
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_PORT_ATTR "/path_cost", &port->path_cost);
+	const char *value;
+	int dirfd;
+
+	if ((dirfd = __ni_sysfs_netif_opendir(ifname, SYSFS_BRIDGE_PORT_ATTR)) < 0)
+		return;
+
+	if ((value = __ni_sysfs_dir_get_attr(dirfd, "priority")))
+		port->priority = strtoul(value, NULL, 0);
+	if ((value = __ni_sysfs_dir_get_attr(dirfd, "path_cost")))
+		port->path_cost = strtoul(value, NULL, 0);
+
+	close(dirfd);
 }
 
 int
@@ -516,23 +678,13 @@ ni_sysfs_bridge_port_update_config(const char *ifname, const ni_bridge_port_t *p
 void
 ni_sysfs_bridge_port_get_status(const char *ifname, ni_bridge_port_status_t *ps)
 {
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_PORT_ATTR "/priority", &ps->priority);
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_PORT_ATTR "/path_cost", &ps->path_cost);
+	int dirfd;
 
-	ni_sysfs_netif_get_int(ifname, SYSFS_BRIDGE_PORT_ATTR "/state", &ps->state);
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_PORT_ATTR "/port_no", &ps->port_no);
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_PORT_ATTR "/port_id", &ps->port_no);
-	ni_sysfs_netif_get_string(ifname, SYSFS_BRIDGE_PORT_ATTR "/designated_root", &ps->designated_root);
-	ni_sysfs_netif_get_string(ifname, SYSFS_BRIDGE_PORT_ATTR "/designated_bridge", &ps->designated_bridge);
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_PORT_ATTR "/designated_port", &ps->designated_port);
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_PORT_ATTR "/designated_cost", &ps->designated_cost);
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_PORT_ATTR "/change_ack", &ps->change_ack);
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_PORT_ATTR "/hairpin_mode", &ps->hairpin_mode);
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_PORT_ATTR "/config_pending", &ps->config_pending);
+	if ((dirfd = __ni_sysfs_netif_opendir(ifname, SYSFS_BRIDGE_PORT_ATTR)) < 0)
+		return;
 
-	ni_sysfs_netif_get_ulong(ifname, SYSFS_BRIDGE_PORT_ATTR "/hold_timer", &ps->hold_timer);
-	ni_sysfs_netif_get_ulong(ifname, SYSFS_BRIDGE_PORT_ATTR "/message_age_timer", &ps->message_age_timer);
-	ni_sysfs_netif_get_ulong(ifname, SYSFS_BRIDGE_PORT_ATTR "/forward_delay_timer", &ps->forward_delay_timer);
+	__ni_sysfs_dir_get_attrs(dirfd, __ni_sysfs_bridge_port_status_attrs, ps);
+	close(dirfd);
 }
 
 /*
@@ -719,21 +871,16 @@ __ni_sysfs_printf(const char *pathname, const char *fmt, ...)
 static int
 __ni_sysfs_read_list(const char *pathname, ni_string_array_t *result)
 {
-	char buffer[256];
-	FILE *fp;
+	char buffer[4096];
+	char *s;
 
-	if ((fp = fopen(pathname, "r")) == NULL) {
+	if (__ni_sysfs_dir_read(AT_FDCWD, pathname, buffer, sizeof(buffer)) < 0) {
 		ni_error("unable to open %s: %m", pathname);
 		return -1;
 	}
 
-	while (fgets(buffer, sizeof(buffer), fp) != NULL) {
-		char *s;
-
-		for (s = strtok(buffer, " \t\n"); s; s = strtok(NULL, " \t\n"))
-			ni_string_array_append(result, s);
-	}
-	fclose(fp);
+	for (s = strtok(buffer, " \t\n"); s; s = strtok(NULL, " \t\n"))
+		ni_string_array_append(result, s);
 	return 0;
 }
 
@@ -741,18 +888,17 @@ static int
 __ni_sysfs_read_string(const char *pathname, char **result)
 {
 	char buffer[256];
-	FILE *fp;
+	ssize_t len;
 
-	if (!(fp = fopen(pathname, "r")))
+	if ((len = __ni_sysfs_dir_read(AT_FDCWD, pathname, buffer, sizeof(buffer))) < 0)
 		return -1;
 
 	ni_string_free(result);
 
-	if (fgets(buffer, sizeof(buffer), fp) != NULL) {
+	if (len > 0) {
 		buffer[strcspn(buffer, "\n")] = '\0';
 		ni_string_dup(result, buffer);
 	}
-	fclose(fp);
 	return 0;
 }
 
@@ -29,12 +29,14 @@
 #include <limits.h>
 #include <pwd.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 
 #include <wicked/util.h>
 #include <wicked/dbus-service.h>
 #include <wicked/dbus-errors.h>
 #include <wicked/netinfo.h>
 #include <wicked/team.h>
+#include <wicked/socket.h>
 
 #include "dbus-dict.h"
 #include "dbus-common.h"
@@ -69,6 +71,13 @@
 #define NI_TEAMD_CALL_PORT_ADD			"PortAdd"
 #define NI_TEAMD_CALL_PORT_CONFIG_UPDATE	"PortConfigUpdate"
 
+/*
+ * Neither ctl notifies about config changes made by other ctl users
+ * (e.g. teamdctl), so a cached config is dumped again after this
+ * time (seconds).
+ */
+#define NI_TEAMD_CONFIG_CACHE_LIFETIME		60
+
 
 typedef struct ni_teamd_client_ops {
 	void	(*destroy)(ni_teamd_client_t *);
@@ -90,8 +99,22 @@ struct ni_teamd_client {
 
 	/* unix */
 	ni_shellcmd_t *		cmd;
+
+	/* persistent clients, see ni_teamd_client_get */
+	ni_teamd_client_t *	next;
+	char *			busname;
+	ni_bool_t		stale;
+
+	/* cached actual config and the generation applied to the device */
+	ni_json_t *		conf;
+	struct timeval		conf_time;
+	unsigned int		conf_gen;
+	unsigned int		applied_gen;
+	unsigned int		applied_ifindex;
 };
 
+static ni_teamd_client_t *	ni_teamd_clients;
+
 static inline const char *
 ni_teamd_service_show_property(const char *ifname, const char *property, char **result)
 {
@@ -116,6 +139,8 @@ ni_teamd_service_show_property(const char *ifname, const char *property, char **
  * === dbus client ===
  */
 static void			ni_teamd_dbus_signal(ni_dbus_connection_t *, ni_dbus_message_t *, void *);
+static void			ni_teamd_dbus_name_owner_changed(ni_dbus_connection_t *, ni_dbus_message_t *, void *);
+static void			ni_teamd_config_cache_drop(ni_teamd_client_t *);
 
 static ni_dbus_class_t		ni_objectmodel_teamd_client_class = {
 	.name = "teamd-client"
@@ -138,12 +163,16 @@ ni_teamd_dbus_client_init(ni_teamd_client_t *tdc, const char *busname)
 			NI_TEAMD_OBJECT_PATH, NI_TEAMD_INTERFACE, tdc);
 	if (!tdc->proxy)
 		return FALSE;
+	ni_string_dup(&tdc->busname, busname);
 	ni_dbus_client_add_signal_handler(tdc->dbus,
-				NI_TEAMD_BUS_NAME,	/* sender */
+				busname,		/* sender */
 				NULL,			/* object path */
 				NI_TEAMD_INTERFACE,	/* object interface */
 				ni_teamd_dbus_signal,
 				tdc);
+	/* teamd restarts or exits: the connection and cache are stale */
+	ni_dbus_client_add_name_owner_handler(tdc->dbus, busname,
+				ni_teamd_dbus_name_owner_changed, tdc);
 	return TRUE;
 }
 
@@ -164,10 +193,38 @@ ni_teamd_dbus_client_destroy(ni_teamd_client_t *tdc)
 static void
 ni_teamd_dbus_signal(ni_dbus_connection_t *connection, ni_dbus_message_t *msg, void *user_data)
 {
-	/* ni_teamd_client_t *tdc = user_data; */
+	ni_teamd_client_t *tdc = user_data;
 	const char *member = dbus_message_get_member(msg);
 
-	ni_debug_dbus("teamd-client: %s signal received (not handled)", member);
+	ni_debug_dbus("teamd-client: %s signal received, invalidating %s config",
+			member, tdc->instance);
+	ni_teamd_config_cache_drop(tdc);
+}
+
+static void
+ni_teamd_dbus_name_owner_changed(ni_dbus_connection_t *connection, ni_dbus_message_t *msg, void *user_data)
+{
+	ni_teamd_client_t *tdc = user_data;
+	const char *name = NULL, *old_owner = NULL, *new_owner = NULL;
+
+	if (!ni_string_eq(dbus_message_get_member(msg), NI_DBUS_SIGNAL_NAME_OWNER_CHANGED))
+		return;
+
+	if (!dbus_message_get_args(msg, NULL,
+				DBUS_TYPE_STRING, &name,
+				DBUS_TYPE_STRING, &old_owner,
+				DBUS_TYPE_STRING, &new_owner,
+				DBUS_TYPE_INVALID))
+		return;
+
+	if (!ni_string_eq(name, tdc->busname))
+		return;
+
+	/* we're called from the connection dispatch, drop it on next use */
+	ni_debug_dbus("teamd-client: %s owner changed from '%s' to '%s'",
+			name, old_owner, new_owner);
+	ni_teamd_config_cache_drop(tdc);
+	tdc->stale = TRUE;
 }
 
 static int
@@ -594,11 +651,183 @@ ni_teamd_client_free(ni_teamd_client_t *tdc)
 	if (tdc) {
 		if (tdc->ops.destroy)
 			tdc->ops.destroy(tdc);
+		ni_teamd_config_cache_drop(tdc);
+		ni_string_free(&tdc->busname);
 		ni_string_free(&tdc->instance);
 		free(tdc);
 	}
 }
 
+/*
+ * Persistent clients, one per team device. They keep the ctl
+ * detection result, the dbus connection and the actual config
+ * until teamd or the team ports change.
+ */
+static ni_teamd_client_t *
+ni_teamd_client_find(const char *instance)
+{
+	ni_teamd_client_t *tdc;
+
+	for (tdc = ni_teamd_clients; tdc; tdc = tdc->next) {
+		if (ni_string_eq(tdc->instance, instance))
+			return tdc;
+	}
+	return NULL;
+}
+
+static void
+ni_teamd_client_drop(ni_teamd_client_t *tdc)
+{
+	ni_teamd_client_t **pos;
+
+	for (pos = &ni_teamd_clients; *pos; pos = &(*pos)->next) {
+		if (*pos == tdc) {
+			*pos = tdc->next;
+			ni_teamd_client_free(tdc);
+			return;
+		}
+	}
+}
+
+static void
+ni_teamd_client_drop_instance(const char *instance)
+{
+	ni_teamd_client_t *tdc;
+
+	if ((tdc = ni_teamd_client_find(instance)))
+		ni_teamd_client_drop(tdc);
+}
+
+/*
+ * Drop the client of a team device deleted without service stop
+ */
+void
+ni_teamd_device_delete(const char *instance)
+{
+	ni_teamd_client_drop_instance(instance);
+}
+
+static ni_teamd_client_t *
+ni_teamd_client_get(const char *instance)
+{
+	ni_teamd_client_t *tdc;
+
+	if ((tdc = ni_teamd_client_find(instance))) {
+		if (!tdc->stale)
+			return tdc;
+		ni_teamd_client_drop(tdc);
+	}
+
+	if (!(tdc = ni_teamd_client_open(instance)))
+		return NULL;
+
+	tdc->next = ni_teamd_clients;
+	ni_teamd_clients = tdc;
+	return tdc;
+}
+
+/*
+ * Cached actual config
+ */
+static void
+ni_teamd_config_cache_drop(ni_teamd_client_t *tdc)
+{
+	if (tdc->conf) {
+		ni_json_free(tdc->conf);
+		tdc->conf = NULL;
+	}
+}
+
+static ni_bool_t
+ni_teamd_config_cache_expired(const ni_teamd_client_t *tdc)
+{
+	struct timeval now, delta;
+
+	ni_timer_get_time(&now);
+	timersub(&now, &tdc->conf_time, &delta);
+	return delta.tv_sec < 0 || delta.tv_sec >= NI_TEAMD_CONFIG_CACHE_LIFETIME;
+}
+
+static ni_json_t *
+ni_teamd_config_cache_get(ni_teamd_client_t *tdc)
+{
+	char *val = NULL;
+
+	if (tdc->conf && !ni_teamd_config_cache_expired(tdc))
+		return tdc->conf;
+
+	ni_teamd_config_cache_drop(tdc);
+	if (ni_teamd_ctl_config_dump(tdc, TRUE, &val) < 0) {
+		/* reconnect and detect the ctl again on next use */
+		tdc->stale = TRUE;
+		return NULL;
+	}
+
+	tdc->conf = ni_json_parse_string(val);
+	ni_string_free(&val);
+	if (!tdc->conf)
+		return NULL;
+
+	ni_timer_get_time(&tdc->conf_time);
+	tdc->conf_gen++;
+	return tdc->conf;
+}
+
+static ni_json_t *
+ni_teamd_config_cache_port(ni_teamd_client_t *tdc, const char *port_name)
+{
+	return ni_json_object_get_value(ni_json_object_get_value(tdc->conf, "ports"), port_name);
+}
+
+/*
+ * Record a port change we've applied ourself, so the following
+ * discovery does not need to dump the config again.
+ */
+static void
+ni_teamd_config_cache_port_set(ni_teamd_client_t *tdc, const char *port_name, ni_json_t *details)
+{
+	ni_json_t *ports;
+
+	if (!tdc->conf) {
+		ni_json_free(details);
+		return;
+	}
+
+	if (!(ports = ni_json_object_get_value(tdc->conf, "ports"))) {
+		ports = ni_json_new_object();
+		if (!ni_json_object_set(tdc->conf, "ports", ports)) {
+			ni_json_free(ports);
+			goto failure;
+		}
+	}
+	if (!ni_json_object_set(ports, port_name, details))
+		goto failure;
+
+	tdc->conf_gen++;
+	return;
+
+failure:
+	ni_json_free(details);
+	ni_teamd_config_cache_drop(tdc);
+}
+
+void
+ni_teamd_port_event(const char *instance, const char *port_name, ni_bool_t enslaved)
+{
+	ni_teamd_client_t *tdc;
+
+	if (!(tdc = ni_teamd_client_find(instance)) || !tdc->conf)
+		return;
+
+	/* nothing to do when it's a change we've made ourself */
+	if (!ni_teamd_config_cache_port(tdc, port_name) == !enslaved)
+		return;
+
+	ni_debug_application("%s: team port %s %s, invalidating cached config",
+			instance, port_name, enslaved ? "added" : "removed");
+	ni_teamd_config_cache_drop(tdc);
+}
+
 /*
  * teamd ctl ops
  */
@@ -671,39 +900,71 @@ ni_teamd_port_config_json(const ni_team_port_config_t *config)
 	return object;
 }
 
+static ni_bool_t
+ni_teamd_port_config_equal(const ni_team_port_config_t *a, const ni_team_port_config_t *b)
+{
+	return	a->queue_id   == b->queue_id   &&
+		a->ab.prio    == b->ab.prio    &&
+		a->ab.sticky  == b->ab.sticky  &&
+		a->lacp.prio  == b->lacp.prio  &&
+		a->lacp.key   == b->lacp.key;
+}
+
+static int				ni_teamd_discover_port_details(ni_team_port_t *, ni_json_t *);
+
 int
 ni_teamd_port_enslave(const ni_netdev_t *master, const ni_netdev_t *port, const ni_team_port_config_t *config)
 {
 	ni_stringbuf_t dump = NI_STRINGBUF_INIT_DYNAMIC;
 	ni_teamd_client_t *tdc;
-	int ret = -1;
+	ni_json_t *details;
+	ni_team_port_t *cur;
 
 	if (!master || !master->name || !port || !port->name)
 		return -1;
 
-	if (!(tdc = ni_teamd_client_open(master->name)))
+	if (!(tdc = ni_teamd_client_get(master->name)))
 		return -1;
 
-	if (ni_teamd_ctl_port_add(tdc, port->name) < 0)
-		goto failure;
+	/*
+	 * Skip the calls teamd would not change anything with:
+	 * the port is in the actual config with the same details.
+	 */
+	ni_teamd_config_cache_get(tdc);
+	details = ni_teamd_config_cache_port(tdc, port->name);
+	if (!details) {
+		if (ni_teamd_ctl_port_add(tdc, port->name) < 0) {
+			ni_teamd_client_drop(tdc);
+			return -1;
+		}
+		ni_teamd_config_cache_port_set(tdc, port->name, ni_json_new_object());
+	}
 
 	if (config) {
-		ni_json_t *object = ni_teamd_port_config_json(config);
+		cur = ni_team_port_new();
+		if (details && ni_teamd_discover_port_details(cur, details) == 0 &&
+		    ni_teamd_port_config_equal(&cur->config, config)) {
+			ni_team_port_free(cur);
+			return 0;
+		}
+		ni_team_port_free(cur);
 
-		if (ni_json_format_string(&dump, object, NULL)) {
-			ni_teamd_ctl_port_config_update(tdc, port->name, dump.string);
-		} else {
+		details = ni_teamd_port_config_json(config);
+		if (!ni_json_format_string(&dump, details, NULL)) {
 			ni_debug_application("Unable to format %s team port config update", port->name);
+			ni_teamd_config_cache_drop(tdc);
+			ni_json_free(details);
+		} else
+		if (ni_teamd_ctl_port_config_update(tdc, port->name, dump.string) < 0) {
+			ni_teamd_config_cache_drop(tdc);
+			ni_json_free(details);
+		} else {
+			ni_teamd_config_cache_port_set(tdc, port->name, details);
 		}
-		ni_json_free(object);
 		ni_stringbuf_destroy(&dump);
 	}
 
-	ret = 0;
-
-failure:
-        ni_teamd_client_free(tdc);
-	return ret;
+	return 0;
 }
 
 
@@ -1020,26 +1281,27 @@ ni_teamd_discover_ports(ni_team_t *team, ni_json_t *conf)
 int
 ni_teamd_discover(ni_netdev_t *dev)
 {
-	ni_teamd_client_t *tdc = NULL;
-	ni_json_t *conf = NULL;
+	ni_teamd_client_t *tdc;
+	ni_json_t *conf;
 	ni_team_t *team = NULL;
-	char *val = NULL;
 
 	if (!dev || dev->link.type != NI_IFTYPE_TEAM)
 		return -1;
 
-	/* we are about to replace dev->team, so just
-	 * allocate new one we can drop at any time */
-	if (!(team = ni_team_new()))
-		goto failure;
+	if (!(tdc = ni_teamd_client_get(dev->name)))
+		return -1;
 
-	if (!(tdc = ni_teamd_client_open(dev->name)))
-		goto failure;
+	if (!(conf = ni_teamd_config_cache_get(tdc)))
+		return -1;
 
-	if (ni_teamd_ctl_config_dump(tdc, TRUE, &val) < 0)
-		goto failure;
+	/* unchanged since we've applied it to this device */
+	if (dev->team && tdc->applied_gen == tdc->conf_gen &&
+	    tdc->applied_ifindex == dev->link.ifindex)
+		return 0;
 
-	if (!(conf = ni_json_parse_string(val)))
+	/* we are about to replace dev->team, so just
+	 * allocate new one we can drop at any time */
+	if (!(team = ni_team_new()))
 		goto failure;
 
 	if (ni_teamd_discover_runner(team, conf) < 0)
@@ -1052,16 +1314,13 @@ ni_teamd_discover(ni_netdev_t *dev)
 		goto failure;
 
 	ni_netdev_set_team(dev, team);
-	ni_teamd_client_free(tdc);
-	ni_json_free(conf);
-	ni_string_free(&val);
+	tdc->applied_gen = tdc->conf_gen;
+	tdc->applied_ifindex = dev->link.ifindex;
 	return 0;
 
 failure:
-	ni_json_free(conf);
 	ni_team_free(team);
-	ni_teamd_client_free(tdc);
-	ni_string_free(&val);
+	ni_teamd_config_cache_drop(tdc);
 	return -1;
 }
 
@@ -1468,6 +1727,7 @@ ni_teamd_service_start(const ni_netdev_t *cfg)
 	if (!cfg || ni_string_empty(cfg->name) || !cfg->team)
 		return -1;
 
+	ni_teamd_client_drop_instance(cfg->name);
 	if (ni_teamd_config_file_write(cfg->name, cfg->team, &cfg->link.hwaddr) < 0)
 		return -1;
 
@@ -1486,6 +1746,7 @@ ni_teamd_service_stop(const char *ifname)
 	int rv;
 	char *service = NULL;
 
+	ni_teamd_client_drop_instance(ifname);
 	ni_string_printf(&service, NI_TEAMD_SERVICE_FMT, ifname);
 	rv = ni_systemctl_service_stop(service);
 	ni_teamd_config_file_remove(ifname);
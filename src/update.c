@@ -207,29 +207,13 @@ ni_updater_source_array_destroy(ni_updater_source_array_t *usa)
 	}
 }
 
-static void
-__ni_updater_source_array_realloc(ni_updater_source_array_t *usa, unsigned int newsize)
-{
-	unsigned int i;
-
-	newsize = (newsize + NI_UPDATER_SOURCE_ARRAY_CHUNK);
-	usa->data = xrealloc(usa->data, newsize * sizeof(ni_updater_source_t *));
-
-	for (i = usa->count; i < newsize; ++i)
-		usa->data[i] = NULL;
-}
-
 static ni_bool_t
 ni_updater_source_array_append(ni_updater_source_array_t *usa, ni_updater_source_t *src)
 {
 	if (!usa || !src)
 		return FALSE;
 
-	if ((usa-> count % NI_UPDATER_SOURCE_ARRAY_CHUNK) == 0)
-		__ni_updater_source_array_realloc(usa, usa->count);
-
-	usa->data[usa->count++] = src;
-	return TRUE;
+	return ni_array_append(usa, src, NI_UPDATER_SOURCE_ARRAY_CHUNK, 0);
 }
 
 static ni_updater_source_t *
@@ -37,6 +37,50 @@
 static int		__ni_pidfile_write(const char *, unsigned int, pid_t, int);
 static const char *	__ni_build_backup_path(const char *, const char *);
 
+/*
+ * Dynamic array growth
+ */
+unsigned int
+ni_array_capacity(unsigned int count, unsigned int chunk)
+{
+	unsigned int cap;
+
+	if (!count)
+		return 0;
+
+	for (cap = chunk ? chunk : 1; cap < count; cap <<= 1) {
+		if (cap > UINT_MAX / 2)
+			return count;
+	}
+	return cap;
+}
+
+void *
+ni_array_grow(void *data, size_t esize, unsigned int count,
+		unsigned int add, unsigned int chunk, unsigned int spare)
+{
+	unsigned int need, cap;
+	char *newdata;
+
+	if (!esize || UINT_MAX - count < add)
+		return NULL;
+
+	need = count + add;
+	if (data && need <= ni_array_capacity(count, chunk))
+		return data;
+
+	cap = ni_array_capacity(need ? need : 1, chunk);
+	if (UINT_MAX - cap < spare || (size_t)(cap + spare) > SIZE_MAX / esize)
+		return NULL;
+	cap += spare;
+
+	if (!(newdata = realloc(data, cap * esize)))
+		return NULL;
+
+	memset(newdata + count * esize, 0, (cap - count) * esize);
+	return newdata;
+}
+
 void
 ni_string_array_init(ni_string_array_t *nsa)
 {
@@ -47,12 +91,21 @@ int
 ni_string_array_copy(ni_string_array_t *dst, const ni_string_array_t *src)
 {
 	unsigned int i;
+	char **newdata;
 
 	ni_string_array_destroy(dst);
-	for (i = 0; i < src->count; ++i) {
-		if (ni_string_array_append(dst, src->data[i]) < 0)
-			return -1;
-	}
+	if (!src->count)
+		return 0;
+
+	/* one grow, filled in place: the capacity follows the count */
+	newdata = ni_array_grow_typed(dst, src->count, NI_STRING_ARRAY_CHUNK, 1);
+	if (!newdata)
+		return -1;
+
+	dst->data = newdata;
+	for (i = 0; i < src->count; ++i)
+		dst->data[i] = xstrdup(src->data[i]);
+	dst->count = src->count;
 	return 0;
 }
 
@@ -60,8 +113,7 @@ void
 ni_string_array_move(ni_string_array_t *dst, ni_string_array_t *src)
 {
 	ni_string_array_destroy(dst);
-	*dst = *src;
-	memset(src, 0, sizeof(*src));
+	ni_array_move(dst, src);
 }
 
 void
@@ -74,24 +126,22 @@ ni_string_array_destroy(ni_string_array_t *nsa)
 }
 
 static void
-__ni_string_array_realloc(ni_string_array_t *nsa, unsigned int newsize)
+__ni_string_array_realloc(ni_string_array_t *nsa, unsigned int add)
 {
 	char **newdata;
-	unsigned int i;
 
-	newsize = (newsize + NI_STRING_ARRAY_CHUNK) + 1;
-	newdata = xrealloc(nsa->data, newsize * sizeof(char *));
+	/* keep the array NULL terminated */
+	newdata = ni_array_grow_typed(nsa, add, NI_STRING_ARRAY_CHUNK, 1);
+	if (!newdata)
+		ni_fatal("%s: out of memory", __func__);
 
 	nsa->data = newdata;
-	for (i = nsa->count; i < newsize; ++i)
-		nsa->data[i] = NULL;
 }
 
 static int
 __ni_string_array_append(ni_string_array_t *nsa, char *str)
 {
-	if ((nsa->count % NI_STRING_ARRAY_CHUNK) == 0)
-		__ni_string_array_realloc(nsa, nsa->count);
+	__ni_string_array_realloc(nsa, 1);
 
 	nsa->data[nsa->count++] = str;
 	return 0;
@@ -100,8 +150,7 @@ __ni_string_array_append(ni_string_array_t *nsa, char *str)
 static int
 __ni_string_array_insert(ni_string_array_t *nsa, unsigned int pos, char *str)
 {
-	if ((nsa->count % NI_STRING_ARRAY_CHUNK) == 0)
-		__ni_string_array_realloc(nsa, nsa->count);
+	__ni_string_array_realloc(nsa, 1);
 
 	if (pos >= nsa->count) {
 		nsa->data[nsa->count++] = str;
@@ -360,19 +409,15 @@ ni_uint_array_destroy(ni_uint_array_t *nua)
 }
 
 static ni_bool_t
-ni_uint_array_realloc(ni_uint_array_t *nua, unsigned int newsize)
+ni_uint_array_realloc(ni_uint_array_t *nua, unsigned int add)
 {
-	unsigned int *newdata, i;
+	unsigned int *newdata;
 
-	newsize = newsize + NI_UINT_ARRAY_CHUNK;
-	newdata = realloc(nua->data, newsize * sizeof(unsigned int));
+	newdata = ni_array_grow_typed(nua, add, NI_UINT_ARRAY_CHUNK, 0);
 	if (!newdata)
 		return FALSE;
 
 	nua->data = newdata;
-	for (i = nua->count; i < newsize; ++i) {
-		nua->data[i] = 0;
-	}
 	return TRUE;
 }
 
@@ -382,8 +427,7 @@ ni_uint_array_append(ni_uint_array_t *nua, unsigned int num)
 	if (!nua)
 		return FALSE;
 
-	if ((nua->count % NI_UINT_ARRAY_CHUNK) == 0 &&
-	    !ni_uint_array_realloc(nua, nua->count))
+	if (!ni_uint_array_realloc(nua, 1))
 		return FALSE;
 
 	nua->data[nua->count++] = num;
@@ -511,19 +555,15 @@ ni_var_array_get(const ni_var_array_t *nva, const char *name)
 }
 
 static void
-__ni_var_array_realloc(ni_var_array_t *nva, unsigned int newsize)
+__ni_var_array_realloc(ni_var_array_t *nva, unsigned int add)
 {
-	unsigned int i;
 	ni_var_t *newdata;
 
-	newsize = (newsize + NI_VAR_ARRAY_CHUNK);
-	newdata = xrealloc(nva->data, newsize * sizeof(ni_var_t));
+	newdata = ni_array_grow_typed(nva, add, NI_VAR_ARRAY_CHUNK, 0);
+	if (!newdata)
+		ni_fatal("%s: out of memory", __func__);
 
 	nva->data = newdata;
-	for (i = nva->count; i < newsize; ++i) {
-		nva->data[i].name = NULL;
-		nva->data[i].value = NULL;
-	}
 }
 
 ni_bool_t
@@ -567,8 +607,7 @@ __ni_var_array_append(ni_var_array_t *nva, const char *name, const char *value)
 {
 	ni_var_t *var;
 
-	if ((nva->count % NI_VAR_ARRAY_CHUNK) == 0)
-		__ni_var_array_realloc(nva, nva->count);
+	__ni_var_array_realloc(nva, 1);
 	var = &nva->data[nva->count++];
 	var->name = xstrdup(name);
 	var->value = xstrdup(value);
@@ -580,8 +619,7 @@ ni_var_array_set(ni_var_array_t *nva, const char *name, const char *value)
 	ni_var_t *var;
 
 	if ((var = ni_var_array_get(nva, name)) == NULL) {
-		if ((nva->count % NI_VAR_ARRAY_CHUNK) == 0)
-			__ni_var_array_realloc(nva, nva->count);
+		__ni_var_array_realloc(nva, 1);
 
 		var = &nva->data[nva->count++];
 		var->name = xstrdup(name);
@@ -606,8 +644,7 @@ void
 ni_var_array_move(ni_var_array_t *dst, ni_var_array_t *src)
 {
 	ni_var_array_destroy(dst);
-	*dst = *src;
-	memset(src, 0, sizeof(*src));
+	ni_array_move(dst, src);
 }
 
 int
@@ -717,6 +754,206 @@ ni_var_array_list_destroy(ni_var_array_t **list)
 }
 
 
+/*
+ * Hash table functions.
+ *
+ * The table does not know anything about keys; it maps the hash of a key
+ * to one or more data pointers and the caller has to verify the key of
+ * each data pointer returned by the lookup functions. Entries using the
+ * same hash are kept in insertion order.
+ */
+#define NI_HASHTABLE_MIN_SIZE	16
+
+struct ni_hashtable_entry {
+	ni_hashtable_entry_t *	next;
+	unsigned int		hash;
+	void *			data;
+};
+
+void
+ni_hashtable_init(ni_hashtable_t *ht)
+{
+	memset(ht, 0, sizeof(*ht));
+}
+
+void
+ni_hashtable_destroy(ni_hashtable_t *ht)
+{
+	ni_hashtable_entry_t *entry;
+	unsigned int i;
+
+	if (!ht)
+		return;
+
+	for (i = 0; i < ht->size; ++i) {
+		while ((entry = ht->buckets[i])) {
+			ht->buckets[i] = entry->next;
+			free(entry);
+		}
+	}
+	free(ht->buckets);
+	ni_hashtable_init(ht);
+}
+
+static ni_bool_t
+ni_hashtable_resize(ni_hashtable_t *ht, unsigned int size)
+{
+	ni_hashtable_entry_t **buckets, *entry, **tail;
+	unsigned int i;
+
+	if (!(buckets = calloc(size, sizeof(*buckets))))
+		return FALSE;
+
+	for (i = 0; i < ht->size; ++i) {
+		while ((entry = ht->buckets[i])) {
+			ht->buckets[i] = entry->next;
+
+			tail = &buckets[entry->hash & (size - 1)];
+			while (*tail)
+				tail = &(*tail)->next;
+			entry->next = NULL;
+			*tail = entry;
+		}
+	}
+	free(ht->buckets);
+	ht->buckets = buckets;
+	ht->size = size;
+	return TRUE;
+}
+
+ni_bool_t
+ni_hashtable_insert(ni_hashtable_t *ht, unsigned int hash, void *data)
+{
+	ni_hashtable_entry_t *entry, **tail;
+
+	if (!ht || !data)
+		return FALSE;
+
+	if (ht->count >= ht->size) {
+		unsigned int size = ht->size ? ht->size << 1 : NI_HASHTABLE_MIN_SIZE;
+
+		if (!ni_hashtable_resize(ht, size) && !ht->size)
+			return FALSE;
+	}
+
+	if (!(entry = calloc(1, sizeof(*entry))))
+		return FALSE;
+	entry->hash = hash;
+	entry->data = data;
+
+	tail = &ht->buckets[hash & (ht->size - 1)];
+	while (*tail)
+		tail = &(*tail)->next;
+	*tail = entry;
+	ht->count++;
+	return TRUE;
+}
+
+ni_bool_t
+ni_hashtable_remove(ni_hashtable_t *ht, unsigned int hash, const void *data)
+{
+	ni_hashtable_entry_t *entry, **pos;
+
+	if (!ht || !ht->size || !data)
+		return FALSE;
+
+	for (pos = &ht->buckets[hash & (ht->size - 1)]; (entry = *pos); pos = &entry->next) {
+		if (entry->hash == hash && entry->data == data) {
+			*pos = entry->next;
+			ht->count--;
+			free(entry);
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+void *
+ni_hashtable_lookup_next(ni_hashtable_iter_t *iter)
+{
+	const ni_hashtable_entry_t *entry;
+
+	if (!iter)
+		return NULL;
+
+	while ((entry = iter->entry)) {
+		iter->entry = entry->next;
+		if (entry->hash == iter->hash)
+			return entry->data;
+	}
+	return NULL;
+}
+
+void *
+ni_hashtable_lookup(const ni_hashtable_t *ht, unsigned int hash, ni_hashtable_iter_t *iter)
+{
+	if (!ht || !iter)
+		return NULL;
+
+	iter->hash = hash;
+	iter->entry = ht->size ? ht->buckets[hash & (ht->size - 1)] : NULL;
+	return ni_hashtable_lookup_next(iter);
+}
+
+/*
+ * 32bit FNV-1a hash over arbitrary data
+ */
+unsigned int
+ni_hash_bytes(const void *data, size_t len)
+{
+	const unsigned char *ptr = data;
+	uint32_t hash = 2166136261U;
+
+	while (ptr && len--) {
+		hash ^= *ptr++;
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+unsigned int
+ni_hash_string(const char *str)
+{
+	return ni_hash_bytes(str, ni_string_len(str));
+}
+
+unsigned int
+ni_hash_uint(unsigned int num)
+{
+	uint32_t hash = num;
+
+	hash = ((hash >> 16) ^ hash) * 0x45d9f3bU;
+	hash = ((hash >> 16) ^ hash) * 0x45d9f3bU;
+	return (hash >> 16) ^ hash;
+}
+
+/*
+ * crc32 (ieee 802.3 polynomial); pass 0 as initial crc,
+ * the previous result to continue over further data.
+ */
+uint32_t
+ni_crc32(uint32_t crc, const void *data, size_t len)
+{
+	static uint32_t table[256];
+	const unsigned char *ptr = data;
+
+	if (!table[1]) {
+		uint32_t c, n, k;
+
+		for (n = 0; n < 256; ++n) {
+			for (c = n, k = 0; k < 8; ++k)
+				c = c & 1 ? 0xedb88320U ^ (c >> 1) : c >> 1;
+			table[n] = c;
+		}
+	}
+
+	crc = ~crc;
+	while (ptr && len--)
+		crc = table[(crc ^ *ptr++) & 0xff] ^ (crc >> 8);
+	return ~crc;
+}
+
+
 /*
  * Bitfield functions
  */
@@ -2920,6 +3157,9 @@ ni_caught_terminal_signal(void)
 		installed_handlers = TRUE;
 	}
 
+	/* all main loops get here once per iteration */
+	ni_log_ring_service();
+
 	if (!__ni_terminal_signal)
 		return FALSE;
 
@@ -14,6 +14,67 @@ extern void *	xrealloc(void *, size_t);
 
 extern char *	xstrdup(const char *);
 
+/*
+ * Dynamic arrays store the element count only; the allocated size is
+ * derived from it: one chunk, then doubled whenever the count passes
+ * a power of two, so n appends cost O(log n) reallocs.
+ * The grow function makes room for count + add elements plus spare
+ * (e.g. NULL terminator) ones, zeroes the new tail and returns the
+ * new data pointer, NULL on failure leaving data untouched.
+ */
+extern unsigned int	ni_array_capacity(unsigned int count, unsigned int chunk);
+extern void *		ni_array_grow(void *data, size_t esize, unsigned int count,
+				unsigned int add, unsigned int chunk, unsigned int spare);
+
+#define ni_array_grow_typed(array, add, chunk, spare)			\
+	ni_array_grow((array)->data, sizeof(*(array)->data),		\
+			(array)->count, (add), (chunk), (spare))
+
+/*
+ * Type checked helpers for arrays with data and count members;
+ * reserve and append evaluate to true on success and leave the
+ * array untouched on failure. As the capacity is derived from the
+ * count, a reservation only holds until the count changes: fill
+ * the reserved elements right away, e.g. via the bulk append,
+ * rather than reserving ahead of a loop of single appends.
+ * The bulk append copies the elements shallow, move hands the
+ * storage of an array over to an empty one.
+ */
+#define ni_array_reserve(array, add, chunk, spare) ({			\
+	typeof((array)->data) __newdata;				\
+	__newdata = ni_array_grow_typed(array, add, chunk, spare);	\
+	if (__newdata)							\
+		(array)->data = __newdata;				\
+	__newdata != NULL;						\
+})
+
+#define ni_array_append(array, elem, chunk, spare) ({			\
+	typeof(*(array)->data) __elem = (elem);				\
+	int __ok = ni_array_reserve(array, 1, chunk, spare);		\
+	if (__ok)							\
+		(array)->data[(array)->count++] = __elem;		\
+	__ok;								\
+})
+
+#define ni_array_append_bulk(array, elems, n, chunk, spare) ({		\
+	typeof((array)->data) __elems = (elems);			\
+	unsigned int __n = (n);						\
+	int __ok = ni_array_reserve(array, __n, chunk, spare);		\
+	if (__ok && __n) {						\
+		memcpy((array)->data + (array)->count, __elems,		\
+				__n * sizeof(*__elems));		\
+		(array)->count += __n;					\
+	}								\
+	__ok;								\
+})
+
+#define ni_array_move(dst, src) do {					\
+	typeof(dst) __dst = (dst);					\
+	typeof(dst) __src = (src);					\
+	*__dst = *__src;						\
+	memset(__src, 0, sizeof(*__src));				\
+} while (0)
+
 #endif /* __WICKED_UTIL_PRIV_H__ */
 
 
@@ -22,6 +22,7 @@
 #include "kernel.h"
 #include "wpa-supplicant.h"
 #include "wireless_priv.h"
+#include "util_priv.h"
 
 #ifndef IW_IE_CIPHER_NONE
 # define IW_IE_CIPHER_NONE       0
@@ -35,6 +36,8 @@
 # define IW_IE_KEY_MGMT_PSK      2
 #endif
 
+#define NI_WIRELESS_NETWORK_ARRAY_CHUNK	8
+
 #if 0
 static ni_wireless_network_t *		ni_wireless_get_assoc_network(ni_wireless_t *);
 #endif
@@ -1013,7 +1016,8 @@ ni_wireless_network_array_init(ni_wireless_network_array_t *array)
 void
 ni_wireless_network_array_append(ni_wireless_network_array_t *array, ni_wireless_network_t *net)
 {
-	array->data = realloc(array->data, (array->count + 1) * sizeof(ni_wireless_network_t *));
+	if (!ni_array_reserve(array, 1, NI_WIRELESS_NETWORK_ARRAY_CHUNK, 0))
+		ni_fatal("%s: out of memory", __func__);
 	array->data[array->count++] = ni_wireless_network_get(net);
 }
 
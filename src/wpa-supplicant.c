@@ -53,6 +53,8 @@
 #define NI_WPA_BSS_INTERFACE	"fi.epitest.hostap.WPASupplicant.BSSID"
 #define NI_WPA_NETWORK_INTERFACE "fi.epitest.hostap.WPASupplicant.Network"
 
+#define NI_WPA_BSS_REFRESH_INTERVAL	60	/* sec */
+
 struct ni_wpa_client {
 	ni_dbus_client_t *	dbus;
 
@@ -346,20 +348,25 @@ ni_wpa_interface_next_network(ni_wpa_interface_t *dev, ni_dbus_object_t **pnext,
 	return __ni_wpa_interface_next_network(pnext, pthis);
 }
 
+/*
+ * Remove all BSSes not seen in a scan since the given time.
+ * BSSes with a properties call in flight are kept until it returns,
+ * as the pending call refers to the object.
+ */
 static unsigned int
-ni_wpa_interface_expire_networks(ni_wpa_interface_t *dev, unsigned int max_age)
+ni_wpa_interface_expire_networks(ni_wpa_interface_t *dev, time_t seen_before)
 {
 	ni_dbus_object_t *dev_object, *pos, *cur;
 	ni_wireless_network_t *net;
 	unsigned int num_expired = 0;
-	time_t now;
 
 	if ((dev_object = dev->proxy) == NULL)
 		return 0;
 
-	now = time(NULL) - max_age;
 	for (net = ni_wpa_interface_first_network(dev, &pos, &cur); net; net = ni_wpa_interface_next_network(dev, &pos, &cur)) {
-		if (net->scan_info.timestamp && net->scan_info.timestamp < now) {
+		if (net->scan_info.updating)
+			continue;
+		if (net->scan_info.timestamp && net->scan_info.timestamp < seen_before) {
 			/* This will also remove child from the list of dev_object->children */
 			ni_dbus_object_free(cur);
 			num_expired++;
@@ -610,24 +617,31 @@ ni_wpa_interface_scan_in_progress(ni_wpa_interface_t *wpa_dev)
 /*
  * Copy scan results from wpa objects to generic ni_wireless_scan_t object
  * Returns TRUE iff the list of networks in scanning range changed.
+ *
+ * The BSS objects are updated in place, so the network array is only
+ * rebuilt when a BSS appeared, disappeared or changed its essid.
  */
 ni_bool_t
 ni_wpa_interface_retrieve_scan(ni_wpa_interface_t *wpa_dev, ni_wireless_scan_t *scan)
 {
 	ni_wireless_network_t *net;
 	ni_dbus_object_t *pos;
-	ni_bool_t send_event = FALSE;
+	ni_bool_t send_event;
 
-	/* Prune old BSSes */
-	if (ni_wpa_interface_expire_networks(wpa_dev, scan->interval + 1) == 0) {
-		/* Nothing pruned. If we didn't receive new scan results in the
-		 * mean time, there's nothing we need to do. */
-		if (scan->timestamp == wpa_dev->scan.timestamp)
-			return FALSE;
+	/* Prune BSSes we haven't seen in a while */
+	if (ni_wpa_interface_expire_networks(wpa_dev, time(NULL) - scan->interval - 1))
+		wpa_dev->scan.changed = TRUE;
 
-		send_event = TRUE;
+	send_event = wpa_dev->scan.changed;
+	for (net = ni_wpa_interface_first_network(wpa_dev, &pos, NULL); net && !send_event; net = ni_wpa_interface_next_network(wpa_dev, &pos, NULL)) {
+		if (net->scan_info.timestamp && net->access_point.len != 0 && !net->notified)
+			send_event = TRUE;
 	}
 
+	scan->timestamp = wpa_dev->scan.timestamp;
+	if (!send_event)
+		return FALSE;
+
 	ni_wireless_network_array_destroy(&scan->networks);
 	for (net = ni_wpa_interface_first_network(wpa_dev, &pos, NULL); net; net = ni_wpa_interface_next_network(wpa_dev, &pos, NULL)) {
 		/* We mix networks learned through scanning with those we configured manually.
@@ -640,15 +654,12 @@ ni_wpa_interface_retrieve_scan(ni_wpa_interface_t *wpa_dev, ni_wireless_scan_t *
 		 */
 		if (net->scan_info.timestamp && net->access_point.len != 0) {
 			ni_wireless_network_array_append(&scan->networks, net);
-			if (!net->notified) {
-				net->notified = TRUE;
-				send_event = TRUE;
-			}
+			net->notified = TRUE;
 		}
 	}
-	scan->timestamp = wpa_dev->scan.timestamp;
+	wpa_dev->scan.changed = FALSE;
 
-	return send_event;
+	return TRUE;
 }
 
 /*
@@ -900,6 +911,11 @@ ni_wpa_interface_update_state(ni_wpa_interface_t *dev, ni_wpa_ifstate_t new_stat
  * Handle async retrieval of scan results.
  * The results of a scan consists of a list of object path names,
  * each of which identifies a BSS object.
+ *
+ * The object name is the BSSID, so known BSSes are found via the
+ * children index of the BSSIDs object. Properties are requested
+ * only for new BSSes and for those not refreshed in a while; BSSes
+ * missing from the list are gone and removed right away.
  */
 static void
 ni_wpa_interface_scan_results(ni_dbus_object_t *proxy, ni_dbus_message_t *msg)
@@ -917,9 +933,10 @@ ni_wpa_interface_scan_results(ni_dbus_object_t *proxy, ni_dbus_message_t *msg)
 	wpa_dev->scan.pending = 0;
 
 	if (rv >= 0) {
-		unsigned int i;
+		unsigned int i, nrequests = 0;
+		time_t now;
 
-		wpa_dev->scan.timestamp = time(NULL);
+		wpa_dev->scan.timestamp = now = time(NULL);
 		for (i = 0; i < object_path_count; ++i) {
 			const char *path = object_path_array[i];
 			ni_dbus_object_t *net_object;
@@ -929,9 +946,24 @@ ni_wpa_interface_scan_results(ni_dbus_object_t *proxy, ni_dbus_message_t *msg)
 				continue;
 
 			net = net_object->handle;
+			net->scan_info.timestamp = now;
+			if (net->scan_info.updating)
+				continue;
+
+			if (net->access_point.len != 0 &&
+			    net->scan_info.updated + NI_WPA_BSS_REFRESH_INTERVAL > now)
+				continue;
+
 			net->scan_info.updating = TRUE;
 			ni_wpa_network_request_properties(net_object);
+			nrequests++;
 		}
+
+		if (ni_wpa_interface_expire_networks(wpa_dev, now))
+			wpa_dev->scan.changed = TRUE;
+
+		ni_debug_wireless("%s: %u BSSes in range, requested properties of %u",
+				wpa_dev->ifname, object_path_count, nrequests);
 	}
 
 	if (object_path_array)
@@ -1824,7 +1856,7 @@ ni_wpa_bss_properties_result(ni_dbus_object_t *proxy, ni_dbus_message_t *msg)
 		ni_debug_wireless("%s: essid changed", ni_link_address_print(&net->access_point));
 		net->notified = FALSE;
 	}
-	net->scan_info.timestamp = time(NULL);
+	net->scan_info.timestamp = net->scan_info.updated = time(NULL);
 
 	ni_dbus_variant_destroy(&dict);
 	return;
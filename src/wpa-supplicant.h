@@ -40,6 +40,7 @@ struct ni_wpa_interface {
 	struct {
 		time_t		timestamp;
 		unsigned char	pending;
+		ni_bool_t	changed;	/* BSS list changed since last retrieval */
 	} scan;
 
 	struct {
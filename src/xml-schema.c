@@ -15,6 +15,9 @@
 #include "xml-schema.h"
 #include "util_priv.h"
 
+#define NI_XS_ARRAY_CHUNK		32
+#define NI_XS_GROUP_ARRAY_CHUNK		4
+
 static int		ni_xs_process_include(xml_node_t *, ni_xs_scope_t *);
 static int		ni_xs_process_class(xml_node_t *, ni_xs_scope_t *);
 static int		ni_xs_process_define(xml_node_t *, ni_xs_scope_t *);
@@ -297,8 +300,8 @@ ni_xs_type_array_destroy(ni_xs_type_array_t *ap)
 void
 ni_xs_type_array_append(ni_xs_type_array_t *array, ni_xs_type_t *type)
 {
-	if ((array->count % 32) == 0)
-		array->data = xrealloc(array->data, (array->count + 32) * sizeof(array->data[0]));
+	if (!ni_array_reserve(array, 1, NI_XS_ARRAY_CHUNK, 0))
+		ni_fatal("%s: out of memory", __func__);
 	array->data[array->count++] = ni_xs_type_hold(type);
 }
 
@@ -338,9 +341,8 @@ ni_xs_name_type_array_append(ni_xs_name_type_array_t *array, const char *name, n
 {
 	ni_xs_name_type_t *def;
 
-	if ((array->count % 32) == 0) {
-		array->data = xrealloc(array->data, (array->count + 32) * sizeof(array->data[0]));
-	}
+	if (!ni_array_reserve(array, 1, NI_XS_ARRAY_CHUNK, 0))
+		ni_fatal("%s: out of memory", __func__);
 	def = &array->data[array->count++];
 	def->name = xstrdup(name);
 	def->type = ni_xs_type_hold(type);
@@ -1711,17 +1713,20 @@ ni_xs_group_clone(ni_xs_group_t *group)
 void
 ni_xs_group_array_append(ni_xs_group_array_t *group_array, ni_xs_group_t *group)
 {
-	group_array->data = xrealloc(group_array->data, (group_array->count + 1) * sizeof(group));
+	if (!ni_array_reserve(group_array, 1, NI_XS_GROUP_ARRAY_CHUNK, 0))
+		ni_fatal("%s: out of memory", __func__);
 	group_array->data[group_array->count++] = ni_xs_group_clone(group);
 }
 
 void
 ni_xs_group_array_copy(ni_xs_group_array_t *dst, const ni_xs_group_array_t *src)
 {
-	unsigned int i;
+	unsigned int i, n = dst->count;
 
-	for (i = 0; i < src->count; ++i)
-		ni_xs_group_array_append(dst, src->data[i]);
+	if (!ni_array_append_bulk(dst, src->data, src->count, NI_XS_GROUP_ARRAY_CHUNK, 0))
+		ni_fatal("%s: out of memory", __func__);
+	for (i = n; i < dst->count; ++i)
+		ni_xs_group_clone(dst->data[i]);
 }
 
 ni_xs_group_t *
@@ -0,0 +1,702 @@
+/*
+ *	Micro benchmarks for hot paths of the wicked library
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	The results are printed as JSON object, e.g.:
+ *	{
+ *	  "version": "0.6.54",
+ *	  "parameters": { "devices": 10000, ... },
+ *	  "results": [
+ *	    { "group": "netconfig", "name": "lookup-by-name",
+ *	      "iterations": 100000, "total-usec": 1234, "nsec-per-op": 12 },
+ *	    ...
+ *	  ]
+ *	}
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <time.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <linux/rtnetlink.h>
+
+#include <wicked/util.h>
+#include <wicked/logging.h>
+#include <wicked/netinfo.h>
+#include <wicked/address.h>
+#include <wicked/route.h>
+#include <wicked/xml.h>
+#include <wicked/addrconf.h>
+#include <wicked/resolver.h>
+#include <wicked/dbus.h>
+#include <wicked/objectmodel.h>
+
+#include "netinfo_priv.h"
+#include "util_priv.h"
+#include "appconfig.h"
+#include "json.h"
+
+enum {
+	OPT_HELP,
+	OPT_DEVICES,
+	OPT_ROUTES,
+	OPT_LOOKUPS,
+	OPT_LOOPS,
+	OPT_SCHEMA,
+	OPT_OUTPUT,
+};
+
+static struct option	options[] = {
+	{ "help",	no_argument,		NULL,	OPT_HELP	},
+	{ "devices",	required_argument,	NULL,	OPT_DEVICES	},
+	{ "routes",	required_argument,	NULL,	OPT_ROUTES	},
+	{ "lookups",	required_argument,	NULL,	OPT_LOOKUPS	},
+	{ "loops",	required_argument,	NULL,	OPT_LOOPS	},
+	{ "schema",	required_argument,	NULL,	OPT_SCHEMA	},
+	{ "output",	required_argument,	NULL,	OPT_OUTPUT	},
+	{ NULL }
+};
+
+static struct bench_params {
+	unsigned int	devices;
+	unsigned int	routes;
+	unsigned int	lookups;
+	unsigned int	loops;
+	const char *	schema;
+} params = {
+	.devices	= 10000,
+	.routes		= 1000000,
+	.lookups	= 100000,
+	.loops		= 10,
+};
+
+typedef struct bench_timer {
+	struct timespec	start;
+} bench_timer_t;
+
+static ni_json_t *	results;
+static volatile unsigned int	bench_sink;	/* keeps lookups from being optimized out */
+
+static void
+bench_start(bench_timer_t *t)
+{
+	clock_gettime(CLOCK_MONOTONIC, &t->start);
+}
+
+static void
+bench_stop(bench_timer_t *t, const char *group, const char *name, unsigned int iterations)
+{
+	struct timespec now;
+	ni_json_t *res;
+	int64_t nsec;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	nsec  = (int64_t)(now.tv_sec - t->start.tv_sec) * 1000000000;
+	nsec += now.tv_nsec - t->start.tv_nsec;
+
+	res = ni_json_new_object();
+	ni_json_object_set(res, "group", ni_json_new_string(group));
+	ni_json_object_set(res, "name", ni_json_new_string(name));
+	ni_json_object_set(res, "iterations", ni_json_new_int64(iterations));
+	ni_json_object_set(res, "total-usec", ni_json_new_int64(nsec / 1000));
+	ni_json_object_set(res, "nsec-per-op", ni_json_new_int64(iterations ? nsec / iterations : 0));
+	ni_json_array_append(results, res);
+}
+
+static void
+bench_skipped(const char *group, const char *reason)
+{
+	ni_json_t *res;
+
+	res = ni_json_new_object();
+	ni_json_object_set(res, "group", ni_json_new_string(group));
+	ni_json_object_set(res, "skipped", ni_json_new_string(reason));
+	ni_json_array_append(results, res);
+}
+
+/*
+ * Synthetic device and route population
+ */
+static void
+bench_route_addr(ni_sockaddr_t *sa, unsigned int net, unsigned int host)
+{
+	struct in_addr in;
+
+	in.s_addr = htonl((10U << 24) | ((net & 0xffff) << 8) | (host & 0xff));
+	ni_sockaddr_set_ipv4(sa, in, 0);
+}
+
+static void
+bench_netconfig(void)
+{
+	ni_netconfig_t *nc;
+	ni_netdev_t **devs;
+	ni_route_t *match;
+	bench_timer_t t;
+	char name[IFNAMSIZ];
+	unsigned int i, j, per_dev;
+
+	if (!params.devices) {
+		bench_skipped("netconfig", "no devices");
+		return;
+	}
+
+	nc = ni_netconfig_new();
+	devs = xcalloc(params.devices, sizeof(*devs));
+	per_dev = params.routes / params.devices;
+
+	bench_start(&t);
+	for (i = 0; i < params.devices; ++i) {
+		snprintf(name, sizeof(name), "bench%u", i);
+		devs[i] = ni_netdev_new(name, i + 1);
+		ni_netconfig_device_append(nc, devs[i]);
+	}
+	bench_stop(&t, "netconfig", "populate-devices", params.devices);
+
+	bench_start(&t);
+	for (i = 0; i < params.devices; ++i) {
+		for (j = 0; j < per_dev; ++j) {
+			ni_sockaddr_t dst, gw;
+
+			bench_route_addr(&dst, i, j);
+			bench_route_addr(&gw, i, 254);
+			ni_route_create(32, &dst, &gw, RT_TABLE_MAIN, &devs[i]->routes);
+		}
+	}
+	bench_stop(&t, "netconfig", "populate-routes", per_dev * params.devices);
+
+	srandom(1);
+	bench_start(&t);
+	for (i = 0; i < params.lookups; ++i) {
+		snprintf(name, sizeof(name), "bench%lu", random() % params.devices);
+		if (ni_netdev_by_name(nc, name))
+			bench_sink++;
+	}
+	bench_stop(&t, "netconfig", "lookup-by-name", params.lookups);
+
+	bench_start(&t);
+	for (i = 0; i < params.lookups; ++i) {
+		if (ni_netdev_by_index(nc, 1 + random() % params.devices))
+			bench_sink++;
+	}
+	bench_stop(&t, "netconfig", "lookup-by-index", params.lookups);
+
+	if (per_dev) {
+		ni_route_t *rp = ni_route_new();
+
+		rp->family = AF_INET;
+		rp->prefixlen = 32;
+		rp->table = RT_TABLE_MAIN;
+
+		bench_start(&t);
+		for (i = 0; i < params.lookups; ++i) {
+			j = random() % params.devices;
+			bench_route_addr(&rp->destination, j, random() % per_dev);
+			match = ni_route_tables_find_match(devs[j]->routes, rp,
+							ni_route_equal_destination);
+			if (match)
+				bench_sink++;
+		}
+		bench_stop(&t, "netconfig", "route-match", params.lookups);
+		ni_route_free(rp);
+	}
+
+	bench_start(&t);
+	ni_netconfig_free(nc);
+	bench_stop(&t, "netconfig", "destroy", params.devices);
+	free(devs);
+
+	bench_start(&t);
+	for (i = 0; i < params.loops; ++i) {
+		if (!ni_global_state_handle(1))
+			break;
+	}
+	if (i == params.loops)
+		bench_stop(&t, "netconfig", "system-refresh", params.loops);
+	else
+		bench_skipped("netconfig", "cannot refresh system state");
+}
+
+/*
+ * XML processing of generated interface configs
+ */
+static void
+bench_xml_config(ni_stringbuf_t *buf, unsigned int index)
+{
+	ni_stringbuf_printf(buf,
+		"<interface>\n"
+		"  <name>bench%u</name>\n"
+		"  <control><mode>boot</mode></control>\n"
+		"  <ethernet><autoneg-enable>true</autoneg-enable></ethernet>\n"
+		"  <ipv4:static>\n"
+		"    <address><local>10.%u.%u.1/24</local></address>\n"
+		"    <route><destination>10.%u.%u.0/24</destination>"
+			"<nexthop><gateway>10.%u.%u.254</gateway></nexthop></route>\n"
+		"  </ipv4:static>\n"
+		"</interface>\n",
+		index,
+		(index >> 8) & 0xff, index & 0xff,
+		((index >> 8) + 1) & 0xff, index & 0xff,
+		(index >> 8) & 0xff, index & 0xff);
+}
+
+static xml_document_t *
+bench_xml(void)
+{
+	ni_stringbuf_t buf = NI_STRINGBUF_INIT_DYNAMIC;
+	xml_document_t *doc = NULL;
+	unsigned char md[20];
+	bench_timer_t t;
+	unsigned int i;
+	char *str;
+
+	ni_stringbuf_puts(&buf, "<interfaces>\n");
+	for (i = 0; i < params.devices; ++i)
+		bench_xml_config(&buf, i);
+	ni_stringbuf_puts(&buf, "</interfaces>\n");
+
+	bench_start(&t);
+	for (i = 0; i < params.loops; ++i) {
+		xml_document_free(doc);
+		if (!(doc = xml_document_from_string(buf.string, "bench"))) {
+			ni_stringbuf_destroy(&buf);
+			bench_skipped("xml", "cannot parse generated config");
+			return NULL;
+		}
+	}
+	bench_stop(&t, "xml", "parse", params.loops);
+	ni_stringbuf_destroy(&buf);
+
+	bench_start(&t);
+	for (i = 0; i < params.loops; ++i) {
+		str = xml_document_sprint(doc);
+		free(str);
+	}
+	bench_stop(&t, "xml", "serialize", params.loops);
+
+	bench_start(&t);
+	for (i = 0; i < params.loops; ++i)
+		xml_document_hash(doc, NI_HASHCTX_SHA1, md, sizeof(md));
+	bench_stop(&t, "xml", "hash-sha1", params.loops);
+
+	return doc;
+}
+
+/*
+ * dbus-xml marshalling of the ipv4:static requestLease argument
+ * using the real schema.
+ */
+static void
+bench_dbus_xml(xml_document_t *doc)
+{
+	const ni_dbus_service_t *service;
+	const ni_dbus_method_t *method;
+	ni_dbus_variant_t *vars;
+	ni_dbus_message_t **msgs;
+	xml_node_t *ifnode, **nodes;
+	xml_node_t *out;
+	bench_timer_t t;
+	unsigned int i, count;
+
+	if (!doc) {
+		bench_skipped("dbus-xml", "no xml configs");
+		return;
+	}
+
+	/* the objectmodel init is fatal without a schema */
+	if (!params.schema) {
+		fprintf(stderr, "skipping dbus-xml benchmarks, no --schema given\n");
+		bench_skipped("dbus-xml", "no schema");
+		return;
+	}
+	ni_string_dup(&ni_global.config->dbus_xml_schema_file, params.schema);
+
+	if (!ni_objectmodel_init(NULL)) {
+		bench_skipped("dbus-xml", "cannot load schema");
+		return;
+	}
+
+	service = ni_objectmodel_service_by_name("org.opensuse.Network.Addrconf.ipv4.static");
+	if (!service || !(method = ni_dbus_service_get_method(service, "requestLease"))) {
+		bench_skipped("dbus-xml", "no ipv4:static requestLease method in schema");
+		return;
+	}
+
+	nodes = xcalloc(params.devices, sizeof(*nodes));
+	count = 0;
+	ifnode = xml_node_get_child(xml_document_root(doc), "interfaces");
+	for (ifnode = ifnode ? ifnode->children : NULL; ifnode; ifnode = ifnode->next) {
+		if (count < params.devices &&
+		    (nodes[count] = xml_node_get_child(ifnode, "ipv4:static")))
+			count++;
+	}
+	vars = xcalloc(count, sizeof(*vars));
+	msgs = xcalloc(count, sizeof(*msgs));
+
+	bench_start(&t);
+	for (i = 0; i < count; ++i)
+		ni_dbus_xml_serialize_arg(method, 0, &vars[i], nodes[i]);
+	bench_stop(&t, "dbus-xml", "xml-to-variant", count);
+
+	bench_start(&t);
+	for (i = 0; i < count; ++i) {
+		msgs[i] = dbus_message_new_method_call(NI_OBJECTMODEL_DBUS_BUS_NAME,
+				NI_OBJECTMODEL_OBJECT_PATH, service->name, method->name);
+		ni_dbus_message_serialize_variants(msgs[i], 1, &vars[i], NULL);
+		ni_dbus_variant_destroy(&vars[i]);
+	}
+	bench_stop(&t, "dbus-xml", "variant-to-message", count);
+
+	bench_start(&t);
+	for (i = 0; i < count; ++i)
+		ni_dbus_message_get_args_variants(msgs[i], &vars[i], 1);
+	bench_stop(&t, "dbus-xml", "message-to-variant", count);
+
+	bench_start(&t);
+	for (i = 0; i < count; ++i) {
+		out = xml_node_new(NULL, NULL);
+		ni_dbus_xml_deserialize_arguments(method, 1, &vars[i], out, NULL);
+		xml_node_free(out);
+	}
+	bench_stop(&t, "dbus-xml", "variant-to-xml", count);
+
+	for (i = 0; i < count; ++i) {
+		ni_dbus_variant_destroy(&vars[i]);
+		dbus_message_unref(msgs[i]);
+	}
+	free(msgs);
+	free(vars);
+	free(nodes);
+}
+
+/*
+ * Growing large arrays, e.g. for property dumps of many routes
+ */
+static void
+bench_arrays(void)
+{
+	ni_string_array_t strings = NI_STRING_ARRAY_INIT;
+	ni_string_array_t copy = NI_STRING_ARRAY_INIT;
+	ni_uint_array_t uints = NI_UINT_ARRAY_INIT;
+	ni_dbus_variant_t dicts = NI_DBUS_VARIANT_INIT;
+	ni_dbus_variant_t *dict;
+	bench_timer_t t;
+	unsigned int i;
+
+	if (!params.routes) {
+		bench_skipped("array", "no routes");
+		return;
+	}
+
+	bench_start(&t);
+	for (i = 0; i < params.routes; ++i)
+		ni_uint_array_append(&uints, i);
+	bench_stop(&t, "array", "uint-append", params.routes);
+	ni_uint_array_destroy(&uints);
+
+	bench_start(&t);
+	for (i = 0; i < params.routes; ++i)
+		ni_string_array_append(&strings, "10.0.0.0/8");
+	bench_stop(&t, "array", "string-append", params.routes);
+
+	bench_start(&t);
+	ni_string_array_copy(&copy, &strings);
+	bench_stop(&t, "array", "string-copy", params.routes);
+	ni_string_array_destroy(&copy);
+	ni_string_array_destroy(&strings);
+
+	bench_start(&t);
+	ni_dbus_dict_array_init(&dicts);
+	for (i = 0; i < params.routes; ++i) {
+		if ((dict = ni_dbus_dict_array_add(&dicts)))
+			ni_dbus_dict_add_uint32(dict, "table", i);
+	}
+	bench_stop(&t, "array", "dbus-dict-array-append", params.routes);
+	ni_dbus_variant_destroy(&dicts);
+}
+
+/*
+ * Debug tracing: disabled facility, formatted to stderr (/dev/null)
+ * and recorded into the trace ring
+ */
+static void
+bench_logging(void)
+{
+	unsigned int i, n = params.lookups;
+	bench_timer_t t;
+	int fd;
+
+	if (!n) {
+		bench_skipped("logging", "no lookups");
+		return;
+	}
+
+	ni_enable_debug("ifconfig");
+
+	bench_start(&t);
+	for (i = 0; i < n; ++i)
+		ni_debug_dbus("dev%u: link %u state %s, mtu %u", i, i, "up", 1500);
+	bench_stop(&t, "logging", "debug-disabled", n);
+
+	fflush(stderr);
+	if ((fd = dup(2)) >= 0 && freopen("/dev/null", "w", stderr)) {
+		bench_start(&t);
+		for (i = 0; i < n; ++i)
+			ni_debug_ifconfig("dev%u: link %u state %s, mtu %u", i, i, "up", 1500);
+		bench_stop(&t, "logging", "debug-stderr", n);
+
+		if (ni_log_ring_enable(4096)) {
+			bench_start(&t);
+			for (i = 0; i < n; ++i)
+				ni_debug_ifconfig("dev%u: link %u state %s, mtu %u", i, i, "up", 1500);
+			bench_stop(&t, "logging", "debug-ring", n);
+			ni_log_ring_enable(0);
+		}
+
+		fflush(stderr);
+		dup2(fd, 2);
+		close(fd);
+	}
+
+	ni_enable_debug("none");
+	ni_log_level_set("notice");
+}
+
+/*
+ * Lease file persistence of a dhcp4 lease, as done on every renew,
+ * compared to the plain xml write and read.
+ */
+static ni_addrconf_lease_t *
+bench_lease_new(void)
+{
+	ni_addrconf_lease_t *lease;
+	ni_sockaddr_t addr, gw;
+	unsigned int i;
+
+	lease = ni_addrconf_lease_new(NI_ADDRCONF_DHCP, AF_INET);
+	lease->state = NI_ADDRCONF_STATE_GRANTED;
+	ni_string_dup(&lease->hostname, "bench.example.com");
+
+	bench_route_addr(&addr, 1, 10);
+	bench_route_addr(&gw, 1, 1);
+	lease->dhcp4.address = addr.sin.sin_addr;
+	lease->dhcp4.server_id = gw.sin.sin_addr;
+	lease->dhcp4.netmask.s_addr = htonl(0xffffff00);
+	lease->dhcp4.lease_time = 3600;
+	lease->dhcp4.renewal_time = 1800;
+	lease->dhcp4.rebind_time = 3150;
+	ni_address_new(AF_INET, 24, &addr, &lease->addrs);
+
+	for (i = 0; i < 10; ++i) {
+		bench_route_addr(&addr, 100 + i, 0);
+		ni_route_create(24, &addr, &gw, RT_TABLE_MAIN, &lease->routes);
+	}
+
+	lease->resolver = ni_resolver_info_new();
+	ni_string_dup(&lease->resolver->default_domain, "example.com");
+	ni_string_array_append(&lease->resolver->dns_servers, "10.0.1.1");
+	ni_string_array_append(&lease->resolver->dns_servers, "10.0.1.2");
+	ni_string_array_append(&lease->resolver->dns_search, "example.com");
+	ni_string_array_append(&lease->ntp_servers, "10.0.1.3");
+	return lease;
+}
+
+static void
+bench_lease(void)
+{
+	char dir[] = "/tmp/bench-lease.XXXXXX";
+	unsigned int i, n = params.loops * 100;
+	ni_addrconf_lease_t *lease, *copy;
+	char tempname[PATH_MAX];
+	char *filename = NULL;
+	xml_node_t *xml;
+	bench_timer_t t;
+	FILE *fp;
+	int fd;
+
+	if (!n || !mkdtemp(dir)) {
+		bench_skipped("lease", "cannot create temporary directory");
+		return;
+	}
+	ni_string_dup(&ni_global.config->storedir.path, dir);
+	ni_string_dup(&ni_global.config->statedir.path, dir);
+	ni_string_printf(&filename, "%s/lease.xml", dir);
+	lease = bench_lease_new();
+
+	bench_start(&t);
+	for (i = 0; i < n; ++i) {
+		if (ni_addrconf_lease_to_xml(lease, &xml, "bench0") != 0)
+			break;
+		snprintf(tempname, sizeof(tempname), "%s.XXXXXX", filename);
+		if ((fd = mkstemp(tempname)) >= 0 && (fp = fdopen(fd, "we"))) {
+			xml_node_print(xml, fp);
+			fclose(fp);
+			rename(tempname, filename);
+		}
+		xml_node_free(xml);
+	}
+	bench_stop(&t, "lease", "write-xml", i);
+
+	bench_start(&t);
+	for (i = 0; i < n; ++i) {
+		if (!(fp = fopen(filename, "re")))
+			break;
+		xml = xml_node_scan(fp, filename);
+		fclose(fp);
+		copy = NULL;
+		if (xml)
+			ni_addrconf_lease_from_xml(&copy, xml, "bench0");
+		xml_node_free(xml);
+		ni_addrconf_lease_free(copy);
+	}
+	bench_stop(&t, "lease", "read-xml", i);
+	unlink(filename);
+
+	bench_start(&t);
+	for (i = 0; i < n; ++i) {
+		if (ni_addrconf_lease_file_write("bench0", lease) < 0)
+			break;
+	}
+	bench_stop(&t, "lease", "write", i);
+
+	bench_start(&t);
+	for (i = 0; i < n; ++i) {
+		if (!(copy = ni_addrconf_lease_file_read("bench0", lease->type, lease->family)))
+			break;
+		ni_addrconf_lease_free(copy);
+	}
+	bench_stop(&t, "lease", "read", i);
+
+	ni_addrconf_lease_file_remove("bench0", lease->type, lease->family);
+	ni_addrconf_lease_free(lease);
+	ni_string_free(&filename);
+	rmdir(dir);
+}
+
+static unsigned int
+bench_uint_arg(const char *opt, const char *arg)
+{
+	unsigned int value;
+
+	if (ni_parse_uint(arg, &value, 10) < 0) {
+		fprintf(stderr, "invalid --%s argument '%s'\n", opt, arg);
+		exit(1);
+	}
+	return value;
+}
+
+int
+main(int argc, char **argv)
+{
+	ni_stringbuf_t buf = NI_STRINGBUF_INIT_DYNAMIC;
+	const char *output = NULL;
+	const char *group = "all";
+	xml_document_t *doc = NULL;
+	ni_json_t *report, *pars;
+	FILE *fp = stdout;
+	int c;
+
+	while ((c = getopt_long(argc, argv, "", options, NULL)) != EOF) {
+		switch (c) {
+		case OPT_DEVICES:
+			params.devices = bench_uint_arg("devices", optarg);
+			break;
+		case OPT_ROUTES:
+			params.routes = bench_uint_arg("routes", optarg);
+			break;
+		case OPT_LOOKUPS:
+			params.lookups = bench_uint_arg("lookups", optarg);
+			break;
+		case OPT_LOOPS:
+			params.loops = bench_uint_arg("loops", optarg);
+			break;
+		case OPT_SCHEMA:
+			params.schema = optarg;
+			break;
+		case OPT_OUTPUT:
+			output = optarg;
+			break;
+		case OPT_HELP:
+		default:
+			fprintf(stderr,
+				"Usage: bench-test [options] [all|netconfig|array|logging|lease|xml|dbus-xml]\n"
+				"Options:\n"
+				"  --devices <count>    number of devices/configs [%u]\n"
+				"  --routes <count>     number of routes [%u]\n"
+				"  --lookups <count>    number of lookups [%u]\n"
+				"  --loops <count>      repetitions of whole-set runs [%u]\n"
+				"  --schema <file>      dbus xml schema to use\n"
+				"  --output <file>      write JSON results to file\n",
+				params.devices, params.routes,
+				params.lookups, params.loops);
+			return c == OPT_HELP ? 0 : 1;
+		}
+	}
+	if (optind < argc)
+		group = argv[optind];
+
+	if (ni_init("bench-test") < 0)
+		return 1;
+
+	results = ni_json_new_array();
+
+	if (ni_string_eq(group, "all") || ni_string_eq(group, "netconfig"))
+		bench_netconfig();
+	if (ni_string_eq(group, "all") || ni_string_eq(group, "array"))
+		bench_arrays();
+	if (ni_string_eq(group, "all") || ni_string_eq(group, "logging"))
+		bench_logging();
+	if (ni_string_eq(group, "all") || ni_string_eq(group, "lease"))
+		bench_lease();
+	if (ni_string_eq(group, "all") || ni_string_eq(group, "xml") ||
+	    ni_string_eq(group, "dbus-xml"))
+		doc = bench_xml();
+	if (ni_string_eq(group, "all") || ni_string_eq(group, "dbus-xml"))
+		bench_dbus_xml(doc);
+	xml_document_free(doc);
+
+	pars = ni_json_new_object();
+	ni_json_object_set(pars, "devices", ni_json_new_int64(params.devices));
+	ni_json_object_set(pars, "routes", ni_json_new_int64(params.routes));
+	ni_json_object_set(pars, "lookups", ni_json_new_int64(params.lookups));
+	ni_json_object_set(pars, "loops", ni_json_new_int64(params.loops));
+
+	report = ni_json_new_object();
+	ni_json_object_set(report, "version", ni_json_new_string(PACKAGE_VERSION));
+	ni_json_object_set(report, "timestamp", ni_json_new_int64(time(NULL)));
+	ni_json_object_set(report, "parameters", pars);
+	ni_json_object_set(report, "results", results);
+
+	if (output && !(fp = fopen(output, "w"))) {
+		fprintf(stderr, "cannot open %s: %m\n", output);
+		ni_json_free(report);
+		return 1;
+	}
+	fprintf(fp, "%s\n", ni_json_format_string(&buf, report, NULL));
+	if (fp != stdout)
+		fclose(fp);
+
+	ni_stringbuf_destroy(&buf);
+	ni_json_free(report);
+	return 0;
+}
@@ -1,8 +1,17 @@
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 #include <signal.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
 
 #include <wicked/fsm.h>
 
@@ -11,12 +20,220 @@
 
 extern ni_global_t ni_global;
 
-int main(int argc, char **argv)
+/*
+ * Client state store test
+ *
+ *   cstate-test				print demo
+ *   cstate-test store <dir>			append, compaction and torn write test
+ *
+ * The store test runs the readers and the other writers in fresh
+ * processes of this program:
+ *
+ *   cstate-test write <dir> <ifindex>=<origin>|- ...
+ *   cstate-test verify <dir> <ifindex>=<origin>|- ...
+ *
+ * where "-" drops resp. expects no state for the ifindex.
+ */
+static const char *	self;
+static const char *	statedir;
+static unsigned int	failures;
+
+static char *
+store_path(void)
+{
+	static char path[PATH_MAX];
+
+	snprintf(path, sizeof(path), "%s/client-state.log", statedir);
+	return path;
+}
+
+static ni_bool_t
+store_save(unsigned int ifindex, const char *origin)
+{
+	ni_client_state_t *cs;
+	ni_bool_t ret;
+
+	if (!origin || !strcmp(origin, "-"))
+		return ni_client_state_drop(ifindex);
+
+	if (!(cs = ni_client_state_new(NI_FSM_STATE_DEVICE_UP)))
+		return FALSE;
+	ni_string_dup(&cs->config.origin, origin);
+	ret = ni_client_state_save(cs, ifindex);
+	ni_client_state_free(cs);
+	return ret;
+}
+
+static ni_bool_t
+store_check(unsigned int ifindex, const char *origin)
+{
+	ni_client_state_t *cs;
+	ni_bool_t found, ret;
+
+	if (!(cs = ni_client_state_new(0)))
+		return FALSE;
+	found = ni_client_state_load(cs, ifindex);
+	if (!origin || !strcmp(origin, "-"))
+		ret = !found;
+	else
+		ret = found && ni_string_eq(cs->config.origin, origin);
+	if (!ret)
+		fprintf(stderr, "ifindex %u: expected %s, found %s\n", ifindex,
+				origin, found ? cs->config.origin : "-");
+	ni_client_state_free(cs);
+	return ret;
+}
+
+static int
+store_cmd(int argc, char **argv, ni_bool_t (*func)(unsigned int, const char *))
+{
+	unsigned int ifindex;
+	char *sep;
+	int i, ret = 0;
+
+	for (i = 0; i < argc; ++i) {
+		if (!(sep = strchr(argv[i], '=')) || sscanf(argv[i], "%u=", &ifindex) != 1)
+			return 2;
+		if (!func(ifindex, sep + 1))
+			ret = 1;
+	}
+	if (!ni_client_state_flush())
+		ret = 1;
+	return ret;
+}
+
+static int
+run(const char *cmd, ...)
+{
+	const char *argv[32];
+	unsigned int argc = 0;
+	va_list ap;
+	pid_t pid;
+	int status;
+
+	argv[argc++] = self;
+	argv[argc++] = cmd;
+	argv[argc++] = statedir;
+	va_start(ap, cmd);
+	while (argc < 31 && (argv[argc] = va_arg(ap, const char *)))
+		argc++;
+	va_end(ap);
+	argv[argc] = NULL;
+
+	if ((pid = fork()) == 0) {
+		execv(self, (char **)argv);
+		_exit(127);
+	}
+	if (pid < 0 || waitpid(pid, &status, 0) < 0)
+		return -1;
+	return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+static void
+expect(const char *what, ni_bool_t ok)
+{
+	printf("%-48s %s\n", what, ok ? "ok" : "FAILED");
+	if (!ok)
+		failures++;
+}
+
+static off_t
+store_size(ino_t *ino)
+{
+	struct stat stb;
+
+	if (stat(store_path(), &stb) < 0)
+		return -1;
+	if (ino)
+		*ino = stb.st_ino;
+	return stb.st_size;
+}
+
+static int
+store_test(void)
+{
+	char origin[128];
+	off_t size, before;
+	ino_t ino, ino2;
+	unsigned int i;
+	int fd;
+
+	expect("initial states written",
+		store_save(1, "p-1") && store_save(2, "p-2") && store_save(3, "p-3") &&
+		ni_client_state_flush() && store_size(NULL) > 0);
+
+	expect("other process appends",
+		run("write", "4=c-4", NULL) == 0);
+
+	before = store_size(NULL);
+	expect("append after foreign append",
+		store_save(5, "p-5") && ni_client_state_flush() && store_size(NULL) > before);
+	expect("all records visible to a new reader",
+		run("verify", "1=p-1", "2=p-2", "3=p-3", "4=c-4", "5=p-5", NULL) == 0);
+	expect("foreign record visible to this process",
+		store_check(4, "c-4"));
+
+	/* a writer died in the middle of a record */
+	size = store_size(NULL);
+	if ((fd = open(store_path(), O_WRONLY | O_APPEND)) >= 0) {
+		if (write(fd, "\x06\0\0\0\x40\0", 6) != 6)
+			failures++;
+		close(fd);
+	}
+	expect("reader ignores torn record",
+		run("verify", "1=p-1", "4=c-4", "5=p-5", "6=-", NULL) == 0);
+	expect("writer truncates torn record",
+		store_save(6, "p-6") && ni_client_state_flush() &&
+		run("verify", "5=p-5", "6=p-6", NULL) == 0);
+	expect("no torn bytes left in the log",
+		store_size(NULL) > size && store_size(NULL) < size + 6 + 256);
+
+	/* another process compacts the log, replacing it */
+	store_size(&ino);
+	for (i = 0; i < 1000; ++i) {
+		snprintf(origin, sizeof(origin), "7=c-7-%u-%0*u", i, 48, 0);
+		if (run("write", origin, NULL) != 0)
+			break;
+		store_size(&ino2);
+		if (ino2 != ino)
+			break;
+	}
+	expect("other process compacted the log", ino2 != ino);
+	expect("append after foreign compaction",
+		store_save(8, "p-8") && ni_client_state_flush());
+	snprintf(origin, sizeof(origin), "7=c-7-%u-%0*u", i, 48, 0);
+	expect("records survive foreign compaction",
+		run("verify", "1=p-1", "2=p-2", "3=p-3", "4=c-4", "5=p-5",
+			"6=p-6", origin, "8=p-8", NULL) == 0);
+
+	expect("drop",
+		store_save(2, "-") && ni_client_state_flush() &&
+		run("verify", "1=p-1", "2=-", "3=p-3", NULL) == 0);
+
+	/* this process compacts the log */
+	store_size(&ino);
+	for (i = 0; i < 2000; ++i) {
+		snprintf(origin, sizeof(origin), "p-1-%u-%0*u", i, 48, 0);
+		if (!store_save(1, origin) || !ni_client_state_flush())
+			break;
+	}
+	store_size(&ino2);
+	expect("compaction", i == 2000 && ino2 != ino && store_size(NULL) < 65536 * 2);
+	expect("append after compaction",
+		store_save(9, "p-9") && ni_client_state_flush());
+	snprintf(origin, sizeof(origin), "1=p-1-%u-%0*u", i - 1, 48, 0);
+	expect("records survive compaction",
+		run("verify", origin, "2=-", "3=p-3", "4=c-4", "9=p-9", NULL) == 0);
+
+	return failures ? 1 : 0;
+}
+
+static int
+print_test(void)
 {
 	ni_client_state_t *cs;
 	const unsigned int ifindex1 = 1, ifindex2 = 2;
 
-	ni_global.config = ni_config_new();
 	ni_enable_debug("all");
 
 	if (!(cs = ni_client_state_new(NI_FSM_STATE_DEVICE_UP)))
@@ -38,7 +255,35 @@ int main(int argc, char **argv)
 
 	ni_client_state_free(cs);
 	ni_client_state_drop(ifindex2);
+	ni_client_state_flush();
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int ret;
+
+	ni_global.config = ni_config_new();
+	self = argv[0];
+
+	if (argc >= 3) {
+		statedir = argv[2];
+		ni_string_dup(&ni_global.config->statedir.path, statedir);
+	}
+
+	if (argc == 3 && !strcmp(argv[1], "store"))
+		ret = store_test();
+	else if (argc >= 3 && !strcmp(argv[1], "write"))
+		ret = store_cmd(argc - 3, argv + 3, store_save);
+	else if (argc >= 3 && !strcmp(argv[1], "verify"))
+		ret = store_cmd(argc - 3, argv + 3, store_check);
+	else if (argc == 1)
+		ret = print_test();
+	else {
+		fprintf(stderr, "Usage: %s [store|write|verify <statedir> ...]\n", argv[0]);
+		ret = 2;
+	}
 
 	ni_config_free(ni_global.config);
-	return 0;
+	return ret;
 }
@@ -0,0 +1,244 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+
+#include <wicked/util.h>
+#include <wicked/address.h>
+#include <wicked/addrconf.h>
+#include <wicked/xml.h>
+
+#include "appconfig.h"
+#include "leasefile.h"
+
+extern ni_global_t ni_global;
+
+/*
+ * Binary lease file test: encode/decode round trip, corrupted and
+ * truncated files and the fallback to the xml lease file.
+ */
+#define TEST_IFNAME		"lt0"
+#define TEST_HDR_LEN		16
+
+static unsigned int	failures;
+static char		binfile[PATH_MAX];
+static char		xmlfile[PATH_MAX];
+
+static void
+expect(const char *what, ni_bool_t ok)
+{
+	printf("%-48s %s\n", what, ok ? "ok" : "FAILED");
+	if (!ok)
+		failures++;
+}
+
+static ni_addrconf_lease_t *
+test_lease(void)
+{
+	ni_addrconf_lease_t *lease;
+	ni_sockaddr_t addr;
+
+	lease = ni_addrconf_lease_new(NI_ADDRCONF_DHCP, AF_INET);
+	lease->state = NI_ADDRCONF_STATE_GRANTED;
+	ni_string_dup(&lease->hostname, "lease-test");
+
+	inet_aton("192.0.2.10", &lease->dhcp4.address);
+	inet_aton("255.255.255.0", &lease->dhcp4.netmask);
+	inet_aton("192.0.2.1", &lease->dhcp4.server_id);
+	lease->dhcp4.lease_time = 3600;
+	lease->dhcp4.renewal_time = 1800;
+	lease->dhcp4.rebind_time = 3150;
+	ni_string_dup(&lease->dhcp4.message, "<a & \"b\">");
+
+	ni_sockaddr_parse(&addr, "192.0.2.10", AF_INET);
+	ni_address_new(AF_INET, 24, &addr, &lease->addrs);
+	return lease;
+}
+
+static char *
+lease_sprint(const ni_addrconf_lease_t *lease)
+{
+	xml_node_t *xml = NULL;
+	char *str;
+
+	if (!lease || ni_addrconf_lease_to_xml(lease, &xml, TEST_IFNAME) != 0)
+		return NULL;
+	str = xml_node_sprint(xml);
+	xml_node_free(xml);
+	return str;
+}
+
+static ni_bool_t
+file_put(const char *path, const void *data, size_t len)
+{
+	FILE *fp;
+	ni_bool_t ok;
+
+	if (!(fp = fopen(path, "w")))
+		return FALSE;
+	ok = fwrite(data, 1, len, fp) == len;
+	return fclose(fp) == 0 && ok;
+}
+
+static unsigned char *
+file_get(const char *path, size_t *len)
+{
+	unsigned char *data = NULL;
+	struct stat st;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY)) < 0)
+		return NULL;
+	if (fstat(fd, &st) == 0 && (data = malloc(st.st_size + 1)) &&
+	    read(fd, data, st.st_size) != st.st_size) {
+		free(data);
+		data = NULL;
+	}
+	*len = data ? (size_t)st.st_size : 0;
+	close(fd);
+	return data;
+}
+
+/* store a payload with a valid header, as a broken encoder would */
+static ni_bool_t
+file_put_payload(const unsigned char *orig, const void *payload, size_t len)
+{
+	unsigned char *data;
+	uint32_t val;
+	ni_bool_t ok;
+
+	data = malloc(TEST_HDR_LEN + len);
+	memcpy(data, orig, TEST_HDR_LEN);
+	memcpy(data + TEST_HDR_LEN, payload, len);
+	val = htonl(len);
+	memcpy(data + 8, &val, 4);
+	val = htonl(ni_crc32(0, payload, len));
+	memcpy(data + 12, &val, 4);
+	ok = file_put(binfile, data, TEST_HDR_LEN + len);
+	free(data);
+	return ok;
+}
+
+static ni_bool_t
+read_fails(void)
+{
+	ni_addrconf_lease_t *lease;
+
+	if (!(lease = ni_addrconf_lease_file_read(TEST_IFNAME, NI_ADDRCONF_DHCP, AF_INET)))
+		return TRUE;
+	ni_addrconf_lease_free(lease);
+	return FALSE;
+}
+
+static ni_bool_t
+load_fails(void)
+{
+	xml_node_t *xml;
+
+	if (!(xml = ni_addrconf_lease_file_load(binfile)))
+		return TRUE;
+	xml_node_free(xml);
+	return FALSE;
+}
+
+int main(int argc, char **argv)
+{
+	char tmpdir[] = "/tmp/lease-test.XXXXXX";
+	ni_addrconf_lease_t *lease;
+	unsigned char *data, *copy;
+	char *expected, *actual;
+	xml_node_t *xml;
+	size_t len;
+
+	ni_global.config = ni_config_new();
+	if (!mkdtemp(tmpdir))
+		return 1;
+	ni_string_dup(&ni_global.config->statedir.path, tmpdir);
+	ni_string_dup(&ni_global.config->storedir.path, tmpdir);
+	snprintf(binfile, sizeof(binfile), "%s/lease-%s-dhcp-ipv4.%s",
+			tmpdir, TEST_IFNAME, NI_ADDRCONF_LEASE_FILE_BIN);
+	snprintf(xmlfile, sizeof(xmlfile), "%s/lease-%s-dhcp-ipv4.%s",
+			tmpdir, TEST_IFNAME, NI_ADDRCONF_LEASE_FILE_XML);
+
+	expect("crc32 check value", ni_crc32(0, "123456789", 9) == 0xcbf43926U);
+	expect("crc32 continued", ni_crc32(ni_crc32(0, "1234", 4), "56789", 5) == 0xcbf43926U);
+
+	/* round trip */
+	lease = test_lease();
+	expected = lease_sprint(lease);
+	expect("lease written", expected &&
+		ni_addrconf_lease_file_write(TEST_IFNAME, lease) == 0);
+	ni_addrconf_lease_free(lease);
+
+	data = file_get(binfile, &len);
+	expect("binary lease file", data && len > TEST_HDR_LEN && !memcmp(data, "WLBL", 4));
+	if (!data || len <= TEST_HDR_LEN)
+		return 1;
+
+	xml = ni_addrconf_lease_file_load(binfile);
+	actual = xml ? xml_node_sprint(xml) : NULL;
+	expect("decoded xml equals encoded xml", ni_string_eq(actual, expected));
+	xml_node_free(xml);
+	ni_string_free(&actual);
+
+	lease = ni_addrconf_lease_file_read(TEST_IFNAME, NI_ADDRCONF_DHCP, AF_INET);
+	actual = lease_sprint(lease);
+	expect("lease read back unchanged", ni_string_eq(actual, expected));
+	ni_addrconf_lease_free(lease);
+	ni_string_free(&actual);
+
+	/* corrupted and truncated files */
+	copy = malloc(len);
+	memcpy(copy, data, len);
+	copy[len - 1] ^= 0x5a;
+	expect("payload corruption detected", file_put(binfile, copy, len) && load_fails());
+
+	memcpy(copy, data, len);
+	copy[5] = 0x7f;
+	expect("unknown version rejected", file_put(binfile, copy, len) && load_fails());
+
+	expect("truncated payload detected", file_put(binfile, data, len - 1) && load_fails());
+	expect("header only file rejected", file_put(binfile, data, TEST_HDR_LEN) && load_fails());
+	expect("truncated header rejected", file_put(binfile, data, 10) && load_fails());
+	expect("empty file rejected", file_put(binfile, data, 0) && read_fails());
+
+	/* checksum ok, but the encoding is broken */
+	expect("name beyond payload rejected",
+		file_put_payload(data, "\x05" "abc", 4) && load_fails());
+	expect("string beyond payload rejected",
+		file_put_payload(data, "\x01" "a\0\0\0\0\xff\xff\xff\x00", 10) && load_fails());
+	expect("missing children rejected",
+		file_put_payload(data, "\x01" "a\0\0\0\x02\xff\xff\xff\xff", 10) && load_fails());
+	memcpy(copy, data + TEST_HDR_LEN, len - TEST_HDR_LEN);
+	copy[len - TEST_HDR_LEN] = 0;
+	expect("trailing data rejected",
+		file_put_payload(data, copy, len - TEST_HDR_LEN + 1) && load_fails());
+
+	/* a broken binary lease falls back to the xml lease file */
+	lease = NULL;
+	if (file_put(binfile, data, len - 1) && file_put(xmlfile, expected, strlen(expected)))
+		lease = ni_addrconf_lease_file_read(TEST_IFNAME, NI_ADDRCONF_DHCP, AF_INET);
+	actual = lease_sprint(lease);
+	expect("xml fallback on broken binary lease", ni_string_eq(actual, expected));
+	ni_addrconf_lease_free(lease);
+	ni_string_free(&actual);
+
+	ni_addrconf_lease_file_remove(TEST_IFNAME, NI_ADDRCONF_DHCP, AF_INET);
+	expect("lease files removed", !ni_file_exists(binfile) && !ni_file_exists(xmlfile));
+	rmdir(tmpdir);
+
+	free(copy);
+	free(data);
+	ni_string_free(&expected);
+	ni_config_free(ni_global.config);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,401 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+
+#include <wicked/types.h>
+#include <wicked/util.h>
+#include <wicked/ovs.h>
+
+#include "ovsdb.h"
+#include "json.h"
+
+/*
+ * ovsdb client test against a stub ovsdb-server on a unix socket
+ * in $OVS_RUNDIR: monitor and echo handling, a batched bridge+ports
+ * transact, update notifications and transact error replies.
+ */
+static unsigned int	failures;
+
+static void
+expect(const char *what, ni_bool_t ok)
+{
+	printf("%-48s %s\n", what, ok ? "ok" : "FAILED");
+	if (!ok)
+		failures++;
+}
+
+/*
+ * stub server
+ */
+static ni_json_t *
+stub_recv(int fd)
+{
+	ni_stringbuf_t buf = NI_STRINGBUF_INIT_DYNAMIC;
+	ni_bool_t string = FALSE, escape = FALSE;
+	unsigned int depth = 0;
+	ni_json_t *msg = NULL;
+	char cc;
+
+	while (read(fd, &cc, 1) == 1) {
+		if (depth == 0 && cc != '{')
+			continue;
+		ni_stringbuf_putc(&buf, cc);
+
+		if (string) {
+			if (escape)
+				escape = FALSE;
+			else if (cc == '\\')
+				escape = TRUE;
+			else if (cc == '"')
+				string = FALSE;
+		} else if (cc == '"') {
+			string = TRUE;
+		} else if (cc == '{' || cc == '[') {
+			depth++;
+		} else if ((cc == '}' || cc == ']') && --depth == 0) {
+			msg = ni_json_parse_string(buf.string);
+			break;
+		}
+	}
+	ni_stringbuf_destroy(&buf);
+	return msg;
+}
+
+static void
+stub_send(int fd, ni_json_t *msg)
+{
+	ni_stringbuf_t buf = NI_STRINGBUF_INIT_DYNAMIC;
+
+	if (ni_json_format_string(&buf, msg, NULL) &&
+	    write(fd, buf.string, buf.len) != (ssize_t)buf.len)
+		perror("stub: write");
+	ni_stringbuf_destroy(&buf);
+	ni_json_free(msg);
+}
+
+static void
+stub_send_string(int fd, const char *str)
+{
+	stub_send(fd, ni_json_parse_string(str));
+}
+
+static ni_bool_t
+stub_string_eq(ni_json_t *json, const char *str)
+{
+	char *value = NULL;
+	ni_bool_t ret;
+
+	ret = ni_json_string_get(json, &value) && ni_string_eq(value, str);
+	ni_string_free(&value);
+	return ret;
+}
+
+static ni_bool_t
+stub_is_request(ni_json_t *msg, const char *method)
+{
+	return stub_string_eq(ni_json_object_get_value(msg, "method"), method) &&
+		stub_string_eq(ni_json_array_get(ni_json_object_get_value(msg, "params"), 0),
+				"Open_vSwitch");
+}
+
+/* number of transact operations (with a mutator) on a table */
+static unsigned int
+stub_count_ops(ni_json_t *msg, const char *op, const char *table, const char *mutator)
+{
+	ni_json_t *params, *item, *mutation;
+	unsigned int i, n, count = 0;
+
+	params = ni_json_object_get_value(msg, "params");
+	n = ni_json_array_entries(params);
+	for (i = 1; i < n; ++i) {
+		item = ni_json_array_get(params, i);
+		if (!stub_string_eq(ni_json_object_get_value(item, "op"), op) ||
+		    !stub_string_eq(ni_json_object_get_value(item, "table"), table))
+			continue;
+		if (mutator) {
+			mutation = ni_json_array_get(ni_json_object_get_value(item, "mutations"), 0);
+			if (!stub_string_eq(ni_json_array_get(mutation, 1), mutator))
+				continue;
+		}
+		count++;
+	}
+	return count;
+}
+
+static ni_json_t *
+stub_reply(ni_json_t *msg, ni_json_t *result, ni_json_t *error)
+{
+	ni_json_t *reply = ni_json_new_object();
+
+	ni_json_object_set(reply, "id", ni_json_object_ref_value(msg, "id"));
+	ni_json_object_set(reply, "result", result ? result : ni_json_new_null());
+	ni_json_object_set(reply, "error", error ? error : ni_json_new_null());
+	return reply;
+}
+
+/* a successful result for each operation of a transact request */
+static ni_json_t *
+stub_transact_result(ni_json_t *msg, int64_t next_cfg)
+{
+	ni_json_t *params, *item, *result, *res, *rows, *row;
+	unsigned int i, n;
+	char uuid[32];
+
+	result = ni_json_new_array();
+	params = ni_json_object_get_value(msg, "params");
+	n = ni_json_array_entries(params);
+	for (i = 1; i < n; ++i) {
+		item = ni_json_array_get(params, i);
+		res = ni_json_new_object();
+		if (stub_string_eq(ni_json_object_get_value(item, "op"), "insert")) {
+			snprintf(uuid, sizeof(uuid), "new%u", i);
+			row = ni_json_new_array();
+			ni_json_array_append(row, ni_json_new_string("uuid"));
+			ni_json_array_append(row, ni_json_new_string(uuid));
+			ni_json_object_set(res, "uuid", row);
+		} else
+		if (stub_string_eq(ni_json_object_get_value(item, "op"), "select")) {
+			row = ni_json_new_object();
+			ni_json_object_set(row, "next_cfg", ni_json_new_int64(next_cfg));
+			rows = ni_json_new_array();
+			ni_json_array_append(rows, row);
+			ni_json_object_set(res, "rows", rows);
+		} else {
+			ni_json_object_set(res, "count", ni_json_new_int64(1));
+		}
+		ni_json_array_append(result, res);
+	}
+	return result;
+}
+
+static int
+stub_server(int lfd)
+{
+	ni_json_t *msg, *echo;
+	int fd;
+
+	if ((fd = accept(lfd, NULL, NULL)) < 0)
+		return 10;
+
+	/* the client has to answer echo requests while it waits */
+	stub_send_string(fd, "{\"method\":\"echo\",\"params\":[\"ping\"],\"id\":\"echo\"}");
+
+	if (!(msg = stub_recv(fd)) || !stub_is_request(msg, "monitor"))
+		return 1;
+	if (!(echo = stub_recv(fd)) ||
+	    !stub_string_eq(ni_json_object_get_value(echo, "id"), "echo") ||
+	    !stub_string_eq(ni_json_array_get(ni_json_object_get_value(echo, "result"), 0), "ping"))
+		return 2;
+	ni_json_free(echo);
+
+	stub_send(fd, stub_reply(msg, ni_json_parse_string("{"
+		"\"Open_vSwitch\":{\"r0\":{\"new\":{"
+			"\"bridges\":[\"uuid\",\"b0\"],\"next_cfg\":1,\"cur_cfg\":1}}},"
+		"\"Bridge\":{\"b0\":{\"new\":{"
+			"\"name\":\"br0\",\"ports\":[\"uuid\",\"p0\"]}}},"
+		"\"Port\":{\"p0\":{\"new\":{"
+			"\"name\":\"br0\",\"tag\":[\"set\",[]],\"fake_bridge\":false}}}"
+		"}"), NULL));
+	ni_json_free(msg);
+
+	/* bridge with two ports in one request */
+	if (!(msg = stub_recv(fd)) || !stub_is_request(msg, "transact") ||
+	    stub_count_ops(msg, "insert", "Bridge", NULL) != 1 ||
+	    stub_count_ops(msg, "insert", "Port", NULL) != 3 ||
+	    stub_count_ops(msg, "insert", "Interface", NULL) != 3 ||
+	    stub_count_ops(msg, "mutate", "Bridge", "insert") != 2 ||
+	    stub_count_ops(msg, "mutate", "Open_vSwitch", "insert") != 1 ||
+	    stub_count_ops(msg, "select", "Open_vSwitch", NULL) != 1)
+		return 3;
+	stub_send(fd, stub_reply(msg, stub_transact_result(msg, 2), NULL));
+	ni_json_free(msg);
+
+	/* the commit waits for cur_cfg to reach next_cfg */
+	stub_send_string(fd, "{\"method\":\"update\",\"id\":null,\"params\":[null,{"
+		"\"Open_vSwitch\":{\"r0\":{\"new\":{"
+			"\"bridges\":[\"set\",[[\"uuid\",\"b0\"],[\"uuid\",\"b1\"]]],"
+			"\"next_cfg\":2,\"cur_cfg\":1}}},"
+		"\"Bridge\":{\"b1\":{\"new\":{\"name\":\"br1\",\"ports\":[\"set\",["
+			"[\"uuid\",\"p1\"],[\"uuid\",\"pa\"],[\"uuid\",\"pb\"]]]}}},"
+		"\"Port\":{"
+			"\"p1\":{\"new\":{\"name\":\"br1\"}},"
+			"\"pa\":{\"new\":{\"name\":\"eth-a\"}},"
+			"\"pb\":{\"new\":{\"name\":\"eth-b\"}}}"
+		"}]}");
+	usleep(100000);
+	stub_send_string(fd, "{\"method\":\"update\",\"id\":null,\"params\":[null,{"
+		"\"Open_vSwitch\":{\"r0\":{\"new\":{"
+			"\"bridges\":[\"set\",[[\"uuid\",\"b0\"],[\"uuid\",\"b1\"]]],"
+			"\"next_cfg\":2,\"cur_cfg\":2}}}"
+		"}]}");
+
+	/* failed operation, with an update received before the reply */
+	if (!(msg = stub_recv(fd)) || !stub_is_request(msg, "transact") ||
+	    stub_count_ops(msg, "mutate", "Bridge", "delete") != 1)
+		return 4;
+	stub_send_string(fd, "{\"method\":\"update\",\"id\":null,\"params\":[null,{"
+		"\"Bridge\":{\"b0\":{\"new\":{\"name\":\"br0\",\"ports\":[\"set\",["
+			"[\"uuid\",\"p0\"],[\"uuid\",\"pc\"]]]}}},"
+		"\"Port\":{\"pc\":{\"new\":{\"name\":\"eth-c\"}}}"
+		"}]}");
+	stub_send(fd, stub_reply(msg, ni_json_parse_string("[{\"count\":0},"
+		"{\"error\":\"constraint violation\",\"details\":\"stub\"}]"), NULL));
+	ni_json_free(msg);
+
+	/* json-rpc error reply */
+	if (!(msg = stub_recv(fd)) || !stub_is_request(msg, "transact") ||
+	    stub_count_ops(msg, "mutate", "Open_vSwitch", "delete") != 1)
+		return 5;
+	stub_send(fd, stub_reply(msg, NULL, ni_json_new_string("not allowed")));
+	ni_json_free(msg);
+
+	/* a port deleted by another client */
+	if (!(msg = stub_recv(fd)) || !stub_is_request(msg, "transact"))
+		return 6;
+	stub_send_string(fd, "{\"method\":\"update\",\"id\":null,\"params\":[null,{"
+		"\"Bridge\":{\"b1\":{\"new\":{\"name\":\"br1\",\"ports\":[\"set\",["
+			"[\"uuid\",\"p1\"],[\"uuid\",\"pb\"]]]}}},"
+		"\"Port\":{\"pa\":{\"old\":{\"name\":\"eth-a\"}}}"
+		"}]}");
+	stub_send(fd, stub_reply(msg, stub_transact_result(msg, 2), NULL));
+	ni_json_free(msg);
+
+	/* client closed the connection */
+	if ((msg = stub_recv(fd))) {
+		ni_json_free(msg);
+		return 7;
+	}
+	close(fd);
+	return 0;
+}
+
+/*
+ * client
+ */
+static ni_bool_t
+bridge_has_ports(const char *brname, const char *names)
+{
+	ni_stringbuf_t buf = NI_STRINGBUF_INIT_DYNAMIC;
+	ni_ovs_bridge_port_array_t ports;
+	unsigned int i;
+	ni_bool_t ret;
+
+	ni_ovs_bridge_port_array_init(&ports);
+	if (ni_ovsdb_bridge_ports(brname, &ports) != 0)
+		return FALSE;
+
+	for (i = 0; i < ports.count; ++i) {
+		if (i)
+			ni_stringbuf_putc(&buf, ' ');
+		ni_stringbuf_puts(&buf, ports.data[i]->device.name);
+	}
+	ret = ni_string_eq(buf.string ? buf.string : "", names);
+	if (!ret)
+		fprintf(stderr, "%s: ports \"%s\", expected \"%s\"\n",
+				brname, buf.string, names);
+	ni_stringbuf_destroy(&buf);
+	ni_ovs_bridge_port_array_destroy(&ports);
+	return ret;
+}
+
+static int
+client_test(void)
+{
+	ni_ovsdb_txn_t *txn;
+	char *brname = NULL;
+
+	expect("connect and monitor", ni_ovsdb_available());
+	expect("bridge from monitor reply", ni_ovsdb_bridge_exists("br0") == 0);
+	expect("unknown bridge", ni_ovsdb_bridge_exists("br1") == 2);
+
+	txn = ni_ovsdb_txn_new();
+	expect("batched bridge and ports",
+		ni_ovsdb_txn_bridge_add(txn, "br1", NULL, 0, FALSE) &&
+		ni_ovsdb_txn_port_add(txn, "br1", "eth-a", TRUE) &&
+		ni_ovsdb_txn_port_add(txn, "br1", "eth-b", TRUE) &&
+		ni_ovsdb_txn_commit(txn) == 0);
+	ni_ovsdb_txn_free(txn);
+
+	expect("bridge from update", ni_ovsdb_bridge_exists("br1") == 0);
+	expect("bridge ports from update", bridge_has_ports("br1", "eth-a eth-b"));
+	expect("port to bridge",
+		ni_ovsdb_port_to_bridge("eth-b", &brname) == 0 &&
+		ni_string_eq(brname, "br1"));
+	ni_string_free(&brname);
+
+	txn = ni_ovsdb_txn_new();
+	expect("operation error reply",
+		ni_ovsdb_txn_port_del(txn, "br1", "eth-a") &&
+		ni_ovsdb_txn_commit(txn) < 0);
+	ni_ovsdb_txn_free(txn);
+	expect("update received while waiting", bridge_has_ports("br0", "eth-c"));
+
+	txn = ni_ovsdb_txn_new();
+	expect("json-rpc error reply",
+		ni_ovsdb_txn_bridge_del(txn, "br1") &&
+		ni_ovsdb_txn_commit(txn) < 0);
+	ni_ovsdb_txn_free(txn);
+	expect("connected after errors", ni_ovsdb_available());
+
+	txn = ni_ovsdb_txn_new();
+	expect("port add after errors",
+		ni_ovsdb_txn_port_add(txn, "br0", "eth-d", FALSE) &&
+		ni_ovsdb_txn_commit(txn) == 0);
+	ni_ovsdb_txn_free(txn);
+	expect("port delete from update", bridge_has_ports("br1", "eth-b"));
+
+	ni_ovsdb_close();
+	return failures ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+	char rundir[] = "/tmp/ovsdb-test.XXXXXX";
+	struct sockaddr_un sun;
+	int lfd, status, rv;
+	pid_t pid;
+
+	if (!mkdtemp(rundir))
+		return 1;
+	setenv("OVS_RUNDIR", rundir, 1);
+
+	memset(&sun, 0, sizeof(sun));
+	sun.sun_family = AF_UNIX;
+	snprintf(sun.sun_path, sizeof(sun.sun_path), "%s/db.sock", rundir);
+	if ((lfd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 ||
+	    bind(lfd, (struct sockaddr *)&sun, sizeof(sun)) < 0 ||
+	    listen(lfd, 1) < 0) {
+		perror("stub: listen");
+		return 1;
+	}
+
+	if ((pid = fork()) == 0)
+		_exit(stub_server(lfd));
+	close(lfd);
+
+	rv = client_test();
+
+	if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status)) {
+		status = -1;
+		rv = 1;
+	} else {
+		status = WEXITSTATUS(status);
+	}
+	expect("stub server checks", status == 0);
+	if (status)
+		fprintf(stderr, "stub server failed at step %d\n", status);
+
+	unlink(sun.sun_path);
+	rmdir(rundir);
+	return rv || status ? 1 : 0;
+}
@@ -0,0 +1,180 @@
+#!/bin/bash
+#
+# Load generator for wickedd and its dhcp supplicants.
+#
+# Creates a veth pair with one end in a separate network namespace,
+# floods rtnetlink events (link up/down, address add/del) on the host
+# end and, when dnsmasq is available, lets wicked acquire dhcp4/dhcp6
+# leases from the namespace end in a loop. The cpu time consumed by
+# the wicked daemons is sampled from /proc and reported as JSON.
+#
+
+name=wbench
+netns=wbench-ns
+rounds=1000
+leases=50
+output=""
+
+usage()
+{
+	echo "Usage: $0 [--name <ifname>] [--rounds <n>] [--leases <n>] [--output <file>]"
+	echo "  --rounds   link/address event rounds (default: $rounds)"
+	echo "  --leases   dhcp ifup/ifdown cycles, 0 to disable (default: $leases)"
+}
+
+while [ $# -gt 0 ]; do
+	case $1 in
+	--name)		name=$2 ; shift ;;
+	--rounds)	rounds=$2 ; shift ;;
+	--leases)	leases=$2 ; shift ;;
+	--output)	output=$2 ; shift ;;
+	-h|--help)	usage ; exit 0 ;;
+	*)		usage ; exit 1 ;;
+	esac
+	shift
+done
+
+test $(id -u) -eq 0 || { echo "$0: needs to run as root" >&2 ; exit 1 ; }
+
+peer="${name}p"
+tmpdir=$(mktemp -d /tmp/wicked-bench.XXXXXX) || exit 1
+
+cleanup()
+{
+	test -f "$tmpdir/dnsmasq.pid" && kill $(cat "$tmpdir/dnsmasq.pid") 2>/dev/null
+	ip link del "$name" 2>/dev/null
+	ip netns del "$netns" 2>/dev/null
+	rm -rf "$tmpdir"
+}
+trap cleanup EXIT
+
+now_usec()
+{
+	local t=$(date +%s%N)
+	echo $((t / 1000))
+}
+
+# utime + stime of the process in clock ticks
+cpu_ticks()
+{
+	local pid=$(pidof -s "$1")
+	test -n "$pid" -a -r "/proc/$pid/stat" || { echo 0 ; return ; }
+	set -- $(sed -e 's/^.*) //' "/proc/$pid/stat")
+	echo $((${12} + ${13}))
+}
+
+daemons="wickedd wickedd-nanny wickedd-dhcp4 wickedd-dhcp6"
+declare -A ticks_before
+
+sample_before()
+{
+	local d
+	for d in $daemons ; do
+		ticks_before[$d]=$(cpu_ticks $d)
+	done
+}
+
+# emits the per-daemon cpu usage since sample_before as JSON members
+sample_after()
+{
+	local d sep="" hz=$(getconf CLK_TCK)
+	for d in $daemons ; do
+		local after=$(cpu_ticks $d)
+		local delta=$((after - ${ticks_before[$d]}))
+		echo -n "$sep\"$d\": $((delta * 1000 / hz))"
+		sep=", "
+	done
+}
+
+results=()
+
+# group name iterations usec cpu-members
+add_result()
+{
+	local nsec=0
+	test $3 -gt 0 && nsec=$(($4 * 1000 / $3))
+	results+=("{ \"group\": \"$1\", \"name\": \"$2\", \"iterations\": $3, \"total-usec\": $4, \"nsec-per-op\": $nsec, \"cpu-msec\": { $5 } }")
+}
+
+ip netns add "$netns" || exit 1
+ip link add "$name" type veth peer name "$peer" || exit 1
+ip link set "$peer" netns "$netns" || exit 1
+ip -n "$netns" link set lo up
+ip -n "$netns" link set "$peer" up
+ip -n "$netns" addr add 192.168.234.1/24 dev "$peer"
+ip -n "$netns" addr add fd00:234::1/64 dev "$peer" nodad
+
+# link up/down flood
+sample_before
+start=$(now_usec)
+for ((i = 0; i < rounds; i++)); do
+	ip link set "$name" up
+	ip link set "$name" down
+done
+stop=$(now_usec)
+add_result rtnl link-updown $((rounds * 2)) $((stop - start)) "$(sample_after)"
+
+# address add/del flood, via batch mode to keep the fork overhead low
+ip link set "$name" up
+for ((i = 0; i < rounds; i++)); do
+	a=$((i % 250 + 2))
+	echo "addr add 192.168.235.$a/32 dev $name"
+	echo "addr del 192.168.235.$a/32 dev $name"
+done > "$tmpdir/addr.batch"
+sample_before
+start=$(now_usec)
+ip -force -batch "$tmpdir/addr.batch" 2>/dev/null
+stop=$(now_usec)
+add_result rtnl addr-adddel $((rounds * 2)) $((stop - start)) "$(sample_after)"
+ip link set "$name" down
+
+# dhcp4/dhcp6 lease acquisition
+if [ $leases -gt 0 ] && type -p dnsmasq >/dev/null && type -p wicked >/dev/null ; then
+	ip netns exec "$netns" dnsmasq --pid-file="$tmpdir/dnsmasq.pid" \
+		--interface="$peer" --bind-interfaces --port=0 \
+		--dhcp-range=192.168.234.10,192.168.234.250,5m \
+		--dhcp-range=fd00:234::10,fd00:234::ff,64,5m \
+		--enable-ra --leasefile-ro --log-facility=/dev/null
+
+	cat > "$tmpdir/$name.xml" <<-EOF
+	<interface>
+	  <name>$name</name>
+	  <control><mode>manual</mode></control>
+	  <ipv4:dhcp><enabled>true</enabled></ipv4:dhcp>
+	  <ipv6:dhcp><enabled>true</enabled><mode>managed</mode></ipv6:dhcp>
+	</interface>
+	EOF
+
+	sample_before
+	start=$(now_usec)
+	for ((i = 0; i < leases; i++)); do
+		wicked ifup --ifconfig "$tmpdir/$name.xml" --timeout 30 "$name" >/dev/null 2>&1
+		wicked ifdown "$name" >/dev/null 2>&1
+	done
+	stop=$(now_usec)
+	add_result dhcp ifup-ifdown $leases $((stop - start)) "$(sample_after)"
+else
+	results+=("{ \"group\": \"dhcp\", \"skipped\": \"dnsmasq or wicked not available\" }")
+fi
+
+report()
+{
+	local sep=""
+	echo "{"
+	echo "  \"timestamp\": $(date +%s),"
+	echo "  \"parameters\": { \"rounds\": $rounds, \"leases\": $leases },"
+	echo "  \"results\": ["
+	for r in "${results[@]}" ; do
+		echo -n "$sep    $r"
+		sep=$',\n'
+	done
+	echo
+	echo "  ]"
+	echo "}"
+}
+
+if [ -n "$output" ]; then
+	report > "$output"
+else
+	report
+fi
@@ -0,0 +1,238 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/rtnetlink.h>
+
+#include <wicked/util.h>
+#include <wicked/netinfo.h>
+#include <wicked/address.h>
+#include <wicked/route.h>
+
+#include "appconfig.h"
+#include "netinfo_priv.h"
+#include "snapshot.h"
+
+extern ni_global_t ni_global;
+
+/*
+ * State snapshot test: publish, partial updates of changed records,
+ * route changes and the replacement of an outgrown file.
+ */
+static unsigned int	failures;
+static char		path[PATH_MAX];
+
+static void
+expect(const char *what, ni_bool_t ok)
+{
+	printf("%-48s %s\n", what, ok ? "ok" : "FAILED");
+	if (!ok)
+		failures++;
+}
+
+static ni_netdev_t *
+test_netdev(ni_netconfig_t *nc, unsigned int ifindex)
+{
+	ni_netdev_t *dev;
+	char name[IFNAMSIZ];
+
+	snprintf(name, sizeof(name), "st%u", ifindex);
+	dev = ni_netdev_new(name, ifindex);
+	dev->link.mtu = 1500;
+	ni_netconfig_device_append(nc, dev);
+	return dev;
+}
+
+static ni_bool_t
+test_route_add(ni_netdev_t *dev, const char *dest, unsigned int prefixlen)
+{
+	ni_route_t *rp;
+
+	rp = ni_route_new();
+	rp->family = AF_INET;
+	rp->prefixlen = prefixlen;
+	rp->table = RT_TABLE_MAIN;
+	rp->nh.device.index = dev->link.ifindex;
+	if (ni_sockaddr_parse(&rp->destination, dest, AF_INET) < 0 ||
+	    !ni_route_tables_add_route(&dev->routes, rp)) {
+		ni_route_free(rp);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static const ni_route_t *
+test_route_first(const ni_netdev_t *dev)
+{
+	const ni_route_table_t *tab;
+
+	for (tab = dev ? dev->routes : NULL; tab; tab = tab->next) {
+		if (tab->routes.count)
+			return tab->routes.data[0];
+	}
+	return NULL;
+}
+
+static unsigned int
+test_route_count(const ni_netdev_t *dev)
+{
+	const ni_route_table_t *tab;
+	unsigned int n = 0;
+
+	for (tab = dev ? dev->routes : NULL; tab; tab = tab->next)
+		n += tab->routes.count;
+	return n;
+}
+
+/* the published header as seen by a reader */
+static ni_bool_t
+header_get(ni_state_snapshot_header_t *hdr)
+{
+	int fd;
+	ni_bool_t ok;
+
+	if ((fd = open(path, O_RDONLY)) < 0)
+		return FALSE;
+	ok = read(fd, hdr, sizeof(*hdr)) == sizeof(*hdr);
+	close(fd);
+	return ok;
+}
+
+/* overwrite payload bytes, so we can tell whether they were rewritten */
+static ni_bool_t
+payload_poke(size_t offset, unsigned char value)
+{
+	ni_bool_t ok;
+	int fd;
+
+	if ((fd = open(path, O_WRONLY)) < 0)
+		return FALSE;
+	ok = pwrite(fd, &value, 1, sizeof(ni_state_snapshot_header_t) + offset) == 1;
+	close(fd);
+	return ok;
+}
+
+static int
+payload_peek(size_t offset)
+{
+	unsigned char value;
+	int fd, ret = -1;
+
+	if ((fd = open(path, O_RDONLY)) < 0)
+		return -1;
+	if (pread(fd, &value, 1, sizeof(ni_state_snapshot_header_t) + offset) == 1)
+		ret = value;
+	close(fd);
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	char tmpdir[] = "/tmp/snapshot-test.XXXXXX";
+	ni_state_snapshot_header_t hdr, prev;
+	ni_netconfig_t *nc, *loaded;
+	ni_netdev_t *dev1, *dev2, *dev;
+	const ni_route_t *rp;
+	unsigned int i;
+	ni_bool_t ok;
+
+	ni_global.config = ni_config_new();
+	if (!mkdtemp(tmpdir))
+		return 1;
+	ni_string_dup(&ni_global.config->statedir.path, tmpdir);
+	snprintf(path, sizeof(path), "%s/%s", tmpdir, NI_STATE_SNAPSHOT_FILE);
+
+	nc = ni_netconfig_new();
+	dev1 = test_netdev(nc, 1);
+	dev2 = test_netdev(nc, 2);
+
+	expect("snapshot opened", ni_state_snapshot_open());
+	ni_state_snapshot_commit(nc);
+	loaded = ni_state_snapshot_load(path);
+	expect("devices published", loaded &&
+		ni_netdev_by_index(loaded, 1) && ni_netdev_by_index(loaded, 2) &&
+		ni_string_eq(ni_netdev_by_index(loaded, 2)->name, "st2"));
+	ni_netconfig_free(loaded);
+	expect("header", header_get(&prev) && prev.count == 2 && !(prev.seq & 1));
+
+	ni_state_snapshot_commit(nc);
+	expect("nothing marked, nothing published",
+		header_get(&hdr) && hdr.seq == prev.seq && hdr.generation == prev.generation);
+
+	ni_state_snapshot_mark(1);
+	ni_state_snapshot_commit(nc);
+	expect("unchanged device is not republished",
+		header_get(&hdr) && hdr.seq == prev.seq && hdr.generation == prev.generation);
+
+	/* dev1's record is first: the length prefix, then ifindex 1 */
+	ok = payload_poke(4, 0x55);
+	dev2->link.mtu = 9000;
+	ni_state_snapshot_mark(2);
+	ni_state_snapshot_commit(nc);
+	expect("changed device is republished",
+		header_get(&hdr) && hdr.generation == prev.generation + 1 && !(hdr.seq & 1));
+	expect("records in front of it are not rewritten", ok && payload_peek(4) == 0x55);
+	payload_poke(4, 1);
+	loaded = ni_state_snapshot_load(path);
+	dev = loaded ? ni_netdev_by_index(loaded, 2) : NULL;
+	expect("changed device read back", dev && dev->link.mtu == 9000);
+	ni_netconfig_free(loaded);
+
+	/* dev1 grows, so dev2 moves and has to be rewritten */
+	expect("route added", test_route_add(dev1, "192.0.2.0", 24));
+	ni_state_snapshot_mark(1);
+	ni_state_snapshot_commit(nc);
+	loaded = ni_state_snapshot_load(path);
+	expect("route change published",
+		loaded && test_route_count(ni_netdev_by_index(loaded, 1)) == 1 &&
+		(dev = ni_netdev_by_index(loaded, 2)) && dev->link.mtu == 9000);
+	rp = test_route_first(loaded ? ni_netdev_by_index(loaded, 1) : NULL);
+	expect("route destination read back", rp && rp->prefixlen == 24 &&
+		ni_sockaddr_equal(&rp->destination, &test_route_first(dev1)->destination));
+	ni_netconfig_free(loaded);
+
+	/* the file is replaced when the payload outgrows it */
+	header_get(&prev);
+	for (i = 0; i < 2048; ++i) {
+		char dest[32];
+
+		snprintf(dest, sizeof(dest), "10.%u.%u.0", i / 256, i % 256);
+		test_route_add(dev2, dest, 24);
+	}
+	ni_state_snapshot_mark(2);
+	ni_state_snapshot_commit(nc);
+	loaded = ni_state_snapshot_load(path);
+	expect("outgrown snapshot replaced",
+		header_get(&hdr) && hdr.capacity > prev.capacity &&
+		hdr.generation == prev.generation + 1);
+	expect("all records in the replacement",
+		loaded && test_route_count(ni_netdev_by_index(loaded, 1)) == 1 &&
+		test_route_count(ni_netdev_by_index(loaded, 2)) == 2048);
+	ni_netconfig_free(loaded);
+
+	/* deleted devices are dropped */
+	ni_netconfig_device_remove(nc, dev1);
+	ni_state_snapshot_mark(1);
+	ni_state_snapshot_commit(nc);
+	loaded = ni_state_snapshot_load(path);
+	expect("deleted device dropped",
+		loaded && !ni_netdev_by_index(loaded, 1) &&
+		test_route_count(ni_netdev_by_index(loaded, 2)) == 2048);
+	ni_netconfig_free(loaded);
+
+	ni_state_snapshot_close();
+	expect("snapshot removed on close", !ni_file_exists(path));
+	rmdir(tmpdir);
+
+	ni_netconfig_free(nc);
+	ni_config_free(ni_global.config);
+	return failures ? 1 : 0;
+}